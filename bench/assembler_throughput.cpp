@@ -0,0 +1,79 @@
+/**
+ * @file assembler_throughput.cpp
+ * @brief Measures Assembler throughput on a generated source, in lines and megabytes per second.
+ *
+ * Usage: assembler-bench [lines] [repetitions] [threads]
+ *
+ * The source mixes register, memory, branch and jump instructions with a label every eight lines,
+ * half of the branches referring forward so the fixup pass is exercised. It is written to a temporary
+ * file and assembled from there, so the timing includes mapping both files. `threads` defaults to one per
+ * hardware thread; compare runs with 1 and N threads to see how assembly scales.
+ */
+
+#include <utils/assembler.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+    std::string generateSource(size_t lines) {
+        static constexpr const char* Body[] = {
+            "ADD R1, R2, R3",
+            "SUB R4 R5 R6 ; comment",
+            "LDR R7 [R8] 0x40",
+            "STR R7 [R9] -16",
+            "LSL R10 R11 5",
+            "MOV R12 R13",
+            "PADD.B R1 R2 R3",
+        };
+        std::string source;
+        source.reserve(lines * 24);
+        for (size_t i = 0; i < lines; ++i) {
+            if (i % 8 == 0) {
+                source += "L" + std::to_string(i / 8) + ":\n";
+                ++i;
+            }
+            if (i % 8 == 7) {
+                size_t block = i / 8;
+                // Alternate backward references and forward references to the next block
+                source += "BNE R1 R2 L" + std::to_string(block % 2 ? block : block + 1) + "\n";
+            } else {
+                source += Body[i % std::size(Body)];
+                source += '\n';
+            }
+        }
+        source += "L" + std::to_string(lines / 8 + 1) + ": HLT\n";
+        return source;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const size_t lines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+    const unsigned threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : 0;
+
+    const std::string source = generateSource(lines);
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "xr32-assembler-bench.s";
+    const std::filesystem::path output = std::filesystem::temp_directory_path() / "xr32-assembler-bench.bin";
+    std::ofstream(path, std::ios::binary) << source;
+
+    double best = 0;
+    for (int run = 0; run < repetitions; ++run) {
+        Assembler assembler(threads);
+        auto start = std::chrono::steady_clock::now();
+        assembler.assemble(path.string(), output.string());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = run == 0 ? elapsed.count() : std::min(best, elapsed.count());
+    }
+    std::filesystem::remove(path);
+    std::filesystem::remove(output);
+
+    std::printf("%zu lines, %.1f MB: best of %d %.3f s, %.2f M lines/s, %.1f MB/s\n", lines, source.size() / 1e6,
+                repetitions, best, lines / best / 1e6, source.size() / best / 1e6);
+    return 0;
+}
@@ -2,17 +2,29 @@
 #define CPU_HPP
 
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <concepts>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <variant>
+#include <vector>
 #include <string_view>
 #include <unordered_map>
 #include <components/memory.hpp>
 #include <components/io.hpp>
 #include <components/interrupts.hpp>
 #include <components/isa.hpp>
+#include <components/pmu.hpp>
+#include <components/timeline.hpp>
+#include <components/trace.hpp>
+#include <utils/perfect_hash.hpp>
 
-constexpr std::array<std::pair<uint8_t, std::string_view>, 45> Hex2Register {{
+class ExecutionJournal; // Forward declaration
+
+constexpr std::array<std::pair<uint8_t, std::string_view>, 54> Hex2Register {{
     {0x0, "R0"}, {0x1, "R1"}, {0x2, "R2"}, {0x3, "R3"},
     {0x4, "R4"}, {0x5, "R5"}, {0x6, "R6"}, {0x7, "R7"},
     {0x8, "R8"}, {0x9, "R9"}, {0xA, "R10"}, {0xB, "R11"},
@@ -24,25 +36,60 @@ constexpr std::array<std::pair<uint8_t, std::string_view>, 45> Hex2Register {{
     {0x20, "I0"}, {0x21, "S0"}, {0x22, "S1"}, {0x23, "FR"},
     {0x24, "IVTR"}, {0x25, "IE0"}, {0x26, "IE1"}, {0x27, "IE2"},
     {0x28, "IE3"}, {0x29, "TPDR"}, {0x2A, "TSP"}, {0x2B, "PRR"},
-    {0x2C, "MSR"}
+    {0x2C, "MSR"}, {0x2E, "PMCR"}, {0x2F, "PMOVS"}, {0x30, "PMC0"},
+    {0x31, "PMC1"}, {0x32, "PMC2"}, {0x33, "PMC3"}, {0x34, "PMC4"},
+    {0x35, "CID"}, {0x36, "IPIR"}
 }};
 
-constexpr std::array<std::pair<std::string_view, uint64_t>, 38> Instruction2Hex {{
-    {"ADD", 0x01}, {"SUB", 0x02}, {"AND", 0x03}, {"OR", 0x04}, {"XOR", 0x05},
-    {"LSL", 0x06}, {"LSR", 0x07}, {"LDR", 0x08}, {"STR", 0x09}, {"JMP", 0x0A},
-    {"JAL", 0x0B}, {"BEQ", 0x0C}, {"BNE", 0x0D}, {"MOV", 0x0E}, {"CMP", 0x0F},
-    {"PUSH", 0x10}, {"POP", 0x11}, {"CALL", 0x12}, {"RET", 0x13}, {"IRET", 0x14},
-    {"NOP", 0x15}, {"HLT", 0x16}, {"MUL", 0x17}, {"DIV", 0x18}, {"MOD", 0x19},
-    {"NOT", 0x1A}, {"NEG", 0x1B}, {"INC", 0x1C}, {"DEC", 0x1D}, {"ASL", 0x1E},
-    {"ASR", 0x1F}, {"SWI", 0x20}, {"SEXT", 0x21}, {"ZEXT", 0x22},
-    {"MFS", 0x23}, {"MTS", 0x24}, {"OUT", 0x25}, {"IN", 0x26}
-}};
+/// Mnemonics to opcodes, from OpcodeTable.
+constexpr auto Instruction2Hex = [] {
+    constexpr size_t Count = [] {
+        size_t named = 0;
+        for (const OpcodeInfo& info : OpcodeTable) {
+            named += !info.mnemonic.empty();
+        }
+        return named;
+    }();
+    std::array<std::pair<std::string_view, uint64_t>, Count> names{};
+    size_t next = 0;
+    for (size_t opcode = 0; opcode < OpcodeTable.size(); ++opcode) {
+        if (!OpcodeTable[opcode].mnemonic.empty()) {
+            names[next++] = {OpcodeTable[opcode].mnemonic, opcode};
+        }
+    }
+    return names;
+}();
+
+/// Register names to encodings, the inverse of Hex2Register.
+constexpr auto Register2Hex = [] {
+    std::array<std::pair<std::string_view, uint8_t>, Hex2Register.size()> inverted{};
+    for (size_t i = 0; i < Hex2Register.size(); ++i) {
+        inverted[i] = {Hex2Register[i].second, Hex2Register[i].first};
+    }
+    return inverted;
+}();
+
+/// Compile-time perfect hashes of the mnemonic and register names, for the assembler.
+constexpr PerfectHashTable<uint64_t, Instruction2Hex.size()> InstructionLookup{Instruction2Hex};
+constexpr PerfectHashTable<uint8_t, Register2Hex.size()> RegisterLookup{Register2Hex};
+
+/**
+ * @brief Thrown when a core executes `HLT` with interrupts disabled; the core stops for good.
+ */
+class CpuHalted : public std::runtime_error {
+public:
+    CpuHalted() : std::runtime_error("CPU Halted") {}
+};
 
 /**
  * @brief CPU class simulates the XR-32 architecture CPU.
  *
  * Manages the execution of instructions, interacting with memory, IO, and handling interrupts.
  * Provides methods to execute instructions, reset the CPU state, and manage registers.
+ *
+ * A CPU constructed with a memory size is the boot core of a machine and owns its physical memory
+ * and devices. Secondary cores of an SMP machine are constructed from the boot core and share both;
+ * each core keeps its own registers, TLB and PMU and runs on its own host thread.
  */
 class CPU {
 public:
@@ -51,6 +98,18 @@ public:
      */
     CPU(size_t memorySize) noexcept;
 
+    /**
+     * @brief Constructs a secondary core sharing the boot core's physical memory and devices.
+     * 
+     * Must be called before any core starts executing. Makes the shared IO space thread-safe.
+     * 
+     * @param boot The boot core (core 0).
+     */
+    explicit CPU(CPU& boot);
+
+    CPU(const CPU&) = delete;
+    CPU& operator=(const CPU&) = delete;
+
     void executeNextInstruction();
     void reset() noexcept;
 
@@ -76,12 +135,157 @@ public:
     } registers;
 
     Memory memory;                    ///< memory component
-    IO io;                            ///< IO component
+private:
+    std::unique_ptr<IO> ownedIo;      ///< Set on the boot core only
+public:
+    IO& io;                           ///< IO component, shared by all cores
     Interrupts interrupts;            ///< interrupt handler
     InstructionSet isa;               ///< ISA component
+    PerformanceMonitor pmu;           ///< Performance monitoring unit
+
+    /**
+     * @brief Reads a special register by its index (0x20 and up, see Hex2Register).
+     * 
+     * @param index The special register index.
+     * @return The register value, or 0 for unassigned indices.
+     */
+    [[nodiscard]] uint32_t readSpecialRegister(uint8_t index) noexcept;
+
+    /**
+     * @brief Writes a special register by its index (0x20 and up, see Hex2Register).
+     * 
+     * Writes to read-only registers (`I0`, `PRR`) raise a General Protection Fault.
+     * 
+     * @param index The special register index.
+     * @param value The value to write; truncated for narrower registers.
+     */
+    void writeSpecialRegister(uint8_t index, uint32_t value);
+
+    /**
+     * @brief The core number, readable by the guest through `CID`.
+     */
+    [[nodiscard]] uint8_t id() const noexcept { return coreId; }
+
+    /**
+     * @brief Makes an interrupt pending on this core. Safe to call from any thread.
+     * 
+     * The interrupt is taken at the next instruction boundary at which `FR.I` is set, and wakes the core
+     * if it is waiting in `HLT`.
+     * 
+     * @param vector The interrupt vector.
+     */
+    void raiseInterrupt(uint8_t vector) noexcept;
+
+    /**
+     * @brief Executes `HLT`: waits for an interrupt if `FR.I` is set, otherwise stops the core.
+     * 
+     * @throws CpuHalted if interrupts are disabled, or if no other core or device could raise one.
+     */
+    void halt();
+
+    /**
+     * @brief Instructions this core has retired since it was constructed.
+     */
+    [[nodiscard]] uint64_t retired() const noexcept { return retiredInstructions; }
+
+    /**
+     * @brief Records this core's non-deterministic inputs to a journal, or replays them from one.
+     * 
+     * Covers port reads and asynchronous interrupts; the syscall layer journals its own inputs. While
+     * replaying, interrupts raised by devices are ignored and the logged ones are taken at the logged
+     * instruction counts instead. Single-core machines only.
+     * 
+     * @param log The journal, or nullptr to stop journaling.
+     */
+    void setJournal(ExecutionJournal* log) noexcept;
+
+    /**
+     * @brief Records every instruction this core retires, with its register writes and memory accesses.
+     * 
+     * @param recorder The core's recorder from an InstructionTrace, or nullptr to stop tracing.
+     */
+    void setTracer(InstructionTrace::Recorder* recorder) noexcept { traceRecorder = recorder; }
+
+    /**
+     * @brief The recorder memory accesses are reported to, or nullptr when not tracing.
+     */
+    [[nodiscard]] InstructionTrace::Recorder* tracer() const noexcept { return traceRecorder; }
+
+    /**
+     * @brief Records this core's interrupts, syscalls, mode switches, port accesses and `HLT` waits.
+     * 
+     * @param track The core's track from an EventTimeline, or nullptr to stop recording.
+     */
+    void setTimeline(EventTimeline::Track* track);
+
+    /**
+     * @brief The track events are reported to, or nullptr when no timeline is recorded.
+     */
+    [[nodiscard]] EventTimeline::Track* timeline() const noexcept { return timelineTrack; }
+
+    /**
+     * @brief Whether the core is waiting for an interrupt in `HLT`.
+     */
+    [[nodiscard]] bool halted() const noexcept { return waiting; }
+
+    /**
+     * @brief Wakes the core from `HLT`. Called on interrupt entry.
+     */
+    void resume() noexcept { waiting = false; }
+
+    /**
+     * @brief A load-linked reservation, cleared by `SC` and on interrupt entry.
+     */
+    struct Reservation {
+        uint32_t* word{nullptr}; ///< The reserved word in physical memory, or nullptr.
+        uint32_t value{0};       ///< The value `LL` observed.
+    } reservation;
 
 private:
+    /**
+     * @brief Sends an inter-processor interrupt as encoded in an `IPIR` write.
+     */
+    void sendIpi(uint32_t command) noexcept;
+
+    /**
+     * @brief Takes the lowest pending asynchronous interrupt if `FR.I` is set.
+     */
+    void deliverPendingInterrupt();
+
+    /**
+     * @brief Takes the interrupt the journal logged for the current instruction count, if any.
+     */
+    void replayInterrupt();
+
+    /**
+     * @brief Blocks a halted core until an interrupt is pending or a short timeout elapses.
+     */
+    void waitForInterrupt();
+
+    /**
+     * @brief Executes a fetched instruction between the recorder's begin() and end().
+     */
+    void traceInstruction(uint64_t instruction);
+
+    uint8_t coreId{0};                  ///< This core's number.
+    CPU& boot;                          ///< Core 0; holds the list of all cores.
+    std::vector<CPU*> cores;            ///< All cores, indexed by id (boot core only).
+    bool waiting{false};                ///< Halted with interrupts enabled.
+    uint64_t retiredInstructions{0};    ///< See retired().
+    ExecutionJournal* journal{nullptr}; ///< Records or replays asynchronous inputs, if set.
+    InstructionTrace::Recorder* traceRecorder{nullptr}; ///< See setTracer().
+    EventTimeline::Track* timelineTrack{nullptr};       ///< See setTimeline().
+
+    std::array<std::atomic<uint64_t>, 4> pendingVectors{}; ///< Bitmap of pending asynchronous vectors.
+    std::atomic<bool> interruptPending{false};             ///< Fast-path hint: some bit may be set.
+    std::atomic<bool> sleeping{false};                     ///< Set while parked in waitForInterrupt().
+    std::mutex sleepMutex;                                 ///< Guards `wakeup`.
+    std::condition_variable wakeup;                        ///< Parks a halted core.
+
+
     [[nodiscard]] uint64_t fetchInstruction() const; ///< Fetches the instruction code at the current I0
+
+    friend class MachineSnapshot;
     
 public:
     constexpr static std::string_view findRegister(uint8_t hex) {
@@ -93,20 +297,10 @@ public:
         return "Unknown";
     }
     constexpr static uint8_t findRegister(std::string_view register_name) {
-        for (const auto& [key, value] : Hex2Register) {
-            if (value == register_name) {
-                return key;
-            }
-        }
-        return 0xFF;
+        return RegisterLookup.find(register_name).value_or(0xFF);
     }
     constexpr static uint64_t findInstruction(std::string_view instruction) {
-        for (const auto& [key, value] : Instruction2Hex) {
-            if (key == instruction) {
-                return value;
-            }
-        }
-        return 0xFFFFFFFF;
+        return InstructionLookup.find(instruction).value_or(0xFFFFFFFF);
     }
 };
 
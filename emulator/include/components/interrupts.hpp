@@ -6,6 +6,7 @@
 #include <cstdint>
 
 class CPU;  // Forward declaration
+class SyscallEmulator;  // Forward declaration
 
 /**
  * @brief The Interrupts class manages interrupt handling for the CPU.
@@ -37,8 +38,19 @@ public:
      */
     void triggerIret();
 
+    /**
+     * @brief Installs user-mode syscall emulation.
+     * 
+     * While installed, vectors in the syscall window are serviced by the host, and exceptions the guest
+     * has no IVT for (`IVTR` is 0) stop emulation with a GuestFault instead of jumping to address 0.
+     * 
+     * @param handler The syscall emulator, or nullptr to restore normal delivery.
+     */
+    void setSyscallHandler(SyscallEmulator* handler) noexcept { syscalls = handler; }
+
 private:
     CPU& cpu;  ///< Reference to the CPU object to manage context and state during interrupts.
+    SyscallEmulator* syscalls{nullptr};  ///< User-mode syscall emulation, if enabled.
 
     /**
      * @brief Saves the current CPU context before an ISR is executed.
@@ -79,6 +91,7 @@ enum InterruptType {
     UserInterrupt1 = 0x08,
     UserInterrupt2 = 0x09,
     UserInterrupt3 = 0x0A,
+    PerformanceMonitorOverflow = 0x0B,
     Reserved = 0xFF,
 };
 
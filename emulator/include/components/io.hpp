@@ -2,10 +2,13 @@
 #define IO_HPP
 
 #include <functional>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 #include <cstdint>
 
 class CPU;  // Forward declaration
+class ExecutionJournal;  // Forward declaration
 
 /**
  * @brief The IO class manages input/output operations for the emulator.
@@ -26,12 +29,14 @@ public:
      * @brief Reads a 32-bit value from the specified I/O port.
      * 
      * This method invokes the read function mapped to the specified port and returns the result.
-     * If no device is mapped to the port, it returns 0 or a default value.
+     * If no device is mapped to the port, it returns 0 or a default value. While a journal replays,
+     * the logged value is returned and the device is not accessed.
      * 
      * @param port The I/O port to read from.
      * @return The 32-bit value read from the port.
+     * @throws ReplayDivergence if the journal logged a different input next.
      */
-    [[nodiscard]] uint32_t readPort(uint16_t port) const noexcept;
+    [[nodiscard]] uint32_t readPort(uint16_t port) const;
 
     /**
      * @brief Writes a 32-bit value to the specified I/O port.
@@ -57,11 +62,59 @@ public:
      */
     void mapDevice(uint16_t port, std::function<uint32_t()> readFunc, std::function<void(uint32_t)> writeFunc);
 
+    /**
+     * @brief Registers a function to be called periodically from the CPU thread.
+     * 
+     * Devices with asynchronous host-side input (sockets, files) use this to move completed work
+     * into guest memory and raise interrupts between instructions.
+     * 
+     * @param pollFunc The function to call on every poll.
+     */
+    void addPoller(std::function<void()> pollFunc);
+
+    /**
+     * @brief Runs all registered pollers.
+     */
+    void poll() {
+        std::unique_lock<std::mutex> lock(portMutex, std::defer_lock);
+        if (shared) {
+            lock.lock();
+        }
+        for (auto& poller : pollers) {
+            poller();
+        }
+    }
+
+    /**
+     * @brief Records a device that raises interrupts from other threads without being polled.
+     */
+    void addInterruptSource() noexcept { ++interruptSources; }
+
+    /**
+     * @brief Whether any device can raise interrupts asynchronously.
+     */
+    [[nodiscard]] bool hasInterruptSources() const noexcept { return !pollers.empty() || interruptSources > 0; }
+
+    /**
+     * @brief Serializes all port accesses and polls, for IO spaces used by several cores.
+     * 
+     * Devices are written for a single CPU thread; once shared, at most one core is inside a device
+     * handler at any time. Must be called before the cores start.
+     */
+    void share() noexcept { shared = true; }
+
 private:
     CPU& cpu;  ///< Reference to the CPU object for potential interactions with CPU state.
 
     std::unordered_map<uint16_t, std::function<uint32_t()>> readMap;  ///< Map of ports to their respective read functions.
     std::unordered_map<uint16_t, std::function<void(uint32_t)>> writeMap;  ///< Map of ports to their respective write functions.
+    std::vector<std::function<void()>> pollers;  ///< Device poll functions, run between instructions.
+    unsigned interruptSources{0};  ///< Unpolled devices that raise interrupts, see addInterruptSource().
+    bool shared{false};  ///< Set when several cores use this IO space.
+    mutable std::mutex portMutex;  ///< Serializes device access while shared.
+    ExecutionJournal* journal{nullptr};  ///< Records or replays port reads, set by CPU::setJournal().
+
+    [[nodiscard]] uint32_t readDevice(uint16_t port) const noexcept;
 
     /**
      * @brief Helper function to check if a port is mapped.
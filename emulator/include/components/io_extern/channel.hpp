@@ -0,0 +1,131 @@
+#ifndef CHANNEL_HPP
+#define CHANNEL_HPP
+
+#include <components/io.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CPU; // Forward declaration
+class ChannelDevice; // Forward declaration
+
+/**
+ * @brief A named block of host memory shared by the machines of one process, with doorbells.
+ *
+ * Each of a fixed number of endpoints maps the block into its machine's physical memory through a
+ * ChannelDevice, so guests exchange data with ordinary loads and stores at host memory speed, and
+ * notify each other with doorbell interrupts that wake a waiting `HLT`. The layout of the block is
+ * up to the guests (see ARCH.md, Inter-VM Channels).
+ */
+class Channel {
+public:
+    static constexpr size_t DefaultSize = 256 * 1024; ///< Window size unless configured otherwise.
+
+    /**
+     * @brief Creates the zeroed shared block.
+     *
+     * @param channelName Name of the channel, also used for the backing memfd.
+     * @param size Size in bytes, a multiple of the page size.
+     * @param endpointCount Number of machines that will connect (1-255).
+     * @throws std::runtime_error if the memory cannot be created.
+     */
+    Channel(std::string channelName, size_t size, unsigned endpointCount);
+    ~Channel();
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    [[nodiscard]] const std::string& name() const noexcept { return label; }
+    [[nodiscard]] size_t size() const noexcept { return length; }
+    [[nodiscard]] unsigned endpoints() const noexcept { return static_cast<unsigned>(devices.size()); }
+
+private:
+    friend class ChannelDevice;
+
+    void connect(unsigned endpoint, ChannelDevice& device);
+    void disconnect(unsigned endpoint) noexcept;
+
+    /**
+     * @brief Rings the doorbell of one endpoint, or of every endpoint except `from` for target 0xFF.
+     */
+    void ring(unsigned from, uint32_t target) noexcept;
+
+    std::string label;                    ///< Channel name.
+    size_t length;                        ///< Size of the shared block.
+    int fd{-1};                           ///< memfd holding the shared block.
+    std::mutex mutex;                     ///< Guards `devices` against endpoints going away.
+    std::vector<ChannelDevice*> devices;  ///< Connected device per endpoint, or nullptr.
+    std::atomic<uint32_t> connected{0};   ///< Number of connected endpoints.
+};
+
+/**
+ * @brief One machine's endpoint of a Channel, with the shared block mapped above its RAM.
+ *
+ * | Offset | Name      | Access | Description                                               |
+ * |--------|-----------|--------|-----------------------------------------------------------|
+ * | 0      | Window    | R      | Physical address of the shared window                     |
+ * | 1      | Size      | R      | Window size in bytes                                      |
+ * | 2      | Endpoint  | R      | This machine's endpoint number                            |
+ * | 3      | Endpoints | R      | Number of endpoints of the channel                        |
+ * | 4      | Doorbell  | W      | Rings endpoint `value`; `0xFF` rings every other endpoint |
+ * | 5      | Vector    | R/W    | Doorbell interrupt vector, 0 disables doorbells           |
+ * | 6      | Connected | R      | Number of endpoints whose machine is running              |
+ */
+class ChannelDevice {
+public:
+    static constexpr uint16_t DefaultBase = 0xC100; ///< Base port of the first channel.
+    static constexpr uint16_t PortStride = 0x10;    ///< Distance between the blocks of further channels.
+
+    enum Register : uint16_t { Window, Size, Endpoint, Endpoints, Doorbell, Vector, Connected, RegisterCount };
+
+    static constexpr uint32_t Broadcast = 0xFF; ///< Doorbell target meaning every other endpoint.
+
+    /**
+     * @brief Maps the channel into a machine and connects it as `endpoint`.
+     *
+     * Must be called before the machine starts, after anything that depends on the RAM size.
+     *
+     * @param cpuRef The machine; doorbells are raised on this core.
+     * @param shared The channel.
+     * @param endpoint This machine's endpoint number, below `shared->endpoints()`.
+     * @throws std::runtime_error if the window cannot be mapped or the endpoint is taken.
+     */
+    ChannelDevice(CPU& cpuRef, std::shared_ptr<Channel> shared, unsigned endpoint);
+
+    /**
+     * @brief Disconnects, ringing every remaining endpoint so waiting peers notice.
+     */
+    ~ChannelDevice();
+
+    ChannelDevice(const ChannelDevice&) = delete;
+    ChannelDevice& operator=(const ChannelDevice&) = delete;
+
+    /**
+     * @brief Maps the register block into the port space.
+     *
+     * @param io The IO component to map into.
+     * @param base The first port of the block.
+     * @throws std::invalid_argument if a port is already mapped.
+     */
+    void attach(IO& io, uint16_t base = DefaultBase);
+
+private:
+    friend class Channel;
+
+    /**
+     * @brief Raises the doorbell interrupt, if enabled. Called from any thread.
+     */
+    void doorbell() noexcept;
+
+    CPU& cpu;                         ///< Receives doorbell interrupts.
+    std::shared_ptr<Channel> channel; ///< The shared block.
+    unsigned index;                   ///< This endpoint's number.
+    uint32_t window;                  ///< Physical address of the mapping.
+    std::atomic<uint32_t> vector{0};  ///< Doorbell vector, written by the guest.
+};
+
+#endif // CHANNEL_HPP
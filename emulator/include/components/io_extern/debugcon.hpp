@@ -0,0 +1,37 @@
+#ifndef DEBUGCON_HPP
+#define DEBUGCON_HPP
+
+#include <components/io.hpp>
+#include <components/io_extern/output_sink.hpp>
+#include <cstdint>
+
+/**
+ * @brief Bochs/QEMU style debug console on port 0xE9.
+ *
+ * Every write emits the low byte of the value. Reads return 0xE9 so guests can probe for the device.
+ */
+class DebugCon {
+public:
+    static constexpr uint16_t Port = 0xE9; ///< Default port.
+
+    /**
+     * @brief Constructs a debug console writing to the given sink.
+     *
+     * @param out The sink receiving the console output.
+     */
+    explicit DebugCon(OutputSink& out) noexcept : output(out) {}
+
+    /**
+     * @brief Maps the console into the port space.
+     *
+     * @param io The IO component to map into.
+     * @param port The port to listen on.
+     * @throws std::invalid_argument if the port is already mapped.
+     */
+    void attach(IO& io, uint16_t port = Port);
+
+private:
+    OutputSink& output; ///< Console output.
+};
+
+#endif // DEBUGCON_HPP
@@ -0,0 +1,119 @@
+#ifndef DEVICE_HOST_HPP
+#define DEVICE_HOST_HPP
+
+#include <components/io.hpp>
+#include <utils/spsc_queue.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+class CPU; // Forward declaration
+class DeviceHost; // Forward declaration
+
+/**
+ * @brief A port-mapped device whose backend runs on a DeviceHost thread instead of the CPU thread.
+ *
+ * Port writes are queued to the host thread and handled there, so slow host I/O never stalls the guest.
+ * Port reads stay on the CPU thread and must be served from state the device publishes (e.g. atomics).
+ * Completions are reported with DeviceHost::complete() and reach the guest as interrupts.
+ */
+class OffloadedDevice {
+public:
+    virtual ~OffloadedDevice() = default;
+
+    /**
+     * @brief Number of consecutive ports the device occupies.
+     */
+    [[nodiscard]] virtual uint16_t portCount() const noexcept = 0;
+
+    /**
+     * @brief Serves a port read on the CPU thread. Must not block.
+     *
+     * @param offset The port offset relative to the device base.
+     */
+    [[nodiscard]] virtual uint32_t read(uint16_t offset) noexcept = 0;
+
+    /**
+     * @brief Observes a port write on the CPU thread before it is queued. Must not block.
+     *
+     * Lets a device flip status bits (e.g. busy) synchronously with the guest's doorbell.
+     */
+    virtual void submitted(uint16_t, uint32_t) noexcept {}
+
+    /**
+     * @brief Handles a queued port write on the host thread.
+     *
+     * @param offset The port offset relative to the device base.
+     * @param value The value written by the guest.
+     * @param host The host running the device, used to report completions.
+     */
+    virtual void write(uint16_t offset, uint32_t value, DeviceHost& host) = 0;
+};
+
+/**
+ * @brief Runs OffloadedDevice backends on a dedicated host thread.
+ *
+ * Requests travel CPU -> host over a lock-free SPSC ring. Completions are raised with
+ * CPU::raiseInterrupt(), so they are taken at an instruction boundary with `FR.I` cleared on entry,
+ * like any other pending interrupt, and the CPU thread never waits on the host.
+ */
+class DeviceHost {
+public:
+    /**
+     * @brief Starts the host thread.
+     *
+     * @param cpuRef The CPU receiving completion interrupts.
+     */
+    explicit DeviceHost(CPU& cpuRef);
+
+    /**
+     * @brief Finishes all queued requests and stops the host thread.
+     */
+    ~DeviceHost();
+
+    DeviceHost(const DeviceHost&) = delete;
+    DeviceHost& operator=(const DeviceHost&) = delete;
+
+    /**
+     * @brief Maps an offloaded device into the port space.
+     *
+     * @param io The IO component to map into.
+     * @param base The first port of the device.
+     * @param device The device; must outlive the host.
+     * @throws std::invalid_argument if any of the ports is already mapped.
+     */
+    void attach(IO& io, uint16_t base, OffloadedDevice& device);
+
+    /**
+     * @brief Reports a completion from the host thread. The interrupt stays pending until `FR.I` is set.
+     *
+     * @param vector The interrupt vector to raise on the CPU.
+     */
+    void complete(uint8_t vector) noexcept;
+
+private:
+    struct Request {
+        OffloadedDevice* device;
+        uint16_t offset;
+        uint32_t value;
+    };
+
+    void submit(const Request& request) noexcept;
+    void hostLoop() noexcept;
+    void wakeHost() noexcept;
+
+    CPU& cpu; ///< Receives completion interrupts.
+
+    SpscQueue<Request, 1024> requests; ///< CPU thread -> host thread.
+    bool sourceRegistered{false};      ///< Registered once per host with IO::addInterruptSource().
+
+    std::atomic<bool> hostSleeping{false}; ///< Set while the host thread is parked.
+    std::atomic<bool> stopping{false};     ///< Requests host shutdown.
+    std::mutex wakeupMutex;                ///< Guards `wakeup`.
+    std::condition_variable wakeup;        ///< Parks the host thread while idle.
+    std::thread host;                      ///< The host thread.
+};
+
+#endif // DEVICE_HOST_HPP
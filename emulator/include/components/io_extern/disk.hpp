@@ -0,0 +1,69 @@
+#ifndef DISK_HPP
+#define DISK_HPP
+
+#include <components/io_extern/device_host.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+class CPU; // Forward declaration
+
+/**
+ * @brief Sector-based disk backed by a host image file, served from a DeviceHost thread.
+ *
+ * The guest fills in LBA, buffer address and sector count, then writes a command. The transfer
+ * between the image and guest physical memory happens on the host thread; the guest polls `Status`
+ * or waits for the completion interrupt.
+ *
+ * | Offset | Name     | Access | Description                                      |
+ * |--------|----------|--------|--------------------------------------------------|
+ * | 0      | Lba      | R/W    | First sector of the transfer                     |
+ * | 1      | Buffer   | R/W    | Physical address of the guest buffer             |
+ * | 2      | Count    | R/W    | Number of 512-byte sectors                       |
+ * | 3      | Command  | W      | 1 = read, 2 = write, 3 = flush                   |
+ * | 4      | Status   | R      | Bit 0: busy, bit 1: error                        |
+ * | 5      | Vector   | R/W    | Completion interrupt vector, 0 disables it       |
+ * | 6      | Capacity | R      | Image size in sectors                            |
+ */
+class DiskDevice : public OffloadedDevice {
+public:
+    static constexpr uint16_t DefaultBase = 0x1F0; ///< Default base port.
+    static constexpr uint32_t SectorSize = 512;
+
+    enum Register : uint16_t { Lba, Buffer, Count, Command, Status, Vector, Capacity, RegisterCount };
+    enum CommandCode : uint32_t { CommandRead = 1, CommandWrite = 2, CommandFlush = 3 };
+
+    static constexpr uint32_t StatusBusy = 1 << 0;
+    static constexpr uint32_t StatusError = 1 << 1;
+
+    /**
+     * @brief Opens the disk image.
+     *
+     * @param cpuRef The CPU whose memory is the target of transfers.
+     * @param imagePath Path to the image file, opened read/write.
+     * @throws std::runtime_error if the image cannot be opened.
+     */
+    DiskDevice(CPU& cpuRef, std::string_view imagePath);
+    ~DiskDevice() override;
+
+    [[nodiscard]] uint16_t portCount() const noexcept override { return RegisterCount; }
+    [[nodiscard]] uint32_t read(uint16_t offset) noexcept override;
+    void submitted(uint16_t offset, uint32_t value) noexcept override;
+    void write(uint16_t offset, uint32_t value, DeviceHost& host) override;
+
+private:
+    [[nodiscard]] bool transfer(uint32_t command) noexcept;
+
+    CPU& cpu;        ///< Owner of the transfer buffers.
+    int fd{-1};      ///< Image file.
+    uint32_t sectors; ///< Image size in sectors.
+
+    // Register file: written on the host thread, read on the CPU thread.
+    std::atomic<uint32_t> lba{0};
+    std::atomic<uint32_t> buffer{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> status{0};
+    std::atomic<uint32_t> vector{0};
+};
+
+#endif // DISK_HPP
@@ -0,0 +1,70 @@
+#ifndef INPUT_SOURCE_HPP
+#define INPUT_SOURCE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+/**
+ * @brief Non-blocking host input feeding guest character devices.
+ *
+ * A reader thread polls the host descriptor and pushes bytes into a single-producer/single-consumer
+ * ring, so device reads on the CPU thread only ever check the ring and never block on the host.
+ * Input is dropped when the guest does not drain the ring fast enough.
+ */
+class InputSource {
+public:
+    /**
+     * @brief Starts reading from the given host file descriptor.
+     *
+     * @param fd The descriptor to read from (defaults to stdin).
+     */
+    explicit InputSource(int fd = 0);
+
+    /**
+     * @brief Stops the reader thread.
+     */
+    ~InputSource();
+
+    InputSource(const InputSource&) = delete;
+    InputSource& operator=(const InputSource&) = delete;
+
+    /**
+     * @brief Pops the next pending input byte, if any.
+     *
+     * @param byte Receives the byte.
+     * @return true if a byte was available.
+     */
+    [[nodiscard]] bool tryPop(uint8_t& byte) noexcept {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        byte = buffer[t & Mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Checks whether input is pending without consuming it.
+     */
+    [[nodiscard]] bool available() const noexcept {
+        return tail.load(std::memory_order_relaxed) != head.load(std::memory_order_acquire);
+    }
+
+private:
+    void readerLoop() noexcept;
+
+    static constexpr uint32_t Capacity = 4096;
+    static constexpr uint32_t Mask = Capacity - 1;
+
+    int fd;                                    ///< Host descriptor being read.
+    std::array<uint8_t, Capacity> buffer{};    ///< Ring storage.
+    alignas(64) std::atomic<uint32_t> head{0}; ///< Producer position (reader thread).
+    alignas(64) std::atomic<uint32_t> tail{0}; ///< Consumer position (CPU thread).
+    std::atomic<bool> stopping{false};         ///< Requests reader shutdown.
+    std::thread reader;                        ///< Background reader.
+};
+
+#endif // INPUT_SOURCE_HPP
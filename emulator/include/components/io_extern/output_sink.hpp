@@ -0,0 +1,93 @@
+#ifndef OUTPUT_SINK_HPP
+#define OUTPUT_SINK_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+/**
+ * @brief Buffered byte sink shared by the character devices (serial, debugcon).
+ *
+ * Guest writes land in a single-producer/single-consumer ring buffer and are drained by a
+ * dedicated writer thread in large `writev` batches, so the CPU thread never performs a
+ * per-byte syscall. When the ring is full the producer waits for the writer instead of
+ * dropping output.
+ */
+class OutputSink {
+public:
+    /**
+     * @brief Opens the sink for the given target.
+     *
+     * @param target `stdout`, `stderr` or a file path (the file is created or truncated).
+     * @param capacity Ring buffer size in bytes, rounded up to a power of two.
+     * @throws std::runtime_error if the target file cannot be opened.
+     */
+    explicit OutputSink(std::string_view target, size_t capacity = DefaultCapacity);
+
+    /**
+     * @brief Drains any buffered output, stops the writer thread and closes the target.
+     */
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    /**
+     * @brief Appends a single byte to the ring buffer.
+     *
+     * @param byte The byte to append.
+     */
+    void put(uint8_t byte) noexcept {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail == mask + 1) [[unlikely]] {
+            waitForSpace(h);
+        }
+        buffer[h & mask] = byte;
+        head.store(h + 1, std::memory_order_release);
+        if (writerSleeping.load(std::memory_order_relaxed)) [[unlikely]] {
+            wakeWriter();
+        }
+    }
+
+    /**
+     * @brief Appends a block of bytes to the ring buffer.
+     *
+     * @param bytes The bytes to append.
+     */
+    void write(std::string_view bytes) noexcept;
+
+    /**
+     * @brief Blocks until everything appended so far has been handed to the target.
+     */
+    void flush() noexcept;
+
+    static constexpr size_t DefaultCapacity = 4 * 1024 * 1024; ///< 4 MiB ring per sink.
+
+private:
+    void writerLoop() noexcept;
+    void waitForSpace(uint64_t h) noexcept;
+    void wakeWriter() noexcept;
+
+    std::unique_ptr<uint8_t[]> buffer; ///< Ring storage.
+    uint64_t mask;                     ///< Capacity - 1.
+    int fd;                            ///< Target file descriptor.
+    bool ownsFd;                       ///< Whether `fd` is closed on destruction.
+
+    alignas(64) std::atomic<uint64_t> head{0};     ///< Producer position (CPU thread).
+    uint64_t cachedTail{0};                        ///< Producer-side copy of `tail`.
+    alignas(64) std::atomic<uint64_t> tail{0};     ///< Consumer position (writer thread).
+    std::atomic<bool> writerSleeping{false};       ///< Set while the writer is parked on `wakeup`.
+    std::atomic<bool> stopping{false};             ///< Requests writer shutdown.
+
+    std::mutex wakeupMutex;                        ///< Guards `wakeup`, only taken when the writer is idle.
+    std::condition_variable wakeup;                ///< Parks the writer while the ring is empty.
+
+    std::thread writer; ///< Background writer draining the ring.
+};
+
+#endif // OUTPUT_SINK_HPP
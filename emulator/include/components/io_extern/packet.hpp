@@ -0,0 +1,53 @@
+#ifndef PACKET_HPP
+#define PACKET_HPP
+
+#include <components/io_extern/virtqueue.hpp>
+#include <array>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @brief Network-style packet device on top of the virtqueue transport.
+ *
+ * Queue 0 receives frames into guest buffers, queue 1 transmits guest buffers. The host side is a
+ * Unix datagram socket bound to a local path and sending to a peer path, so two emulator processes
+ * can exchange frames by pointing at each other's sockets. Frames move with `sendmmsg`/`recvmmsg`
+ * directly between the socket and guest RAM, many per syscall.
+ */
+class PacketDevice : public VirtqueueTransport {
+public:
+    static constexpr uint16_t DefaultBase = 0xC000; ///< Default base port of the register block.
+    static constexpr uint32_t Id = 1;               ///< DeviceId value.
+    static constexpr uint16_t RxQueue = 0;          ///< Host-to-guest frames.
+    static constexpr uint16_t TxQueue = 1;          ///< Guest-to-host frames.
+
+    /**
+     * @brief Creates the device and its host socket.
+     *
+     * @param cpuRef The CPU the device is attached to.
+     * @param localPath Path the socket is bound to (replaced if it already exists).
+     * @param peerPath Path transmitted frames are sent to.
+     * @throws std::runtime_error if the socket cannot be created or bound.
+     */
+    PacketDevice(CPU& cpuRef, std::string_view localPath, std::string_view peerPath);
+    ~PacketDevice() override;
+
+protected:
+    void onNotify(uint16_t queue) override;
+    void onPoll() override;
+
+private:
+    void transmit();
+    void receive();
+
+    static constexpr size_t Batch = 32; ///< Frames per sendmmsg/recvmmsg call.
+
+    int fd{-1};              ///< Host datagram socket.
+    std::string local;       ///< Bound path, unlinked on destruction.
+    sockaddr_un peer{};      ///< Destination of transmitted frames.
+    std::array<Chain, Batch> chains; ///< Reused chain storage for one batch.
+};
+
+#endif // PACKET_HPP
@@ -0,0 +1,51 @@
+#ifndef SERIAL_HPP
+#define SERIAL_HPP
+
+#include <components/io.hpp>
+#include <components/io_extern/output_sink.hpp>
+#include <components/io_extern/input_source.hpp>
+#include <cstdint>
+
+/**
+ * @brief Minimal 16550-style UART.
+ *
+ * Only the data register (`base + 0`) and the line status register (`base + 5`) are implemented.
+ * Transmitted bytes go to an OutputSink, received bytes come from an optional InputSource.
+ */
+class SerialPort {
+public:
+    static constexpr uint16_t COM1 = 0x3F8; ///< Default base port.
+
+    static constexpr uint16_t DataRegister = 0;       ///< THR on write, RBR on read.
+    static constexpr uint16_t LineStatusRegister = 5; ///< LSR, read-only.
+
+    static constexpr uint32_t LsrDataReady = 1 << 0;        ///< A received byte is waiting in RBR.
+    static constexpr uint32_t LsrTransmitterEmpty = 1 << 5; ///< THR can accept a byte.
+    static constexpr uint32_t LsrIdle = 1 << 6;             ///< Transmitter fully idle.
+
+    /**
+     * @brief Constructs a UART writing to the given sink.
+     *
+     * @param out The sink receiving transmitted bytes.
+     * @param in Optional source of received bytes.
+     */
+    explicit SerialPort(OutputSink& out, InputSource* in = nullptr) noexcept : output(out), input(in) {}
+
+    /**
+     * @brief Maps the UART registers into the port space.
+     *
+     * @param io The IO component to map into.
+     * @param base The base port of the UART.
+     * @throws std::invalid_argument if any of the ports is already mapped.
+     */
+    void attach(IO& io, uint16_t base = COM1);
+
+private:
+    [[nodiscard]] uint32_t readData() noexcept;
+    [[nodiscard]] uint32_t readLineStatus() const noexcept;
+
+    OutputSink& output;  ///< Transmit side.
+    InputSource* input;  ///< Receive side, may be null.
+};
+
+#endif // SERIAL_HPP
@@ -0,0 +1,188 @@
+#ifndef VIRTQUEUE_HPP
+#define VIRTQUEUE_HPP
+
+#include <components/io.hpp>
+#include <cstdint>
+#include <vector>
+#include <sys/uio.h>
+
+class CPU; // Forward declaration
+
+/**
+ * @brief Descriptor table entry of a split virtqueue, laid out exactly as in guest memory.
+ */
+struct VirtqDesc {
+    uint64_t addr;  ///< Guest physical address of the buffer.
+    uint32_t len;   ///< Length of the buffer in bytes.
+    uint16_t flags; ///< VirtqDescNext / VirtqDescWrite.
+    uint16_t next;  ///< Index of the next descriptor when VirtqDescNext is set.
+};
+static_assert(sizeof(VirtqDesc) == 16);
+
+constexpr uint16_t VirtqDescNext = 1;   ///< Buffer continues in `next`.
+constexpr uint16_t VirtqDescWrite = 2;  ///< Buffer is device-writable.
+constexpr uint16_t VirtqAvailNoInterrupt = 1; ///< Avail flag: guest does not want completion interrupts.
+constexpr uint16_t VirtqUsedNoNotify = 1;     ///< Used flag: device does not need doorbells right now.
+
+/**
+ * @brief Paravirtual split-ring transport.
+ *
+ * Implements the virtio split virtqueue layout (descriptor table, avail ring, used ring) in guest
+ * physical memory behind a small port-mapped register block. The guest posts any number of buffers
+ * and rings the doorbell once; the device then walks every available chain and accesses the buffers
+ * in place through Memory::physicalSpan. Completion interrupts are coalesced to one per batch.
+ *
+ * Register block, relative to the base port:
+ * | Offset | Name            | Access | Description                                           |
+ * |--------|-----------------|--------|-------------------------------------------------------|
+ * | 0      | DeviceId        | R      | Device type (1 = packet device)                       |
+ * | 1      | QueueSelect     | R/W    | Queue addressed by the queue registers below          |
+ * | 2      | QueueSize       | R/W    | Maximum size on read, configured size on write        |
+ * | 3      | QueueDesc       | R/W    | Physical address of the descriptor table              |
+ * | 4      | QueueAvail      | R/W    | Physical address of the avail ring                    |
+ * | 5      | QueueUsed       | R/W    | Physical address of the used ring                     |
+ * | 6      | QueueReady      | R/W    | Write 1 to enable the queue if its rings are valid    |
+ * | 7      | QueueNotify     | W      | Doorbell, value is the queue index                    |
+ * | 8      | InterruptStatus | R      | Bit 0: used buffers pending; cleared by the read      |
+ * | 9      | InterruptVector | R/W    | Vector raised on completion, 0 disables interrupts    |
+ * | 10     | Status          | R/W    | Device status, writing 0 resets the device            |
+ */
+class VirtqueueTransport {
+public:
+    enum Register : uint16_t {
+        DeviceId = 0,
+        QueueSelect = 1,
+        QueueSize = 2,
+        QueueDesc = 3,
+        QueueAvail = 4,
+        QueueUsed = 5,
+        QueueReady = 6,
+        QueueNotify = 7,
+        InterruptStatus = 8,
+        InterruptVector = 9,
+        Status = 10,
+        RegisterCount
+    };
+
+    static constexpr uint16_t MaxQueueSize = 256; ///< Largest ring the transport accepts.
+    static constexpr uint32_t StatusNeedsReset = 0x40; ///< Set when the guest handed the device a malformed ring.
+
+    /**
+     * @brief Constructs the transport.
+     *
+     * @param cpuRef The CPU whose memory holds the rings and which receives the interrupts.
+     * @param deviceId Value reported by the DeviceId register.
+     * @param queueCount Number of virtqueues the device exposes.
+     */
+    VirtqueueTransport(CPU& cpuRef, uint32_t deviceId, uint16_t queueCount);
+    virtual ~VirtqueueTransport() = default;
+
+    VirtqueueTransport(const VirtqueueTransport&) = delete;
+    VirtqueueTransport& operator=(const VirtqueueTransport&) = delete;
+
+    /**
+     * @brief Maps the register block into the port space and registers the device poller.
+     *
+     * @param io The IO component to map into.
+     * @param base The first port of the register block.
+     * @throws std::invalid_argument if any port of the block is already mapped.
+     */
+    void attach(IO& io, uint16_t base);
+
+protected:
+    /**
+     * @brief A descriptor chain resolved to host memory.
+     *
+     * Readable (driver-to-device) segments come first, followed by the writable ones starting at `writableOffset`.
+     */
+    struct Chain {
+        uint16_t head{0};            ///< Index of the head descriptor, returned through the used ring.
+        std::vector<iovec> segments; ///< Host views of the guest buffers.
+        size_t writableOffset{0};    ///< Index of the first writable segment.
+        size_t writableBytes{0};     ///< Total capacity of the writable segments.
+    };
+
+    /**
+     * @brief Pops the next available chain of a queue.
+     *
+     * @param queue The queue index.
+     * @param chain Receives the chain; its storage is reused across calls.
+     * @return false if the queue is not ready or has no more available chains.
+     */
+    bool nextChain(uint16_t queue, Chain& chain);
+
+    /**
+     * @brief Un-pops the most recently popped chains of a queue, e.g. when the host had no data for them.
+     *
+     * @param queue The queue index.
+     * @param count Number of chains to give back.
+     */
+    void rewindAvail(uint16_t queue, uint16_t count) noexcept;
+
+    /**
+     * @brief Returns a chain to the guest through the used ring.
+     *
+     * @param queue The queue index.
+     * @param head The head descriptor index of the chain.
+     * @param written Number of bytes the device wrote into the chain.
+     */
+    void pushUsed(uint16_t queue, uint16_t head, uint32_t written);
+
+    /**
+     * @brief Marks used buffers pending and raises the interrupt unless the guest suppressed it.
+     *
+     * @param queue The queue whose used ring advanced.
+     */
+    void signalUsed(uint16_t queue);
+
+    /**
+     * @brief Checks whether a queue has available chains without consuming them.
+     */
+    [[nodiscard]] bool hasAvailable(uint16_t queue) const;
+
+    /**
+     * @brief Called when the guest rings the doorbell of a queue.
+     */
+    virtual void onNotify(uint16_t queue) = 0;
+
+    /**
+     * @brief Called between instructions; used to complete host-side work.
+     */
+    virtual void onPoll() {}
+
+    /**
+     * @brief Called when the guest resets the device.
+     */
+    virtual void onReset() {}
+
+    CPU& cpu; ///< Owner of the guest memory and interrupt path.
+
+private:
+    struct Queue {
+        uint16_t size{0};
+        uint32_t desc{0};
+        uint32_t avail{0};
+        uint32_t used{0};
+        bool ready{false};
+        uint16_t lastAvail{0}; ///< Next avail ring slot the device will consume.
+        uint16_t usedIdx{0};   ///< Device-side copy of used->idx.
+    };
+
+    [[nodiscard]] uint32_t readRegister(uint16_t reg) noexcept;
+    void writeRegister(uint16_t reg, uint32_t value);
+    void reset() noexcept;
+    void deliverInterrupt() noexcept;
+
+    [[nodiscard]] uint16_t* ringIndex(uint32_t ring) const noexcept;
+
+    uint32_t deviceId;           ///< Reported device type.
+    std::vector<Queue> queues;   ///< Queue configuration.
+    uint16_t selected{0};        ///< QueueSelect.
+    uint32_t status{0};          ///< Status.
+    uint32_t vector{0};          ///< InterruptVector.
+    bool interruptPending{false}; ///< InterruptStatus bit 0.
+    bool interruptWanted{false};  ///< Completion interrupt waiting for delivery.
+    bool interruptRaised{false};  ///< Interrupt delivered and not yet acknowledged through InterruptStatus.
+};
+
+#endif // VIRTQUEUE_HPP
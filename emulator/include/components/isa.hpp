@@ -3,42 +3,114 @@
 
 #include <components/memory.hpp>
 #include <components/io.hpp>
+#include <array>
 #include <cstdint>
-#include <variant>
+#include <string_view>
+#include <utility>
 
 class CPU; // Forward declaration
+class InstructionSet;
+struct DecodedInstruction;
 
 /**
- * @brief Struct representing a decoded R-Type instruction.
+ * @brief How an instruction word is split into fields. Every format has the opcode in bits 63–58.
  */
-struct RTypeInstruction {
-    uint64_t reserved : 29;  ///< Reserved space (29 bits)
-    uint64_t func     : 8;   ///< Function code for extended operations (8 bits)
-    uint64_t shamt    : 6;   ///< Shift amount (6 bits)
-    uint64_t rs2      : 5;   ///< Second source register (5 bits)
-    uint64_t rs1      : 5;   ///< First source register (5 bits)
-    uint64_t rd       : 5;   ///< Destination register (5 bits)
-    uint64_t opcode   : 6;   ///< Operation code (6 bits)
+enum class InstructionFormat : uint8_t {
+    Invalid, ///< Undefined opcode.
+    R,       ///< rd 57–53, rs1 52–48, rs2 47–43, shamt 42–37, func 36–29.
+    I,       ///< rd 57–53, rs1 52–48, immediate 47–16, absolute 15.
+    J,       ///< address 57–26.
 };
 
+/// I-type bit 15: `LDR`/`STR` address memory by the immediate alone and ignore rs1.
+inline constexpr uint64_t AbsoluteAddressBit = uint64_t(1) << 15;
+
+/**
+ * @brief Operand syntax of an instruction in assembly, shared by the assemblers and the disassembler.
+ */
+enum class OperandSyntax : uint8_t {
+    Invalid,
+    None,    ///< `HLT`
+    One,     ///< `PUSH rd`
+    Two,     ///< `MOV rd rs1`
+    Three,   ///< `ADD rd rs1 rs2`
+    Shift,   ///< `LSL rd rs1 shamt`
+    Memory,  ///< `LDR rd [rs1] offset`, or `LDR rd address` with AbsoluteAddressBit set
+    Branch,  ///< `BEQ rd rs1 target`
+    Jump,    ///< `JMP target`
+    Vector,  ///< `SWI vector`
+    Special, ///< `MFS rd special`, `MTS special rd`
+};
+
+/**
+ * @brief Flags an instruction sets once its handler has run.
+ */
+enum class FlagEffect : uint8_t {
+    None,
+    Result,  ///< From the value left in rd.
+    Compare, ///< From rs1 - rd.
+};
+
+/**
+ * @brief How an instruction changes the flow of control, for tools that follow it.
+ */
+enum class ControlFlow : uint8_t {
+    None,
+    Branch, ///< Conditional, relative to the next instruction.
+    Jump,   ///< Unconditional, to an absolute address.
+    Call,   ///< Jump that pushes the return address.
+    Return, ///< Continues at an address popped from the stack or the interrupt frame.
+    Halt,   ///< Stops until an interrupt, then resumes at the next instruction.
+};
+
+/// Executes one decoded instruction.
+using InstructionHandler = void (InstructionSet::*)(const DecodedInstruction&);
+
 /**
- * @brief Struct representing a decoded I-Type instruction.
+ * @brief Everything the emulator and the tools know about an opcode: one row of OpcodeTable.
  */
-struct ITypeInstruction {
-    uint64_t reserved  : 16;   ///< Reserved space (16 bits)
-    uint64_t immediate : 32;   ///< Immediate value (32 bits)
-    uint64_t rs1       : 5;    ///< Source register (5 bits)
-    uint64_t rd        : 5;    ///< Destination register (5 bits)
-    uint64_t opcode    : 6;    ///< Operation code (6 bits)
+struct OpcodeInfo {
+    std::string_view mnemonic; ///< Empty for opcode 0x00, whose packed instructions are named by `func`.
+    InstructionFormat format{InstructionFormat::Invalid};
+    OperandSyntax operands{OperandSyntax::Invalid};
+    FlagEffect flags{FlagEffect::None};
+    ControlFlow control{ControlFlow::None};
+    InstructionHandler handler{nullptr};
 };
 
 /**
- * @brief Struct representing a decoded J-Type instruction.
+ * @brief Shift semantics, shared by the scalar and lockstep engines.
+ *
+ * `shamt` is six bits wide, so counts of 32 to 63 are defined too: they shift every bit out, leaving 0,
+ * or for an arithmetic right shift the sign bit in every position. `ASL` shifts like `LSL`.
  */
-struct JTypeInstruction {
-    uint64_t reserved : 26;    ///< Reserved space (26 bits)
-    uint64_t address  : 32;    ///< Jump target address (32 bits)
-    uint64_t opcode   : 6;     ///< Operation code (6 bits)
+struct Shifter {
+    static constexpr uint32_t left(uint32_t value, unsigned count) noexcept {
+        return count < 32 ? value << count : 0;
+    }
+    static constexpr uint32_t rightLogical(uint32_t value, unsigned count) noexcept {
+        return count < 32 ? value >> count : 0;
+    }
+    static constexpr uint32_t rightArithmetic(uint32_t value, unsigned count) noexcept {
+        return static_cast<uint32_t>(static_cast<int32_t>(value) >> (count < 32 ? count : 31));
+    }
+};
+
+/**
+ * @brief An instruction split into every field of every format; the handler reads those of its own.
+ */
+struct DecodedInstruction {
+    InstructionHandler handler;
+    FlagEffect flags;
+    uint8_t opcode;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    uint8_t shamt;
+    uint8_t func;
+    bool absolute;
+    uint32_t immediate;
+    uint32_t address;
 };
 
 /**
@@ -54,25 +126,71 @@ public:
     explicit InstructionSet(CPU& cpuRef) : cpu(cpuRef) {}
 
     /**
-     * @brief Decodes a fetched instruction into its appropriate type.
-     * @param instruction The raw 32-bit instruction code.
-     * @return Decoded instruction as one of the defined instruction structs.
+     * @brief Every opcode's mnemonic, format, operands, flag effects, control flow and handler,
+     * indexed by opcode. The decoder, the assemblers, the disassembler and the profilers all read it.
      */
-    static std::variant<RTypeInstruction, ITypeInstruction, JTypeInstruction> decodeInstruction(uint64_t instruction);
+    static const std::array<OpcodeInfo, 64> Opcodes;
 
     /**
-     * @brief Executes a decoded instruction.
+     * @brief Decodes a fetched instruction with one lookup in Opcodes.
+     * @param instruction The raw 64-bit instruction word.
+     * @return The fields of the instruction and the handler that executes it; undefined opcodes and
+     * packed `func` codes get the handler that raises the invalid opcode interrupt.
+     */
+    static DecodedInstruction decodeInstruction(uint64_t instruction) noexcept;
+
+    /**
+     * @brief Executes a decoded instruction and applies its flag effect.
      * @param instruction The decoded instruction to execute.
      */
-    void execute(const std::variant<RTypeInstruction, ITypeInstruction, JTypeInstruction>& instruction);
+    void execute(const DecodedInstruction& instruction);
 
 private:
     CPU& cpu;  ///< Reference to the CPU object to interact with the CPU state, memory, and interrupts.
 
-    // Helper functions for instruction execution
-    void executeRType(const RTypeInstruction& instr);
-    void executeIType(const ITypeInstruction& instr);
-    void executeJType(const JTypeInstruction& instr);
+    // Handlers, one per operation; see Opcodes for the opcodes that use each.
+    void packed(const DecodedInstruction& instr);
+    void add(const DecodedInstruction& instr);
+    void subtract(const DecodedInstruction& instr);
+    void bitwiseAnd(const DecodedInstruction& instr);
+    void bitwiseOr(const DecodedInstruction& instr);
+    void bitwiseXor(const DecodedInstruction& instr);
+    void shiftLeft(const DecodedInstruction& instr);
+    void shiftRightLogical(const DecodedInstruction& instr);
+    void shiftRightArithmetic(const DecodedInstruction& instr);
+    void load(const DecodedInstruction& instr);
+    void store(const DecodedInstruction& instr);
+    void jump(const DecodedInstruction& instr);
+    void jumpAndLink(const DecodedInstruction& instr);
+    void branchIfEqual(const DecodedInstruction& instr);
+    void branchIfNotEqual(const DecodedInstruction& instr);
+    void move(const DecodedInstruction& instr);
+    void push(const DecodedInstruction& instr);
+    void pop(const DecodedInstruction& instr);
+    void call(const DecodedInstruction& instr);
+    void returnFromCall(const DecodedInstruction& instr);
+    void returnFromInterrupt(const DecodedInstruction& instr);
+    void nop(const DecodedInstruction& instr);
+    void halt(const DecodedInstruction& instr);
+    void multiply(const DecodedInstruction& instr);
+    void divide(const DecodedInstruction& instr);
+    void modulo(const DecodedInstruction& instr);
+    void bitwiseNot(const DecodedInstruction& instr);
+    void negate(const DecodedInstruction& instr);
+    void increment(const DecodedInstruction& instr);
+    void decrement(const DecodedInstruction& instr);
+    void softwareInterrupt(const DecodedInstruction& instr);
+    void signExtend(const DecodedInstruction& instr);
+    void zeroExtend(const DecodedInstruction& instr);
+    void moveFromSpecial(const DecodedInstruction& instr);
+    void moveToSpecial(const DecodedInstruction& instr);
+    void portOut(const DecodedInstruction& instr);
+    void portIn(const DecodedInstruction& instr);
+    void compareAndSwap(const DecodedInstruction& instr);
+    void loadLinked(const DecodedInstruction& instr);
+    void storeConditional(const DecodedInstruction& instr);
+    void fence(const DecodedInstruction& instr);
+    void invalid(const DecodedInstruction& instr);
 
     /**
      * @brief Sets the flags in the CPU based on the result of an operation.
@@ -82,7 +200,75 @@ private:
      */
     void setFlags(uint32_t result, bool carry, bool overflow);
 
+    /**
+     * @brief Ends the current PMU block and counts a taken branch when the PMU is counting.
+     */
+    void countBranch() noexcept;
+
     friend class CPU;
+    friend class LockstepGroup; // Keys its lane kernels off the handlers in Opcodes
 };
 
+inline constexpr std::array<OpcodeInfo, 64> InstructionSet::Opcodes = [] {
+    using enum InstructionFormat;
+    using Syntax = OperandSyntax;
+    using Flags = FlagEffect;
+    using Flow = ControlFlow;
+    using IS = InstructionSet;
+    std::array<OpcodeInfo, 64> table{};
+    table.fill({"", Invalid, Syntax::Invalid, Flags::None, Flow::None, &IS::invalid});
+    constexpr std::pair<uint8_t, OpcodeInfo> Defined[] = {
+        {0x00, {"",      R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::packed}},
+        {0x01, {"ADD",   R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::add}},
+        {0x02, {"SUB",   R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::subtract}},
+        {0x03, {"AND",   R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::bitwiseAnd}},
+        {0x04, {"OR",    R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::bitwiseOr}},
+        {0x05, {"XOR",   R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::bitwiseXor}},
+        {0x06, {"LSL",   R, Syntax::Shift,   Flags::Result,  Flow::None,   &IS::shiftLeft}},
+        {0x07, {"LSR",   R, Syntax::Shift,   Flags::Result,  Flow::None,   &IS::shiftRightLogical}},
+        {0x08, {"LDR",   I, Syntax::Memory,  Flags::None,    Flow::None,   &IS::load}},
+        {0x09, {"STR",   I, Syntax::Memory,  Flags::None,    Flow::None,   &IS::store}},
+        {0x0A, {"JMP",   J, Syntax::Jump,    Flags::None,    Flow::Jump,   &IS::jump}},
+        {0x0B, {"JAL",   J, Syntax::Jump,    Flags::None,    Flow::Jump,   &IS::jumpAndLink}}, // Nothing returns through R31
+        {0x0C, {"BEQ",   I, Syntax::Branch,  Flags::None,    Flow::Branch, &IS::branchIfEqual}},
+        {0x0D, {"BNE",   I, Syntax::Branch,  Flags::None,    Flow::Branch, &IS::branchIfNotEqual}},
+        {0x0E, {"MOV",   I, Syntax::Two,     Flags::None,    Flow::None,   &IS::move}},
+        {0x0F, {"CMP",   I, Syntax::Two,     Flags::Compare, Flow::None,   &IS::nop}},
+        {0x10, {"PUSH",  I, Syntax::One,     Flags::None,    Flow::None,   &IS::push}},
+        {0x11, {"POP",   I, Syntax::One,     Flags::None,    Flow::None,   &IS::pop}},
+        {0x12, {"CALL",  J, Syntax::Jump,    Flags::None,    Flow::Call,   &IS::call}},
+        {0x13, {"RET",   J, Syntax::None,    Flags::None,    Flow::Return, &IS::returnFromCall}},
+        {0x14, {"IRET",  J, Syntax::None,    Flags::None,    Flow::Return, &IS::returnFromInterrupt}},
+        {0x15, {"NOP",   J, Syntax::None,    Flags::None,    Flow::None,   &IS::nop}},
+        {0x16, {"HLT",   J, Syntax::None,    Flags::None,    Flow::Halt,   &IS::halt}},
+        {0x17, {"MUL",   R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::multiply}},
+        {0x18, {"DIV",   R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::divide}},
+        {0x19, {"MOD",   R, Syntax::Three,   Flags::Result,  Flow::None,   &IS::modulo}},
+        {0x1A, {"NOT",   R, Syntax::Two,     Flags::Result,  Flow::None,   &IS::bitwiseNot}},
+        {0x1B, {"NEG",   R, Syntax::Two,     Flags::Result,  Flow::None,   &IS::negate}},
+        {0x1C, {"INC",   R, Syntax::One,     Flags::Result,  Flow::None,   &IS::increment}},
+        {0x1D, {"DEC",   R, Syntax::One,     Flags::Result,  Flow::None,   &IS::decrement}},
+        {0x1E, {"ASL",   R, Syntax::Shift,   Flags::Result,  Flow::None,   &IS::shiftLeft}},
+        {0x1F, {"ASR",   R, Syntax::Shift,   Flags::Result,  Flow::None,   &IS::shiftRightArithmetic}},
+        {0x20, {"SWI",   I, Syntax::Vector,  Flags::None,    Flow::None,   &IS::softwareInterrupt}},
+        {0x21, {"SEXT",  I, Syntax::Two,     Flags::None,    Flow::None,   &IS::signExtend}},
+        {0x22, {"ZEXT",  I, Syntax::Two,     Flags::None,    Flow::None,   &IS::zeroExtend}},
+        {0x23, {"MFS",   I, Syntax::Special, Flags::None,    Flow::None,   &IS::moveFromSpecial}},
+        {0x24, {"MTS",   I, Syntax::Special, Flags::None,    Flow::None,   &IS::moveToSpecial}},
+        {0x25, {"OUT",   I, Syntax::Two,     Flags::None,    Flow::None,   &IS::portOut}},
+        {0x26, {"IN",    I, Syntax::Two,     Flags::None,    Flow::None,   &IS::portIn}},
+        {0x27, {"CAS",   R, Syntax::Three,   Flags::None,    Flow::None,   &IS::compareAndSwap}},
+        {0x28, {"LL",    R, Syntax::Two,     Flags::None,    Flow::None,   &IS::loadLinked}},
+        {0x29, {"SC",    R, Syntax::Three,   Flags::None,    Flow::None,   &IS::storeConditional}},
+        {0x2A, {"FENCE", J, Syntax::None,    Flags::None,    Flow::None,   &IS::fence}},
+    };
+    for (const auto& [opcode, info] : Defined) {
+        table[opcode] = info;
+    }
+    return table;
+}();
+
+/// The instruction set table, for code outside InstructionSet.
+inline constexpr const std::array<OpcodeInfo, 64>& OpcodeTable = InstructionSet::Opcodes;
+
 #endif // ISA_HPP
@@ -0,0 +1,197 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+/**
+ * @brief Thrown when a replayed guest asks for an input other than the one the log recorded next.
+ */
+class ReplayDivergence : public std::runtime_error {
+public:
+    explicit ReplayDivergence(const std::string& what) : std::runtime_error("Replay diverged: " + what) {}
+};
+
+/**
+ * @brief Log of every non-deterministic input to one core, for deterministic record and replay.
+ *
+ * Recorded inputs are port reads, asynchronous interrupts (keyed by the number of instructions the
+ * core had retired when it took them) and the host data returned by the `clock` and `read` syscalls.
+ * Everything else a single-core guest does follows from these and the initial state, so feeding them
+ * back in the same order reproduces the run instruction for instruction.
+ *
+ * While recording, events are appended as tagged varints to a chunk buffer on the CPU thread. Full
+ * chunks, and at least every `FlushInterval` the current one, are handed to a writer thread that
+ * deflates them into the log with a sync flush, so the log is readable up to the last handed-off chunk
+ * even if the emulator is killed. While replaying, the log is inflated on demand.
+ *
+ * A journal is used by exactly one core; it is not thread-safe.
+ */
+class ExecutionJournal {
+public:
+    enum class Mode {
+        Record, ///< Append inputs as the guest consumes them.
+        Replay, ///< Serve inputs from the log.
+    };
+
+    static constexpr size_t ChunkSize = 64 * 1024;                 ///< Hand-off size while recording.
+    static constexpr size_t MaxQueuedChunks = 64;                  ///< Back-pressure limit for the writer.
+    static constexpr std::chrono::milliseconds FlushInterval{100}; ///< Maximum age of unwritten events.
+
+    /**
+     * @brief Opens a log.
+     *
+     * @param path The log file; created or truncated when recording.
+     * @param mode Whether to record or replay.
+     * @throws std::runtime_error if the file cannot be opened or is not a journal.
+     */
+    ExecutionJournal(const std::string& path, Mode mode);
+
+    /**
+     * @brief Ends the log (when recording) and closes the file.
+     */
+    ~ExecutionJournal();
+
+    ExecutionJournal(const ExecutionJournal&) = delete;
+    ExecutionJournal& operator=(const ExecutionJournal&) = delete;
+
+    [[nodiscard]] bool replaying() const noexcept { return mode == Mode::Replay; }
+
+    /**
+     * @brief Records the value a port read returned.
+     */
+    void recordPortRead(uint16_t port, uint32_t value) {
+        put(PortRead);
+        putVarint(port);
+        putVarint(value);
+    }
+
+    /**
+     * @brief Returns the value the next port read returned when recording.
+     *
+     * @throws ReplayDivergence if the next logged input is not a read of `port`.
+     */
+    [[nodiscard]] uint32_t replayPortRead(uint16_t port);
+
+    /**
+     * @brief Records an asynchronous interrupt taken before retiring instruction `retired` + 1.
+     */
+    void recordInterrupt(uint64_t retired, uint8_t vector);
+
+    /**
+     * @brief Whether the next logged input is an interrupt to take now.
+     *
+     * @param retired Instructions the core has retired.
+     * @param vector Receives the vector if one is due.
+     */
+    [[nodiscard]] bool interruptDue(uint64_t retired, uint8_t& vector);
+
+    /**
+     * @brief Records the result of a host clock read.
+     */
+    void recordClock(uint32_t seconds, uint32_t nanoseconds) {
+        put(Clock);
+        putVarint(seconds);
+        putVarint(nanoseconds);
+    }
+
+    /**
+     * @brief Returns the logged result of the next host clock read.
+     *
+     * @throws ReplayDivergence if the next logged input is not a clock read.
+     */
+    void replayClock(uint32_t& seconds, uint32_t& nanoseconds);
+
+    /**
+     * @brief Records the result of a host `read` and the bytes it returned.
+     *
+     * @param result The syscall result: bytes read, or a negative errno.
+     * @param bytes The data, `result` bytes long if positive.
+     */
+    void recordRead(int32_t result, const std::vector<uint8_t>& bytes);
+
+    /**
+     * @brief Returns the logged result of the next host `read`.
+     *
+     * @param data Receives the bytes read, if any.
+     * @throws ReplayDivergence if the next logged input is not a read.
+     */
+    [[nodiscard]] int32_t replayRead(std::vector<uint8_t>& data);
+
+    /**
+     * @brief Hands the current chunk to the writer if it is older than FlushInterval. Cheap enough to call
+     * between instructions.
+     */
+    void sync() {
+        if (mode == Mode::Record && !chunk.empty() && std::chrono::steady_clock::now() - chunkStart >= FlushInterval) {
+            handOff();
+        }
+    }
+
+private:
+    enum Tag : uint8_t {
+        PortRead = 1,
+        Interrupt = 2,
+        Clock = 3,
+        Read = 4,
+    };
+
+    void put(uint8_t byte) {
+        if (chunk.empty()) {
+            chunkStart = std::chrono::steady_clock::now();
+        }
+        chunk.push_back(byte);
+        if (chunk.size() >= ChunkSize) [[unlikely]] {
+            handOff();
+        }
+    }
+
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            put(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        put(static_cast<uint8_t>(value));
+    }
+
+    void handOff();
+    void writerLoop() noexcept;
+
+    [[nodiscard]] bool fill();
+    void buffer(size_t bytes);
+    [[nodiscard]] int peek();
+    [[nodiscard]] uint8_t get();
+    [[nodiscard]] uint64_t getVarint();
+    void expect(Tag tag, const char* what);
+
+    Mode mode;
+    int fd{-1};
+    z_stream zlib{};
+    uint64_t lastInterrupt{0};                         ///< Retired count of the previous interrupt event.
+
+    // Recording
+    std::vector<uint8_t> chunk;                        ///< Events not yet handed to the writer.
+    std::chrono::steady_clock::time_point chunkStart;  ///< When the first event of `chunk` was added.
+    std::deque<std::vector<uint8_t>> queue;            ///< Chunks waiting for the writer.
+    std::mutex queueMutex;                             ///< Guards `queue` and `stopping`.
+    std::condition_variable queued;                    ///< Wakes the writer.
+    bool stopping{false};                              ///< Set once the last chunk is queued.
+    std::thread writer;                                ///< Compresses and writes chunks.
+
+    // Replaying
+    std::vector<uint8_t> compressed;                   ///< Input buffer for inflate.
+    std::vector<uint8_t> window;                       ///< Inflated events.
+    size_t position{0};                                ///< Next unread byte of `window`.
+    bool endOfLog{false};                              ///< The compressed stream is exhausted.
+    uint64_t consumed{0};                              ///< Events replayed so far, for error messages.
+};
+
+#endif // JOURNAL_HPP
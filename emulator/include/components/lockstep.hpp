@@ -0,0 +1,147 @@
+#ifndef LOCKSTEP_HPP
+#define LOCKSTEP_HPP
+
+#include <components/cpu.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Runs up to 16 independent guests in lockstep, one decoded instruction for all of them at a time.
+ *
+ * Meant for input sweeps: many instances of the same program that mostly follow the same path on
+ * different data. The general-purpose registers, `I0`, `S0` and `FR` of all lanes are kept in
+ * lane-major arrays (`R[register][lane]`), so an ALU instruction is a handful of vector operations
+ * across every lane instead of one interpreter round trip per guest. The lane kernels are compiled
+ * for AVX-512, AVX2 and baseline x86-64 and picked at load time.
+ *
+ * Each step executes the instruction at the lowest `I0` of any running lane, for all lanes at that
+ * address; lanes that took a different branch wait until the others catch up with them (min-PC
+ * reconvergence). Instructions the vector path does not handle (syscalls, special registers, IO,
+ * atomics, faulting accesses) are executed by the lane's own CPU, one lane at a time. A lane is
+ * ejected and finished on its scalar CPU once it turns on paging or the PMU, modifies the program
+ * image, or diverges from its group for too long.
+ *
+ * All lanes must be unpaged guests started from the same program image, which must not be modified
+ * through syscalls. The CPUs must not be touched while the group runs.
+ */
+class LockstepGroup {
+public:
+    static constexpr unsigned MaxLanes = 16;
+
+    /**
+     * @brief How a lane ended.
+     */
+    enum class LaneStatus {
+        Running,         ///< Not finished yet.
+        Exited,          ///< The guest called exit; see `exitCode`.
+        Halted,          ///< The guest executed HLT with nothing left to wait for.
+        BudgetExhausted, ///< The instruction budget ran out.
+        Error,           ///< Emulation failed; see `message`.
+    };
+
+    /**
+     * @brief The result of one lane.
+     */
+    struct LaneOutcome {
+        LaneStatus status{LaneStatus::Running};
+        int32_t exitCode{0};      ///< Valid for LaneStatus::Exited.
+        uint64_t instructions{0}; ///< Instructions executed by this lane.
+        std::string message;      ///< Emulator error, for LaneStatus::Error.
+    };
+
+    /**
+     * @brief Takes over a set of ready-to-run CPUs.
+     *
+     * @param cpus One CPU per lane (1-16), with the program loaded and `I0` at its entry point.
+     * @param budget Maximum number of instructions each lane may execute.
+     * @param codeStart Load address of the program image.
+     * @param codeEnd First address past the program image. Stores into the image eject the lane.
+     * @throws std::invalid_argument if the lane count is out of range.
+     */
+    LockstepGroup(const std::vector<CPU*>& cpus, uint64_t budget, uint32_t codeStart, uint32_t codeEnd);
+
+    /**
+     * @brief Runs every lane until it finishes. The lanes' registers are written back to their CPUs.
+     */
+    void run();
+
+    /**
+     * @brief The result of a lane after run().
+     */
+    [[nodiscard]] const LaneOutcome& outcome(unsigned lane) const noexcept { return outcomes[lane]; }
+
+private:
+    using LaneArray = std::array<uint32_t, MaxLanes>;
+
+    /**
+     * @brief The lane kernel that executes an instruction, picked by its InstructionSet handler.
+     */
+    enum class Kernel : uint8_t;
+
+    /// Kernel of each opcode; opcodes without one are executed by the lanes' CPUs.
+    static const std::array<Kernel, 64> Kernels;
+
+    /**
+     * @brief Lane-major register file. Lanes past `laneCount` are never active.
+     */
+    struct LaneRegisters {
+        alignas(64) std::array<LaneArray, 32> R{}; ///< R[register][lane].
+        alignas(64) LaneArray I0{};
+        alignas(64) LaneArray S0{};
+        alignas(64) LaneArray FR{};
+        alignas(64) std::array<uint64_t, MaxLanes> executed{}; ///< Instructions retired per lane.
+    };
+
+    /**
+     * @brief Issues the instruction at the lowest `I0` of the running lanes.
+     *
+     * Executes it on the vector path for every lane at that address it can handle.
+     *
+     * @param issued Receives the lanes the instruction was issued to.
+     * @return The lanes that still have to execute it on their scalar CPU.
+     */
+    [[gnu::target_clones("avx512f", "avx2", "default")]] uint32_t step(uint32_t& issued);
+
+    /**
+     * @brief Ejects every running lane outside the largest group of lanes sharing an `I0`.
+     */
+    void splitDivergentLanes() noexcept;
+
+    /**
+     * @brief Executes one instruction of a lane on its scalar CPU and reloads the lane's registers.
+     */
+    void escape(unsigned lane);
+
+    /**
+     * @brief Finishes a lane on its scalar CPU, within the remaining budget.
+     */
+    void runScalar(unsigned lane);
+
+    /**
+     * @brief Executes one instruction on a lane's CPU, finishing the lane if the guest stops or fails.
+     *
+     * @return Whether the lane is still running.
+     */
+    bool executeScalar(unsigned lane) noexcept;
+
+    void loadLane(unsigned lane) noexcept;
+    void storeLane(unsigned lane) noexcept;
+    void finish(unsigned lane, LaneStatus status) noexcept;
+
+    std::vector<CPU*> lanes;                 ///< The CPU of each lane.
+    unsigned laneCount;                      ///< Number of lanes in use.
+    uint64_t budget;                         ///< Per-lane instruction limit.
+    uint32_t codeStart;                      ///< Program image; stores into it eject the lane.
+    uint32_t codeEnd;                        ///< First address past the program image.
+    LaneRegisters regs;                      ///< Vector-path state of every lane.
+    std::array<uint8_t*, MaxLanes> ram{};    ///< Physical memory of each lane.
+    std::array<uint64_t, MaxLanes> ramSize{}; ///< Physical memory size of each lane.
+    uint32_t running{0};                     ///< Lanes still on the vector path.
+    uint32_t ejectPending{0};                ///< Lanes to move to their scalar CPU after this step.
+    uint32_t divergentSteps{0};              ///< Consecutive steps not issued to every running lane.
+    std::array<LaneOutcome, MaxLanes> outcomes{};
+};
+
+#endif // LOCKSTEP_HPP
@@ -1,7 +1,9 @@
 #ifndef MEMORY_HPP
 #define MEMORY_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include <array>
 
@@ -16,11 +18,85 @@ enum class AccessType {
     Write  ///< Represents a write operation.
 };
 
+/**
+ * @brief Zero-initialized physical RAM backed by an anonymous host mapping.
+ *
+ * Host pages are only committed when the guest first touches them, so large or numerous machines
+ * cost nothing for memory they never use, and clearing returns pages to the host instead of
+ * writing zeros. Address space above RAM is reserved for shared windows, host memory mapped into
+ * more than one machine.
+ */
+class PhysicalMemory {
+public:
+    static constexpr size_t WindowSpace = 16u << 20; ///< Room above RAM for shared windows.
+
+    /**
+     * @brief Maps `size` bytes of zeroed memory.
+     * 
+     * @throws std::bad_alloc if the mapping fails.
+     */
+    explicit PhysicalMemory(size_t size);
+    ~PhysicalMemory();
+
+    PhysicalMemory(const PhysicalMemory&) = delete;
+    PhysicalMemory& operator=(const PhysicalMemory&) = delete;
+
+    [[nodiscard]] uint8_t* data() noexcept { return bytes; }
+    [[nodiscard]] const uint8_t* data() const noexcept { return bytes; }
+    [[nodiscard]] size_t size() const noexcept { return length; }
+    [[nodiscard]] uint8_t& operator[](size_t index) noexcept { return bytes[index]; }
+    [[nodiscard]] const uint8_t& operator[](size_t index) const noexcept { return bytes[index]; }
+
+    /**
+     * @brief Zeroes RAM by dropping its pages. Shared windows keep their contents.
+     */
+    void clear() noexcept;
+
+    /**
+     * @brief Maps a shared host file at the next free page above RAM and earlier windows.
+     * 
+     * The window becomes part of physical memory (`size()` grows to include it), so every access
+     * path reaches it at host memory speed; all machines mapping the same file see the same bytes.
+     * 
+     * @param fd The file to map, typically a memfd.
+     * @param size The window size in bytes, a multiple of the page size.
+     * @return The physical address of the window.
+     * @throws std::runtime_error if the window does not fit or cannot be mapped.
+     */
+    uint32_t mapShared(int fd, size_t size);
+
+    /**
+     * @brief Maps part of a file over RAM, copy-on-write.
+     * 
+     * Pages are read from the file when the guest first touches them and guest writes stay private,
+     * so a machine restored this way only pays for the memory it uses. clear() drops the mapping.
+     * 
+     * @param offset The RAM offset, a multiple of the page size.
+     * @param fd The file to map.
+     * @param fileOffset The file offset, a multiple of the page size.
+     * @param size The length in bytes.
+     * @throws std::runtime_error if the range is outside RAM or cannot be mapped.
+     */
+    void mapPrivate(size_t offset, int fd, uint64_t fileOffset, size_t size);
+
+    /**
+     * @brief Whether parts of RAM are mapped from files; such pages may be non-resident yet non-zero.
+     */
+    [[nodiscard]] bool fileBacked() const noexcept { return hasFileMappings; }
+
+private:
+    uint8_t* bytes{nullptr}; ///< Start of the mapping.
+    size_t length{0};        ///< Accessible bytes: RAM and any windows.
+    size_t ramLength{0};     ///< Size of RAM in bytes.
+    bool hasFileMappings{false}; ///< Set by mapPrivate(), cleared by clear().
+};
+
 /**
  * @brief Memory class simulates the system's memory, including support for paging.
  *
  * This class manages reading from and writing to memory, as well as translating virtual addresses
- * to physical addresses using a simplified paging mechanism.
+ * to physical addresses using a simplified paging mechanism. Physical storage may be shared between
+ * the cores of an SMP machine; the translation state (TLB) is always private to one core.
  */
 class Memory {
 public:
@@ -31,6 +107,14 @@ public:
      */
     explicit Memory(size_t size, CPU& cpuarg);
 
+    /**
+     * @brief Constructs a per-core view of another core's physical memory.
+     * 
+     * @param shared The memory whose physical storage is shared.
+     * @param cpuarg The core this view translates for.
+     */
+    Memory(const Memory& shared, CPU& cpuarg);
+
     /**
      * @brief Reads a 32-bit value from the specified address.
      * 
@@ -67,6 +151,40 @@ public:
      */
     void writeRaw(uint32_t physicalAddress, uint32_t value);
 
+    /**
+     * @brief Returns a host pointer to a range of physical memory for zero-copy device access.
+     * 
+     * @param physicalAddress The first physical address of the range.
+     * @param length The length of the range in bytes.
+     * @return Pointer to the start of the range, or nullptr if the range is outside physical memory.
+     */
+    [[nodiscard]] uint8_t* physicalSpan(uint32_t physicalAddress, size_t length) noexcept {
+        if (physicalAddress > memory.size() || length > memory.size() - physicalAddress) {
+            return nullptr;
+        }
+        return memory.data() + physicalAddress;
+    }
+
+    /**
+     * @brief Returns the size of physical memory in bytes, including shared windows.
+     */
+    [[nodiscard]] size_t size() const noexcept { return memory.size(); }
+
+    /**
+     * @brief Maps a shared window above RAM, see PhysicalMemory::mapShared().
+     */
+    uint32_t mapShared(int fd, size_t size) { return memory.mapShared(fd, size); }
+
+    /**
+     * @brief Maps part of a file over RAM, see PhysicalMemory::mapPrivate().
+     */
+    void mapPrivate(size_t offset, int fd, uint64_t fileOffset, size_t size) { memory.mapPrivate(offset, fd, fileOffset, size); }
+
+    /**
+     * @brief Whether parts of RAM are mapped from files, see PhysicalMemory::fileBacked().
+     */
+    [[nodiscard]] bool fileBacked() const noexcept { return memory.fileBacked(); }
+
     /**
      * @brief Translates a virtual address to a physical address using the page table.
      * 
@@ -76,19 +194,50 @@ public:
      */
     [[nodiscard]] uint32_t translateVirtualAddress(uint32_t virtualAddress) const;
 
+    /**
+     * @brief Resolves an aligned word for an atomic access.
+     * 
+     * Raises an Alignment Check for misaligned addresses and a General Protection Fault if `access`
+     * is not permitted, like `read`/`write` do.
+     * 
+     * @param virtualAddress The virtual address of the word.
+     * @param access The access the caller is going to perform.
+     * @return Pointer to the word in physical memory, or nullptr if an exception was raised.
+     * @throws std::out_of_range if the address is outside the memory bounds.
+     */
+    [[nodiscard]] uint32_t* atomicWord(uint32_t virtualAddress, AccessType access);
+
+    /**
+     * @brief Drops every cached translation. Called when `TPDR` is written.
+     */
+    void flushTlb() noexcept { tlb.fill({}); }
+
     /**
      * @brief Resets the memory by clearing its contents and resetting the page table.
      */
     void reset() noexcept;
 
 private:
-    std::vector<uint8_t> memory; ///< The main memory storage as a byte-addressable vector.
+    /**
+     * @brief A cached page translation.
+     */
+    struct TlbEntry {
+        uint32_t tag{0};   ///< Virtual page number shifted left by one, with bit 0 as the valid bit.
+        uint32_t frame{0}; ///< Physical page base.
+    };
+
+    static constexpr size_t TlbEntries = 64; ///< Direct-mapped by the low bits of the virtual page number.
+
+    std::shared_ptr<PhysicalMemory> storage; ///< Physical memory, shared by all cores.
+    PhysicalMemory& memory; ///< The main memory storage as a byte-addressable array.
     CPU& cpu; ///< A reference to the CPU object for the TPDR register.
+    mutable std::array<TlbEntry, TlbEntries> tlb{}; ///< This core's translation cache.
 
     /**
      * @brief Internal helper function to translate a virtual address to a physical address.
      * 
-     * This function is used by `translateVirtualAddress` to perform the actual translation.
+     * This function is used by `translateVirtualAddress` to perform the actual translation. The page
+     * tables are only walked on a TLB miss.
      * 
      * @param address The virtual address to translate.
      * @return The corresponding physical address.
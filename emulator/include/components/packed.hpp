@@ -0,0 +1,303 @@
+#ifndef PACKED_HPP
+#define PACKED_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief The packed-integer extension: R-type opcode 0x00, with the operation selected by `func`.
+ *
+ * A packed instruction treats its 32-bit registers as independent lanes and applies the same
+ * operation to every lane of `rs1` and `rs2`. `func` holds the operation in bits 7–2 and the lane
+ * format in bits 1–0, so each operation comes in three widths, named by a mnemonic suffix:
+ * `.N` (8 × 4-bit), `.B` (4 × 8-bit) and `.H` (2 × 16-bit). An undefined `func` raises the invalid
+ * opcode interrupt like an undefined opcode does.
+ *
+ * Byte and halfword lanes run on SSE2 when the host has it; nibble lanes are widened to bytes,
+ * run the same way and packed back. A portable lane-by-lane loop defines the semantics and serves
+ * hosts without SSE2.
+ */
+class PackedAlu {
+public:
+    static constexpr uint8_t Opcode = 0x00; ///< The R-type opcode shared by all packed instructions.
+
+    /**
+     * @brief Lane format, `func` bits 1–0.
+     */
+    enum Format : uint8_t {
+        Nibbles = 0, ///< `.N`: eight 4-bit lanes.
+        Bytes = 1,   ///< `.B`: four 8-bit lanes.
+        Halves = 2,  ///< `.H`: two 16-bit lanes.
+    };
+
+    /**
+     * @brief Operation, `func` bits 7–2.
+     */
+    enum Operation : uint8_t {
+        Add = 1,        ///< PADD: wrapping add.
+        AddUnsigned,    ///< PADDUS: add, saturating to the unsigned lane range.
+        AddSigned,      ///< PADDS: add, saturating to the signed lane range.
+        Sub,            ///< PSUB: wrapping subtract.
+        SubUnsigned,    ///< PSUBUS: subtract, saturating at zero.
+        SubSigned,      ///< PSUBS: subtract, saturating to the signed lane range.
+        MinUnsigned,    ///< PMINU: unsigned minimum.
+        MinSigned,      ///< PMINS: signed minimum.
+        MaxUnsigned,    ///< PMAXU: unsigned maximum.
+        MaxSigned,      ///< PMAXS: signed maximum.
+        Average,        ///< PAVG: unsigned average, rounding up.
+        CompareEqual,   ///< PCMPEQ: all ones in lanes that are equal, zero elsewhere.
+        AbsDifference,  ///< PSAD: sum of the lanes' absolute differences, as one 32-bit value.
+        Shuffle,        ///< PSHUF: lane i = rs1 lane (rs2 lane i mod lanes), or zero if its top bit is set.
+    };
+
+    /**
+     * @brief Builds the `func` value of an operation and lane format.
+     */
+    [[nodiscard]] static constexpr uint8_t func(Operation operation, Format format) noexcept {
+        return static_cast<uint8_t>(operation << 2 | format);
+    }
+
+    /**
+     * @brief Whether `func` names a packed instruction.
+     */
+    [[nodiscard]] static constexpr bool defined(uint8_t func) noexcept {
+        uint8_t operation = func >> 2;
+        return (func & 3) != 3 && operation >= Add && operation <= Shuffle;
+    }
+
+    /**
+     * @brief Looks up the `func` of a packed mnemonic such as `PADDUS.B`.
+     *
+     * @return The `func` value, or nothing if `mnemonic` is not a packed instruction.
+     */
+    [[nodiscard]] static constexpr std::optional<uint8_t> findMnemonic(std::string_view mnemonic) noexcept {
+        size_t dot = mnemonic.find('.');
+        if (dot == std::string_view::npos || dot + 2 != mnemonic.size()) {
+            return std::nullopt;
+        }
+        uint8_t format;
+        switch (mnemonic[dot + 1]) {
+            case 'N': format = Nibbles; break;
+            case 'B': format = Bytes; break;
+            case 'H': format = Halves; break;
+            default: return std::nullopt;
+        }
+        for (uint8_t operation = Add; operation <= Shuffle; ++operation) {
+            if (Mnemonics[operation] == mnemonic.substr(0, dot)) {
+                return static_cast<uint8_t>(operation << 2 | format);
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief The operation name of a packed `func`, without its lane suffix.
+     *
+     * @return The name, or an empty view if `func` is undefined.
+     */
+    [[nodiscard]] static constexpr std::string_view operationMnemonic(uint8_t func) noexcept {
+        return defined(func) ? Mnemonics[func >> 2] : std::string_view{};
+    }
+
+    /**
+     * @brief The mnemonic of a packed `func`, for disassembly.
+     *
+     * @return The mnemonic with its lane suffix, or an empty string if `func` is undefined.
+     */
+    [[nodiscard]] static std::string mnemonic(uint8_t func) {
+        if (!defined(func)) {
+            return {};
+        }
+        return std::string(Mnemonics[func >> 2]) + "." + "NBH"[func & 3];
+    }
+
+    /**
+     * @brief Executes a packed instruction.
+     *
+     * @param func A defined packed `func`.
+     * @param a The value of `rs1`.
+     * @param b The value of `rs2`.
+     * @return The value written to `rd`.
+     */
+    [[nodiscard]] static uint32_t execute(uint8_t func, uint32_t a, uint32_t b) noexcept {
+        auto operation = static_cast<Operation>(func >> 2);
+        auto format = static_cast<Format>(func & 3);
+        if (operation == Shuffle) {
+            return lanewise(operation, format, a, b); // SSE2 has no variable shuffle; four lanes at most
+        }
+#if defined(__SSE2__)
+        switch (format) {
+            case Bytes:
+                return bytes(operation, a, b);
+            case Halves:
+                return halves(operation, a, b);
+            case Nibbles:
+                return nibbles(operation, a, b);
+        }
+#endif
+        return lanewise(operation, format, a, b);
+    }
+
+    /**
+     * @brief Portable reference implementation, one lane at a time.
+     */
+    [[nodiscard]] static constexpr uint32_t lanewise(Operation operation, Format format, uint32_t a, uint32_t b) noexcept {
+        const unsigned bits = 4u << format;
+        const unsigned lanes = 32 / bits;
+        const uint32_t mask = (1u << bits) - 1;
+        const int32_t smin = -(1 << (bits - 1));
+        const int32_t smax = (1 << (bits - 1)) - 1;
+        auto clamp = [](int32_t value, int32_t low, int32_t high) {
+            return value < low ? low : value > high ? high : value;
+        };
+        auto extend = [&](uint32_t lane) {
+            return static_cast<int32_t>(lane ^ (1u << (bits - 1))) - (1 << (bits - 1));
+        };
+
+        uint32_t result = 0;
+        uint32_t sum = 0;
+        for (unsigned lane = 0; lane < lanes; ++lane) {
+            const unsigned shift = lane * bits;
+            const uint32_t x = (a >> shift) & mask;
+            const uint32_t y = (b >> shift) & mask;
+            const int32_t sx = extend(x);
+            const int32_t sy = extend(y);
+            uint32_t r = 0;
+            switch (operation) {
+                case Add: r = x + y; break;
+                case AddUnsigned: r = x + y > mask ? mask : x + y; break;
+                case AddSigned: r = static_cast<uint32_t>(clamp(sx + sy, smin, smax)); break;
+                case Sub: r = x - y; break;
+                case SubUnsigned: r = x > y ? x - y : 0; break;
+                case SubSigned: r = static_cast<uint32_t>(clamp(sx - sy, smin, smax)); break;
+                case MinUnsigned: r = x < y ? x : y; break;
+                case MinSigned: r = sx < sy ? x : y; break;
+                case MaxUnsigned: r = x > y ? x : y; break;
+                case MaxSigned: r = sx > sy ? x : y; break;
+                case Average: r = (x + y + 1) >> 1; break;
+                case CompareEqual: r = x == y ? mask : 0; break;
+                case AbsDifference: sum += x > y ? x - y : y - x; break;
+                case Shuffle: r = (y >> (bits - 1)) ? 0 : (a >> ((y % lanes) * bits)) & mask; break;
+            }
+            result |= (r & mask) << shift;
+        }
+        return operation == AbsDifference ? sum : result;
+    }
+
+private:
+    static constexpr std::array<std::string_view, Shuffle + 1> Mnemonics {{
+        "", "PADD", "PADDUS", "PADDS", "PSUB", "PSUBUS", "PSUBS", "PMINU", "PMINS",
+        "PMAXU", "PMAXS", "PAVG", "PCMPEQ", "PSAD", "PSHUF"
+    }};
+
+#if defined(__SSE2__)
+    /**
+     * @brief Byte-lane operations on the low bytes of an XMM register. The upper bytes of both
+     * operands are zero, which also keeps them out of PSAD's sum.
+     */
+    [[nodiscard]] static __m128i bytes(Operation operation, __m128i x, __m128i y) noexcept {
+        const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+        switch (operation) {
+            case Add: return _mm_add_epi8(x, y);
+            case AddUnsigned: return _mm_adds_epu8(x, y);
+            case AddSigned: return _mm_adds_epi8(x, y);
+            case Sub: return _mm_sub_epi8(x, y);
+            case SubUnsigned: return _mm_subs_epu8(x, y);
+            case SubSigned: return _mm_subs_epi8(x, y);
+            case MinUnsigned: return _mm_min_epu8(x, y);
+            case MaxUnsigned: return _mm_max_epu8(x, y);
+            // Signed byte min/max are SSE4.1; bias into the unsigned range instead.
+            case MinSigned: return _mm_xor_si128(_mm_min_epu8(_mm_xor_si128(x, sign), _mm_xor_si128(y, sign)), sign);
+            case MaxSigned: return _mm_xor_si128(_mm_max_epu8(_mm_xor_si128(x, sign), _mm_xor_si128(y, sign)), sign);
+            case Average: return _mm_avg_epu8(x, y);
+            case CompareEqual: return _mm_cmpeq_epi8(x, y);
+            case AbsDifference: return _mm_sad_epu8(x, y);
+            case Shuffle: break;
+        }
+        return _mm_setzero_si128();
+    }
+
+    [[nodiscard]] static uint32_t bytes(Operation operation, uint32_t a, uint32_t b) noexcept {
+        __m128i x = _mm_cvtsi32_si128(static_cast<int>(a));
+        __m128i y = _mm_cvtsi32_si128(static_cast<int>(b));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(bytes(operation, x, y)));
+    }
+
+    [[nodiscard]] static uint32_t halves(Operation operation, uint32_t a, uint32_t b) noexcept {
+        const __m128i x = _mm_cvtsi32_si128(static_cast<int>(a));
+        const __m128i y = _mm_cvtsi32_si128(static_cast<int>(b));
+        const __m128i sign = _mm_set1_epi16(static_cast<short>(0x8000));
+        __m128i r = _mm_setzero_si128();
+        switch (operation) {
+            case Add: r = _mm_add_epi16(x, y); break;
+            case AddUnsigned: r = _mm_adds_epu16(x, y); break;
+            case AddSigned: r = _mm_adds_epi16(x, y); break;
+            case Sub: r = _mm_sub_epi16(x, y); break;
+            case SubUnsigned: r = _mm_subs_epu16(x, y); break;
+            case SubSigned: r = _mm_subs_epi16(x, y); break;
+            case MinSigned: r = _mm_min_epi16(x, y); break;
+            case MaxSigned: r = _mm_max_epi16(x, y); break;
+            // Unsigned halfword min/max are SSE4.1; bias into the signed range instead.
+            case MinUnsigned: r = _mm_xor_si128(_mm_min_epi16(_mm_xor_si128(x, sign), _mm_xor_si128(y, sign)), sign); break;
+            case MaxUnsigned: r = _mm_xor_si128(_mm_max_epi16(_mm_xor_si128(x, sign), _mm_xor_si128(y, sign)), sign); break;
+            case Average: r = _mm_avg_epu16(x, y); break;
+            case CompareEqual: r = _mm_cmpeq_epi16(x, y); break;
+            case AbsDifference: {
+                __m128i difference = _mm_or_si128(_mm_subs_epu16(x, y), _mm_subs_epu16(y, x));
+                uint32_t both = static_cast<uint32_t>(_mm_cvtsi128_si32(difference));
+                return (both & 0xFFFF) + (both >> 16);
+            }
+            case Shuffle: break;
+        }
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(r));
+    }
+
+    /**
+     * @brief Nibble lanes: the low nibbles go to bytes 0–3 and the high nibbles to bytes 4–7, the
+     * byte operation runs on values 0–15 (sign-extended for signed operations) and the results are
+     * clamped or masked back to four bits.
+     */
+    [[nodiscard]] static uint32_t nibbles(Operation operation, uint32_t a, uint32_t b) noexcept {
+        auto widen = [](uint32_t value) {
+            uint64_t spread = (value & 0x0F0F0F0Fu) | uint64_t((value >> 4) & 0x0F0F0F0Fu) << 32;
+            return _mm_cvtsi64_si128(static_cast<long long>(spread));
+        };
+        const __m128i low = _mm_set1_epi8(0x0F);
+        const __m128i x = widen(a);
+        const __m128i y = widen(b);
+        __m128i r;
+        switch (operation) {
+            case AddUnsigned:
+                r = _mm_min_epu8(_mm_add_epi8(x, y), low);
+                break;
+            case AddSigned:
+            case SubSigned:
+            case MinSigned:
+            case MaxSigned: {
+                // Sign-extend the nibbles into bytes, run the byte operation, clamp to -8..7.
+                const __m128i eight = _mm_set1_epi8(8);
+                __m128i sx = _mm_sub_epi8(_mm_xor_si128(x, eight), eight);
+                __m128i sy = _mm_sub_epi8(_mm_xor_si128(y, eight), eight);
+                r = bytes(operation == AddSigned ? Add : operation == SubSigned ? Sub : operation, sx, sy);
+                r = bytes(MaxSigned, bytes(MinSigned, r, _mm_set1_epi8(7)), _mm_set1_epi8(-8));
+                break;
+            }
+            case AbsDifference:
+                return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_sad_epu8(x, y)));
+            default:
+                r = bytes(operation, x, y);
+                break;
+        }
+        uint64_t packed = static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_and_si128(r, low)));
+        return static_cast<uint32_t>(packed) | static_cast<uint32_t>(packed >> 32) << 4;
+    }
+#endif
+};
+
+#endif // PACKED_HPP
@@ -0,0 +1,127 @@
+#ifndef PMU_HPP
+#define PMU_HPP
+
+#include <array>
+#include <cstdint>
+
+class CPU; // Forward declaration
+
+/**
+ * @brief Guest-visible performance monitoring unit.
+ *
+ * Five 32-bit counters exposed as special registers (see ARCH.md, Performance Monitoring). Retired
+ * instructions and cycles are accumulated per basic block and folded into the counters when control
+ * flow leaves the block, so the per-instruction cost is a single increment while counting and a
+ * single predictable branch while every counter is disabled.
+ */
+class PerformanceMonitor {
+public:
+    /**
+     * @brief Counter indices, matching the bit positions in PMCR and PMOVS.
+     */
+    enum Counter : uint8_t {
+        Instructions = 0, ///< Retired instructions.
+        Cycles = 1,       ///< Virtual cycles, see CycleCost.
+        Branches = 2,     ///< Taken branches, jumps, calls and returns.
+        PageWalks = 3,    ///< Page table walks (TLB misses).
+        Interrupts = 4,   ///< Interrupts and exceptions taken.
+        CounterCount
+    };
+
+    /**
+     * @brief Virtual cycle cost model.
+     */
+    struct CycleCost {
+        static constexpr uint32_t Instruction = 1; ///< Base cost of every instruction.
+        static constexpr uint32_t PageWalk = 2;    ///< One memory access per translation level.
+        static constexpr uint32_t Interrupt = 4;   ///< Context save and IVT fetch.
+    };
+
+    static constexpr uint32_t EnableMask = (1u << CounterCount) - 1; ///< PMCR bits 0-4.
+    static constexpr uint32_t OverflowInterruptShift = 8;            ///< PMCR bits 8-12.
+
+    /**
+     * @brief Constructs a PMU with all counters disabled.
+     *
+     * @param cpuRef The CPU the counters belong to.
+     */
+    explicit PerformanceMonitor(CPU& cpuRef) noexcept : cpu(cpuRef) {}
+
+    /**
+     * @brief Whether any counter is enabled. Guards every hook on the hot path.
+     */
+    [[nodiscard]] bool active() const noexcept { return control & EnableMask; }
+
+    /**
+     * @brief Accounts one retired instruction to the current block.
+     */
+    void retire() noexcept { ++blockInstructions; }
+
+    /**
+     * @brief Folds the current block into the instruction and cycle counters.
+     */
+    void endBlock() noexcept;
+
+    /**
+     * @brief Adds to a counter if it is enabled and records overflow.
+     *
+     * @param counter The counter to increment.
+     * @param amount The amount to add.
+     */
+    void count(Counter counter, uint32_t amount = 1) noexcept;
+
+    /**
+     * @brief Records a taken branch; ends the current block.
+     */
+    void branch() noexcept {
+        endBlock();
+        count(Branches);
+    }
+
+    /**
+     * @brief Whether an overflow interrupt is waiting to be raised.
+     */
+    [[nodiscard]] bool overflowPending() const noexcept { return pendingOverflow; }
+
+    /**
+     * @brief Raises the overflow interrupt at an instruction boundary if interrupts are enabled.
+     */
+    void deliverOverflow();
+
+    /**
+     * @brief Reads a PMU special register.
+     *
+     * @param index The special register index (PMCR..PMC4).
+     */
+    [[nodiscard]] uint32_t read(uint8_t index) noexcept;
+
+    /**
+     * @brief Writes a PMU special register.
+     *
+     * @param index The special register index (PMCR..PMC4).
+     * @param value The value to write.
+     */
+    void write(uint8_t index, uint32_t value) noexcept;
+
+    /**
+     * @brief Disables and clears all counters.
+     */
+    void reset() noexcept;
+
+    static constexpr uint8_t PMCR = 0x2E;  ///< Control register index.
+    static constexpr uint8_t PMOVS = 0x2F; ///< Overflow status register index.
+    static constexpr uint8_t PMC0 = 0x30;  ///< First counter register index.
+
+private:
+    CPU& cpu; ///< Receives the overflow interrupt.
+
+    uint32_t control{0};                           ///< PMCR.
+    uint32_t overflowStatus{0};                    ///< PMOVS.
+    std::array<uint32_t, CounterCount> counters{}; ///< PMC0-PMC4.
+    uint32_t blockInstructions{0};                 ///< Instructions retired since the last block boundary.
+    bool pendingOverflow{false};                   ///< An enabled counter overflowed and was not yet signalled.
+
+    friend class MachineSnapshot;
+};
+
+#endif // PMU_HPP
@@ -0,0 +1,75 @@
+#ifndef SMP_HPP
+#define SMP_HPP
+
+#include <components/cpu.hpp>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The secondary cores of an SMP machine, each running on its own host thread.
+ *
+ * The boot core is owned and run by the caller (it also polls devices); the cluster owns cores
+ * 1..N-1. Execution stops when a core fails (an emulation error or guest exit), when the boot core
+ * stops, or when the cluster is destroyed. A secondary core that halts with interrupts disabled just
+ * stops; the rest of the machine keeps running.
+ */
+class CoreCluster {
+public:
+    /**
+     * @brief Creates the secondary cores. They start with the boot core's current `I0`.
+     *
+     * @param boot The boot core.
+     * @param coreCount Total number of cores including the boot core (1-255).
+     * @throws std::invalid_argument if `coreCount` is out of range.
+     */
+    CoreCluster(CPU& boot, unsigned coreCount);
+
+    /**
+     * @brief Stops and joins all secondary cores.
+     */
+    ~CoreCluster();
+
+    CoreCluster(const CoreCluster&) = delete;
+    CoreCluster& operator=(const CoreCluster&) = delete;
+
+    /**
+     * @brief The secondary cores, in id order (core 1 first).
+     */
+    [[nodiscard]] const std::vector<std::unique_ptr<CPU>>& secondaries() const noexcept { return cores; }
+
+    /**
+     * @brief Starts one host thread per secondary core.
+     */
+    void start();
+
+    /**
+     * @brief Asks every secondary core to stop and joins their threads.
+     */
+    void stop() noexcept;
+
+    /**
+     * @brief Whether a secondary core ended with an exception. Cheap enough to poll from the boot core.
+     */
+    [[nodiscard]] bool failed() const noexcept { return failure.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Rethrows the first exception raised by a secondary core, if any.
+     */
+    void rethrowFailure();
+
+private:
+    void run(CPU& core) noexcept;
+
+    std::vector<std::unique_ptr<CPU>> cores; ///< Cores 1..N-1.
+    std::vector<std::thread> threads;        ///< One per secondary core.
+    std::atomic<bool> stopping{false};       ///< Set by stop().
+    std::atomic<bool> failure{false};        ///< Set once `firstError` is recorded.
+    std::mutex errorMutex;                   ///< Guards `firstError`.
+    std::exception_ptr firstError;           ///< The first exception a secondary core raised.
+};
+
+#endif // SMP_HPP
@@ -0,0 +1,99 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+class CPU; // Forward declaration
+class SyscallEmulator; // Forward declaration
+
+/**
+ * @brief Saves a stopped single-core machine to a file and resumes it later, possibly on another host.
+ *
+ * A snapshot holds the core's registers, pending interrupts, PMU and retired-instruction count, the
+ * host side of user-mode guests (open files and the mmap area), and RAM. RAM is stored page by page:
+ * every 4 KiB page gets a 64-bit content hash, all-zero pages are not stored, and a snapshot taken
+ * against a parent only stores pages whose hash differs from the parent's, so chains of snapshots
+ * grow with what changed rather than with RAM size. Stored pages are grouped into extents that are
+ * deflated in parallel; extents that do not compress, and all extents of an uncompressed snapshot,
+ * are kept page-aligned so restore can map them straight into RAM and let the guest fault them in.
+ *
+ * File layout (version 2, little-endian):
+ * - header: magic `XR32SNAP`, version, page size, RAM size, snapshot id, parent id, metadata size
+ * - metadata: parent path, CPU state, host state (mmap top and floor, open files), one kind byte and
+ *   one hash per page, extent table
+ * - extents: raw or deflated page contents, in page order
+ *
+ * The snapshot id hashes the metadata, so a child refuses to restore on top of a parent that was
+ * overwritten since. Devices with state of their own (`--netdev`, `--harddisk`) are not captured.
+ */
+class MachineSnapshot {
+public:
+    static constexpr uint32_t Version = 2;         ///< Format version written and accepted.
+    static constexpr size_t PageSize = 4096;       ///< Unit of hashing, elision and delta.
+    static constexpr size_t ExtentPages = 64;      ///< Stored pages per compression unit.
+
+    /**
+     * @brief How to write a snapshot.
+     */
+    struct SaveOptions {
+        std::optional<std::string> parent; ///< Only store pages that differ from this snapshot.
+        bool compress{true};               ///< Deflate extents; uncompressed snapshots restore lazily.
+        unsigned threads{0};               ///< Hashing and compression threads; 0 for one per hardware thread.
+    };
+
+    /**
+     * @brief What a save stored, for reporting.
+     */
+    struct SaveStatistics {
+        size_t pages{0};       ///< Pages of RAM.
+        size_t zeroPages{0};   ///< Pages elided because they are all zero.
+        size_t parentPages{0}; ///< Pages elided because the parent holds the same content.
+        size_t storedPages{0}; ///< Pages written to the file.
+        uint64_t fileBytes{0}; ///< Size of the snapshot file.
+    };
+
+    /**
+     * @brief Writes the machine's state to a file.
+     *
+     * The file is written under a temporary name and renamed when complete, so an interrupted save
+     * never leaves a truncated snapshot behind. The machine must not run while it is saved.
+     *
+     * @param path The snapshot file.
+     * @param cpu The boot core; RAM size must be a multiple of PageSize.
+     * @param syscalls The user-mode syscall layer, or nullptr for a bare machine.
+     * @param options Parent, compression and threads.
+     * @throws std::runtime_error if the snapshot or its parent cannot be written or read.
+     */
+    static SaveStatistics save(const std::string& path, CPU& cpu, SyscallEmulator* syscalls, const SaveOptions& options);
+
+    /**
+     * @brief Reads the RAM size a snapshot was taken with, to size the machine before restore().
+     *
+     * @throws std::runtime_error if the file is not a snapshot of this format version.
+     */
+    [[nodiscard]] static size_t memorySize(const std::string& path);
+
+    /**
+     * @brief Replaces the machine's state with a snapshot's.
+     *
+     * Parents are opened relative to the directory of the snapshot naming them. Deflated extents
+     * are inflated in parallel and checked against their page hashes; raw extents are mapped.
+     *
+     * @param path The snapshot file.
+     * @param cpu The boot core; must have the snapshot's RAM size.
+     * @param syscalls The user-mode syscall layer; required if and only if the snapshot has host state.
+     * @param threads Inflate threads; 0 for one per hardware thread.
+     * @throws std::runtime_error if the snapshot chain is incomplete, inconsistent or corrupt.
+     */
+    static void restore(const std::string& path, CPU& cpu, SyscallEmulator* syscalls, unsigned threads = 0);
+
+private:
+    [[nodiscard]] static std::vector<uint8_t> encodeCore(const CPU& cpu);
+    static void decodeCore(CPU& cpu, const std::vector<uint8_t>& state);
+};
+
+#endif // SNAPSHOT_HPP
@@ -0,0 +1,224 @@
+#ifndef SYSCALLS_HPP
+#define SYSCALLS_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+class CPU; // Forward declaration
+class ExecutionJournal; // Forward declaration
+
+/**
+ * @brief Thrown by the exit syscall to unwind the emulation loop with the guest's exit status.
+ */
+class GuestExit : public std::runtime_error {
+public:
+    explicit GuestExit(int32_t status)
+        : std::runtime_error("Guest exited with status " + std::to_string(status)), code(status) {}
+
+    /**
+     * @brief The status passed to the exit syscall.
+     */
+    [[nodiscard]] int32_t status() const noexcept { return code; }
+
+private:
+    int32_t code;
+};
+
+/**
+ * @brief Thrown when a guest running without a kernel takes an exception it has no handler for.
+ */
+class GuestFault : public std::runtime_error {
+public:
+    GuestFault(uint8_t vector, uint8_t errorCode, uint32_t address);
+};
+
+/**
+ * @brief User-mode syscall emulation: services `SWI` calls on the host instead of in a guest kernel.
+ *
+ * While installed, `SWI 0x80 + n` performs syscall `n` (see ARCH.md, User-Mode Syscall ABI). Arguments
+ * are taken from R1-R6 and the result is returned in R0, negative errno values signalling failure.
+ * Guest file descriptors are translated through a private table so the guest can never reach host
+ * descriptors it did not open, and buffers are handed to the host as iovecs pointing straight into
+ * guest RAM, so `read`/`write` run at host speed without intermediate copies. One emulator serves all
+ * cores of an SMP machine; each core gets its own stack below the top of RAM.
+ */
+class SyscallEmulator {
+public:
+    static constexpr uint8_t VectorBase = 0x80;  ///< `SWI VectorBase + n` calls syscall `n`.
+    static constexpr uint8_t VectorCount = 0x10; ///< Vectors 0x80-0x8F are reserved for syscalls.
+    static constexpr uint32_t StackSize = 1u << 20; ///< Per-core stack reserved below the top of RAM.
+
+    /**
+     * @brief Syscall numbers.
+     */
+    enum Number : uint8_t {
+        Exit = 0x00,  ///< exit(status)
+        Read = 0x01,  ///< read(fd, buf, len) -> bytes read
+        Write = 0x02, ///< write(fd, buf, len) -> bytes written
+        Open = 0x03,  ///< open(path, flags, mode) -> fd
+        Close = 0x04, ///< close(fd)
+        Mmap = 0x05,  ///< mmap(addr, len, prot, flags) -> address; anonymous mappings only
+        Clock = 0x06, ///< clock(clockId, timespec*) writes {seconds, nanoseconds}
+    };
+
+    /**
+     * @brief Guest `open` flags; values are fixed by the ABI, not by the host.
+     */
+    enum OpenFlags : uint32_t {
+        ReadOnly = 0x000,
+        WriteOnly = 0x001,
+        ReadWrite = 0x002,
+        Create = 0x040,
+        Truncate = 0x200,
+        Append = 0x400,
+    };
+
+    static constexpr uint32_t MapAnonymous = 0x20; ///< The only supported mmap flag.
+
+    /**
+     * @brief In-memory standard streams, so a guest can run without touching host descriptors.
+     */
+    struct CapturedStreams {
+        std::string_view input;      ///< Served to reads from fd 0.
+        size_t inputOffset{0};       ///< Bytes of `input` already read.
+        std::string output;          ///< Collects writes to fd 1.
+        std::string error;           ///< Collects writes to fd 2.
+        size_t limit{1u << 20};      ///< Per-stream cap; the guest sees further writes succeed.
+        bool truncated{false};       ///< Set once a write was cut short by `limit`.
+    };
+
+    /**
+     * @brief A guest file descriptor as it was when a snapshot was taken.
+     */
+    struct OpenFile {
+        std::string path; ///< Host path of the file; empty for a free slot or an unnamed file.
+        int flags{0};     ///< Host open flags.
+        off_t offset{0};  ///< File position.
+    };
+
+    /**
+     * @brief The host-side state a guest depends on, enough to resume it in another emulator.
+     */
+    struct Snapshot {
+        uint32_t mmapTop{0};         ///< Bottom of the anonymous mappings handed out so far.
+        uint32_t mmapFloor{0};       ///< Lowest address the mmap area may reach.
+        std::vector<OpenFile> files; ///< Guest descriptors 3 and up, in order.
+    };
+
+    /**
+     * @brief Lays out user-mode memory for a machine.
+     *
+     * Reserves one stack per core at the top of RAM and places the mmap area below the stacks.
+     * Guest descriptors 0-2 map to the host's standard streams.
+     *
+     * @param boot The boot core, whose memory is laid out.
+     * @param imageEnd First address past the loaded program; the mmap area never grows below it.
+     * @param coreCount Number of cores that will be attached.
+     */
+    SyscallEmulator(CPU& boot, uint32_t imageEnd, unsigned coreCount = 1);
+
+    /**
+     * @brief Closes every descriptor the guest left open.
+     */
+    ~SyscallEmulator();
+
+    SyscallEmulator(const SyscallEmulator&) = delete;
+    SyscallEmulator& operator=(const SyscallEmulator&) = delete;
+
+    /**
+     * @brief Services a core's `SWI` calls and points its stack pointer at its stack.
+     *
+     * @param core The core, whose id selects its stack.
+     */
+    void attach(CPU& core) noexcept;
+
+    /**
+     * @brief Redirects guest descriptors 0-2 to in-memory buffers.
+     *
+     * @param streams The buffers, or nullptr to use the host's standard streams again.
+     */
+    void captureStandardStreams(CapturedStreams* streams) noexcept { captured = streams; }
+
+    /**
+     * @brief Keeps the guest from changing host files.
+     *
+     * Files are opened read-only whatever the guest asks for, and writes to them report success
+     * without touching the file. Used to re-run parts of a guest that already ran once.
+     */
+    void sandbox() noexcept { sandboxed = true; }
+
+    /**
+     * @brief Records the host data returned by `read` and `clock`, or replays it from a journal.
+     *
+     * While replaying, `read` and `clock` return the logged results without touching the host.
+     *
+     * @param log The journal, or nullptr to stop journaling.
+     */
+    void setJournal(ExecutionJournal* log) noexcept { journal = log; }
+
+    /**
+     * @brief Records the mmap area and the path, flags and position of every open guest file.
+     */
+    [[nodiscard]] Snapshot snapshot();
+
+    /**
+     * @brief Reopens the files of a snapshot under the same guest descriptors and restores the mmap area.
+     *
+     * Files that can no longer be opened by path (pipes, sockets, deleted files) become closed
+     * descriptors. Standard streams are left alone.
+     */
+    void restore(const Snapshot& state);
+
+    /**
+     * @brief Whether a vector belongs to the syscall window.
+     */
+    [[nodiscard]] static constexpr bool isSyscall(uint8_t vector) noexcept {
+        return vector >= VectorBase && vector < VectorBase + VectorCount;
+    }
+
+    /**
+     * @brief Performs the syscall selected by a vector in the syscall window. Thread-safe.
+     *
+     * @param core The calling core, whose registers carry arguments and result.
+     * @param vector The `SWI` vector.
+     * @throws GuestExit when the guest calls exit.
+     */
+    void handle(CPU& core, uint8_t vector);
+
+private:
+    [[nodiscard]] int32_t doRead(CPU& core, uint32_t fd, uint32_t buffer, uint32_t length);
+    [[nodiscard]] int32_t doJournaledRead(CPU& core, uint32_t fd, uint32_t buffer, uint32_t length);
+    [[nodiscard]] int32_t doWrite(CPU& core, uint32_t fd, uint32_t buffer, uint32_t length);
+    [[nodiscard]] int32_t doOpen(CPU& core, uint32_t path, uint32_t flags, uint32_t mode);
+    [[nodiscard]] int32_t doClose(uint32_t fd);
+    [[nodiscard]] int32_t doMmap(CPU& core, uint32_t length, uint32_t flags);
+    [[nodiscard]] int32_t doClock(CPU& core, uint32_t clockId, uint32_t timespec);
+
+    /**
+     * @brief Resolves a guest buffer into host iovecs, one per physically contiguous run.
+     *
+     * @return false if any part of the buffer lies outside RAM. Unmapped pages fault as usual.
+     */
+    [[nodiscard]] static bool guestBuffer(CPU& core, uint32_t address, uint32_t length, std::vector<iovec>& out);
+
+    [[nodiscard]] int hostDescriptor(uint32_t fd);
+    [[nodiscard]] static int32_t readCaptured(CapturedStreams& streams, const std::vector<iovec>& iov);
+    [[nodiscard]] static int32_t writeCaptured(std::string& stream, CapturedStreams& streams, const std::vector<iovec>& iov);
+
+    std::mutex stateMutex;        ///< Guards the descriptor table and the mmap area.
+    std::vector<int> descriptors; ///< Guest fd -> host fd, -1 for free slots.
+    uint32_t stackTop;            ///< Top of core 0's stack.
+    uint32_t mmapTop;             ///< Next anonymous mapping ends here; the area grows down.
+    uint32_t mmapFloor;           ///< Lowest address the mmap area may reach.
+    CapturedStreams* captured{nullptr}; ///< In-memory standard streams, if capturing.
+    bool sandboxed{false};        ///< Host files are read-only to the guest.
+    ExecutionJournal* journal{nullptr}; ///< Records or replays host inputs, if set.
+};
+
+#endif // SYSCALLS_HPP
@@ -0,0 +1,152 @@
+#ifndef TIMELINE_HPP
+#define TIMELINE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Machine-level event timeline in the Chrome trace-event JSON format, loadable by Perfetto and
+ * `chrome://tracing`.
+ *
+ * Records interrupt handlers as spans from entry to `IRET`, host-serviced syscalls as spans, `HLT`
+ * waits, user/kernel mode as a counter per core, port accesses, and interrupts raised by devices and
+ * other cores. Every event is exported twice: against host time, and against virtual time in which
+ * one microsecond is one instruction retired by that core. Raised interrupts come from threads that
+ * have no instruction count and appear on the host timeline only.
+ *
+ * Each core appends to a Track it owns without locks; full batches go to a writer thread that formats
+ * and writes them. The file is valid JSON once the timeline is destroyed; a truncated one still loads
+ * in the trace viewers, which accept an unterminated event array.
+ */
+class EventTimeline {
+public:
+    static constexpr size_t BatchSize = 4096; ///< Events a track buffers before handing them off.
+
+    enum class Event : uint8_t {
+        InterruptEntry, ///< `a`: vector | error code << 8, `b`: interrupted `I0`.
+        InterruptExit,
+        SyscallEntry,   ///< `a`: syscall vector.
+        SyscallExit,
+        Mode,           ///< `a`: 1 in kernel mode, 0 in user mode.
+        PortIn,         ///< `a`: port, `b`: value read.
+        PortOut,        ///< `a`: port, `b`: value written.
+        HaltEntry,
+        HaltExit,
+        Raise,          ///< `a`: vector; host time only.
+    };
+
+    /**
+     * @brief One recorded event.
+     */
+    struct Record {
+        uint64_t host;    ///< Nanoseconds since the timeline started.
+        uint64_t retired; ///< Instructions the core had retired.
+        uint32_t a;
+        uint32_t b;
+        Event kind;
+        uint8_t core;
+    };
+
+    /**
+     * @brief Records one core's events. Used only by the thread running that core, except raised().
+     */
+    class Track {
+    public:
+        void record(Event kind, uint64_t retired, uint32_t a = 0, uint32_t b = 0) {
+            events.push_back({timeline.now(), retired, a, b, kind, coreId});
+            if (events.size() == BatchSize) [[unlikely]] {
+                handOff();
+            }
+        }
+
+        /**
+         * @brief Records the core's mode if it differs from the last one recorded.
+         */
+        void mode(bool kernel, uint64_t retired) {
+            if (kernel != kernelMode) {
+                kernelMode = kernel;
+                record(Event::Mode, retired, kernel);
+            }
+        }
+
+        /**
+         * @brief Records that an interrupt was made pending on this core. Safe to call from any thread.
+         */
+        void raised(uint8_t vector) noexcept { timeline.raised(coreId, vector); }
+
+    private:
+        friend class EventTimeline;
+
+        Track(EventTimeline& owner, uint8_t core) : timeline(owner), coreId(core) { events.reserve(BatchSize); }
+
+        /**
+         * @brief Queues the buffered events for the writer.
+         */
+        void handOff();
+
+        EventTimeline& timeline;
+        uint8_t coreId;
+        int kernelMode{-1}; ///< Last mode recorded, or -1 before the first.
+        std::vector<Record> events;
+    };
+
+    /**
+     * @brief Creates the timeline file and starts the writer thread.
+     *
+     * @param path The JSON file; created or truncated.
+     * @throws std::runtime_error if the file cannot be created.
+     */
+    explicit EventTimeline(const std::string& path);
+
+    /**
+     * @brief Writes every buffered event, terminates the JSON and closes the file. The cores must have
+     * stopped.
+     */
+    ~EventTimeline();
+
+    EventTimeline(const EventTimeline&) = delete;
+    EventTimeline& operator=(const EventTimeline&) = delete;
+
+    /**
+     * @brief Creates the track of a core. Call before the core starts running.
+     */
+    Track& track(uint8_t core);
+
+    /**
+     * @brief Nanoseconds since the timeline started.
+     */
+    [[nodiscard]] uint64_t now() const noexcept {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now() - start).count());
+    }
+
+private:
+    void raised(uint8_t core, uint8_t vector) noexcept;
+    void submit(std::vector<Record>&& batch);
+    void writerLoop() noexcept;
+    void write(const std::string& text) noexcept;
+
+    /**
+     * @brief Appends a record's JSON events to `out`, each preceded by a comma.
+     */
+    static void format(const Record& record, std::string& out);
+
+    int fd{-1};
+    std::chrono::steady_clock::time_point start;
+    std::vector<std::unique_ptr<Track>> tracks;
+    std::vector<Record> raises;                   ///< Raised interrupts not yet handed off.
+    std::vector<std::vector<Record>> pending;     ///< Batches for the writer.
+    std::string metadata;                         ///< Track names for the writer.
+    std::mutex mutex;                             ///< Guards `tracks`, `raises`, `pending` and `metadata`.
+    std::condition_variable wake;
+    bool stopping{false};
+    std::thread writer;
+};
+
+#endif // TIMELINE_HPP
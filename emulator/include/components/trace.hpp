@@ -0,0 +1,188 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utils/spsc_queue.hpp>
+
+/**
+ * @brief Binary instruction trace: every retired instruction's `I0`, word, register writes and memory
+ * accesses, recorded per core and written by a background thread.
+ *
+ * Each core encodes its records into a ring of fixed-size chunks it owns, so recording takes no locks
+ * and no system calls. A full chunk is passed to the writer thread over a single-producer queue and
+ * comes back over another once written; a core only waits if every chunk of its ring is queued. The
+ * writer stores each chunk as a block, deflated unless compression is off.
+ *
+ * Records are delta-encoded: `I0` only when it is not the previous `I0` + 8, the word only when it
+ * differs from the one last seen at that address, and register values as varints. A tight loop thus
+ * costs about three bytes per instruction before compression.
+ *
+ * decode() renders a trace as text, optionally only the instructions in an address range.
+ */
+class InstructionTrace {
+public:
+    static constexpr size_t ChunkSize = 256 * 1024; ///< Bytes of records per block.
+    static constexpr size_t RingChunks = 16;        ///< Chunks per core.
+    static constexpr size_t MaxAccesses = 8;        ///< Memory accesses kept per instruction.
+
+    /**
+     * @brief Record header bits.
+     */
+    enum Flags : uint8_t {
+        Jump = 1 << 0,      ///< `I0` follows as a zigzag varint delta from the previous `I0` + 8.
+        Word = 1 << 1,      ///< The instruction word follows, 8 bytes little-endian.
+        Registers = 1 << 2, ///< A count, then that many register indices and varint values.
+        Accesses = 1 << 3,  ///< A count, then that many kinds (0 read, 1 write), varint addresses and values.
+    };
+
+    /**
+     * @brief Records one core's instructions. Used only by the thread running that core.
+     */
+    class Recorder {
+    public:
+        /**
+         * @brief Register state before an instruction: the general registers, `S0` and `FR`.
+         */
+        struct Snapshot {
+            std::array<uint32_t, 32> R;
+            uint32_t S0;
+            uint8_t FR;
+        };
+
+        /**
+         * @brief Starts the record of the instruction at `i0`; the registers are compared in end().
+         */
+        void begin(uint32_t i0, uint64_t word, const std::array<uint32_t, 32>& R, uint32_t S0, uint8_t FR) noexcept {
+            pc = i0;
+            instruction = word;
+            before.R = R;
+            before.S0 = S0;
+            before.FR = FR;
+            accessCount = 0;
+        }
+
+        /**
+         * @brief Notes a memory access of the current instruction.
+         */
+        void access(bool write, uint32_t address, uint32_t value) noexcept {
+            if (accessCount < MaxAccesses) {
+                accesses[accessCount++] = {address, value, write};
+            }
+        }
+
+        /**
+         * @brief Encodes the current instruction given the registers after it.
+         */
+        void end(const std::array<uint32_t, 32>& R, uint32_t S0, uint8_t FR);
+
+    private:
+        friend class InstructionTrace;
+
+        struct Access {
+            uint32_t address;
+            uint32_t value;
+            bool write;
+        };
+
+        struct Chunk {
+            std::unique_ptr<uint8_t[]> data{new uint8_t[ChunkSize]};
+            size_t size{0};
+            uint64_t first{0}; ///< Index of the chunk's first record in the core's trace.
+        };
+
+        Recorder(InstructionTrace& owner, uint8_t core);
+
+        /**
+         * @brief Queues the current chunk for writing and takes a free one.
+         */
+        void handOff();
+
+        void putVarint(uint64_t value) noexcept {
+            while (value >= 0x80) {
+                *cursor++ = static_cast<uint8_t>(value | 0x80);
+                value >>= 7;
+            }
+            *cursor++ = static_cast<uint8_t>(value);
+        }
+
+        InstructionTrace& trace;
+        uint8_t coreId;
+        std::array<Chunk, RingChunks> chunks;
+        SpscQueue<uint32_t, RingChunks * 2> filled; ///< Chunks for the writer.
+        SpscQueue<uint32_t, RingChunks * 2> spare;  ///< Chunks the writer has finished with.
+        uint32_t current{0};                        ///< Chunk being filled.
+        uint8_t* cursor;                            ///< Next byte of the current chunk.
+        uint64_t records{0};                        ///< Records encoded so far.
+
+        uint32_t pc{0};
+        uint64_t instruction{0};
+        Snapshot before{};
+        std::array<Access, MaxAccesses> accesses{};
+        size_t accessCount{0};
+        uint32_t expected{0};                               ///< `I0` the next record is assumed to have.
+        std::array<std::pair<uint32_t, uint64_t>, 4096> words{}; ///< Last word seen per address, direct-mapped.
+    };
+
+    /**
+     * @brief Creates a trace file and starts the writer thread.
+     *
+     * @param path The trace file; created or truncated.
+     * @param compress Whether to deflate blocks.
+     * @throws std::runtime_error if the file cannot be created.
+     */
+    InstructionTrace(const std::string& path, bool compress);
+
+    /**
+     * @brief Writes every partial chunk and closes the file. The cores must have stopped.
+     */
+    ~InstructionTrace();
+
+    InstructionTrace(const InstructionTrace&) = delete;
+    InstructionTrace& operator=(const InstructionTrace&) = delete;
+
+    /**
+     * @brief Creates the recorder for a core. Call before the core starts running.
+     */
+    Recorder& recorder(uint8_t core);
+
+    /**
+     * @brief Renders a trace as one line per instruction.
+     *
+     * @param path The trace file.
+     * @param out Receives the text.
+     * @param low,high Only instructions with `low` <= `I0` < `high` are listed.
+     * @return The number of instructions listed.
+     * @throws std::runtime_error if the file is not a trace or is corrupt.
+     */
+    static uint64_t decode(const std::string& path, std::ostream& out, uint32_t low = 0, uint64_t high = UINT64_C(1) << 32);
+
+    /**
+     * @brief The bound on the encoded size of one record.
+     */
+    static constexpr size_t MaxRecordSize = 1 + 5 + 8 + 1 + 34 * 6 + 1 + MaxAccesses * 11;
+
+private:
+    void writerLoop() noexcept;
+    bool writeChunks(Recorder& core);
+    void wake() noexcept;
+
+    int fd{-1};
+    bool compressBlocks;
+    std::vector<std::unique_ptr<Recorder>> recorders;
+    std::mutex mutex;                   ///< Guards `recorders` and the writer's sleep.
+    std::condition_variable pending;    ///< Wakes the writer.
+    std::atomic<bool> stopping{false};
+    std::thread writer;
+};
+
+#endif // TRACE_HPP
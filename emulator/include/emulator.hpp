@@ -5,6 +5,10 @@
 #include <components/memory.hpp>
 #include <components/io.hpp>
 #include <components/interrupts.hpp>
+#include <utils/build_cache.hpp>
+#include <optional>
+#include <string_view>
+#include <vector>
 
 /**
  * @brief The Emulator class encapsulates the entire system emulation.
@@ -17,48 +21,86 @@ class Emulator {
 public:
     /**
      * @brief Constructs the Emulator object, initializing all components.
-     * 
+     *
      * Initializes the CPU, memory, IO, and interrupt systems, preparing the emulator for program loading and execution.
+     * Assembly sources are cached in BuildCache::defaultDirectory().
+     *
+     * @param memorySize The amount of guest RAM in bytes.
      */
-    Emulator();
+    explicit Emulator(size_t memorySize);
 
     /**
-     * @brief Loads a program from the specified file into memory.
-     * 
+     * @brief A program image and, for assembled sources, the address it was assembled for.
+     */
+    struct ProgramImage {
+        std::vector<uint8_t> bytes;
+        std::optional<uint32_t> origin; ///< The source's `.org`, else Assembler::DefaultOrigin; none for binaries.
+    };
+
+    /**
+     * @brief Loads a program from the specified file into memory and points `I0` at its first byte.
+     *
      * This method reads the binary or assembly file specified by the filepath and loads its contents
-     * into the emulated memory, starting at a predefined memory address.
-     * 
+     * into the emulated memory. Assembly is done in memory; its output is looked up in and stored to
+     * the build cache, keyed by the source and Assembler::Version.
+     *
      * @param filepath The path to the file containing the program to be loaded.
-     * @param paddr The memory address at which the program should be loaded.
+     * @param paddr The memory address at which a binary is loaded; an assembly source is loaded at its origin.
      * @param assemble If true, the file will be parsed as an assembly file and assembled, otherwise it will be loaded directly.
+     * @return The first address past the loaded image.
      * @throws std::runtime_error if the file cannot be read or if the program exceeds memory limits.
      */
-    void loadProgram(std::string_view filepath, uint32_t paddr, bool assemble = false);
+    uint32_t loadProgram(std::string_view filepath, uint32_t paddr, bool assemble = false);
+
+    /**
+     * @brief Reads a program image from a binary file, or assembles it from a source file.
+     *
+     * @param filepath The program file.
+     * @param assemble Whether the file is assembly source.
+     * @param cache The build cache to consult for sources, or nullptr to always assemble.
+     * @throws std::runtime_error if the file cannot be read or does not assemble.
+     */
+    [[nodiscard]] static ProgramImage readProgram(std::string_view filepath, bool assemble, const BuildCache* cache);
+
+    /**
+     * @brief Whether a file name denotes assembly source (`.s` or `.asm`) rather than a binary image.
+     */
+    [[nodiscard]] static bool isAssemblySource(std::string_view filepath) noexcept;
+
+    /**
+     * @brief Always assembles sources, neither reading nor writing the build cache.
+     */
+    void disableBuildCache() noexcept { cache.reset(); }
 
     /**
      * @brief Runs the emulation, executing the loaded program.
-     * 
+     *
      * This method starts the emulation loop, continuously executing instructions until a halt condition is encountered
      * or an interrupt signals the end of execution.
+     *
+     * @throws GuestExit when a user-mode guest exits; other exceptions signal emulation errors.
      */
     void run();
 
     /**
      * @brief Resets the emulator to its initial state.
-     * 
+     *
      * Resets the CPU, clears the memory, reinitializes the IO and interrupt systems, and prepares the emulator for a new run.
      */
     void reset();
 
+    /**
+     * @brief The boot core, through which memory, IO and interrupts are reached.
+     */
+    [[nodiscard]] CPU& core() noexcept { return cpu; }
+
 private:
-    CPU cpu;                 ///< The CPU component, responsible for instruction execution.
-    Memory memory;           ///< The Memory component, simulating the system's memory.
-    IO io;                   ///< The IO component, handling input/output operations.
-    Interrupts interrupts;   ///< The Interrupts component, managing system interrupts.
+    CPU cpu;                         ///< The CPU component; owns memory, IO and interrupts.
+    std::optional<BuildCache> cache; ///< Assembled sources, if a cache directory is available.
 
     /**
      * @brief Executes a single emulation cycle.
-     * 
+     *
      * This method fetches, decodes, and executes a single instruction, simulating one CPU cycle.
      * It also handles any interrupts that may occur during the cycle.
      */
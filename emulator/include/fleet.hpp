@@ -0,0 +1,96 @@
+#ifndef FLEET_HPP
+#define FLEET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One guest run in a fleet: a program, its standard input and its limits.
+ */
+struct FleetJob {
+    std::string binary;  ///< Program image, loaded at 0x1000.
+    std::string input;   ///< File served as the guest's standard input; empty for none.
+    uint64_t budget;     ///< Maximum number of instructions to execute.
+    size_t memorySize;   ///< Guest RAM in bytes.
+    std::vector<std::string> channels; ///< Channels the guest connects to, see ChannelDevice.
+};
+
+/**
+ * @brief The outcome of a FleetJob.
+ */
+struct FleetResult {
+    enum class Status {
+        Exited,          ///< The guest called exit; see `exitCode`.
+        Halted,          ///< The guest executed HLT with nothing left to wait for.
+        BudgetExhausted, ///< The instruction budget ran out.
+        Error,           ///< Emulation failed; see `message`.
+    };
+
+    Status status{Status::Error};
+    int32_t exitCode{0};        ///< Valid for Status::Exited.
+    uint64_t instructions{0};   ///< Instructions executed.
+    uint64_t microseconds{0};   ///< Wall time of the run, including setup; of the whole group in lockstep.
+    std::string output;         ///< Captured standard output.
+    std::string error;          ///< Captured standard error.
+    bool truncated{false};      ///< Output exceeded the capture limit.
+    std::string message;        ///< Emulator error, for Status::Error.
+};
+
+/**
+ * @brief Runs many independent user-mode guests in-process on a work-stealing thread pool.
+ *
+ * Each job gets its own CPU and memory, captured standard streams and an instruction budget; nothing
+ * is shared between running jobs except read-only program and input images, which are loaded once
+ * per distinct path, and the channels jobs name to talk to each other. Results are reported as JSON
+ * Lines, one object per job in job order.
+ */
+class Fleet {
+public:
+    /**
+     * @brief Per-job settings used when a job line does not override them.
+     */
+    struct Defaults {
+        uint64_t budget;
+        size_t memorySize;
+    };
+
+    /**
+     * @brief Parses a job file.
+     *
+     * Each non-empty line not starting with `#` holds a binary path followed by optional
+     * `input=<file>`, `budget=<instructions>`, `mem=<bytes>` and any number of `channel=<name>`
+     * fields. Relative paths are resolved against the job file's directory.
+     *
+     * @param path The job file.
+     * @param defaults Settings for fields a line omits.
+     * @throws std::runtime_error naming the offending line on malformed input.
+     */
+    [[nodiscard]] static std::vector<FleetJob> parseJobs(const std::string& path, const Defaults& defaults);
+
+    /**
+     * @brief Runs all jobs and returns their results in job order.
+     *
+     * Jobs connected through channels run concurrently, each on a thread of its own, and are
+     * numbered as endpoints of each channel in job order. With `lanes` above 1, the other jobs with
+     * the same binary, memory size and budget are batched into lockstep groups of up to `lanes`
+     * guests (see LockstepGroup), each run by one worker.
+     *
+     * @param jobs The jobs to run.
+     * @param threads Worker threads; 0 selects one per hardware thread.
+     * @param lanes Guests per lockstep group (1-16); 1 runs every job on its own CPU.
+     */
+    [[nodiscard]] static std::vector<FleetResult> run(const std::vector<FleetJob>& jobs, unsigned threads, unsigned lanes = 1);
+
+    /**
+     * @brief Writes one JSON object per job.
+     *
+     * Captured output is emitted as JSON strings. Bytes outside printable ASCII are written as
+     * unicode escapes of the same value (0-255), so the original bytes can always be recovered.
+     */
+    static void writeReport(std::ostream& out, const std::vector<FleetJob>& jobs, const std::vector<FleetResult>& results);
+};
+
+#endif // FLEET_HPP
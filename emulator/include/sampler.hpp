@@ -0,0 +1,102 @@
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Settings of a sampled run.
+ */
+struct SampleOptions {
+    std::string binary;      ///< Program image, loaded at 0x1000.
+    std::string input;       ///< File served as the guest's standard input; empty for none.
+    uint64_t interval;       ///< Instructions per interval.
+    unsigned clusters;       ///< Maximum number of simulation points.
+    uint64_t budget;         ///< Maximum number of instructions to fast-forward.
+    size_t memorySize;       ///< Guest RAM in bytes.
+    unsigned threads;        ///< Replay threads; 0 selects one per hardware thread.
+};
+
+/**
+ * @brief What an instrumented replay of one interval observed.
+ */
+struct IntervalProfile {
+    uint64_t instructions{0};            ///< Instructions replayed.
+    uint64_t controlTransfers{0};        ///< Taken branches, jumps, calls, returns and interrupts.
+    std::array<uint64_t, 64> opcodes{};  ///< Retired instructions per opcode.
+    std::vector<std::pair<uint32_t, uint64_t>> hotBlocks; ///< Busiest basic blocks (address, instructions), busiest first.
+    bool diverged{false};                ///< The replay did not end in the state the fast-forward pass recorded.
+    std::string message;                 ///< Emulator error, if the replay failed.
+};
+
+/**
+ * @brief One representative interval and the share of the run it stands for.
+ */
+struct SimulationPoint {
+    size_t interval;         ///< Index of the interval.
+    uint64_t start;          ///< Instructions executed before the interval.
+    size_t members;          ///< Intervals in its cluster.
+    double weight;           ///< Fraction of all executed instructions its cluster covers.
+    IntervalProfile profile; ///< Result of the instrumented replay.
+};
+
+/**
+ * @brief The outcome of a sampled run.
+ */
+struct SampleReport {
+    enum class Status {
+        Exited,          ///< The guest called exit; see `exitCode`.
+        Halted,          ///< The guest executed HLT with nothing left to wait for.
+        BudgetExhausted, ///< The instruction budget ran out.
+        Error,           ///< Emulation failed; see `message`.
+    };
+
+    Status status{Status::Error};
+    int32_t exitCode{0};          ///< Valid for Status::Exited.
+    std::string message;          ///< Emulator error, for Status::Error.
+    uint64_t instructions{0};     ///< Instructions executed by the fast-forward pass.
+    size_t intervals{0};          ///< Intervals the run was cut into.
+    size_t checkpointBytes{0};    ///< Memory held by all checkpoints.
+    double fastForwardSeconds{0}; ///< Wall time of the fast-forward pass.
+    double replaySeconds{0};      ///< Wall time of clustering and all replays.
+    std::vector<SimulationPoint> points; ///< One per cluster, by interval.
+};
+
+/**
+ * @brief Sampled simulation: one fast pass over a long user-mode run, then detailed replays of a few intervals.
+ *
+ * The fast-forward pass runs the guest once on the plain interpreter, cut into fixed-length intervals.
+ * For every interval it records a basic block vector, randomly projected to a few dimensions as in
+ * SimPoint, and at every interval boundary it takes a checkpoint: the registers, the syscall layer's
+ * state and the RAM pages that changed since the previous checkpoint. The intervals are then
+ * clustered with k-means and the interval closest to each centroid is replayed from its checkpoint
+ * on a work-stealing pool with per-instruction instrumentation. The replays' profiles, weighted by
+ * cluster size, estimate the profile of the whole run.
+ *
+ * Replays see the guest's standard input at the position it had, discard all output and open host
+ * files read-only (see SyscallEmulator::sandbox()), so they leave no trace on the host.
+ */
+class Sampler {
+public:
+    /**
+     * @brief Runs the fast-forward pass and replays the simulation points.
+     *
+     * @param options The program and the sampling parameters.
+     * @param output Receives the guest's standard output, as the fast-forward pass produces it.
+     * @param error Receives the guest's standard error.
+     * @throws std::runtime_error if the program or input cannot be loaded.
+     */
+    [[nodiscard]] static SampleReport run(const SampleOptions& options, std::ostream& output, std::ostream& error);
+
+    /**
+     * @brief Writes the report as JSON Lines: a summary with whole-run estimates, then one object per simulation point.
+     */
+    static void writeReport(std::ostream& out, const SampleOptions& options, const SampleReport& report);
+};
+
+#endif // SAMPLER_HPP
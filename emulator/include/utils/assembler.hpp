@@ -1,73 +1,205 @@
 #ifndef ASSEMBLER_HPP
 #define ASSEMBLER_HPP
 
+#include <array>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <components/cpu.hpp>
+#include <utils/assembly_syntax.hpp>
+#include <utils/object_file.hpp>
+#include <utils/work_stealing_pool.hpp>
 
 /**
  * @brief Assembler class for XR-32 architecture.
- * 
+ *
  * This class provides methods to assemble XR-32 assembly code into binary machine code.
+ *
+ * Source is one statement per line: an optional `label:`, then an instruction or directive with its
+ * operands separated by spaces or commas. `;` starts a comment. Numbers are decimal, `0x` hex or `0b`
+ * binary, optionally negative. Wherever an address or immediate is expected a symbol may be used,
+ * optionally with a `+n`/`-n` addend; `BEQ`/`BNE` turn symbols into offsets relative to the next
+ * instruction. Directives: `.org`, `.equ`, `.byte`, `.word` (32-bit), `.quad`, `.ascii`, `.asciz`,
+ * `.align`, `.space`, `.text` and `.data` (the sections that follow go to), and `.global`.
+ *
+ * Flat binaries hold `.text` followed by `.data`, aligned to its largest `.align`. Objects keep the
+ * two sections apart, each assembled from address 0; references to labels that need to move with
+ * their section, and to symbols no line defines, become relocations for the linker.
+ *
+ * Assembly runs in three passes. The layout pass sizes every statement and records where labels,
+ * `.equ`, `.align`, `.space` and `.org` fall; because instructions are a fixed 8 bytes it only looks at
+ * the operands of directives. The placement pass walks those records in source order, assigning chunk
+ * addresses and defining every symbol. The encoding pass then writes each chunk into its preallocated
+ * part of the output, resolving symbols directly, so forward references need no fixups. Large sources
+ * are split at line boundaries into chunks that are laid out and encoded in parallel; the output is
+ * the same for any number of threads.
+ *
+ * The lexer works on `string_view`s into the source (a mapped file when assembling from disk), and
+ * mnemonics and registers are looked up in compile-time perfect hash tables, so no per-line
+ * allocations are made.
  */
 class Assembler {
 public:
+    /**
+     * @brief Revision of the encoder. Part of the build cache key, so it must change whenever the same
+     * source would assemble to different bytes.
+     */
+    static constexpr uint32_t Version = 4;
+
+    /**
+     * @brief Address of the first byte unless the source starts with `.org`; where xr32-tool loads programs.
+     */
+    static constexpr uint32_t DefaultOrigin = 0x1000;
+
+    /**
+     * @brief Bytes of source per chunk; smaller sources are assembled on the calling thread.
+     */
+    static constexpr size_t ChunkSize = 1 << 20;
+
     /**
      * @brief Constructs an Assembler object.
+     * @param threads Threads to assemble large sources on; 0 selects one per hardware thread.
      */
-    Assembler() = default;
+    explicit Assembler(unsigned threads = 0);
 
     /**
      * @brief Assembles a given XR-32 assembly source file into a binary file.
+     *
+     * The source is mapped rather than read, and the output file is created at its final size and
+     * mapped, so encoding threads write straight into it.
      * @param sourceFile The file containing XR-32 assembly code.
      * @param outputFile The binary file to write the assembled machine code.
      * @return true if assembly was successful, false otherwise.
+     * @throws std::runtime_error if a file cannot be opened or a line does not assemble.
      */
     bool assemble(const std::string& sourceFile, const std::string& outputFile);
 
+    /**
+     * @brief Assembles XR-32 source held in memory.
+     * @param source The assembly code.
+     * @return The machine code, 8 little-endian bytes per instruction.
+     * @throws std::runtime_error naming the line that does not assemble.
+     */
+    std::vector<uint8_t> assemble(std::string_view source);
+
+    /**
+     * @brief Address the image of the last assemble() starts at: its `.org`, else DefaultOrigin.
+     */
+    [[nodiscard]] uint32_t imageOrigin() const noexcept { return origin; }
+
+    /**
+     * @brief Assembles XR-32 source into a relocatable object for Linker.
+     * @throws std::runtime_error naming the line that does not assemble.
+     */
+    ObjectFile assembleObject(std::string_view source);
+
+    /**
+     * @brief Assembles a source file into an object file.
+     * @throws std::runtime_error if a file cannot be opened or a line does not assemble.
+     */
+    void assembleObject(const std::string& sourceFile, const std::string& objectFile);
+
     /**
      * @brief Parses a single line of XR-32 assembly code and converts it into binary.
-     * @param line The line of XR-32 assembly code to parse.
+     * @param line The line of XR-32 assembly code to parse; it may not refer to symbols.
      * @return The corresponding 64-bit machine code for the given instruction.
      */
-    uint64_t parseAssemblyLine(const std::string& line);
+    uint64_t parseAssemblyLine(std::string_view line);
 
 private:
+    using Section = ObjectFile::Section;
+    using FieldKind = ObjectFile::FieldKind;
+
+    struct Symbol {
+        int64_t value;
+        Section section; ///< Absolute once a flat binary is laid out.
+    };
+
+    using Statement = xr32::syntax::Statement;
+
     /**
-     * @brief Assembles an R-Type instruction from tokens.
-     * @param tokens The tokens representing the instruction.
-     * @return The assembled 64-bit instruction.
+     * @brief A statement whose effect on the layout depends on what precedes it in the source.
      */
-    uint64_t assembleRType(const std::vector<std::string>& tokens);
+    struct LayoutItem {
+        enum class Kind : uint8_t { Label, Equ, Align, Space, Org, Section, Global } kind;
+        size_t gap;             ///< Bytes laid out since the previous item of the chunk.
+        std::string_view name;  ///< Label, `.equ` or `.global` name, or the section directive.
+        std::string_view value; ///< Operand of `.equ`, `.align`, `.space` or `.org`.
+        size_t line;            ///< Line within the chunk.
+    };
 
     /**
-     * @brief Assembles an I-Type instruction from tokens.
-     * @param tokens The tokens representing the instruction.
-     * @return The assembled 64-bit instruction.
+     * @brief A run of whole source lines, laid out and encoded by one task.
      */
-    uint64_t assembleIType(const std::vector<std::string>& tokens);
+    struct Chunk {
+        std::string_view source;
+        size_t firstLine{0};              ///< Lines before this chunk.
+        size_t lines{0};
+        std::vector<LayoutItem> items;
+        size_t tail{0};                   ///< Bytes laid out after the last item.
+        Section section{Section::Text};   ///< Section the chunk starts in.
+        std::array<uint64_t, ObjectFile::SectionCount> start{}; ///< Where the chunk continues each section.
+        std::vector<std::pair<ObjectFile::Relocation, std::string_view>> relocations; ///< With the symbol name, if not local.
+        size_t errorLine{0};              ///< Line within the chunk of the first error, if any.
+        std::optional<std::string> error;
+    };
 
     /**
-     * @brief Assembles a J-Type instruction from tokens.
-     * @param tokens The tokens representing the instruction.
-     * @return The assembled 64-bit instruction.
+     * @brief Where the encoding pass is writing.
      */
-    uint64_t assembleJType(const std::vector<std::string>& tokens);
+    struct Cursor {
+        uint8_t* data;
+        uint64_t address;
+        Section section;
+    };
+
+    [[nodiscard]] size_t layout(std::string_view source, bool object);
+    void encode(const std::array<uint8_t*, ObjectFile::SectionCount>& targets);
+    template <typename Work> void forEachChunk(Work work);
+    void throwFirstError() const;
+
+    void layoutChunk(Chunk& chunk) const;
+    void place();
+    void encodeChunk(Chunk& chunk, const std::array<uint8_t*, ObjectFile::SectionCount>& targets) const;
+
+    static void lex(std::string_view line, Statement& statement, bool operands);
+    [[nodiscard]] static size_t dataSize(const Statement& statement);
+    void encodeInstruction(const Statement& statement, Cursor& at, Chunk& chunk) const;
+    void encodeDirective(const Statement& statement, Cursor& at, Chunk& chunk) const;
+    void define(std::string_view symbol, Symbol value);
 
     /**
-     * @brief Utility to split a line of assembly code into tokens.
-     * @param line The line of code to tokenize.
-     * @return A vector of tokens.
+     * @brief Encodes an operand that may be a number or a symbol into the field of `kind`, recording
+     * a relocation in `chunk` if the symbol is not a plain number.
      */
-    std::vector<std::string> tokenizeLine(const std::string& line);
+    [[nodiscard]] uint64_t operand(std::string_view token, FieldKind kind, const Cursor& at, Chunk& chunk) const;
 
     /**
-     * @brief Utility to parse an immediate value from a string.
-     * @param immStr The string to parse.
-     * @return The parsed immediate value.
+     * @brief Evaluates an operand that must be known now: a number or an already defined symbol.
      */
-    int32_t parseImmediate(const std::string& immStr);
+    [[nodiscard]] Symbol evaluate(std::string_view token) const;
+
+    /**
+     * @brief Evaluates an operand that must be a plain number.
+     */
+    [[nodiscard]] int64_t constant(std::string_view token) const;
+
+    unsigned threads;                                      ///< Worker count for large sources.
+    std::unique_ptr<WorkStealingPool> pool;                ///< Present while a multi-chunk source is assembled.
+    std::vector<Chunk> chunks;                             ///< The source being assembled.
+    std::unordered_map<std::string_view, Symbol> symbols;  ///< Labels and `.equ` values.
+    std::unordered_set<std::string_view> globals;          ///< Names declared `.global`.
+    std::vector<std::string_view> globalOrder;             ///< The same, in declaration order.
+    bool relocatable{false};                               ///< Assembling an object rather than a binary.
+    uint32_t origin{DefaultOrigin};                        ///< Address of the first output byte.
+    std::array<uint64_t, ObjectFile::SectionCount> sectionBase{};  ///< Address of each section's first byte.
+    std::array<uint64_t, ObjectFile::SectionCount> sectionSize{};
+    std::array<uint32_t, ObjectFile::SectionCount> sectionAlignment{};
 };
 
 #endif // ASSEMBLER_HPP
@@ -0,0 +1,270 @@
+#ifndef ASSEMBLY_SYNTAX_HPP
+#define ASSEMBLY_SYNTAX_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <components/isa.hpp>
+#include <utils/object_file.hpp>
+
+/**
+ * @brief The XR-32 assembly language shared by Assembler and the compile-time assembler in
+ * static_assembler.hpp: lexing, numbers, symbols and the operand syntax of each opcode.
+ *
+ * Everything here is `constexpr` and reports malformed input through its return value, so the same
+ * rules apply whether a source is assembled by xr32-tool or by the compiler.
+ */
+namespace xr32::syntax {
+/**
+ * @brief Operand syntax of an instruction; OpcodeTable gives each opcode's.
+ */
+using Operands = OperandSyntax;
+
+/**
+ * @brief One lexed statement: views into the source.
+ */
+struct Statement {
+    std::string_view labels;    ///< The `label:` tokens before the mnemonic.
+    std::string_view mnemonic;
+    std::array<std::string_view, 4> operands;
+    size_t operandCount{0};
+    std::string_view text;      ///< Everything after the mnemonic, for string directives.
+};
+
+/**
+ * @brief How a token splits into a symbol and an addend.
+ */
+enum class SymbolForm : uint8_t {
+    NotSymbol,     ///< The token does not start like a symbol.
+    Symbol,        ///< `symbol`, `symbol+n` or `symbol-n`.
+    InvalidAddend, ///< A symbol followed by something other than a number.
+};
+
+constexpr bool isSpace(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',';
+}
+
+constexpr bool isSymbolStart(char c) noexcept {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || c == '.';
+}
+
+/**
+ * @brief Splits a line into its labels, mnemonic and, if `operands` is set, its operands.
+ * @return false if the line has more operands than a Statement holds.
+ */
+constexpr bool lex(std::string_view line, Statement& statement, bool operands) noexcept {
+    line = line.substr(0, line.find(';'));
+    statement.operandCount = 0;
+
+    size_t position = 0;
+    auto nextToken = [&]() {
+        while (position < line.size() && isSpace(line[position])) {
+            ++position;
+        }
+        size_t start = position;
+        while (position < line.size() && !isSpace(line[position])) {
+            ++position;
+        }
+        return line.substr(start, position - start);
+    };
+
+    std::string_view token = nextToken();
+    const size_t labels = static_cast<size_t>(token.data() - line.data());
+    while (!token.empty() && token.back() == ':') {
+        token = nextToken();
+    }
+    statement.labels = line.substr(labels, static_cast<size_t>(token.data() - line.data()) - labels);
+    statement.mnemonic = token;
+    statement.text = line.substr(position);
+    if (!operands) {
+        return true;
+    }
+    for (token = nextToken(); !token.empty(); token = nextToken()) {
+        if (statement.operandCount == statement.operands.size()) {
+            return false;
+        }
+        statement.operands[statement.operandCount++] = token;
+    }
+    return true;
+}
+
+/**
+ * @brief Removes and returns the first label of Statement::labels, without its colon.
+ */
+constexpr std::string_view nextLabel(std::string_view& labels) noexcept {
+    constexpr std::string_view Separators = " \t\r,";
+    size_t colon = labels.find(':');
+    std::string_view label = labels.substr(0, colon);
+    label.remove_prefix(std::min(label.find_first_not_of(Separators), label.size()));
+    labels.remove_prefix(colon + 1);
+    labels.remove_prefix(std::min(labels.find_first_not_of(Separators), labels.size()));
+    return label;
+}
+
+/**
+ * @brief Parses a number: decimal, `0x` hex or `0b` binary, optionally negative.
+ * @return false if the token is not a number or its magnitude does not fit 64 bits.
+ */
+constexpr bool parseNumber(std::string_view token, int64_t& value) noexcept {
+    bool negative = !token.empty() && token.front() == '-';
+    if (negative) {
+        token.remove_prefix(1);
+    }
+    uint64_t base = 10;
+    if (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) {
+        base = 16;
+        token.remove_prefix(2);
+    } else if (token.size() > 2 && token[0] == '0' && (token[1] == 'b' || token[1] == 'B')) {
+        base = 2;
+        token.remove_prefix(2);
+    }
+    if (token.empty()) {
+        return false;
+    }
+    uint64_t magnitude = 0;
+    for (char c : token) {
+        uint64_t digit = c >= '0' && c <= '9' ? static_cast<uint64_t>(c - '0')
+                       : c >= 'a' && c <= 'f' ? static_cast<uint64_t>(c - 'a' + 10)
+                       : c >= 'A' && c <= 'F' ? static_cast<uint64_t>(c - 'A' + 10)
+                       : base;
+        if (digit >= base || magnitude > (UINT64_MAX - digit) / base) {
+            return false;
+        }
+        magnitude = magnitude * base + digit;
+    }
+    value = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    return true;
+}
+
+/**
+ * @brief Splits `symbol+n` / `symbol-n` into the symbol and its addend.
+ */
+constexpr SymbolForm splitSymbol(std::string_view token, std::string_view& symbol, int64_t& addend) noexcept {
+    if (token.empty() || !isSymbolStart(token.front())) {
+        return SymbolForm::NotSymbol;
+    }
+    size_t sign = token.find_first_of("+-", 1);
+    symbol = token.substr(0, sign);
+    addend = 0;
+    if (sign != std::string_view::npos) {
+        std::string_view number = token.substr(sign + 1);
+        if (!parseNumber(number, addend) || number.front() == '-') {
+            return SymbolForm::InvalidAddend;
+        }
+        addend = token[sign] == '-' ? -addend : addend;
+    }
+    return SymbolForm::Symbol;
+}
+
+constexpr uint64_t rd(uint8_t index) noexcept { return static_cast<uint64_t>(index) << 53; }
+constexpr uint64_t rs1(uint8_t index) noexcept { return static_cast<uint64_t>(index) << 48; }
+constexpr uint64_t rs2(uint8_t index) noexcept { return static_cast<uint64_t>(index) << 43; }
+
+/**
+ * @brief What encodeOperands reports to its error sink.
+ */
+enum class EncodingError : uint8_t {
+    WrongOperandCount,      ///< The token is the mnemonic; the count is the one expected.
+    InvalidRegister,        ///< The token is not a general register.
+    InvalidSpecialRegister, ///< The token is not a special register.
+    InvalidOpcode,          ///< The opcode has no operand syntax; the token is the mnemonic.
+};
+
+/**
+ * @brief Encodes the operands of an instruction into the fields its operand syntax places them in.
+ *
+ * @param registers `uint8_t(std::string_view)`: the register a name denotes, as CPU::findRegister.
+ * @param operand `uint64_t(std::string_view, ObjectFile::FieldKind)`: a number or symbol placed in a field.
+ * @param error `void(EncodingError, std::string_view token, size_t count)`: may throw; if it returns,
+ *        the operands it concerns encode as 0.
+ * @return The instruction without its opcode and `func`.
+ */
+template <typename Registers, typename Operand, typename Error>
+constexpr uint64_t encodeOperands(uint64_t opcode, const Statement& statement, Registers&& registers, Operand&& operand,
+                                  Error&& error) {
+    using FieldKind = ObjectFile::FieldKind;
+    const auto& op = statement.operands;
+    auto expect = [&](size_t count) {
+        if (statement.operandCount != count) {
+            error(EncodingError::WrongOperandCount, statement.mnemonic, count);
+        }
+        return statement.operandCount == count;
+    };
+    auto isSpecial = [&](std::string_view token) {
+        uint8_t index = registers(token);
+        return index >= 0x20 && index != 0xFF;
+    };
+    auto general = [&](std::string_view token) -> uint8_t {
+        uint8_t index = registers(token);
+        if (index >= 0x20) {
+            error(EncodingError::InvalidRegister, token, 0);
+            return 0;
+        }
+        return index;
+    };
+    auto special = [&](std::string_view token) -> uint8_t {
+        if (!isSpecial(token)) {
+            error(EncodingError::InvalidSpecialRegister, token, 0);
+            return 0;
+        }
+        return registers(token) & 0x1F; // Stored without its 0x20 base to fit the 5-bit field
+    };
+
+    switch (OpcodeTable[opcode].operands) {
+        case Operands::None:
+            expect(0);
+            return 0;
+        case Operands::One:
+            return expect(1) ? rd(general(op[0])) : 0;
+        case Operands::Two:
+            return expect(2) ? rd(general(op[0])) | rs1(general(op[1])) : 0;
+        case Operands::Three:
+            return expect(3) ? rd(general(op[0])) | rs1(general(op[1])) | rs2(general(op[2])) : 0;
+        case Operands::Shift:
+            return expect(3) ? rd(general(op[0])) | rs1(general(op[1])) | operand(op[2], FieldKind::Shift) : 0;
+        case Operands::Memory: {
+            if (statement.operandCount == 2) {
+                return AbsoluteAddressBit | rd(general(op[0])) | operand(op[1], FieldKind::Immediate);
+            }
+            if (!expect(3)) {
+                return 0;
+            }
+            std::string_view base = op[1];
+            if (base.size() > 2 && base.front() == '[' && base.back() == ']') {
+                base = base.substr(1, base.size() - 2);
+            }
+            return rd(general(op[0])) | rs1(general(base)) | operand(op[2], FieldKind::Immediate);
+        }
+        case Operands::Branch: {
+            if (!expect(3)) {
+                return 0;
+            }
+            // A literal is the offset itself; a symbol is made relative to the next instruction.
+            int64_t literal = 0;
+            FieldKind kind = parseNumber(op[2], literal) ? FieldKind::Immediate : FieldKind::Branch;
+            return rd(general(op[0])) | rs1(general(op[1])) | operand(op[2], kind);
+        }
+        case Operands::Jump:
+            return expect(1) ? operand(op[0], FieldKind::Address) : 0;
+        case Operands::Vector:
+            return expect(1) ? operand(op[0], FieldKind::Vector) : 0;
+        case Operands::Special: {
+            if (!expect(2)) {
+                return 0;
+            }
+            // MTS accepts both "MTS TPDR R1" and "MTS R1 TPDR"
+            bool swapped = OpcodeTable[opcode].mnemonic == "MTS" && isSpecial(op[0]);
+            return rd(general(op[swapped ? 1 : 0])) | rs1(special(op[swapped ? 0 : 1]));
+        }
+        case Operands::Invalid:
+            break;
+    }
+    error(EncodingError::InvalidOpcode, statement.mnemonic, 0);
+    return 0;
+}
+
+} // namespace xr32::syntax
+
+#endif // ASSEMBLY_SYNTAX_HPP
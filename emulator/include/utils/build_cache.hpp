@@ -0,0 +1,57 @@
+#ifndef BUILD_CACHE_HPP
+#define BUILD_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Content-addressed store of build outputs, shared by all runs of the tool on a host.
+ *
+ * An entry is keyed by a hash of the input and the version of the tool that produced the output, so
+ * unchanged inputs are never rebuilt and a new tool version never sees stale outputs. Entries are
+ * written under a temporary name and renamed into place, so concurrent runs may share a directory
+ * and never read a partial entry. The cache is an optimization only: failures to read or write it
+ * are ignored and the caller rebuilds.
+ */
+class BuildCache {
+public:
+    /**
+     * @brief Uses the given directory, creating it on the first store.
+     */
+    explicit BuildCache(std::filesystem::path root) : directory(std::move(root)) {}
+
+    /**
+     * @brief The cache directory for this user: `$XR32_CACHE_DIR`, else `$XDG_CACHE_HOME/xr32`, else
+     * `$HOME/.cache/xr32`.
+     *
+     * @return The directory, or nothing if none of the variables is set.
+     */
+    [[nodiscard]] static std::optional<std::filesystem::path> defaultDirectory();
+
+    /**
+     * @brief Derives the key of an input.
+     *
+     * @param input The complete input, e.g. an assembly source.
+     * @param toolVersion Version of the producer; outputs of other versions are never returned.
+     */
+    [[nodiscard]] static std::string key(std::string_view input, uint32_t toolVersion);
+
+    /**
+     * @brief Returns the output stored under `key`, if any.
+     */
+    [[nodiscard]] std::optional<std::vector<uint8_t>> load(const std::string& key) const;
+
+    /**
+     * @brief Stores an output under `key`, replacing any previous entry. Best effort.
+     */
+    void store(const std::string& key, const std::vector<uint8_t>& output) const noexcept;
+
+private:
+    std::filesystem::path directory;
+};
+
+#endif // BUILD_CACHE_HPP
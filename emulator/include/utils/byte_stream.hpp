@@ -0,0 +1,82 @@
+#ifndef BYTE_STREAM_HPP
+#define BYTE_STREAM_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Appends little-endian fields to a byte buffer, for the tool's binary file formats.
+ */
+class ByteWriter {
+public:
+    void u8(uint8_t value) { bytes.push_back(value); }
+    void u16(uint16_t value) { raw(&value, sizeof(value)); }
+    void u32(uint32_t value) { raw(&value, sizeof(value)); }
+    void u64(uint64_t value) { raw(&value, sizeof(value)); }
+    void raw(const void* data, size_t size) {
+        auto* first = static_cast<const uint8_t*>(data);
+        bytes.insert(bytes.end(), first, first + size);
+    }
+    void blob(const std::vector<uint8_t>& data) {
+        u32(static_cast<uint32_t>(data.size()));
+        raw(data.data(), data.size());
+    }
+    void string(const std::string& text) {
+        u32(static_cast<uint32_t>(text.size()));
+        raw(text.data(), text.size());
+    }
+
+    std::vector<uint8_t> bytes;
+};
+
+/**
+ * @brief Reads fields written by ByteWriter, throwing instead of reading past the end.
+ */
+class ByteReader {
+public:
+    /**
+     * @param corrupt Message of the std::runtime_error thrown on truncated input.
+     */
+    ByteReader(const uint8_t* data, size_t size, const char* corrupt) noexcept
+        : next(data), end(data + size), corruptMessage(corrupt) {}
+
+    uint8_t u8() { return take<uint8_t>(); }
+    uint16_t u16() { return take<uint16_t>(); }
+    uint32_t u32() { return take<uint32_t>(); }
+    uint64_t u64() { return take<uint64_t>(); }
+    const uint8_t* raw(size_t size) {
+        if (size > static_cast<size_t>(end - next)) {
+            throw std::runtime_error(corruptMessage);
+        }
+        const uint8_t* data = next;
+        next += size;
+        return data;
+    }
+    std::vector<uint8_t> blob() {
+        uint32_t size = u32();
+        const uint8_t* data = raw(size);
+        return {data, data + size};
+    }
+    std::string string() {
+        uint32_t size = u32();
+        return {reinterpret_cast<const char*>(raw(size)), size};
+    }
+    [[nodiscard]] bool done() const noexcept { return next == end; }
+
+private:
+    template <typename T>
+    T take() {
+        T value;
+        std::memcpy(&value, raw(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    const uint8_t* next;
+    const uint8_t* end;
+    const char* corruptMessage;
+};
+
+#endif // BYTE_STREAM_HPP
@@ -1,111 +1,185 @@
 #ifndef DISASSEMBLER_HPP
 #define DISASSEMBLER_HPP
 
-#include <string>
+#include <array>
 #include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
+#include <utils/assembler.hpp>
 
 /**
- * @brief The Disassembler class converts machine code instructions into human-readable assembly code.
+ * @brief The Disassembler class converts XR-32 machine code into a listing of assembly code.
+ *
+ * Every 8-byte word becomes one line holding its address, the word in hex and the instruction in
+ * the syntax Assembler reads, e.g. `00001068:  3422000000f80000  BNE R1 R2 done`. Words whose opcode,
+ * packed `func` or special register is undefined are listed as `.quad`, and a trailing partial word
+ * as `.byte`.
+ *
+ * Instructions are decoded through OpcodeTable, the table InstructionSet decodes with, and the
+ * operand syntax of the assembler, so listings show what the emulator executes and reassemble to the
+ * same words. Lines are formatted with `std::to_chars` straight into large buffers, and files are
+ * mapped rather than read.
+ *
+ * Because instructions are fixed 8-byte words, an image splits into independent chunks at any word
+ * boundary. Chunks are decoded on all threads a batch at a time and their listings written in order,
+ * so the output does not depend on the thread count and memory use does not grow with the image.
  *
- * This class provides methods for disassembling various types of instructions (R-Type, I-Type, J-Type, etc.)
- * and assembling the output into a readable format. The Disassembler is initialized with a vector of 32-bit
- * instructions and processes them to generate the corresponding assembly code.
+ * Symbols are optional. An address that has one gets a `00001000 <name>:` line above it, and
+ * branch, jump and absolute memory operands that point at one are shown by name. Branches to other
+ * addresses keep their offset, with the target in a comment.
  */
 class Disassembler {
 public:
     /**
-     * @brief Constructs a Disassembler with a list of instructions.
-     * 
-     * @param instructions A vector of 32-bit instructions to be disassembled.
+     * @brief Bytes of image per chunk.
      */
-    Disassembler(std::vector<uint32_t> instructions);
+    static constexpr size_t ChunkSize = 1 << 20;
 
     /**
-     * @brief Disassembles the provided instructions and returns the assembly code as a string.
-     * 
-     * This method processes all instructions provided to the Disassembler and generates the corresponding
-     * assembly code for each instruction.
-     * 
-     * @return The complete disassembly as a string.
+     * @brief Bytes of listing formatted before it is written out.
      */
-    [[nodiscard]] std::string disassemble();
+    static constexpr size_t BufferSize = 1 << 20;
 
     /**
-     * @brief Retrieves the current disassembly output.
-     * 
-     * @return The disassembly output as a string.
+     * @brief A control transfer out of a basic block.
      */
-    [[nodiscard]] std::string getOutput() const { return output; }
+    struct Edge {
+        enum class Kind : uint8_t {
+            Fallthrough, ///< To the next word, at the end of a block that does not always jump.
+            Branch,      ///< `BEQ`/`BNE` taken.
+            Jump,        ///< `JMP`/`JAL`.
+            Call,        ///< `CALL`; the block also falls through to the return address.
+        };
+        Kind kind;
+        uint64_t target; ///< May lie outside the image.
+    };
+
+    /**
+     * @brief A maximal run of code entered only at its first word and left only at its last.
+     *
+     * Blocks start at the image start, at branch, jump and call targets, after every control transfer
+     * and after undefined words, which belong to no block. A block ending in `RET` or `IRET` has no
+     * successors.
+     */
+    struct BasicBlock {
+        uint64_t start;
+        uint64_t end;                     ///< One past the last word.
+        std::array<Edge, 2> successors{};
+        uint8_t successorCount{0};
+    };
+
+    /**
+     * @brief Code reachable from the image start or a `CALL` target without following calls.
+     */
+    struct Function {
+        uint64_t entry;
+        std::vector<size_t> blocks; ///< Indices into ControlFlowGraph::blocks, in address order.
+    };
+
+    struct ControlFlowGraph {
+        std::vector<BasicBlock> blocks;  ///< In address order.
+        std::vector<Function> functions; ///< In entry order.
+    };
+
+    /**
+     * @brief Constructs a Disassembler for images loaded at `baseAddress`.
+     * @param threads Threads to decode on; 0 selects one per hardware thread.
+     */
+    explicit Disassembler(uint64_t baseAddress = Assembler::DefaultOrigin, unsigned threads = 0);
+
+    /**
+     * @brief Names an address in listings and graphs.
+     */
+    void addSymbol(uint64_t address, std::string name);
 
-private:
     /**
-     * @brief Disassembles an R-Type instruction into its assembly equivalent.
-     * 
-     * @param instruction The 32-bit R-Type instruction to disassemble.
-     * @return The assembly code as a string.
+     * @brief Reads symbols from a map file: one `<address> <name>` per line, `;` comments.
+     *
+     * @throws std::runtime_error if the file cannot be read or a line is malformed.
      */
-    [[nodiscard]] static std::string disassembleRType(uint32_t instruction);
+    void loadSymbols(const std::string& path);
 
     /**
-     * @brief Disassembles an I-Type instruction into its assembly equivalent.
-     * 
-     * @param instruction The 32-bit I-Type instruction to disassemble.
-     * @return The assembly code as a string.
+     * @brief Lists a memory image.
+     *
+     * @param image The machine code; its first byte is at the base address.
+     * @param out Receives the listing in large blocks.
      */
-    [[nodiscard]] static std::string disassembleIType(uint32_t instruction);
+    void disassemble(std::string_view image, std::ostream& out);
 
     /**
-     * @brief Disassembles a J-Type instruction into its assembly equivalent.
-     * 
-     * @param instruction The 32-bit J-Type instruction to disassemble.
-     * @return The assembly code as a string.
+     * @brief Recovers the basic blocks, functions and control-flow edges of a memory image.
      */
-    [[nodiscard]] static std::string disassembleJType(uint32_t instruction);
+    [[nodiscard]] ControlFlowGraph controlFlow(std::string_view image);
 
     /**
-     * @brief Disassembles a branch instruction into its assembly equivalent.
-     * 
-     * @param instruction The 32-bit branch instruction to disassemble.
-     * @return The assembly code as a string.
+     * @brief Lists a binary file into a text file and, if `graphFile` is given, writes its control-flow
+     * graph there as JSON; both come from one pass over the image.
+     *
+     * @return The number of bytes disassembled.
+     * @throws std::runtime_error if a file cannot be opened or written.
      */
-    [[nodiscard]] static std::string disassembleBranchType(uint32_t instruction);
+    uint64_t disassemble(const std::string& binaryFile, const std::string& outputFile, const std::string& graphFile = {});
 
     /**
-     * @brief Disassembles a load instruction into its assembly equivalent.
-     * 
-     * @param instruction The 32-bit load instruction to disassemble.
-     * @return The assembly code as a string.
+     * @brief Writes a graph as one JSON object: the base and size of the image, `blocks` with their
+     * `start`, `end` and `successors` (`to` and `kind`), and `functions` with their `entry`, symbol
+     * `name` when known, and the starts of their `blocks`.
      */
-    [[nodiscard]] static std::string disassembleLoadType(uint32_t instruction);
+    void writeControlFlow(const ControlFlowGraph& graph, uint64_t imageSize, std::ostream& out) const;
 
     /**
-     * @brief Disassembles a store instruction into its assembly equivalent.
-     * 
-     * @param instruction The 32-bit store instruction to disassemble.
-     * @return The assembly code as a string.
+     * @brief Disassembles a single instruction, without address, hex or symbols.
+     *
+     * @param instruction The instruction word.
+     * @param address Where it is, for branch targets.
+     * @return The instruction as Assembler would read it, or a `.quad` of an undefined word.
      */
-    [[nodiscard]] static std::string disassembleStoreType(uint32_t instruction);
+    [[nodiscard]] static std::string disassembleInstruction(uint64_t instruction, uint64_t address = 0);
+
+private:
+    class Listing; ///< An output buffer.
 
     /**
-     * @brief Disassembles a compare instruction into its assembly equivalent.
-     * 
-     * @param instruction The 32-bit compare instruction to disassemble.
-     * @return The assembly code as a string.
+     * @brief One pass over an image in parallel chunks, producing a listing, a graph, or both.
      */
-    [[nodiscard]] static std::string disassembleCmpType(uint32_t instruction);
+    void scan(std::string_view image, std::ostream* listing, ControlFlowGraph* graph);
 
     /**
-     * @brief Disassembles an immediate instruction into its assembly equivalent.
-     * 
-     * @param instruction The 32-bit immediate instruction to disassemble.
-     * @return The assembly code as a string.
+     * @brief Lists words [first, last) of an image.
      */
-    [[nodiscard]] static std::string disassembleImmType(uint32_t instruction);
+    void listWords(std::string_view image, size_t first, size_t last, Listing& out) const;
+
+    /**
+     * @brief Appends the block boundaries that words [first, last) imply, as word indices shifted left
+     * by one; the low bit is set where an undefined word starts a gap.
+     */
+    void findBoundaries(std::string_view image, size_t first, size_t last, std::vector<uint64_t>& boundaries) const;
+
+    /**
+     * @brief Builds the graph from the sorted boundaries of the whole image.
+     */
+    void buildGraph(std::string_view image, std::vector<uint64_t>& boundaries, ControlFlowGraph& graph) const;
+
+    /**
+     * @brief Formats one instruction's mnemonic and operands.
+     */
+    void formatInstruction(uint64_t instruction, uint64_t address, Listing& out) const;
+
+    /**
+     * @brief The symbol at `address`, or null.
+     */
+    [[nodiscard]] const std::string* symbolAt(uint64_t address) const;
+
+    void sortSymbols();
 
-    std::string output; ///< The complete disassembly output as a string.
-    std::vector<uint32_t> instructions; ///< The list of instructions to be disassembled.
-    size_t index; ///< The current index in the instructions vector.
+    uint64_t base;                                          ///< Address of the image's first byte.
+    unsigned threads;                                       ///< Worker count for multi-chunk images.
+    std::vector<std::pair<uint64_t, std::string>> symbols;  ///< By address once sorted.
+    bool sorted{true};
 };
 
 #endif // DISASSEMBLER_HPP
@@ -0,0 +1,37 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief 64-bit content hash; four independent lanes keep the multiplier busy on large inputs.
+ *
+ * Not cryptographic. Used to detect changed snapshot pages and to key cached build outputs, where
+ * inputs are trusted and an accidental collision is the only concern.
+ */
+inline uint64_t contentHash(const uint8_t* data, size_t size, uint64_t seed = 0) noexcept {
+    constexpr uint64_t Multiplier = 0x9E3779B97F4A7C15;
+    uint64_t lanes[4] = {seed, seed ^ 0x243F6A8885A308D3, seed ^ 0x13198A2E03707344, seed ^ 0xA4093822299F31D0};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (size_t lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            std::memcpy(&word, data + i + lane * sizeof(word), sizeof(word));
+            lanes[lane] = (lanes[lane] ^ word) * Multiplier;
+            lanes[lane] ^= lanes[lane] >> 31;
+        }
+    }
+    uint64_t hash = size * Multiplier;
+    for (; i < size; ++i) {
+        hash = (hash ^ data[i]) * Multiplier;
+    }
+    for (uint64_t lane : lanes) {
+        hash = (hash ^ lane) * Multiplier;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+#endif // HASH_HPP
@@ -0,0 +1,42 @@
+#ifndef JSON_HPP
+#define JSON_HPP
+
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Writes text as a quoted JSON string.
+ *
+ * Bytes outside printable ASCII are written as unicode escapes of the same value (0-255), so the
+ * original bytes can always be recovered, even from output that is not valid UTF-8.
+ */
+inline void writeJsonString(std::ostream& out, std::string_view text) {
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string escaped;
+    escaped.reserve(text.size() + 2);
+    escaped.push_back('"');
+    for (char c : text) {
+        auto byte = static_cast<unsigned char>(c);
+        switch (byte) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (byte < 0x20 || byte >= 0x7F) {
+                    escaped += "\\u00";
+                    escaped.push_back(hex[byte >> 4]);
+                    escaped.push_back(hex[byte & 0xF]);
+                } else {
+                    escaped.push_back(c);
+                }
+                break;
+        }
+    }
+    escaped.push_back('"');
+    out << escaped;
+}
+
+#endif // JSON_HPP
@@ -0,0 +1,121 @@
+#ifndef LINKER_HPP
+#define LINKER_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <utils/assembler.hpp>
+#include <utils/object_file.hpp>
+
+/**
+ * @brief Links XR-32 objects into a flat binary that xr32-tool loads like an assembled program.
+ *
+ * The image starts at the origin with every object's `.text`, in command-line order, followed by
+ * every object's `.data`; each contribution is aligned as its object requires. Execution starts at
+ * the first object's `.text`. Global symbols must be defined exactly once, and every import must be
+ * defined by some object.
+ *
+ * An incremental link gives each contribution some slack and records the layout, each object's
+ * exports and imports, and the file times in a state file beside the output (`<output>.xlink`). A
+ * later incremental link of the same object list rewrites only the objects whose files changed, plus
+ * the objects importing symbols that moved as a result, in place in the existing output. It falls
+ * back to a full link when the list, the origin or the output changed, or a changed object no longer
+ * fits its slot. Text slack is filled with `NOP`s.
+ */
+class Linker {
+public:
+    /**
+     * @brief Minimum slack per contribution in an incremental link; a quarter of its size if larger.
+     */
+    static constexpr uint64_t MinimumSlack = 64;
+
+    /**
+     * @brief What a link did.
+     */
+    struct Report {
+        size_t objects{0};        ///< Objects in the link.
+        size_t relinked{0};       ///< Objects read and written; all of them unless the link was incremental.
+        bool incremental{false};  ///< Whether the existing output was updated in place.
+        uint64_t size{0};         ///< Bytes in the output.
+    };
+
+    /**
+     * @param loadAddress Address of the output's first byte; where xr32-tool loads programs.
+     */
+    explicit Linker(uint32_t loadAddress = Assembler::DefaultOrigin) noexcept : origin(loadAddress) {}
+
+    /**
+     * @brief Links object files into `output`.
+     *
+     * @param objects The object files, in placement order.
+     * @param output The binary to write.
+     * @param incremental Whether to lay out for, and attempt, incremental relinking.
+     * @throws std::runtime_error on unreadable or malformed objects, duplicate or undefined symbols,
+     * fields that cannot hold their relocated values, and I/O errors.
+     */
+    Report link(const std::vector<std::string>& objects, const std::string& output, bool incremental);
+
+private:
+    static constexpr size_t SectionCount = ObjectFile::SectionCount;
+
+    /**
+     * @brief Where one object went, and what it exports and imports.
+     */
+    struct Input {
+        std::string path;
+        uint64_t fileSize{0};
+        int64_t fileTime{0};
+        std::array<uint64_t, SectionCount> base{};     ///< Address of each contribution.
+        std::array<uint64_t, SectionCount> capacity{}; ///< Bytes reserved for each contribution.
+        std::array<uint64_t, SectionCount> length{};   ///< Bytes used.
+        std::vector<std::pair<std::string, int64_t>> exports; ///< Defined symbols and their values.
+        std::vector<std::string> imports;
+    };
+
+    /**
+     * @brief The contents of a state file.
+     */
+    struct State {
+        uint32_t origin{0};
+        uint64_t outputSize{0};
+        int64_t outputTime{0};
+        std::vector<Input> inputs;
+    };
+
+    struct Definition {
+        int64_t value;
+        size_t owner; ///< Index of the defining input.
+    };
+
+    using SymbolTable = std::unordered_map<std::string, Definition>;
+
+    Report fullLink(const std::vector<std::string>& objects, const std::string& output, bool incremental);
+    std::optional<Report> incrementalLink(const std::vector<std::string>& objects, const std::string& output);
+
+    /**
+     * @brief Records an object's file identity, exports and imports into `input`, given its placement.
+     */
+    static void describe(Input& input, const ObjectFile& object);
+
+    /**
+     * @brief Adds `input`'s exports to `table`.
+     * @throws std::runtime_error if a symbol is already defined by another input.
+     */
+    static void define(SymbolTable& table, const std::vector<Input>& inputs, size_t owner);
+
+    /**
+     * @brief Produces the bytes of one contribution, `capacity` long, with its relocations applied.
+     */
+    static std::vector<uint8_t> render(const ObjectFile& object, const Input& input, size_t section, const SymbolTable& table);
+
+    static std::string statePath(const std::string& output) { return output + ".xlink"; }
+    static std::optional<State> readState(const std::string& path);
+    static void writeState(const std::string& path, const State& state);
+
+    uint32_t origin; ///< Address of the output's first byte.
+};
+
+#endif // LINKER_HPP
@@ -1,9 +1,28 @@
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
+#include <atomic>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <string>
 #include <string_view>
-#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Lowest level compiled in; calls below it compile to nothing. Build with
+ * `-DXR32_LOG_LEVEL=1` to strip debug logging from instruction-rate paths.
+ */
+#ifndef XR32_LOG_LEVEL
+#define XR32_LOG_LEVEL 0
+#endif
 
 enum class LogLevel {
     DEBUG,
@@ -13,72 +32,215 @@ enum class LogLevel {
     LOG
 };
 
+/**
+ * @brief A log format string checked at compile time against the argument count, like
+ * `std::format_string`. Placeholders are `{}` and `{:x}` (hex); `{{` and `}}` are literal braces.
+ * Only constant strings convert, so the writer thread never reads a format that is gone.
+ */
+template <typename... Args>
+struct LogFormat {
+    template <typename Text>
+        requires std::convertible_to<const Text&, std::string_view>
+    consteval LogFormat(const Text& format) : text(format) {
+        if (placeholders(text) != sizeof...(Args)) {
+            throw "Log format does not match its arguments"; // Not a constant expression: fails the build
+        }
+    }
+
+    /**
+     * @brief Counts the placeholders of a format, or returns SIZE_MAX if it is malformed.
+     */
+    static constexpr size_t placeholders(std::string_view format) noexcept {
+        size_t count = 0;
+        for (size_t i = 0; i < format.size(); ++i) {
+            if (format[i] == '}') {
+                if (i + 1 == format.size() || format[++i] != '}') {
+                    return SIZE_MAX;
+                }
+            } else if (format[i] == '{') {
+                if (i + 1 < format.size() && format[i + 1] == '{') {
+                    ++i;
+                    continue;
+                }
+                size_t close = format.find('}', i);
+                if (close == std::string_view::npos || (close != i + 1 && format.substr(i + 1, close - i - 1) != ":x")) {
+                    return SIZE_MAX;
+                }
+                ++count;
+                i = close;
+            }
+        }
+        return count;
+    }
+
+    std::string_view text;
+};
+
+/**
+ * @brief Asynchronous logger: producers copy their arguments into a lock-free ring and a writer thread
+ * formats and writes them.
+ *
+ * A call claims a slot with one compare-and-swap, moves the format and its arguments into it and
+ * returns; formatting, the level prefix and the stream write happen on the writer thread, which
+ * flushes only when the ring runs dry. Formats are LogFormat constants; arguments are integers or
+ * strings, and strings are copied.
+ *
+ * When the ring is full, OverflowPolicy::Block waits for the writer and OverflowPolicy::Drop discards
+ * the message; the writer then reports how many were discarded.
+ */
 class Logger {
 public:
-    Logger(std::ostream& os = std::cout) : outStream(os) {}
-
-    void log(LogLevel level, std::string_view msg) {
-        std::lock_guard<std::mutex> lock(logMutex);
-        switch (level) {
-            case LogLevel::DEBUG:
-                outStream << ANSI_BOLD_BLUE << "[DEBUG] " << ANSI_RESET;
-                break;
-            case LogLevel::WARN:
-                outStream << ANSI_BOLD_DIM_YELLOW << "[WARN] " << ANSI_RESET;
-                break;
-            case LogLevel::ERROR:
-                outStream << ANSI_RED << "[ERROR] " << ANSI_RESET;
-                break;
-            case LogLevel::FATAL:
-                outStream << ANSI_BOLD_RED << "[FATAL] " << ANSI_RESET;
-                break;
-            case LogLevel::LOG:
-            default:
-                outStream << "[LOG] ";
-                break;
-        }
-        outStream << msg << std::endl;
+    enum class OverflowPolicy {
+        Block, ///< Wait for a free slot; nothing is lost.
+        Drop,  ///< Discard the message and report how many were discarded.
+    };
+
+    static constexpr LogLevel MinimumLevel = static_cast<LogLevel>(XR32_LOG_LEVEL);
+    static constexpr size_t PayloadSize = 192; ///< Bytes of arguments a message can carry.
+
+    /**
+     * @brief Starts the writer thread.
+     *
+     * @param os Where messages go.
+     * @param capacity Messages the ring holds, rounded up to a power of two.
+     * @param policy What a full ring does to new messages.
+     */
+    explicit Logger(std::ostream& os = std::cout, size_t capacity = 4096, OverflowPolicy policy = OverflowPolicy::Block);
 
-        if (level == LogLevel::FATAL) {
-            std::abort();
+    /**
+     * @brief Writes every queued message and joins the writer.
+     */
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    template <typename... Args>
+    using Format = LogFormat<std::type_identity_t<Args>...>;
+
+    template <LogLevel Level, typename... Args>
+    void log(Format<Args...> format, Args&&... args) {
+        if constexpr (Level >= MinimumLevel) {
+            enqueue(Level, format.text, std::forward<Args>(args)...);
+            if constexpr (Level == LogLevel::FATAL) {
+                flush();
+                std::abort();
+            }
         }
     }
 
-    void debug(std::string_view msg) { log(LogLevel::DEBUG, msg); }
-    void warn(std::string_view msg) { log(LogLevel::WARN, msg); }
-    void error(std::string_view msg) { log(LogLevel::ERROR, msg); }
-    void fatal(std::string_view msg) { log(LogLevel::FATAL, msg); }
-    void log(std::string_view msg) { log(LogLevel::LOG, msg); }
+    template <typename... Args>
+    void debug(Format<Args...> format, Args&&... args) { log<LogLevel::DEBUG>(format, std::forward<Args>(args)...); }
+    template <typename... Args>
+    void warn(Format<Args...> format, Args&&... args) { log<LogLevel::WARN>(format, std::forward<Args>(args)...); }
+    template <typename... Args>
+    void error(Format<Args...> format, Args&&... args) { log<LogLevel::ERROR>(format, std::forward<Args>(args)...); }
+    template <typename... Args>
+    [[noreturn]] void fatal(Format<Args...> format, Args&&... args) {
+        log<LogLevel::FATAL>(format, std::forward<Args>(args)...);
+        std::abort(); // Reached only when FATAL is compiled out
+    }
+    template <typename... Args>
+    void log(Format<Args...> format, Args&&... args) { log<LogLevel::LOG>(format, std::forward<Args>(args)...); }
+
+    /**
+     * @brief Blocks until every message logged before the call is written and the stream flushed.
+     */
+    void flush();
 
 private:
+    /// Arguments as they are kept until the writer formats them: strings by value, integers decayed.
+    template <typename T>
+    using Stored = std::conditional_t<std::is_convertible_v<const std::decay_t<T>&, std::string_view>,
+                                      std::string, std::decay_t<T>>;
+
+    /**
+     * @brief One message: a slot of the ring.
+     */
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence{0}; ///< Ring position the slot is free for, or that position + 1 once filled.
+        LogLevel level{LogLevel::LOG};
+        std::string_view format;
+        void (*render)(std::string_view format, std::byte* payload, std::string& out){nullptr}; ///< Formats, then destroys the payload.
+        alignas(std::max_align_t) std::byte payload[PayloadSize];
+    };
+
+    /**
+     * @brief Copies `format` from `position` to the next placeholder, or to its end, unescaping braces.
+     * @return Whether the placeholder is `{:x}`; `position` is left past it.
+     */
+    static bool copyText(std::string_view format, size_t& position, std::string& out);
+
+    /**
+     * @brief Copies `format` from `position` up to the next placeholder, then `value` in its place.
+     */
+    template <typename T>
+    static void substitute(std::string_view format, size_t& position, const T& value, std::string& out) {
+        const bool hex = copyText(format, position, out);
+        if constexpr (std::is_same_v<T, std::string>) {
+            out += value;
+        } else {
+            static_assert(std::is_integral_v<T>, "Log arguments are integers or strings");
+            auto bits = static_cast<uint64_t>(value);
+            if (!hex && std::is_signed_v<T> && value < 0) {
+                out += '-';
+                bits = 0 - bits;
+            }
+            char digits[24];
+            out.append(digits, std::to_chars(digits, digits + sizeof(digits), bits, hex ? 16 : 10).ptr);
+        }
+    }
+
+    template <typename... Values>
+    static void render(std::string_view format, std::byte* payload, std::string& out) {
+        auto* values = std::launder(reinterpret_cast<std::tuple<Values...>*>(payload));
+        size_t position = 0;
+        std::apply([&](const auto&... value) { (substitute(format, position, value, out), ...); }, *values);
+        copyText(format, position, out);
+        std::destroy_at(values);
+    }
+
+    template <typename... Args>
+    void enqueue(LogLevel level, std::string_view format, Args&&... args) {
+        using Payload = std::tuple<Stored<Args>...>;
+        static_assert(sizeof(Payload) <= PayloadSize && alignof(Payload) <= alignof(std::max_align_t),
+                      "Log arguments do not fit Logger::PayloadSize");
+        Slot* slot = claim();
+        if (!slot) {
+            return;
+        }
+        slot->level = level;
+        slot->format = format;
+        slot->render = &render<Stored<Args>...>;
+        ::new (static_cast<void*>(slot->payload)) Payload(std::forward<Args>(args)...);
+        publish(*slot);
+    }
+
+    /**
+     * @brief Reserves the next slot, or returns null if the ring is full and the policy drops.
+     */
+    Slot* claim() noexcept;
+
+    /**
+     * @brief Hands a filled slot to the writer and wakes it if it sleeps.
+     */
+    void publish(Slot& slot) noexcept;
+
+    void wake() noexcept;
+    void run();
+    static void writePrefix(LogLevel level, std::string& out);
+
     std::ostream& outStream;
-    std::mutex logMutex;
-
-    static constexpr std::string_view ANSI_RESET = "\033[0m";
-    static constexpr std::string_view ANSI_BOLD = "\033[1m";
-    static constexpr std::string_view ANSI_DIM = "\033[2m";
-    static constexpr std::string_view ANSI_ITALIC = "\033[3m";
-    static constexpr std::string_view ANSI_UNDERLINE = "\033[4m";
-    static constexpr std::string_view ANSI_BLINK = "\033[5m";
-    static constexpr std::string_view ANSI_REVERSE = "\033[7m";
-    
-    static constexpr std::string_view ANSI_RED = "\033[31m";
-    static constexpr std::string_view ANSI_GREEN = "\033[32m";
-    static constexpr std::string_view ANSI_YELLOW = "\033[33m";
-    static constexpr std::string_view ANSI_BLUE = "\033[34m";
-    static constexpr std::string_view ANSI_MAGENTA = "\033[35m";
-    
-    static constexpr std::string_view ANSI_BOLD_RED = "\033[1;31m";
-    static constexpr std::string_view ANSI_BOLD_GREEN = "\033[1;32m";
-    static constexpr std::string_view ANSI_BOLD_YELLOW = "\033[1;33m";
-    static constexpr std::string_view ANSI_BOLD_BLUE = "\033[1;34m";
-    static constexpr std::string_view ANSI_BOLD_MAGENTA = "\033[1;35m";
-
-    static constexpr std::string_view ANSI_BOLD_DIM_RED = "\033[2;31m";
-    static constexpr std::string_view ANSI_BOLD_DIM_GREEN = "\033[2;32m";
-    static constexpr std::string_view ANSI_BOLD_DIM_YELLOW = "\033[2;33m";
-    static constexpr std::string_view ANSI_BOLD_DIM_BLUE = "\033[2;34m";
-    static constexpr std::string_view ANSI_BOLD_DIM_MAGENTA = "\033[2;35m";
+    OverflowPolicy overflow;
+    size_t mask;                                   ///< Capacity - 1.
+    std::unique_ptr<Slot[]> slots;
+
+    alignas(64) std::atomic<uint64_t> enqueued{0}; ///< Next position producers claim.
+    alignas(64) std::atomic<uint64_t> written{0};  ///< Positions written and flushed by the writer.
+    std::atomic<uint64_t> dropped{0};              ///< Drops not yet reported.
+    std::atomic<bool> sleeping{false};             ///< The writer found the ring empty and waits.
+    std::atomic<bool> stopping{false};
+    std::thread writer;
 };
 
 #endif // LOGGER_HPP
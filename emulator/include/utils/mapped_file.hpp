@@ -0,0 +1,51 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief A whole file mapped into memory, for parsing or producing it without copying.
+ *
+ * Existing files are mapped read-only, privately, and advised for sequential access. Created files are
+ * mapped shared and writable, so bytes stored through data() land in the file. Empty files map to an
+ * empty view.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Maps a file.
+     *
+     * @throws std::runtime_error if the file cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::string& path);
+
+    /**
+     * @brief Creates or truncates a file of `size` zero bytes and maps it writable.
+     *
+     * @throws std::runtime_error if the file cannot be created or mapped.
+     */
+    MappedFile(const std::string& path, size_t size);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief The file's contents; valid while this object lives.
+     */
+    [[nodiscard]] std::string_view view() const noexcept { return {bytes, size}; }
+
+    /**
+     * @brief The mapped bytes; writable only for files created by this object.
+     */
+    [[nodiscard]] char* data() noexcept { return bytes; }
+
+private:
+    char* bytes{nullptr};
+    size_t size{0};
+};
+
+#endif // MAPPED_FILE_HPP
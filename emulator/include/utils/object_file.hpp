@@ -0,0 +1,137 @@
+#ifndef OBJECT_FILE_HPP
+#define OBJECT_FILE_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief A relocatable XR-32 object: the output of `xr32-tool -a --object` and the input of `--link`.
+ *
+ * An object holds two sections, `.text` and `.data`, whose contents are assembled as if each started
+ * at address 0. Symbols are section-relative labels, absolute `.equ` values, or imports the object
+ * references but does not define. Only `.global` symbols and imports are listed; references to local
+ * labels are relocated against the symbol of their section, with the label's offset in the addend.
+ * Each relocation names the field to patch and how its value is placed, which mirrors the instruction
+ * formats: absolute immediates and addresses, and branch offsets relative to the next instruction.
+ *
+ * On disk: the magic `XR32OBJ1`, then the section alignments and contents, the symbols and the
+ * relocations, all little-endian.
+ */
+class ObjectFile {
+public:
+    /**
+     * @brief What a symbol is relative to, and which section a relocation patches.
+     */
+    enum class Section : uint8_t {
+        Text = 0,
+        Data = 1,
+        Absolute = 0xFE,  ///< A plain number.
+        Undefined = 0xFF, ///< Defined by another object.
+    };
+
+    static constexpr size_t SectionCount = 2;
+
+    /**
+     * @brief How a value is placed into the output. Values are full addresses or numbers; the field
+     * determines the bits it occupies and, for branches, the offset it is turned into.
+     */
+    enum class FieldKind : uint8_t {
+        Immediate, ///< I-type immediate, bits 47–16.
+        Branch,    ///< I-type immediate relative to the next instruction.
+        Address,   ///< J-type address, bits 57–26.
+        Vector,    ///< `SWI` vector, bits 23–16.
+        Shift,     ///< R-type shift amount, bits 42–37.
+        Word,      ///< 32-bit data.
+        Quad,      ///< 64-bit data.
+    };
+
+    struct Symbol {
+        std::string name;
+        Section section;
+        int64_t value;  ///< Offset in the section, or the number itself for Absolute.
+    };
+
+    struct Relocation {
+        Section section;   ///< Section holding the field.
+        FieldKind kind;
+        uint32_t offset;   ///< Offset of the instruction or data item in its section.
+        uint32_t symbol;   ///< A Section below SectionSymbols, else `symbols[symbol - SectionSymbols]`.
+        int64_t addend;
+    };
+
+    std::array<std::vector<uint8_t>, SectionCount> sections;  ///< Contents of `.text` and `.data`.
+    std::array<uint32_t, SectionCount> alignment{8, 8};       ///< Largest `.align` in each section.
+    std::vector<Symbol> symbols;                              ///< Exports and imports.
+    std::vector<Relocation> relocations;
+
+    /**
+     * @brief Relocation symbol indices below this refer to the start of a section of this object.
+     */
+    static constexpr uint32_t SectionSymbols = SectionCount;
+
+    /**
+     * @brief Places `value` into the bits of `kind`, as for a field at `address`.
+     *
+     * @throws std::runtime_error if the value does not fit.
+     */
+    [[nodiscard]] static uint64_t field(FieldKind kind, int64_t value, uint64_t address);
+
+    /**
+     * @brief As field(), for use in constant expressions.
+     * @return The field bits, or nothing if the value does not fit.
+     */
+    [[nodiscard]] static constexpr std::optional<uint64_t> tryField(FieldKind kind, int64_t value, uint64_t address) noexcept {
+        auto fit = [&](int64_t low, int64_t high, uint64_t mask, unsigned shift) -> std::optional<uint64_t> {
+            if (value < low || value > high) {
+                return std::nullopt;
+            }
+            return (static_cast<uint64_t>(value) & mask) << shift;
+        };
+        switch (kind) {
+            case FieldKind::Immediate:
+                return fit(INT32_MIN, UINT32_MAX, 0xFFFFFFFF, 16);
+            case FieldKind::Branch:
+                value -= static_cast<int64_t>(address + sizeof(uint64_t)); // I0 has advanced past the branch
+                return fit(INT32_MIN, INT32_MAX, 0xFFFFFFFF, 16);
+            case FieldKind::Address:
+                return fit(0, UINT32_MAX, 0xFFFFFFFF, 26);
+            case FieldKind::Vector:
+                return fit(0, 0xFF, 0xFF, 16);
+            case FieldKind::Shift:
+                return fit(0, 0x3F, 0x3F, 37);
+            case FieldKind::Word:
+                return fit(INT32_MIN, UINT32_MAX, 0xFFFFFFFF, 0);
+            case FieldKind::Quad:
+                return static_cast<uint64_t>(value);
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Whether `bytes` start like an object file.
+     */
+    [[nodiscard]] static bool isObject(std::string_view bytes) noexcept;
+
+    [[nodiscard]] std::vector<uint8_t> serialize() const;
+
+    /**
+     * @throws std::runtime_error if `bytes` are not a well-formed object.
+     */
+    [[nodiscard]] static ObjectFile parse(std::string_view bytes);
+
+    /**
+     * @throws std::runtime_error if the file cannot be read or is not an object.
+     */
+    [[nodiscard]] static ObjectFile read(const std::string& path);
+
+    /**
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void write(const std::string& path) const;
+};
+
+#endif // OBJECT_FILE_HPP
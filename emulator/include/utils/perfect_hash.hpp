@@ -0,0 +1,80 @@
+#ifndef PERFECT_HASH_HPP
+#define PERFECT_HASH_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+/**
+ * @brief Collision-free hash table over a fixed set of string keys, built at compile time.
+ *
+ * The constructor searches for a hash seed under which every key lands in its own slot of a table
+ * four times the size of the key set (rounded up to a power of two), so a lookup is one hash, one
+ * mask and one string compare. Keys must be distinct. Construct instances as `constexpr` so the
+ * search runs in the compiler; it fails to compile if no seed is found.
+ *
+ * @tparam Value The mapped type.
+ * @tparam N The number of keys.
+ */
+template <typename Value, size_t N>
+class PerfectHashTable {
+public:
+    static constexpr size_t Slots = std::bit_ceil(N * 4);
+
+    consteval explicit PerfectHashTable(const std::array<std::pair<std::string_view, Value>, N>& entries) {
+        for (uint64_t candidate = 1; candidate < 100000; ++candidate) {
+            if (place(entries, candidate)) {
+                seed = candidate;
+                return;
+            }
+        }
+        throw "PerfectHashTable: no collision-free seed"; // Not a constant expression: fails the build
+    }
+
+    /**
+     * @brief Looks up a key.
+     */
+    [[nodiscard]] constexpr std::optional<Value> find(std::string_view key) const noexcept {
+        const Slot& slot = slots[hash(key, seed) & (Slots - 1)];
+        if (slot.used && slot.key == key) {
+            return slot.value;
+        }
+        return std::nullopt;
+    }
+
+private:
+    struct Slot {
+        std::string_view key{};
+        Value value{};
+        bool used{false};
+    };
+
+    static constexpr uint64_t hash(std::string_view key, uint64_t seed) noexcept {
+        uint64_t h = seed * 0x9E3779B97F4A7C15;
+        for (char c : key) {
+            h = (h ^ static_cast<uint8_t>(c)) * 0x100000001B3;
+        }
+        return h ^ (h >> 32);
+    }
+
+    constexpr bool place(const std::array<std::pair<std::string_view, Value>, N>& entries, uint64_t candidate) {
+        slots = {};
+        for (const auto& [key, value] : entries) {
+            Slot& slot = slots[hash(key, candidate) & (Slots - 1)];
+            if (slot.used) {
+                return false;
+            }
+            slot = Slot{key, value, true};
+        }
+        return true;
+    }
+
+    std::array<Slot, Slots> slots{};
+    uint64_t seed{0};
+};
+
+#endif // PERFECT_HASH_HPP
@@ -0,0 +1,79 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+/**
+ * @brief Bounded lock-free single-producer/single-consumer ring buffer.
+ *
+ * Exactly one thread may call push() and exactly one (other) thread may call pop(). Both sides cache
+ * the opposite index so the shared cache line is only touched when the cached view runs out.
+ *
+ * @tparam T Element type; must be trivially copyable.
+ * @tparam Capacity Number of slots, must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "SpscQueue elements must be trivially copyable");
+
+public:
+    /**
+     * @brief Appends an element (producer side).
+     *
+     * @param value The element to append.
+     * @return false if the queue is full.
+     */
+    bool push(const T& value) noexcept {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail == Capacity) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail == Capacity) {
+                return false;
+            }
+        }
+        slots[h & (Capacity - 1)] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest element (consumer side).
+     *
+     * @return The element, or std::nullopt if the queue is empty.
+     */
+    std::optional<T> pop() noexcept {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t == cachedHead) {
+                return std::nullopt;
+            }
+        }
+        T value = slots[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return value;
+    }
+
+    /**
+     * @brief Checks for pending elements; usable from either side as a hint.
+     */
+    [[nodiscard]] bool empty() const noexcept {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> slots{};
+
+    alignas(64) std::atomic<uint64_t> head{0}; ///< Written by the producer.
+    uint64_t cachedTail{0};                    ///< Producer's view of `tail`.
+    alignas(64) std::atomic<uint64_t> tail{0}; ///< Written by the consumer.
+    uint64_t cachedHead{0};                    ///< Consumer's view of `head`.
+};
+
+#endif // SPSC_QUEUE_HPP
@@ -0,0 +1,366 @@
+#ifndef STATIC_ASSEMBLER_HPP
+#define STATIC_ASSEMBLER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <components/cpu.hpp>
+#include <components/packed.hpp>
+#include <utils/assembler.hpp>
+#include <utils/assembly_syntax.hpp>
+#include <utils/object_file.hpp>
+
+/**
+ * @brief Compile-time XR-32 assembly, for embedding guest programs in host code.
+ *
+ * `xr32::asm_<"...">()` assembles its source in the compiler and returns a
+ * `std::array<uint64_t, N>` holding one element per instruction or `.quad` value, so a
+ * `static constexpr` program lives in read-only data and loads with a plain copy, e.g. through
+ * `xr32_load_image`. The `_xr32` literal in `xr32::literals` does the same.
+ *
+ * The syntax is Assembler's, limited to what a sequence of 64-bit words can hold: instructions,
+ * labels, `.equ`, `.quad`, `.org`, and `.align` and `.space` that pad by whole words. Symbols resolve
+ * as in a flat binary loaded at `Origin`, `Assembler::DefaultOrigin` unless given.
+ *
+ * A line that does not assemble fails the build. The static assertion names the error and the line:
+ * `'xr32::detail::Assembled<xr32::AssemblyError::InvalidRegister, 3>' evaluates to false`.
+ */
+namespace xr32 {
+
+/**
+ * @brief Why a compile-time assembly failed.
+ */
+enum class AssemblyError : uint8_t {
+    None,
+    TooManyOperands,
+    InvalidOpcode,
+    WrongOperandCount,
+    InvalidRegister,
+    InvalidSpecialRegister,
+    InvalidOperand,        ///< Neither a number nor a symbol.
+    InvalidExpression,     ///< A symbol with a malformed addend.
+    UndefinedSymbol,
+    SymbolNotYetDefined,   ///< `.equ`, `.org`, `.align` and `.space` only see symbols defined above them.
+    InvalidSymbolName,
+    SymbolDefinedTwice,
+    ValueOutOfRange,
+    OrgAfterCode,
+    InvalidAlignment,
+    PartialWord,           ///< Padding that is not a whole number of 64-bit words.
+    UnsupportedDirective,  ///< Emits bytes or sections that an array of words cannot hold.
+    UnknownDirective,
+};
+
+/**
+ * @brief A string literal usable as a template argument.
+ */
+template <size_t N>
+struct FixedString {
+    char chars[N]{};
+
+    consteval FixedString(const char (&text)[N]) { std::copy_n(text, N, chars); }
+
+    [[nodiscard]] constexpr std::string_view view() const noexcept { return {chars, N - 1}; }
+};
+
+namespace detail {
+
+/**
+ * @brief The result of assembling a source: its length in words, or the first error.
+ */
+struct Outcome {
+    size_t words{0};
+    AssemblyError error{AssemblyError::None};
+    size_t line{0}; ///< 1-based line of the error.
+};
+
+/**
+ * @brief The assembler behind asm_(). Runs in two passes like Assembler's layout and encoding: the
+ * first defines every label and `.equ`, the second encodes, so forward references need no fixups.
+ */
+class StaticAssembler {
+public:
+    consteval StaticAssembler(std::string_view text, uint32_t loadAddress) : source(text), origin(loadAddress) {}
+
+    /**
+     * @brief Assembles the source, writing the words to `output` if it is not null.
+     */
+    consteval Outcome run(uint64_t* output) {
+        out = output;
+        for (bool encoding : {false, true}) {
+            outcome = {};
+            address = origin;
+            std::string_view rest = source;
+            size_t line = 0;
+            while (!rest.empty()) {
+                size_t end = rest.find('\n');
+                std::string_view text = rest.substr(0, end);
+                rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+                outcome.line = ++line;
+                if (encoding) {
+                    encodeLine(text);
+                } else {
+                    layoutLine(text);
+                }
+                if (outcome.error != AssemblyError::None) {
+                    return outcome;
+                }
+            }
+        }
+        outcome.line = 0;
+        return outcome;
+    }
+
+private:
+    using Operands = syntax::Operands;
+    using FieldKind = ObjectFile::FieldKind;
+
+    /**
+     * @brief Records the first error. Returns a placeholder so callers can carry on to the end of the line.
+     */
+    constexpr uint64_t fail(AssemblyError error) {
+        if (outcome.error == AssemblyError::None) {
+            outcome.error = error;
+        }
+        return 0;
+    }
+
+    constexpr void emit(uint64_t word) {
+        if (out) {
+            out[outcome.words] = word;
+        }
+        ++outcome.words;
+        address += sizeof(uint64_t);
+    }
+
+    constexpr bool lex(std::string_view text, syntax::Statement& statement) {
+        if (!syntax::lex(text, statement, true)) {
+            fail(AssemblyError::TooManyOperands);
+            return false;
+        }
+        return true;
+    }
+
+    constexpr void layoutLine(std::string_view text) {
+        syntax::Statement statement;
+        if (!lex(text, statement)) {
+            return;
+        }
+        for (std::string_view labels = statement.labels; !labels.empty();) {
+            define(syntax::nextLabel(labels), static_cast<int64_t>(address));
+        }
+        const std::string_view mnemonic = statement.mnemonic;
+        const auto& op = statement.operands;
+        if (mnemonic.empty()) {
+            return;
+        }
+        if (mnemonic.front() != '.') {
+            address += sizeof(uint64_t);
+        } else if (mnemonic == ".equ") {
+            if (statement.operandCount != 2) {
+                fail(AssemblyError::WrongOperandCount);
+                return;
+            }
+            define(op[0], evaluate(op[1]));
+        } else if (mnemonic == ".quad") {
+            address += sizeof(uint64_t) * statement.operandCount;
+        } else if (mnemonic == ".org" || mnemonic == ".align" || mnemonic == ".space") {
+            if (statement.operandCount != 1) {
+                fail(AssemblyError::WrongOperandCount);
+                return;
+            }
+            int64_t value = evaluate(op[0]);
+            if (mnemonic == ".org") {
+                if (address != origin) {
+                    fail(AssemblyError::OrgAfterCode);
+                }
+                origin = static_cast<uint32_t>(value);
+                address = origin;
+            } else {
+                address += padding(mnemonic, value);
+            }
+        } else {
+            directive(mnemonic);
+        }
+    }
+
+    constexpr void encodeLine(std::string_view text) {
+        syntax::Statement statement;
+        if (!lex(text, statement)) {
+            return;
+        }
+        const std::string_view mnemonic = statement.mnemonic;
+        if (mnemonic.empty() || mnemonic == ".equ" || mnemonic == ".org") {
+            return;
+        }
+        if (mnemonic == ".quad") {
+            for (size_t i = 0; i < statement.operandCount; ++i) {
+                emit(operand(statement.operands[i], FieldKind::Quad));
+            }
+        } else if (mnemonic == ".align" || mnemonic == ".space") {
+            for (uint64_t words = padding(mnemonic, evaluate(statement.operands[0])) / sizeof(uint64_t); words; --words) {
+                emit(0);
+            }
+        } else {
+            emit(instruction(statement));
+        }
+    }
+
+    /**
+     * @brief Bytes that `.align` or `.space` adds at the current address.
+     */
+    constexpr uint64_t padding(std::string_view mnemonic, int64_t value) {
+        uint64_t bytes = static_cast<uint64_t>(value);
+        if (mnemonic == ".align") {
+            if (value <= 0 || (value & (value - 1)) != 0 || value > 0x10000) {
+                return fail(AssemblyError::InvalidAlignment);
+            }
+            bytes = (bytes - address % bytes) % bytes;
+        } else if (value < 0) {
+            return fail(AssemblyError::ValueOutOfRange);
+        }
+        if (bytes % sizeof(uint64_t) != 0) {
+            return fail(AssemblyError::PartialWord);
+        }
+        return bytes;
+    }
+
+    constexpr void directive(std::string_view mnemonic) {
+        for (std::string_view known : {".byte", ".word", ".ascii", ".asciz", ".text", ".data", ".global"}) {
+            if (mnemonic == known) {
+                fail(AssemblyError::UnsupportedDirective);
+                return;
+            }
+        }
+        fail(AssemblyError::UnknownDirective);
+    }
+
+    constexpr uint64_t instruction(const syntax::Statement& statement) {
+        uint64_t opcode = CPU::findInstruction(statement.mnemonic);
+        uint64_t func = 0;
+        if (opcode == 0xFFFFFFFF) {
+            auto packed = PackedAlu::findMnemonic(statement.mnemonic);
+            if (!packed) {
+                return fail(AssemblyError::InvalidOpcode);
+            }
+            opcode = PackedAlu::Opcode;
+            func = *packed;
+        }
+        auto registers = [](std::string_view token) { return CPU::findRegister(token); };
+        auto field = [&](std::string_view token, FieldKind kind) { return operand(token, kind); };
+        auto reject = [&](syntax::EncodingError error, std::string_view, size_t) {
+            switch (error) {
+                case syntax::EncodingError::WrongOperandCount: fail(AssemblyError::WrongOperandCount); break;
+                case syntax::EncodingError::InvalidRegister: fail(AssemblyError::InvalidRegister); break;
+                case syntax::EncodingError::InvalidSpecialRegister: fail(AssemblyError::InvalidSpecialRegister); break;
+                case syntax::EncodingError::InvalidOpcode: fail(AssemblyError::InvalidOpcode); break;
+            }
+        };
+        return (opcode << 58) | (func << 29) | syntax::encodeOperands(opcode, statement, registers, field, reject);
+    }
+
+    /**
+     * @brief Encodes a number or a symbol, defined anywhere in the source, into the field of `kind`.
+     */
+    constexpr uint64_t operand(std::string_view token, FieldKind kind) {
+        int64_t value = resolve(token, true);
+        if (outcome.error != AssemblyError::None) {
+            return 0;
+        }
+        auto bits = ObjectFile::tryField(kind, value, address);
+        return bits ? *bits : fail(AssemblyError::ValueOutOfRange);
+    }
+
+    /**
+     * @brief Evaluates a number or a symbol defined above the current line.
+     */
+    constexpr int64_t evaluate(std::string_view token) { return resolve(token, false); }
+
+    constexpr int64_t resolve(std::string_view token, bool anywhere) {
+        int64_t value = 0;
+        if (syntax::parseNumber(token, value)) {
+            return value;
+        }
+        std::string_view name;
+        int64_t addend = 0;
+        switch (syntax::splitSymbol(token, name, addend)) {
+            case syntax::SymbolForm::NotSymbol:
+                return static_cast<int64_t>(fail(AssemblyError::InvalidOperand));
+            case syntax::SymbolForm::InvalidAddend:
+                return static_cast<int64_t>(fail(AssemblyError::InvalidExpression));
+            case syntax::SymbolForm::Symbol:
+                break;
+        }
+        for (const auto& [symbol, symbolValue] : symbols) {
+            if (symbol == name) {
+                return symbolValue + addend;
+            }
+        }
+        return static_cast<int64_t>(fail(anywhere ? AssemblyError::UndefinedSymbol : AssemblyError::SymbolNotYetDefined));
+    }
+
+    constexpr void define(std::string_view name, int64_t value) {
+        if (name.empty() || !syntax::isSymbolStart(name.front()) || CPU::findRegister(name) != 0xFF) {
+            fail(AssemblyError::InvalidSymbolName);
+            return;
+        }
+        for (const auto& symbol : symbols) {
+            if (symbol.first == name) {
+                fail(AssemblyError::SymbolDefinedTwice);
+                return;
+            }
+        }
+        symbols.emplace_back(name, value);
+    }
+
+    std::string_view source;
+    uint32_t origin;
+    uint64_t address{0};
+    uint64_t* out{nullptr};
+    Outcome outcome;
+    std::vector<std::pair<std::string_view, int64_t>> symbols; ///< Labels and `.equ` values.
+};
+
+/**
+ * @brief False exactly when assembly failed, so a failed static assertion shows the error and line.
+ */
+template <AssemblyError Error, size_t Line>
+inline constexpr bool Assembled = Error == AssemblyError::None;
+
+} // namespace detail
+
+/**
+ * @brief Assembles `Source` at compile time.
+ *
+ * @tparam Source The assembly code.
+ * @tparam Origin Address of the first word, for labels.
+ * @return The machine code, one 64-bit word per instruction or `.quad` value.
+ */
+template <FixedString Source, uint32_t Origin = Assembler::DefaultOrigin>
+consteval auto asm_() {
+    constexpr detail::Outcome outcome = detail::StaticAssembler(Source.view(), Origin).run(nullptr);
+    static_assert(detail::Assembled<outcome.error, outcome.line>, "XR-32 assembly failed");
+    std::array<uint64_t, outcome.words> program{};
+    detail::StaticAssembler(Source.view(), Origin).run(program.data());
+    return program;
+}
+
+namespace literals {
+
+/**
+ * @brief `"ADD R1 R2 R3\nHLT"_xr32`: asm_() at the default origin.
+ */
+template <FixedString Source>
+consteval auto operator""_xr32() {
+    return asm_<Source>();
+}
+
+} // namespace literals
+
+} // namespace xr32
+
+#endif // STATIC_ASSEMBLER_HPP
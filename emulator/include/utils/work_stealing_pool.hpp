@@ -0,0 +1,77 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed-size thread pool where idle workers steal queued tasks from busy ones.
+ *
+ * Each worker owns a deque: it takes its own tasks from the back (most recently queued, still hot
+ * in cache) and steals from the front of the others' deques when it runs dry, so uneven task lengths
+ * balance out without a single contended queue. Tasks are coarse (whole guest runs), so a mutex per
+ * deque is cheaper than it looks and keeps stealing simple.
+ */
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @brief Starts the worker threads.
+     *
+     * @param threadCount Number of workers; 0 selects one per hardware thread.
+     */
+    explicit WorkStealingPool(unsigned threadCount = 0);
+
+    /**
+     * @brief Finishes all queued tasks and joins the workers.
+     */
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * @brief Queues a task. Tasks must not throw.
+     *
+     * @param task The task to run on some worker.
+     */
+    void submit(Task task);
+
+    /**
+     * @brief Blocks until every submitted task has finished.
+     */
+    void wait();
+
+    /**
+     * @brief Number of worker threads.
+     */
+    [[nodiscard]] unsigned size() const noexcept { return static_cast<unsigned>(threads.size()); }
+
+private:
+    struct Worker {
+        std::mutex mutex;       ///< Guards `tasks`.
+        std::deque<Task> tasks; ///< Owner pops from the back, thieves from the front.
+    };
+
+    void workerLoop(size_t self) noexcept;
+    [[nodiscard]] bool take(size_t self, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers; ///< One per thread.
+    std::vector<std::thread> threads;             ///< The workers.
+    std::atomic<size_t> nextWorker{0};            ///< Round-robin submission target.
+    std::atomic<size_t> queued{0};                ///< Tasks submitted but not yet taken.
+    std::atomic<size_t> unfinished{0};            ///< Tasks submitted but not yet finished.
+    bool stopping{false};                         ///< Guarded by `stateMutex`.
+    std::mutex stateMutex;                        ///< Guards `stopping` and the condition variables.
+    std::condition_variable workAvailable;        ///< Wakes idle workers.
+    std::condition_variable allDone;              ///< Wakes wait().
+};
+
+#endif // WORK_STEALING_POOL_HPP
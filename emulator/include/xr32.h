@@ -0,0 +1,172 @@
+#ifndef XR32_H
+#define XR32_H
+
+/**
+ * @file xr32.h
+ * @brief C API of libxr32, for embedding the XR-32 emulator in other programs.
+ *
+ * A machine is one XR-32 core with its RAM and IO space. Machines are independent of each other, so
+ * a host may create many and run them on as many threads as it likes, but each machine must only be
+ * used by one thread at a time. Functions that can fail return an xr32_status; the message of the
+ * last failure on a machine is available from xr32_last_error().
+ *
+ * The API is versioned by XR32_API_VERSION. Later versions only add functions, enumerators and
+ * flags; existing signatures, values and struct layouts do not change.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XR32_API_VERSION 1
+
+#if defined(__GNUC__)
+#define XR32_API __attribute__((visibility("default")))
+#else
+#define XR32_API
+#endif
+
+/** @brief Opaque handle of an emulated machine. */
+typedef struct xr32_machine xr32_machine;
+
+/** @brief Result of a fallible call. */
+typedef enum xr32_status {
+    XR32_OK = 0,                /**< Success. */
+    XR32_ERROR_ARGUMENT = -1,   /**< A null pointer, unknown register or invalid value was passed. */
+    XR32_ERROR_RANGE = -2,      /**< A memory access or image does not fit in RAM. */
+    XR32_ERROR_STATE = -3,      /**< The machine cannot do this now, e.g. the port is already mapped. */
+    XR32_ERROR_FAILED = -4,     /**< The operation failed; see xr32_last_error(). */
+} xr32_status;
+
+/** @brief Why xr32_run() returned. */
+typedef enum xr32_stop_reason {
+    XR32_STOP_BUDGET = 0,       /**< The instruction budget ran out; the machine can run on. */
+    XR32_STOP_EXITED = 1,       /**< A user-mode guest called exit; see `exit_code`. */
+    XR32_STOP_HALTED = 2,       /**< The guest executed HLT with nothing left to wait for. */
+    XR32_STOP_FAULT = 3,        /**< Emulation failed, e.g. an unhandled exception; see xr32_last_error(). */
+} xr32_stop_reason;
+
+/** @brief Outcome of xr32_run(). */
+typedef struct xr32_run_result {
+    xr32_stop_reason reason;    /**< Why the run stopped. */
+    int32_t exit_code;          /**< The guest's exit status, for XR32_STOP_EXITED. */
+    uint64_t instructions;      /**< Instructions retired by this run. */
+} xr32_run_result;
+
+/** @brief Flags of xr32_create(). */
+enum {
+    XR32_MACHINE_USER_MODE = 1, /**< Service `SWI 0x80`-`0x8F` on the host (see ARCH.md, User-Mode Syscall ABI). */
+};
+
+/** @brief Handles a guest `IN` from a mapped port. */
+typedef uint32_t (*xr32_port_read_fn)(void* context, uint16_t port);
+
+/** @brief Handles a guest `OUT` to a mapped port. */
+typedef void (*xr32_port_write_fn)(void* context, uint16_t port, uint32_t value);
+
+/**
+ * @brief The XR32_API_VERSION the library was built with.
+ */
+XR32_API uint32_t xr32_api_version(void);
+
+/**
+ * @brief Creates a machine with zeroed RAM and registers in their reset state.
+ *
+ * @param memory_size RAM in bytes.
+ * @param flags Zero or more XR32_MACHINE_* flags.
+ * @return The machine, or NULL if RAM could not be allocated.
+ */
+XR32_API xr32_machine* xr32_create(size_t memory_size, uint32_t flags);
+
+/**
+ * @brief Destroys a machine, closing any files its guest left open. Accepts NULL.
+ */
+XR32_API void xr32_destroy(xr32_machine* machine);
+
+/**
+ * @brief Resets registers, zeroes RAM and forgets loaded images, keeping mapped ports.
+ */
+XR32_API xr32_status xr32_reset(xr32_machine* machine);
+
+/**
+ * @brief Copies a program image into RAM and points `I0` at its first byte.
+ *
+ * User-mode machines lay out their stack and mmap area above the highest image loaded so far, and
+ * point `S0` at the top of the stack.
+ *
+ * @param address Physical load address; 0x1000 is where `xr32-tool` loads programs.
+ */
+XR32_API xr32_status xr32_load_image(xr32_machine* machine, const void* image, size_t size, uint32_t address);
+
+/**
+ * @brief Runs the machine until it stops or `budget` instructions have been executed.
+ *
+ * @param result Receives why the run stopped; may be NULL.
+ * @return XR32_OK unless the arguments are invalid; emulation failures are reported in `result`.
+ */
+XR32_API xr32_status xr32_run(xr32_machine* machine, uint64_t budget, xr32_run_result* result);
+
+/**
+ * @brief Reads a register by its encoding: 0-31 for `R0`-`R31`, 0x20 and up for the special
+ * registers (see ARCH.md, Register Hexadecimal Representation).
+ */
+XR32_API xr32_status xr32_get_register(xr32_machine* machine, unsigned index, uint32_t* value);
+
+/**
+ * @brief Writes a register by its encoding. `I0` may be written; the read-only `PRR` and `CID` may not.
+ */
+XR32_API xr32_status xr32_set_register(xr32_machine* machine, unsigned index, uint32_t value);
+
+/**
+ * @brief Copies `size` bytes of physical memory starting at `address` into `buffer`.
+ */
+XR32_API xr32_status xr32_read_memory(xr32_machine* machine, uint32_t address, void* buffer, size_t size);
+
+/**
+ * @brief Copies `size` bytes from `data` into physical memory starting at `address`.
+ */
+XR32_API xr32_status xr32_write_memory(xr32_machine* machine, uint32_t address, const void* data, size_t size);
+
+/**
+ * @brief Maps host callbacks to an IO port.
+ *
+ * The callbacks run on the thread calling xr32_run(). A NULL `read` makes `IN` return 0 and a NULL
+ * `write` ignores `OUT`.
+ *
+ * @param context Passed to both callbacks unchanged.
+ */
+XR32_API xr32_status xr32_map_port(xr32_machine* machine, uint16_t port, xr32_port_read_fn read,
+                                   xr32_port_write_fn write, void* context);
+
+/**
+ * @brief Makes an interrupt pending; it is taken once `FR.I` is set. Safe to call from port callbacks.
+ */
+XR32_API xr32_status xr32_raise_interrupt(xr32_machine* machine, uint8_t vector);
+
+/**
+ * @brief Saves the machine to a snapshot file (see `xr32-tool --save`). Mapped ports are not saved.
+ *
+ * @param parent A snapshot to store only the difference to, or NULL for a full snapshot.
+ */
+XR32_API xr32_status xr32_save_snapshot(xr32_machine* machine, const char* path, const char* parent);
+
+/**
+ * @brief Restores a snapshot into a machine created with the same RAM size and flags.
+ */
+XR32_API xr32_status xr32_restore_snapshot(xr32_machine* machine, const char* path);
+
+/**
+ * @brief The message of the last failed call on `machine`, or an empty string.
+ *
+ * The pointer stays valid until the next call on the machine.
+ */
+XR32_API const char* xr32_last_error(const xr32_machine* machine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XR32_H */
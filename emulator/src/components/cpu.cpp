@@ -1,24 +1,260 @@
 #include <components/cpu.hpp>
+#include <components/journal.hpp>
+#include <bit>
+#include <chrono>
 #include <stdexcept>
 
 CPU::CPU(size_t memorySize) noexcept
-    : registers(Registers{}), memory(memorySize, *this), io(*this), interrupts(*this), isa(*this)  {
+    : registers(Registers{}), memory(memorySize, *this), ownedIo(std::make_unique<IO>(*this)), io(*ownedIo),
+      interrupts(*this), isa(*this), pmu(*this), boot(*this), cores{this}  {
     reset();
 }
 
+CPU::CPU(CPU& bootCore)
+    : registers(Registers{}), memory(bootCore.memory, *this), io(bootCore.io), interrupts(*this), isa(*this),
+      pmu(*this), coreId(static_cast<uint8_t>(bootCore.cores.size())), boot(bootCore) {
+    if (bootCore.cores.size() > 0xFF) {
+        throw std::length_error("Too many cores");
+    }
+    reset();
+    boot.cores.push_back(this);
+    io.share();
+}
+
 void CPU::reset() noexcept {
     registers = Registers{};
     registers.MSR = 0x1;
+    pmu.reset();
 }
 
 void CPU::executeNextInstruction() {
+    if (interruptPending.load(std::memory_order_acquire)) [[unlikely]] {
+        deliverPendingInterrupt();
+    }
+    if (waiting) [[unlikely]] {
+        waitForInterrupt();
+        return;
+    }
+    ++retiredInstructions;
     uint64_t instruction = fetchInstruction();
+    if (traceRecorder) [[unlikely]] {
+        traceInstruction(instruction);
+        return;
+    }
+    registers.I0 += sizeof(uint64_t);
+    auto decoded = isa.decodeInstruction(instruction);
+    if (pmu.active()) [[unlikely]] {
+        pmu.retire();
+        isa.execute(decoded);
+        if (pmu.overflowPending()) {
+            pmu.deliverOverflow();
+        }
+        return;
+    }
+    isa.execute(decoded);
+}
+
+void CPU::traceInstruction(uint64_t instruction) {
+    // Ends the record however the instruction leaves, including by a guest exit or halt.
+    struct Record {
+        CPU& core;
+        ~Record() { core.traceRecorder->end(core.registers.R, core.registers.S0, core.registers.FR); }
+    };
+    traceRecorder->begin(registers.I0, instruction, registers.R, registers.S0, registers.FR);
+    Record record{*this};
+    registers.I0 += sizeof(uint64_t);
     auto decoded = isa.decodeInstruction(instruction);
+    const bool counting = pmu.active();
+    if (counting) [[unlikely]] {
+        pmu.retire();
+    }
     isa.execute(decoded);
+    if (counting && pmu.overflowPending()) [[unlikely]] {
+        pmu.deliverOverflow();
+    }
+}
+
+uint32_t CPU::readSpecialRegister(uint8_t index) noexcept {
+    switch (index) {
+        case 0x20: return registers.I0;
+        case 0x21: return registers.S0;
+        case 0x22: return registers.S1;
+        case 0x23: return registers.FR;
+        case 0x24: return registers.IVTR;
+        case 0x25: return registers.IE0;
+        case 0x26: return registers.IE1;
+        case 0x27: return registers.IE2;
+        case 0x28: return registers.IE3;
+        case 0x29: return registers.TPDR;
+        case 0x2A: return registers.TSP;
+        case 0x2B: return registers.PRR;
+        case 0x2C: return registers.MSR;
+        case 0x35: return coreId;
+        case PerformanceMonitor::PMCR:
+        case PerformanceMonitor::PMOVS:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::Instructions:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::Cycles:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::Branches:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::PageWalks:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::Interrupts:
+            return pmu.read(index);
+        default: return 0;
+    }
+}
+
+void CPU::writeSpecialRegister(uint8_t index, uint32_t value) {
+    switch (index) {
+        case 0x21: registers.S0 = value; break;
+        case 0x22: registers.S1 = value; break;
+        case 0x23: registers.FR = static_cast<uint8_t>(value); break;
+        case 0x24: registers.IVTR = value; break;
+        case 0x25: registers.IE0 = static_cast<uint8_t>(value); break;
+        case 0x26: registers.IE1 = value; break;
+        case 0x27: registers.IE2 = value; break;
+        case 0x28: registers.IE3 = static_cast<uint8_t>(value); break;
+        case 0x29:
+            registers.TPDR = value;
+            memory.flushTlb();
+            break;
+        case 0x2A: registers.TSP = value; break;
+        case 0x2C:
+            registers.MSR = value;
+            if (timelineTrack) [[unlikely]] {
+                timelineTrack->mode(registers.MSR >> 31, retiredInstructions);
+            }
+            break;
+        case PerformanceMonitor::PMCR:
+        case PerformanceMonitor::PMOVS:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::Instructions:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::Cycles:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::Branches:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::PageWalks:
+        case PerformanceMonitor::PMC0 + PerformanceMonitor::Interrupts:
+            pmu.write(index, value);
+            break;
+        case 0x36: // IPIR
+            sendIpi(value);
+            break;
+        case 0x20: // I0
+        case 0x2B: // PRR
+        case 0x35: // CID
+            interrupts.triggerInterrupt(GeneralProtectionFault, ReservedSystemRegisterAccess);
+            break;
+        default:
+            break;
+    }
 }
 
 uint64_t CPU::fetchInstruction() const {
-    uint64_t instruction = memory.read(registers.I0);
-    return instruction;
+    uint64_t low = memory.read(registers.I0);
+    uint64_t high = memory.read(registers.I0 + sizeof(uint32_t));
+    return (high << 32) | low;
+}
+
+
+void CPU::raiseInterrupt(uint8_t vector) noexcept {
+    pendingVectors[vector >> 6].fetch_or(uint64_t{1} << (vector & 63), std::memory_order_release);
+    interruptPending.store(true, std::memory_order_seq_cst);
+    if (timelineTrack) [[unlikely]] {
+        timelineTrack->raised(vector);
+    }
+    if (sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeup.notify_one();
+    }
 }
 
+void CPU::sendIpi(uint32_t command) noexcept {
+    uint8_t vector = command & 0xFF;
+    uint8_t target = (command >> 8) & 0xFF;
+    const auto& all = boot.cores;
+    if (target == 0xFF) {
+        for (CPU* core : all) {
+            if (core != this) {
+                core->raiseInterrupt(vector);
+            }
+        }
+    } else if (target < all.size()) {
+        all[target]->raiseInterrupt(vector);
+    }
+}
+
+void CPU::setJournal(ExecutionJournal* log) noexcept {
+    journal = log;
+    io.journal = log;
+    // While replaying, every instruction boundary asks the journal whether an interrupt is due.
+    if (log && log->replaying()) {
+        interruptPending.store(true, std::memory_order_seq_cst);
+    }
+}
+
+void CPU::setTimeline(EventTimeline::Track* track) {
+    timelineTrack = track;
+    if (track) {
+        track->mode(registers.MSR >> 31, retiredInstructions);
+    }
+}
+
+void CPU::deliverPendingInterrupt() {
+    if (!(registers.FR & (1 << 4))) {
+        return; // Stays pending until the guest re-enables interrupts
+    }
+    if (journal && journal->replaying()) [[unlikely]] {
+        replayInterrupt();
+        return;
+    }
+    interruptPending.store(false, std::memory_order_seq_cst);
+    for (size_t word = 0; word < pendingVectors.size(); ++word) {
+        uint64_t bits = pendingVectors[word].load(std::memory_order_acquire);
+        if (bits == 0) {
+            continue;
+        }
+        uint64_t lowest = bits & (~bits + 1);
+        uint64_t remaining = pendingVectors[word].fetch_and(~lowest, std::memory_order_acq_rel) & ~lowest;
+        for (size_t rest = word + 1; remaining == 0 && rest < pendingVectors.size(); ++rest) {
+            remaining = pendingVectors[rest].load(std::memory_order_relaxed);
+        }
+        if (remaining != 0) {
+            interruptPending.store(true, std::memory_order_relaxed); // Taken once the guest unmasks again
+        }
+        auto vector = static_cast<uint8_t>(word * 64 + std::countr_zero(bits));
+        if (journal) {
+            journal->recordInterrupt(retiredInstructions, vector);
+        }
+        interrupts.triggerInterrupt(vector);
+        registers.FR &= ~(1 << 4); // Mask further asynchronous interrupts until IRET restores FR
+        return;
+    }
+}
+
+void CPU::replayInterrupt() {
+    uint8_t vector;
+    if (journal->interruptDue(retiredInstructions, vector)) {
+        interrupts.triggerInterrupt(vector);
+        registers.FR &= ~(1 << 4);
+    } else if (waiting) {
+        throw ReplayDivergence("the guest waits in HLT after " + std::to_string(retiredInstructions) +
+                               " instructions, but the log holds no interrupt for it");
+    }
+}
+
+void CPU::halt() {
+    // Waiting is pointless if interrupts are masked or nothing (another core, a device) could wake us.
+    if (!(registers.FR & (1 << 4)) || (boot.cores.size() == 1 && !io.hasInterruptSources())) {
+        throw CpuHalted();
+    }
+    waiting = true;
+    if (timelineTrack) [[unlikely]] {
+        timelineTrack->record(EventTimeline::Event::HaltEntry, retiredInstructions);
+    }
+}
+
+void CPU::waitForInterrupt() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleeping.store(true, std::memory_order_seq_cst);
+    if (!interruptPending.load(std::memory_order_seq_cst)) {
+        // Bounded so the boot core keeps polling devices and every core notices shutdown.
+        wakeup.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    sleeping.store(false, std::memory_order_relaxed);
+}
@@ -1,10 +1,39 @@
 #include <components/memory.hpp>
 #include <components/interrupts.hpp>
 #include <components/cpu.hpp>
+#include <components/syscalls.hpp>
 #include <cstdint>
 #include <stdexcept>
 
 void Interrupts::triggerInterrupt(uint8_t interruptNumber, uint8_t errorCode) {
+    if (syscalls) [[unlikely]] {
+        if (SyscallEmulator::isSyscall(interruptNumber)) {
+            EventTimeline::Track* track = cpu.timeline();
+            if (track) [[unlikely]] {
+                track->record(EventTimeline::Event::SyscallEntry, cpu.retired(), interruptNumber);
+            }
+            syscalls->handle(cpu, interruptNumber);
+            if (track) [[unlikely]] {
+                track->record(EventTimeline::Event::SyscallExit, cpu.retired());
+            }
+            return;
+        }
+        if (cpu.registers.IVTR == 0) {
+            throw GuestFault(interruptNumber, errorCode, cpu.registers.I0);
+        }
+    }
+    if (cpu.pmu.active()) {
+        cpu.pmu.endBlock();
+        cpu.pmu.count(PerformanceMonitor::Interrupts);
+        cpu.pmu.count(PerformanceMonitor::Cycles, PerformanceMonitor::CycleCost::Interrupt);
+    }
+    if (EventTimeline::Track* track = cpu.timeline()) [[unlikely]] {
+        if (cpu.halted()) {
+            track->record(EventTimeline::Event::HaltExit, cpu.retired());
+        }
+        track->record(EventTimeline::Event::InterruptEntry, cpu.retired(), interruptNumber | errorCode << 8, cpu.registers.I0);
+        track->mode(true, cpu.retired());
+    }
     saveContext();
     cpu.registers.IE0 = errorCode;
     uint32_t isrAddress = fetchISRAddress(interruptNumber);
@@ -14,9 +43,15 @@ void Interrupts::triggerInterrupt(uint8_t interruptNumber, uint8_t errorCode) {
 
 void Interrupts::triggerIret() {
     restoreContext();
+    if (EventTimeline::Track* track = cpu.timeline()) [[unlikely]] {
+        track->record(EventTimeline::Event::InterruptExit, cpu.retired());
+        track->mode(cpu.registers.MSR >> 31, cpu.retired());
+    }
 }
 
 void Interrupts::saveContext() {
+    cpu.resume();                    // Interrupts end HLT
+    cpu.reservation.word = nullptr;  // and break LL/SC sequences
     cpu.registers.IE1 = cpu.registers.I0;   // Save the current instruction pointer (I0)
     cpu.registers.IE2 = cpu.registers.S0;   // Save the stack pointer (S0)
     cpu.registers.IE3 = cpu.registers.FR;   // Save the flags register (FR)
@@ -1,7 +1,24 @@
 #include <components/io.hpp>
+#include <components/journal.hpp>
 #include <stdexcept>
 
-uint32_t IO::readPort(uint16_t port) const noexcept {
+uint32_t IO::readPort(uint16_t port) const {
+    if (journal) [[unlikely]] {
+        if (journal->replaying()) {
+            return journal->replayPortRead(port);
+        }
+        uint32_t value = readDevice(port);
+        journal->recordPortRead(port, value);
+        return value;
+    }
+    return readDevice(port);
+}
+
+uint32_t IO::readDevice(uint16_t port) const noexcept {
+    std::unique_lock<std::mutex> lock(portMutex, std::defer_lock);
+    if (shared) {
+        lock.lock();
+    }
     if (isPortMapped(port)) {
         return readMap.at(port)();
     }
@@ -9,6 +26,10 @@ uint32_t IO::readPort(uint16_t port) const noexcept {
 }
 
 void IO::writePort(uint16_t port, uint32_t value) noexcept {
+    std::unique_lock<std::mutex> lock(portMutex, std::defer_lock);
+    if (shared) {
+        lock.lock();
+    }
     if (isPortMapped(port)) {
         writeMap.at(port)(value);
     }
@@ -22,6 +43,10 @@ void IO::mapDevice(uint16_t port, std::function<uint32_t()> readFunc, std::funct
     writeMap[port] = std::move(writeFunc);
 }
 
+void IO::addPoller(std::function<void()> pollFunc) {
+    pollers.push_back(std::move(pollFunc));
+}
+
 bool IO::isPortMapped(uint16_t port) const noexcept {
     return readMap.find(port) != readMap.end() && writeMap.find(port) != writeMap.end();
 }
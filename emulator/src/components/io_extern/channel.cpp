@@ -0,0 +1,99 @@
+#include <components/io_extern/channel.hpp>
+#include <components/cpu.hpp>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+Channel::Channel(std::string channelName, size_t size, unsigned endpointCount)
+    : label(std::move(channelName)), length(size), devices(endpointCount, nullptr) {
+    if (endpointCount == 0 || endpointCount > 0xFF) {
+        throw std::invalid_argument("Channel " + label + " must have 1 to 255 endpoints");
+    }
+    fd = memfd_create(label.c_str(), MFD_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create channel " + label);
+    }
+    if (ftruncate(fd, static_cast<off_t>(length)) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to size channel " + label);
+    }
+}
+
+Channel::~Channel() {
+    ::close(fd);
+}
+
+void Channel::connect(unsigned endpoint, ChannelDevice& device) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (endpoint >= devices.size() || devices[endpoint]) {
+        throw std::runtime_error("Endpoint " + std::to_string(endpoint) + " of channel " + label + " is not available");
+    }
+    devices[endpoint] = &device;
+    connected.fetch_add(1, std::memory_order_release);
+}
+
+void Channel::disconnect(unsigned endpoint) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    devices[endpoint] = nullptr;
+    connected.fetch_sub(1, std::memory_order_release);
+    for (ChannelDevice* device : devices) {
+        if (device) {
+            device->doorbell();
+        }
+    }
+}
+
+void Channel::ring(unsigned from, uint32_t target) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (target == ChannelDevice::Broadcast) {
+        for (size_t endpoint = 0; endpoint < devices.size(); ++endpoint) {
+            if (endpoint != from && devices[endpoint]) {
+                devices[endpoint]->doorbell();
+            }
+        }
+    } else if (target < devices.size() && devices[target]) {
+        devices[target]->doorbell();
+    }
+}
+
+ChannelDevice::ChannelDevice(CPU& cpuRef, std::shared_ptr<Channel> shared, unsigned endpoint)
+    : cpu(cpuRef), channel(std::move(shared)), index(endpoint),
+      window(cpu.memory.mapShared(channel->fd, channel->size())) {
+    channel->connect(index, *this);
+    cpu.io.addInterruptSource();
+}
+
+ChannelDevice::~ChannelDevice() {
+    channel->disconnect(index);
+}
+
+void ChannelDevice::attach(IO& io, uint16_t base) {
+    for (uint16_t offset = 0; offset < RegisterCount; ++offset) {
+        io.mapDevice(base + offset,
+            [this, offset]() -> uint32_t {
+                switch (offset) {
+                    case Window: return window;
+                    case Size: return static_cast<uint32_t>(channel->size());
+                    case Endpoint: return index;
+                    case Endpoints: return channel->endpoints();
+                    case Vector: return vector.load(std::memory_order_relaxed);
+                    case Connected: return channel->connected.load(std::memory_order_acquire);
+                    default: return 0;
+                }
+            },
+            [this, offset](uint32_t value) {
+                if (offset == Doorbell) {
+                    channel->ring(index, value);
+                } else if (offset == Vector) {
+                    vector.store(value & 0xFF, std::memory_order_relaxed);
+                }
+            });
+    }
+}
+
+void ChannelDevice::doorbell() noexcept {
+    // raiseInterrupt() publishes the ringer's earlier stores to the woken core.
+    if (uint8_t target = static_cast<uint8_t>(vector.load(std::memory_order_relaxed))) {
+        cpu.raiseInterrupt(target);
+    }
+}
@@ -0,0 +1,7 @@
+#include <components/io_extern/debugcon.hpp>
+
+void DebugCon::attach(IO& io, uint16_t port) {
+    io.mapDevice(port,
+        []() -> uint32_t { return Port; },
+        [this](uint32_t value) { output.put(static_cast<uint8_t>(value)); });
+}
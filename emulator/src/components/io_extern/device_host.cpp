@@ -0,0 +1,76 @@
+#include <components/io_extern/device_host.hpp>
+#include <components/cpu.hpp>
+#include <chrono>
+
+DeviceHost::DeviceHost(CPU& cpuRef) : cpu(cpuRef) {
+    host = std::thread(&DeviceHost::hostLoop, this);
+}
+
+DeviceHost::~DeviceHost() {
+    stopping.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+        wakeup.notify_one();
+    }
+    host.join();
+}
+
+void DeviceHost::attach(IO& io, uint16_t base, OffloadedDevice& device) {
+    for (uint16_t offset = 0; offset < device.portCount(); ++offset) {
+        io.mapDevice(base + offset,
+            [&device, offset]() { return device.read(offset); },
+            [this, &device, offset](uint32_t value) {
+                device.submitted(offset, value);
+                submit({&device, offset, value});
+            });
+    }
+    if (!sourceRegistered) {
+        io.addInterruptSource();
+        sourceRegistered = true;
+    }
+}
+
+void DeviceHost::submit(const Request& request) noexcept {
+    // A full ring means the host is over a thousand requests behind; yield to it rather than drop.
+    while (!requests.push(request)) {
+        wakeHost();
+        std::this_thread::yield();
+    }
+    wakeHost();
+}
+
+void DeviceHost::complete(uint8_t vector) noexcept {
+    cpu.raiseInterrupt(vector);
+}
+
+void DeviceHost::wakeHost() noexcept {
+    if (hostSleeping.exchange(false, std::memory_order_acq_rel)) {
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+        wakeup.notify_one();
+    }
+}
+
+void DeviceHost::hostLoop() noexcept {
+    while (true) {
+        if (auto request = requests.pop()) {
+            try {
+                request->device->write(request->offset, request->value, *this);
+            } catch (...) {
+                // Backend failures are reported through device status, never by unwinding the host.
+            }
+            continue;
+        }
+        if (stopping.load(std::memory_order_acquire)) {
+            if (requests.empty()) {
+                return;
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeupMutex);
+        hostSleeping.store(true, std::memory_order_seq_cst);
+        if (requests.empty() && !stopping.load(std::memory_order_acquire)) {
+            wakeup.wait_for(lock, std::chrono::milliseconds(2));
+        }
+        hostSleeping.store(false, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,95 @@
+#include <components/io_extern/disk.hpp>
+#include <components/cpu.hpp>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+DiskDevice::DiskDevice(CPU& cpuRef, std::string_view imagePath) : cpu(cpuRef) {
+    std::string path(imagePath);
+    fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open disk image: " + path);
+    }
+    struct stat info{};
+    ::fstat(fd, &info);
+    sectors = static_cast<uint32_t>(info.st_size / SectorSize);
+}
+
+DiskDevice::~DiskDevice() {
+    ::close(fd);
+}
+
+uint32_t DiskDevice::read(uint16_t offset) noexcept {
+    switch (offset) {
+        case Lba: return lba.load(std::memory_order_relaxed);
+        case Buffer: return buffer.load(std::memory_order_relaxed);
+        case Count: return count.load(std::memory_order_relaxed);
+        case Status: return status.load(std::memory_order_acquire);
+        case Vector: return vector.load(std::memory_order_relaxed);
+        case Capacity: return sectors;
+        default: return 0;
+    }
+}
+
+void DiskDevice::submitted(uint16_t offset, uint32_t) noexcept {
+    if (offset == Command) {
+        // Busy must be visible to the very next IN, before the host thread has picked up the command.
+        status.store(StatusBusy, std::memory_order_release);
+    }
+}
+
+void DiskDevice::write(uint16_t offset, uint32_t value, DeviceHost& host) {
+    switch (offset) {
+        case Lba: lba.store(value, std::memory_order_relaxed); break;
+        case Buffer: buffer.store(value, std::memory_order_relaxed); break;
+        case Count: count.store(value, std::memory_order_relaxed); break;
+        case Vector: vector.store(value & 0xFF, std::memory_order_relaxed); break;
+        case Command: {
+            bool ok = transfer(value);
+            status.store(ok ? 0 : StatusError, std::memory_order_release);
+            if (uint32_t v = vector.load(std::memory_order_relaxed)) {
+                host.complete(static_cast<uint8_t>(v));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool DiskDevice::transfer(uint32_t command) noexcept {
+    if (command == CommandFlush) {
+        return ::fdatasync(fd) == 0;
+    }
+    uint64_t first = lba.load(std::memory_order_relaxed);
+    uint64_t n = count.load(std::memory_order_relaxed);
+    if (first + n > sectors) {
+        return false;
+    }
+    size_t bytes = n * SectorSize;
+    uint8_t* data = cpu.memory.physicalSpan(buffer.load(std::memory_order_relaxed), bytes);
+    if (!data) {
+        return false;
+    }
+
+    off_t position = static_cast<off_t>(first * SectorSize);
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t r = command == CommandRead
+            ? ::pread(fd, data + done, bytes - done, position + done)
+            : command == CommandWrite
+                ? ::pwrite(fd, data + done, bytes - done, position + done)
+                : -1;
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(r);
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#include <components/io_extern/input_source.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+
+InputSource::InputSource(int fdarg) : fd(fdarg) {
+    reader = std::thread(&InputSource::readerLoop, this);
+}
+
+InputSource::~InputSource() {
+    stopping.store(true, std::memory_order_release);
+    reader.join();
+}
+
+void InputSource::readerLoop() noexcept {
+    uint8_t chunk[512];
+    while (!stopping.load(std::memory_order_acquire)) {
+        // Short poll timeout so shutdown never waits on a quiet terminal.
+        pollfd pfd{fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 50);
+        if (ready <= 0 || !(pfd.revents & (POLLIN | POLLHUP))) {
+            continue;
+        }
+
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t space = Capacity - (h - tail.load(std::memory_order_acquire));
+        if (space == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Guest is not draining input.
+            continue;
+        }
+        ssize_t n = ::read(fd, chunk, std::min<size_t>(sizeof(chunk), space));
+        if (n == 0) {
+            return; // EOF
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            buffer[(h + i) & Mask] = chunk[i];
+        }
+        head.store(h + static_cast<uint32_t>(n), std::memory_order_release);
+    }
+}
@@ -0,0 +1,125 @@
+#include <components/io_extern/output_sink.hpp>
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+OutputSink::OutputSink(std::string_view target, size_t capacity)
+    : buffer(std::make_unique<uint8_t[]>(std::bit_ceil(capacity))), mask(std::bit_ceil(capacity) - 1) {
+    if (target.empty() || target == "stdout") {
+        fd = STDOUT_FILENO;
+        ownsFd = false;
+    } else if (target == "stderr") {
+        fd = STDERR_FILENO;
+        ownsFd = false;
+    } else {
+        std::string path(target);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open output file: " + path);
+        }
+        ownsFd = true;
+    }
+    writer = std::thread(&OutputSink::writerLoop, this);
+}
+
+OutputSink::~OutputSink() {
+    stopping.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+        wakeup.notify_one();
+    }
+    writer.join();
+    if (ownsFd) {
+        ::close(fd);
+    }
+}
+
+void OutputSink::write(std::string_view bytes) noexcept {
+    while (!bytes.empty()) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail == mask + 1) {
+            waitForSpace(h);
+        }
+        size_t offset = h & mask;
+        size_t space = (mask + 1) - (h - cachedTail);
+        size_t chunk = std::min({bytes.size(), space, static_cast<size_t>(mask + 1 - offset)});
+        std::copy_n(bytes.data(), chunk, &buffer[offset]);
+        head.store(h + chunk, std::memory_order_release);
+        bytes.remove_prefix(chunk);
+    }
+    if (writerSleeping.load(std::memory_order_relaxed)) {
+        wakeWriter();
+    }
+}
+
+void OutputSink::flush() noexcept {
+    uint64_t target = head.load(std::memory_order_acquire);
+    while (tail.load(std::memory_order_acquire) < target) {
+        wakeWriter();
+        std::this_thread::yield();
+    }
+}
+
+void OutputSink::waitForSpace(uint64_t h) noexcept {
+    // Ring is full: back-pressure the guest rather than dropping its output.
+    cachedTail = tail.load(std::memory_order_acquire);
+    while (h - cachedTail == mask + 1) {
+        wakeWriter();
+        std::this_thread::yield();
+        cachedTail = tail.load(std::memory_order_acquire);
+    }
+}
+
+void OutputSink::wakeWriter() noexcept {
+    if (writerSleeping.exchange(false, std::memory_order_acq_rel)) {
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+        wakeup.notify_one();
+    }
+}
+
+void OutputSink::writerLoop() noexcept {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t h = head.load(std::memory_order_acquire);
+        if (h == t) {
+            if (stopping.load(std::memory_order_acquire)) {
+                if (head.load(std::memory_order_acquire) == t) {
+                    return;
+                }
+                continue;
+            }
+            // Park until the producer notices the flag or the timeout bounds a missed wakeup.
+            std::unique_lock<std::mutex> lock(wakeupMutex);
+            writerSleeping.store(true, std::memory_order_seq_cst);
+            if (head.load(std::memory_order_seq_cst) == t && !stopping.load(std::memory_order_acquire)) {
+                wakeup.wait_for(lock, std::chrono::milliseconds(2));
+            }
+            writerSleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        // At most two contiguous spans when the pending range wraps around the ring.
+        size_t start = t & mask;
+        size_t pending = h - t;
+        size_t first = std::min(pending, static_cast<size_t>(mask + 1 - start));
+        iovec iov[2] = {
+            {&buffer[start], first},
+            {&buffer[0], pending - first},
+        };
+        ssize_t written = ::writev(fd, iov, pending == first ? 1 : 2);
+        if (written < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            written = static_cast<ssize_t>(pending); // Target is gone; discard rather than wedge the guest.
+        }
+        t += static_cast<uint64_t>(written);
+        tail.store(t, std::memory_order_release);
+    }
+}
@@ -0,0 +1,121 @@
+#include <components/io_extern/packet.hpp>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+    sockaddr_un makeAddress(std::string_view path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Socket path too long: " + std::string(path));
+        }
+        std::memcpy(address.sun_path, path.data(), path.size());
+        return address;
+    }
+}
+
+PacketDevice::PacketDevice(CPU& cpuRef, std::string_view localPath, std::string_view peerPath)
+    : VirtqueueTransport(cpuRef, Id, 2), local(localPath), peer(makeAddress(peerPath)) {
+    sockaddr_un address = makeAddress(localPath);
+    fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create packet socket");
+    }
+    ::unlink(local.c_str());
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to bind packet socket: " + local);
+    }
+}
+
+PacketDevice::~PacketDevice() {
+    ::close(fd);
+    ::unlink(local.c_str());
+}
+
+void PacketDevice::onNotify(uint16_t queue) {
+    if (queue == TxQueue) {
+        transmit();
+    } else if (queue == RxQueue) {
+        receive();
+    }
+}
+
+void PacketDevice::onPoll() {
+    receive();
+}
+
+void PacketDevice::transmit() {
+    std::array<mmsghdr, Batch> messages{};
+    size_t count;
+    do {
+        count = 0;
+        while (count < Batch && nextChain(TxQueue, chains[count])) {
+            Chain& chain = chains[count];
+            msghdr& header = messages[count].msg_hdr;
+            header = msghdr{};
+            header.msg_name = &peer;
+            header.msg_namelen = sizeof(peer);
+            header.msg_iov = chain.segments.data();
+            header.msg_iovlen = chain.writableOffset; // Only the driver-readable part is the frame
+            ++count;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        // A missing or congested peer drops frames, like a cable with nobody on the other end.
+        size_t sent = 0;
+        while (sent < count) {
+            int n = ::sendmmsg(fd, &messages[sent], static_cast<unsigned>(count - sent), 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            pushUsed(TxQueue, chains[i].head, 0);
+        }
+        signalUsed(TxQueue);
+    } while (count == Batch);
+}
+
+void PacketDevice::receive() {
+    if (!hasAvailable(RxQueue)) {
+        return;
+    }
+    std::array<mmsghdr, Batch> messages{};
+    while (true) {
+        size_t count = 0;
+        while (count < Batch && nextChain(RxQueue, chains[count])) {
+            Chain& chain = chains[count];
+            msghdr& header = messages[count].msg_hdr;
+            header = msghdr{};
+            header.msg_iov = chain.segments.data() + chain.writableOffset;
+            header.msg_iovlen = chain.segments.size() - chain.writableOffset;
+            ++count;
+        }
+        if (count == 0) {
+            return;
+        }
+
+        int received = ::recvmmsg(fd, messages.data(), static_cast<unsigned>(count), MSG_DONTWAIT, nullptr);
+        size_t done = received > 0 ? static_cast<size_t>(received) : 0;
+        for (size_t i = 0; i < done; ++i) {
+            pushUsed(RxQueue, chains[i].head, messages[i].msg_len);
+        }
+        if (done > 0) {
+            signalUsed(RxQueue);
+        }
+        if (done < count) {
+            // Hand the unfilled buffers back to the avail side so they are picked up next poll.
+            rewindAvail(RxQueue, static_cast<uint16_t>(count - done));
+            return;
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#include <components/io_extern/serial.hpp>
+
+void SerialPort::attach(IO& io, uint16_t base) {
+    io.mapDevice(base + DataRegister,
+        [this]() { return readData(); },
+        [this](uint32_t value) { output.put(static_cast<uint8_t>(value)); });
+    io.mapDevice(base + LineStatusRegister,
+        [this]() { return readLineStatus(); },
+        [](uint32_t) {});
+}
+
+uint32_t SerialPort::readData() noexcept {
+    uint8_t byte = 0;
+    if (input && input->tryPop(byte)) {
+        return byte;
+    }
+    return 0;
+}
+
+uint32_t SerialPort::readLineStatus() const noexcept {
+    // Transmit never stalls from the guest's point of view; the sink absorbs the bursts.
+    uint32_t status = LsrTransmitterEmpty | LsrIdle;
+    if (input && input->available()) {
+        status |= LsrDataReady;
+    }
+    return status;
+}
@@ -0,0 +1,204 @@
+#include <components/io_extern/virtqueue.hpp>
+#include <components/cpu.hpp>
+#include <cstring>
+
+VirtqueueTransport::VirtqueueTransport(CPU& cpuRef, uint32_t id, uint16_t queueCount)
+    : cpu(cpuRef), deviceId(id), queues(queueCount) {}
+
+void VirtqueueTransport::attach(IO& io, uint16_t base) {
+    for (uint16_t reg = 0; reg < RegisterCount; ++reg) {
+        io.mapDevice(base + reg,
+            [this, reg]() { return readRegister(reg); },
+            [this, reg](uint32_t value) { writeRegister(reg, value); });
+    }
+    io.addPoller([this]() {
+        if (!(status & StatusNeedsReset)) {
+            onPoll();
+        }
+        deliverInterrupt();
+    });
+}
+
+uint32_t VirtqueueTransport::readRegister(uint16_t reg) noexcept {
+    if (reg >= QueueSize && reg <= QueueReady && selected >= queues.size()) {
+        return 0;
+    }
+    switch (reg) {
+        case DeviceId: return deviceId;
+        case QueueSelect: return selected;
+        case QueueSize: return queues[selected].size ? queues[selected].size : MaxQueueSize;
+        case QueueDesc: return queues[selected].desc;
+        case QueueAvail: return queues[selected].avail;
+        case QueueUsed: return queues[selected].used;
+        case QueueReady: return queues[selected].ready;
+        case InterruptStatus: {
+            // Reading acknowledges the interrupt and re-arms delivery for the next batch.
+            uint32_t value = interruptPending;
+            interruptPending = false;
+            interruptRaised = false;
+            return value;
+        }
+        case InterruptVector: return vector;
+        case Status: return status;
+        default: return 0;
+    }
+}
+
+void VirtqueueTransport::writeRegister(uint16_t reg, uint32_t value) {
+    if (reg >= QueueSize && reg <= QueueReady && selected >= queues.size()) {
+        return;
+    }
+    switch (reg) {
+        case QueueSelect:
+            selected = static_cast<uint16_t>(value);
+            break;
+        case QueueSize:
+            // Ring indices wrap at 2^16, so only power-of-two sizes keep slots consistent.
+            if (value != 0 && value <= MaxQueueSize && (value & (value - 1)) == 0) {
+                queues[selected].size = static_cast<uint16_t>(value);
+            }
+            break;
+        case QueueDesc: queues[selected].desc = value; break;
+        case QueueAvail: queues[selected].avail = value; break;
+        case QueueUsed: queues[selected].used = value; break;
+        case QueueReady: {
+            Queue& q = queues[selected];
+            q.ready = false;
+            // The rings are accessed in place as typed arrays, so they need their virtio alignment.
+            if (value && q.size && q.desc % 16 == 0 && q.avail % 2 == 0 && q.used % 4 == 0 &&
+                cpu.memory.physicalSpan(q.desc, q.size * sizeof(VirtqDesc)) &&
+                cpu.memory.physicalSpan(q.avail, 4 + q.size * sizeof(uint16_t)) &&
+                cpu.memory.physicalSpan(q.used, 4 + q.size * 2 * sizeof(uint32_t))) {
+                q.ready = true;
+                q.lastAvail = 0;
+                q.usedIdx = 0;
+            }
+            break;
+        }
+        case QueueNotify:
+            if (value < queues.size() && !(status & StatusNeedsReset)) {
+                onNotify(static_cast<uint16_t>(value));
+                deliverInterrupt();
+            }
+            break;
+        case InterruptVector:
+            vector = value & 0xFF;
+            break;
+        case Status:
+            if (value == 0) {
+                reset();
+            } else {
+                status = value & ~StatusNeedsReset;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void VirtqueueTransport::reset() noexcept {
+    for (auto& q : queues) {
+        q = Queue{};
+    }
+    selected = 0;
+    status = 0;
+    interruptPending = false;
+    interruptWanted = false;
+    interruptRaised = false;
+    onReset();
+}
+
+uint16_t* VirtqueueTransport::ringIndex(uint32_t ring) const noexcept {
+    // idx lives right after the 16-bit flags word in both the avail and used rings.
+    return reinterpret_cast<uint16_t*>(cpu.memory.physicalSpan(ring, 4) + sizeof(uint16_t));
+}
+
+bool VirtqueueTransport::hasAvailable(uint16_t queue) const {
+    const Queue& q = queues[queue];
+    return q.ready && q.lastAvail != *ringIndex(q.avail);
+}
+
+bool VirtqueueTransport::nextChain(uint16_t queue, Chain& chain) {
+    Queue& q = queues[queue];
+    if (!q.ready || (status & StatusNeedsReset)) {
+        return false;
+    }
+    uint16_t availIdx = __atomic_load_n(ringIndex(q.avail), __ATOMIC_ACQUIRE);
+    if (q.lastAvail == availIdx) {
+        return false;
+    }
+
+    uint16_t head;
+    std::memcpy(&head, cpu.memory.physicalSpan(q.avail + 4 + (q.lastAvail & (q.size - 1)) * sizeof(uint16_t), 2), sizeof(head));
+    ++q.lastAvail;
+
+    chain.head = head;
+    chain.segments.clear();
+    chain.writableOffset = 0;
+    chain.writableBytes = 0;
+
+    const auto* table = reinterpret_cast<const VirtqDesc*>(cpu.memory.physicalSpan(q.desc, q.size * sizeof(VirtqDesc)));
+    uint16_t index = head;
+    for (uint16_t hops = 0; ; ++hops) {
+        if (index >= q.size || hops >= q.size) {
+            status |= StatusNeedsReset; // Out-of-range index or a descriptor loop
+            return false;
+        }
+        VirtqDesc desc;
+        std::memcpy(&desc, &table[index], sizeof(desc));
+        uint8_t* data = desc.addr <= UINT32_MAX ? cpu.memory.physicalSpan(static_cast<uint32_t>(desc.addr), desc.len) : nullptr;
+        if (!data) {
+            status |= StatusNeedsReset;
+            return false;
+        }
+        if (desc.flags & VirtqDescWrite) {
+            chain.writableBytes += desc.len;
+        } else {
+            if (chain.writableBytes != 0) {
+                status |= StatusNeedsReset; // Readable segment after a writable one
+                return false;
+            }
+            chain.writableOffset = chain.segments.size() + 1;
+        }
+        chain.segments.push_back({data, desc.len});
+        if (!(desc.flags & VirtqDescNext)) {
+            break;
+        }
+        index = desc.next;
+    }
+    return true;
+}
+
+void VirtqueueTransport::rewindAvail(uint16_t queue, uint16_t count) noexcept {
+    queues[queue].lastAvail -= count;
+}
+
+void VirtqueueTransport::pushUsed(uint16_t queue, uint16_t head, uint32_t written) {
+    Queue& q = queues[queue];
+    uint32_t element[2] = {head, written};
+    std::memcpy(cpu.memory.physicalSpan(q.used + 4 + (q.usedIdx & (q.size - 1)) * sizeof(element), sizeof(element)),
+                element, sizeof(element));
+    ++q.usedIdx;
+    __atomic_store_n(ringIndex(q.used), q.usedIdx, __ATOMIC_RELEASE);
+}
+
+void VirtqueueTransport::signalUsed(uint16_t queue) {
+    const Queue& q = queues[queue];
+    interruptPending = true;
+    uint16_t availFlags;
+    std::memcpy(&availFlags, cpu.memory.physicalSpan(q.avail, 2), sizeof(availFlags));
+    if (!(availFlags & VirtqAvailNoInterrupt)) {
+        interruptWanted = true;
+    }
+}
+
+void VirtqueueTransport::deliverInterrupt() noexcept {
+    // One interrupt per acknowledged batch. It is only made pending, so a notify never takes it in
+    // the middle of the OUT, and the CPU delivers it once FR.I is set, masking FR.I on entry.
+    if (!interruptWanted || interruptRaised || vector == 0) {
+        return;
+    }
+    interruptWanted = false;
+    interruptRaised = true;
+    cpu.raiseInterrupt(static_cast<uint8_t>(vector));
+}
@@ -2,243 +2,272 @@
 #include <components/cpu.hpp>
 #include <components/memory.hpp>
 #include <components/io.hpp>
-#include <stdexcept>
-#include <variant>
+#include <components/packed.hpp>
+#include <atomic>
 #include <cstring>
 
-std::variant<RTypeInstruction, ITypeInstruction, JTypeInstruction>
-InstructionSet::decodeInstruction(uint64_t instruction) {
-    uint64_t opcode = instruction >> 58; // Extract the opcode (6 bits: 63–58)
-
-    if (opcode == 0x01 || opcode == 0x02 || opcode == 0x03 || opcode == 0x04 || opcode == 0x05 ||
-        opcode == 0x06 || opcode == 0x07 || opcode == 0x17 || opcode == 0x18 || opcode == 0x19) {
-        // R-Type instruction
-        RTypeInstruction rInstr{
-            .reserved = 0,
-            .func = static_cast<uint8_t>((instruction >> 29) & 0xFF),    // func: bits 36–29
-            .shamt = static_cast<uint8_t>((instruction >> 37) & 0x3F),   // shamt: bits 42–37
-            .rs2 = static_cast<uint8_t>((instruction >> 43) & 0x1F),     // rs2: bits 47–43
-            .rs1 = static_cast<uint8_t>((instruction >> 48) & 0x1F),     // rs1: bits 52–48
-            .rd = static_cast<uint8_t>((instruction >> 53) & 0x1F),      // rd: bits 57–53
-            .opcode = static_cast<uint8_t>(opcode),
-        };
-        return rInstr;
-    } else if (opcode == 0x08 || opcode == 0x09 || opcode == 0x0C || opcode == 0x0D || opcode == 0x0E || 
-               opcode == 0x0F || opcode == 0x10 || opcode == 0x11 || opcode == 0x20 || opcode == 0x21 || 
-               opcode == 0x22 || opcode == 0x23 || opcode == 0x24) {
-        // I-Type instruction
-        ITypeInstruction iInstr{
-            .reserved = 0,
-            .immediate = static_cast<uint64_t>((instruction >> 16) & 0xFFFFFFFF), // immediate: bits 47–16
-            .rs1 = static_cast<uint8_t>((instruction >> 48) & 0x1F),     // rs1: bits 52–48
-            .rd = static_cast<uint8_t>((instruction >> 53) & 0x1F),      // rd: bits 57–53
-            .opcode = static_cast<uint8_t>(opcode),
-        };
-        return iInstr;
-    } else if (opcode == 0x0A || opcode == 0x0B || opcode == 0x12 || opcode == 0x13 || opcode == 0x14 || 
-               opcode == 0x15 || opcode == 0x16) {
-        // J-Type instruction
-        JTypeInstruction jInstr{
-            .reserved = 0,
-            .address = static_cast<uint32_t>((instruction >> 26) & 0xFFFFFFFF), // address: bits 57–26
-            .opcode = static_cast<uint8_t>(opcode),
-        };
-        return jInstr;
-    } else {
-        // Invalid instruction
-        throw std::runtime_error("Invalid instruction opcode");
+DecodedInstruction InstructionSet::decodeInstruction(uint64_t instruction) noexcept {
+    const auto opcode = static_cast<uint8_t>(instruction >> 58); // opcode: bits 63–58
+    const OpcodeInfo& info = Opcodes[opcode];
+    DecodedInstruction decoded{
+        .handler = info.handler,
+        .flags = info.flags,
+        .opcode = opcode,
+        .rd = static_cast<uint8_t>((instruction >> 53) & 0x1F),     // rd: bits 57–53
+        .rs1 = static_cast<uint8_t>((instruction >> 48) & 0x1F),    // rs1: bits 52–48
+        .rs2 = static_cast<uint8_t>((instruction >> 43) & 0x1F),    // rs2: bits 47–43
+        .shamt = static_cast<uint8_t>((instruction >> 37) & 0x3F),  // shamt: bits 42–37
+        .func = static_cast<uint8_t>((instruction >> 29) & 0xFF),   // func: bits 36–29
+        .absolute = (instruction & AbsoluteAddressBit) != 0,        // absolute: bit 15
+        .immediate = static_cast<uint32_t>(instruction >> 16),      // immediate: bits 47–16
+        .address = static_cast<uint32_t>(instruction >> 26),        // address: bits 57–26
+    };
+    if (opcode == PackedAlu::Opcode && !PackedAlu::defined(decoded.func)) {
+        decoded.handler = &InstructionSet::invalid;
+        decoded.flags = FlagEffect::None;
     }
+    return decoded;
 }
 
-void InstructionSet::execute(const std::variant<RTypeInstruction, ITypeInstruction, JTypeInstruction>& instruction) {
-    std::visit([this](auto&& instr) {
-        using T = std::decay_t<decltype(instr)>;
-        if constexpr (std::is_same_v<T, RTypeInstruction>) {
-            this->executeRType(instr);
-        } else if constexpr (std::is_same_v<T, ITypeInstruction>) {
-            this->executeIType(instr);
-        } else if constexpr (std::is_same_v<T, JTypeInstruction>) {
-            this->executeJType(instr);
-        }
-    }, instruction);
-}
-
-void InstructionSet::executeRType(const RTypeInstruction& instr) {
-    switch (instr.opcode) {
-        case 0x01: // ADD
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] + cpu.registers.R[instr.rs2];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x02: // SUB
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] - cpu.registers.R[instr.rs2];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x03: // AND
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] & cpu.registers.R[instr.rs2];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x04: // OR
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] | cpu.registers.R[instr.rs2];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x05: // XOR
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] ^ cpu.registers.R[instr.rs2];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x06: // LSL
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] << instr.shamt;
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x07: // LSR
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] >> instr.shamt;
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x17: // MUL
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] * cpu.registers.R[instr.rs2];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x18: // DIV
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] / cpu.registers.R[instr.rs2];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x19: // MOD
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] % cpu.registers.R[instr.rs2];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x1A: // NOT
-            cpu.registers.R[instr.rd] = ~cpu.registers.R[instr.rs1];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x1B: // NEG
-            cpu.registers.R[instr.rd] = -cpu.registers.R[instr.rs1];
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x1C: // INC
-            cpu.registers.R[instr.rd] += 1;
-            setFlags(cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x1D: // DEC
-            cpu.registers.R[instr.rd] -= 1;
-            setFlags(cpu.registers.R[instr.rd], false, false);
+void InstructionSet::execute(const DecodedInstruction& instruction) {
+    const uint32_t next = cpu.registers.I0;
+    (this->*instruction.handler)(instruction);
+    if (cpu.registers.I0 != next) [[unlikely]] {
+        return; // Faulted: only an exception moves I0 in an instruction with a flag effect
+    }
+    switch (instruction.flags) {
+        case FlagEffect::None:
             break;
-        case 0x1E: // ASL (Arithmetic shift left)
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] << instr.shamt;
-            setFlags(cpu.registers.R[instr.rd], false, false);
+        case FlagEffect::Result:
+            setFlags(cpu.registers.R[instruction.rd], false, false);
             break;
-        case 0x1F: // ASR (Arithmetic shift right)
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] >> instr.shamt;
-            setFlags(cpu.registers.R[instr.rd], false, false);
+        case FlagEffect::Compare:
+            setFlags(cpu.registers.R[instruction.rs1] - cpu.registers.R[instruction.rd], false, false);
             break;
+    }
+}
 
-        default:
-            cpu.interrupts.triggerInterrupt(0x1);
-            break;
+void InstructionSet::packed(const DecodedInstruction& instr) { // Packed-integer operation selected by func
+    cpu.registers.R[instr.rd] = PackedAlu::execute(instr.func, cpu.registers.R[instr.rs1], cpu.registers.R[instr.rs2]);
+}
+
+void InstructionSet::add(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] + cpu.registers.R[instr.rs2];
+}
+
+void InstructionSet::subtract(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] - cpu.registers.R[instr.rs2];
+}
+
+void InstructionSet::bitwiseAnd(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] & cpu.registers.R[instr.rs2];
+}
+
+void InstructionSet::bitwiseOr(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] | cpu.registers.R[instr.rs2];
+}
+
+void InstructionSet::bitwiseXor(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] ^ cpu.registers.R[instr.rs2];
+}
+
+void InstructionSet::shiftLeft(const DecodedInstruction& instr) { // LSL, ASL
+    cpu.registers.R[instr.rd] = Shifter::left(cpu.registers.R[instr.rs1], instr.shamt);
+}
+
+void InstructionSet::shiftRightLogical(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = Shifter::rightLogical(cpu.registers.R[instr.rs1], instr.shamt);
+}
+
+void InstructionSet::shiftRightArithmetic(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = Shifter::rightArithmetic(cpu.registers.R[instr.rs1], instr.shamt);
+}
+
+void InstructionSet::load(const DecodedInstruction& instr) {
+    const uint32_t base = instr.absolute ? 0 : cpu.registers.R[instr.rs1];
+    cpu.registers.R[instr.rd] = cpu.memory.read(base + instr.immediate);
+}
+
+void InstructionSet::store(const DecodedInstruction& instr) {
+    const uint32_t base = instr.absolute ? 0 : cpu.registers.R[instr.rs1];
+    cpu.memory.write(base + instr.immediate, cpu.registers.R[instr.rd]);
+}
+
+void InstructionSet::jump(const DecodedInstruction& instr) {
+    cpu.registers.I0 = instr.address;
+    countBranch();
+}
+
+void InstructionSet::jumpAndLink(const DecodedInstruction& instr) {
+    cpu.registers.R[31] = cpu.registers.I0; // Store return address in R31
+    cpu.registers.I0 = instr.address;
+    countBranch();
+}
+
+void InstructionSet::branchIfEqual(const DecodedInstruction& instr) {
+    if (cpu.registers.R[instr.rs1] == cpu.registers.R[instr.rd]) {
+        cpu.registers.I0 += instr.immediate;
+        countBranch();
     }
 }
 
-void InstructionSet::executeIType(const ITypeInstruction& instr) {
-    switch (instr.opcode) {
-        case 0x08: // LDR
-            if (instr.rs1 == 0x2D) {
-                cpu.registers.R[instr.rd] = cpu.memory.read(instr.immediate);
-            } else {
-                cpu.registers.R[instr.rd] = cpu.memory.read(cpu.registers.R[instr.rs1] + instr.immediate);
-            }
-            break;
-        case 0x09: // STR
-            if (instr.rs1 == 0x2D) {
-                cpu.memory.write(instr.immediate, cpu.registers.R[instr.rd]);
-            } else {
-                cpu.memory.write(cpu.registers.R[instr.rs1] + instr.immediate, cpu.registers.R[instr.rd]);
-            }
-            break;
-        case 0x0C: // BEQ
-            if (cpu.registers.R[instr.rs1] == cpu.registers.R[instr.rd]) {
-                cpu.registers.I0 += instr.immediate;
-            }
-            break;
-        case 0x0D: // BNE
-            if (cpu.registers.R[instr.rs1] != cpu.registers.R[instr.rd]) {
-                cpu.registers.I0 += instr.immediate;
-            }
-            break;
-        case 0x0E: // MOV
-            cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1];
-            break;
-        case 0x0F: // CMP
-            setFlags(cpu.registers.R[instr.rs1] - cpu.registers.R[instr.rd], false, false);
-            break;
-        case 0x10: // PUSH
-            cpu.registers.S0 -= 4;
-            cpu.memory.write(cpu.registers.S0, cpu.registers.R[instr.rd]);
-            break;
-        case 0x11: // POP
-            cpu.registers.R[instr.rd] = cpu.memory.read(cpu.registers.S0);
-            cpu.registers.S0 += 4;
-            break;
-        case 0x20: // SWI
-            cpu.interrupts.triggerInterrupt(instr.immediate & 0xFF);
-            break;
-        case 0x21: // SEXT
-            cpu.registers.R[instr.rd] = static_cast<int32_t>(cpu.registers.R[instr.rs1]); // Sign extend to 32-bit
-            break;
-        case 0x22: // ZEXT
-            cpu.registers.R[instr.rd] = static_cast<uint32_t>(cpu.registers.R[instr.rs1]); // Zero extend to 32-bit
-            break;
-        case 0x23: // MFS
-            if (instr.rs1 < cpu.registers.R.size()) {
-                cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1];
-            }
-            break;
-        case 0x24: // MTS
-            if (instr.rd < cpu.registers.R.size()) {
-                cpu.registers.R[instr.rs1] = cpu.registers.R[instr.rd];
-            }
-            break;
-        case 0x25: // OUT
-            cpu.io.writePort(instr.rd, cpu.registers.R[instr.rs1]);
-            break;
-        case 0x26: // IN
-            cpu.registers.R[instr.rs1] = cpu.io.readPort(instr.rd);
-            break;
+void InstructionSet::branchIfNotEqual(const DecodedInstruction& instr) {
+    if (cpu.registers.R[instr.rs1] != cpu.registers.R[instr.rd]) {
+        cpu.registers.I0 += instr.immediate;
+        countBranch();
+    }
+}
 
-        default:
-            cpu.interrupts.triggerInterrupt(0x1);
-            break;
+void InstructionSet::move(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1];
+}
+
+void InstructionSet::push(const DecodedInstruction& instr) {
+    cpu.registers.S0 -= 4;
+    cpu.memory.write(cpu.registers.S0, cpu.registers.R[instr.rd]);
+}
+
+void InstructionSet::pop(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = cpu.memory.read(cpu.registers.S0);
+    cpu.registers.S0 += 4;
+}
+
+void InstructionSet::call(const DecodedInstruction& instr) {
+    cpu.registers.S0 -= 4;
+    cpu.memory.write(cpu.registers.S0, cpu.registers.I0); // Push return address onto the stack
+    cpu.registers.I0 = instr.address;
+    countBranch();
+}
+
+void InstructionSet::returnFromCall(const DecodedInstruction&) {
+    cpu.registers.I0 = cpu.memory.read(cpu.registers.S0); // Pop return address from the stack
+    cpu.registers.S0 += 4;
+    countBranch();
+}
+
+void InstructionSet::returnFromInterrupt(const DecodedInstruction&) {
+    cpu.interrupts.triggerIret();
+    countBranch();
+}
+
+void InstructionSet::nop(const DecodedInstruction&) {
+    // No operation; CMP has only its flag effect
+}
+
+void InstructionSet::halt(const DecodedInstruction&) {
+    cpu.halt();
+}
+
+void InstructionSet::multiply(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] * cpu.registers.R[instr.rs2];
+}
+
+void InstructionSet::divide(const DecodedInstruction& instr) {
+    if (cpu.registers.R[instr.rs2] == 0) [[unlikely]] {
+        cpu.interrupts.triggerInterrupt(DivideByZero);
+        return;
     }
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] / cpu.registers.R[instr.rs2];
 }
 
-void InstructionSet::executeJType(const JTypeInstruction& instr) {
-    switch (instr.opcode) {
-        case 0x0A: // JMP
-            cpu.registers.I0 = instr.address;
-            break;
-        case 0x0B: // JAL
-            cpu.registers.R[31] = cpu.registers.I0; // Store return address in R31
-            cpu.registers.I0 = instr.address;
-            break;
-        case 0x12: // CALL
-            cpu.registers.S0 -= 4;
-            cpu.memory.write(cpu.registers.S0, cpu.registers.I0); // Push return address onto the stack
-            cpu.registers.I0 = instr.address;
-            break;
-        case 0x13: // RET
-            cpu.registers.I0 = cpu.memory.read(cpu.registers.S0); // Pop return address from the stack
-            cpu.registers.S0 += 4;
-            break;
-        case 0x14: // IRET
-            cpu.interrupts.triggerIret();
-            break;
-        case 0x15: // NOP
-            // No operation
-            break;
-        case 0x16: // HLT
-            //TODO Halt? Right now we only got one core so maybe wait for interrupt?
-            throw std::runtime_error("CPU Halted");
-            break;
-        default:
-            cpu.interrupts.triggerInterrupt(0x1); // invalid opcode
-            break;
+void InstructionSet::modulo(const DecodedInstruction& instr) {
+    if (cpu.registers.R[instr.rs2] == 0) [[unlikely]] {
+        cpu.interrupts.triggerInterrupt(DivideByZero);
+        return;
+    }
+    cpu.registers.R[instr.rd] = cpu.registers.R[instr.rs1] % cpu.registers.R[instr.rs2];
+}
+
+void InstructionSet::bitwiseNot(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = ~cpu.registers.R[instr.rs1];
+}
+
+void InstructionSet::negate(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = -cpu.registers.R[instr.rs1];
+}
+
+void InstructionSet::increment(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] += 1;
+}
+
+void InstructionSet::decrement(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] -= 1;
+}
+
+void InstructionSet::softwareInterrupt(const DecodedInstruction& instr) {
+    cpu.interrupts.triggerInterrupt(instr.immediate & 0xFF);
+}
+
+void InstructionSet::signExtend(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = static_cast<int32_t>(cpu.registers.R[instr.rs1]); // Sign extend to 32-bit
+}
+
+void InstructionSet::zeroExtend(const DecodedInstruction& instr) {
+    cpu.registers.R[instr.rd] = static_cast<uint32_t>(cpu.registers.R[instr.rs1]); // Zero extend to 32-bit
+}
+
+void InstructionSet::moveFromSpecial(const DecodedInstruction& instr) { // Special register index is encoded without its 0x20 base
+    cpu.registers.R[instr.rd] = cpu.readSpecialRegister(0x20 | instr.rs1);
+}
+
+void InstructionSet::moveToSpecial(const DecodedInstruction& instr) {
+    cpu.writeSpecialRegister(0x20 | instr.rs1, cpu.registers.R[instr.rd]);
+}
+
+void InstructionSet::portOut(const DecodedInstruction& instr) {
+    const auto port = static_cast<uint16_t>(cpu.registers.R[instr.rd]);
+    cpu.io.writePort(port, cpu.registers.R[instr.rs1]);
+    if (cpu.timeline()) [[unlikely]] {
+        cpu.timeline()->record(EventTimeline::Event::PortOut, cpu.retired(), port, cpu.registers.R[instr.rs1]);
+    }
+}
+
+void InstructionSet::portIn(const DecodedInstruction& instr) {
+    const auto port = static_cast<uint16_t>(cpu.registers.R[instr.rd]);
+    cpu.registers.R[instr.rs1] = cpu.io.readPort(port);
+    if (cpu.timeline()) [[unlikely]] {
+        cpu.timeline()->record(EventTimeline::Event::PortIn, cpu.retired(), port, cpu.registers.R[instr.rs1]);
+    }
+}
+
+void InstructionSet::compareAndSwap(const DecodedInstruction& instr) {
+    if (uint32_t* word = cpu.memory.atomicWord(cpu.registers.R[instr.rs1], AccessType::Write)) {
+        uint32_t expected = cpu.registers.R[instr.rd];
+        std::atomic_ref<uint32_t>(*word).compare_exchange_strong(expected, cpu.registers.R[instr.rs2]);
+        cpu.registers.R[instr.rd] = expected; // The previous value, equal to the old rd on success
+    }
+}
+
+void InstructionSet::loadLinked(const DecodedInstruction& instr) {
+    if (uint32_t* word = cpu.memory.atomicWord(cpu.registers.R[instr.rs1], AccessType::Read)) {
+        uint32_t value = std::atomic_ref<uint32_t>(*word).load();
+        cpu.reservation = {word, value};
+        cpu.registers.R[instr.rd] = value;
+    }
+}
+
+void InstructionSet::storeConditional(const DecodedInstruction& instr) {
+    if (uint32_t* word = cpu.memory.atomicWord(cpu.registers.R[instr.rs1], AccessType::Write)) {
+        // Succeeds if the word still holds the value LL observed (no ABA detection).
+        uint32_t expected = cpu.reservation.value;
+        bool stored = cpu.reservation.word == word &&
+            std::atomic_ref<uint32_t>(*word).compare_exchange_strong(expected, cpu.registers.R[instr.rs2]);
+        cpu.reservation.word = nullptr;
+        cpu.registers.R[instr.rd] = stored ? 0 : 1;
+    }
+}
+
+void InstructionSet::fence(const DecodedInstruction&) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void InstructionSet::invalid(const DecodedInstruction&) {
+    cpu.interrupts.triggerInterrupt(0x1); // Invalid opcode
+}
+
+void InstructionSet::countBranch() noexcept {
+    if (cpu.pmu.active()) {
+        cpu.pmu.branch();
     }
 }
 
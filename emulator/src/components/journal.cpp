@@ -0,0 +1,265 @@
+#include <components/journal.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char Magic[8] = {'X', 'R', '3', '2', 'J', 'R', 'N', 'L'};
+    constexpr uint32_t Version = 1;
+
+    bool writeAll(int fd, const uint8_t* data, size_t size) noexcept {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    int64_t unzigzag(uint64_t value) noexcept {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    uint64_t zigzag(int64_t value) noexcept {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+}
+
+ExecutionJournal::ExecutionJournal(const std::string& path, Mode journalMode) : mode(journalMode) {
+    if (mode == Mode::Record) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to create journal: " + path);
+        }
+        uint8_t header[sizeof(Magic) + sizeof(Version)];
+        std::memcpy(header, Magic, sizeof(Magic));
+        std::memcpy(header + sizeof(Magic), &Version, sizeof(Version));
+        if (!writeAll(fd, header, sizeof(header)) || deflateInit(&zlib, Z_BEST_SPEED) != Z_OK) {
+            ::close(fd);
+            throw std::runtime_error("Failed to write journal: " + path);
+        }
+        chunk.reserve(ChunkSize);
+        writer = std::thread(&ExecutionJournal::writerLoop, this);
+        return;
+    }
+
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open journal: " + path);
+    }
+    uint8_t header[sizeof(Magic) + sizeof(Version)];
+    uint32_t version = 0;
+    if (::read(fd, header, sizeof(header)) != static_cast<ssize_t>(sizeof(header)) ||
+        std::memcmp(header, Magic, sizeof(Magic)) != 0 ||
+        (std::memcpy(&version, header + sizeof(Magic), sizeof(version)), version != Version) ||
+        inflateInit(&zlib) != Z_OK) {
+        ::close(fd);
+        throw std::runtime_error("Not a journal of this emulator version: " + path);
+    }
+    compressed.resize(ChunkSize);
+}
+
+ExecutionJournal::~ExecutionJournal() {
+    if (mode == Mode::Record) {
+        if (!chunk.empty()) {
+            handOff();
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queued.notify_one();
+        writer.join();
+        deflateEnd(&zlib);
+    } else {
+        inflateEnd(&zlib);
+    }
+    ::close(fd);
+}
+
+void ExecutionJournal::handOff() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    // Back-pressure the guest rather than buffering without bound if compression falls behind.
+    queued.wait(lock, [this]() { return queue.size() < MaxQueuedChunks; });
+    queue.push_back(std::move(chunk));
+    lock.unlock();
+    queued.notify_all();
+    chunk = std::vector<uint8_t>();
+    chunk.reserve(ChunkSize);
+}
+
+void ExecutionJournal::writerLoop() noexcept {
+    std::vector<uint8_t> output(ChunkSize + ChunkSize / 8 + 64);
+    while (true) {
+        std::vector<uint8_t> events;
+        bool last;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queued.wait(lock, [this]() { return stopping || !queue.empty(); });
+            last = stopping && queue.size() <= 1;
+            if (!queue.empty()) {
+                events = std::move(queue.front());
+                queue.pop_front();
+            }
+        }
+        queued.notify_all();
+
+        // A sync flush per chunk keeps everything handed off so far decodable.
+        zlib.next_in = events.data();
+        zlib.avail_in = static_cast<uInt>(events.size());
+        int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+        do {
+            zlib.next_out = output.data();
+            zlib.avail_out = static_cast<uInt>(output.size());
+            deflate(&zlib, flush);
+            writeAll(fd, output.data(), output.size() - zlib.avail_out);
+        } while (zlib.avail_out == 0);
+        if (last) {
+            return;
+        }
+    }
+}
+
+void ExecutionJournal::recordInterrupt(uint64_t retired, uint8_t vector) {
+    put(Interrupt);
+    putVarint(retired - lastInterrupt);
+    put(vector);
+    lastInterrupt = retired;
+}
+
+void ExecutionJournal::recordRead(int32_t result, const std::vector<uint8_t>& bytes) {
+    put(Read);
+    putVarint(zigzag(result));
+    for (uint8_t byte : bytes) {
+        put(byte);
+    }
+}
+
+bool ExecutionJournal::fill() {
+    if (endOfLog) {
+        return false;
+    }
+    window.erase(window.begin(), window.begin() + static_cast<ptrdiff_t>(position));
+    position = 0;
+    size_t before = window.size();
+    while (window.size() == before && !endOfLog) {
+        if (zlib.avail_in == 0) {
+            ssize_t n = ::read(fd, compressed.data(), compressed.size());
+            if (n <= 0) {
+                endOfLog = true; // Truncated log: everything up to the last sync flush is usable
+                break;
+            }
+            zlib.next_in = compressed.data();
+            zlib.avail_in = static_cast<uInt>(n);
+        }
+        window.resize(before + ChunkSize);
+        zlib.next_out = window.data() + before;
+        zlib.avail_out = ChunkSize;
+        int status = inflate(&zlib, Z_NO_FLUSH);
+        window.resize(before + ChunkSize - zlib.avail_out);
+        if (status == Z_STREAM_END) {
+            endOfLog = true;
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            throw std::runtime_error("Corrupt journal");
+        }
+    }
+    return window.size() > before;
+}
+
+void ExecutionJournal::buffer(size_t bytes) {
+    while (window.size() - position < bytes && fill()) {
+    }
+}
+
+int ExecutionJournal::peek() {
+    if (position == window.size() && !fill()) {
+        return -1;
+    }
+    return window[position];
+}
+
+uint8_t ExecutionJournal::get() {
+    if (peek() < 0) {
+        throw ReplayDivergence("the log ended after " + std::to_string(consumed) + " events");
+    }
+    return window[position++];
+}
+
+uint64_t ExecutionJournal::getVarint() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = get();
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+void ExecutionJournal::expect(Tag tag, const char* what) {
+    int next = peek();
+    if (next != tag) {
+        static constexpr const char* names[] = {"an unknown event", "a port read", "an interrupt", "a clock read", "a read"};
+        const char* logged = next < 0 ? "the end of the log" : names[next <= Read ? next : 0];
+        throw ReplayDivergence("event " + std::to_string(consumed) + " is " + logged + ", but the guest asked for " + what);
+    }
+    ++position;
+    ++consumed;
+}
+
+uint32_t ExecutionJournal::replayPortRead(uint16_t port) {
+    expect(PortRead, "a port read");
+    uint64_t logged = getVarint();
+    if (logged != port) {
+        throw ReplayDivergence("event " + std::to_string(consumed - 1) + " reads port " + std::to_string(logged) +
+                               ", but the guest read port " + std::to_string(port));
+    }
+    return static_cast<uint32_t>(getVarint());
+}
+
+bool ExecutionJournal::interruptDue(uint64_t retired, uint8_t& vector) {
+    if (peek() != Interrupt) {
+        return false;
+    }
+    // Decode without consuming: the interrupt may be due later. fill() drops consumed bytes, so buffer
+    // the whole event first to keep `saved` valid.
+    buffer(2 + 10);
+    size_t saved = position;
+    ++position;
+    uint64_t due = lastInterrupt + getVarint();
+    if (due != retired) {
+        position = saved;
+        if (due < retired) {
+            throw ReplayDivergence("an interrupt was due after " + std::to_string(due) + " instructions");
+        }
+        return false;
+    }
+    vector = get();
+    lastInterrupt = due;
+    ++consumed;
+    return true;
+}
+
+void ExecutionJournal::replayClock(uint32_t& seconds, uint32_t& nanoseconds) {
+    expect(Clock, "a clock read");
+    seconds = static_cast<uint32_t>(getVarint());
+    nanoseconds = static_cast<uint32_t>(getVarint());
+}
+
+int32_t ExecutionJournal::replayRead(std::vector<uint8_t>& data) {
+    expect(Read, "a read");
+    auto result = static_cast<int32_t>(unzigzag(getVarint()));
+    data.resize(result > 0 ? static_cast<size_t>(result) : 0);
+    for (uint8_t& byte : data) {
+        byte = get();
+    }
+    return result;
+}
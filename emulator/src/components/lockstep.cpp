@@ -0,0 +1,487 @@
+#include <components/lockstep.hpp>
+#include <components/isa.hpp>
+#include <components/packed.hpp>
+#include <components/syscalls.hpp>
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    constexpr uint32_t InstructionSize = sizeof(uint64_t);
+    constexpr uint32_t WordSize = sizeof(uint32_t);
+    constexpr uint32_t ZeroFlag = 1 << 1;
+    constexpr uint32_t SignFlag = 1 << 2;
+
+    // Steps in a row that leave some lane waiting before the group is split up.
+    constexpr uint32_t DivergenceLimit = 4096;
+}
+
+enum class LockstepGroup::Kernel : uint8_t {
+    Scalar, ///< Left to each lane's CPU.
+    Packed,
+    Add,
+    Subtract,
+    And,
+    Or,
+    Xor,
+    Multiply,
+    ShiftLeft,
+    ShiftRightLogical,
+    ShiftRightArithmetic,
+    Divide,
+    Modulo,
+    Load,
+    Store,
+    Push,
+    Pop,
+    Call,
+    Return,
+    BranchIfEqual,
+    BranchIfNotEqual,
+    Move,
+    Jump,
+    JumpAndLink,
+    Nop,
+};
+
+constexpr std::array<LockstepGroup::Kernel, 64> LockstepGroup::Kernels = [] {
+    using IS = InstructionSet;
+    // Syscalls, special registers, IO, atomics, IRET, HLT and undefined opcodes have no kernel.
+    constexpr std::pair<InstructionHandler, Kernel> Handlers[] = {
+        {&IS::packed, Kernel::Packed},
+        {&IS::add, Kernel::Add},
+        {&IS::subtract, Kernel::Subtract},
+        {&IS::bitwiseAnd, Kernel::And},
+        {&IS::bitwiseOr, Kernel::Or},
+        {&IS::bitwiseXor, Kernel::Xor},
+        {&IS::multiply, Kernel::Multiply},
+        {&IS::shiftLeft, Kernel::ShiftLeft},
+        {&IS::shiftRightLogical, Kernel::ShiftRightLogical},
+        {&IS::shiftRightArithmetic, Kernel::ShiftRightArithmetic},
+        {&IS::divide, Kernel::Divide},
+        {&IS::modulo, Kernel::Modulo},
+        {&IS::load, Kernel::Load},
+        {&IS::store, Kernel::Store},
+        {&IS::push, Kernel::Push},
+        {&IS::pop, Kernel::Pop},
+        {&IS::call, Kernel::Call},
+        {&IS::returnFromCall, Kernel::Return},
+        {&IS::branchIfEqual, Kernel::BranchIfEqual},
+        {&IS::branchIfNotEqual, Kernel::BranchIfNotEqual},
+        {&IS::move, Kernel::Move},
+        {&IS::signExtend, Kernel::Move}, // Registers are 32 bits wide: both extensions copy
+        {&IS::zeroExtend, Kernel::Move},
+        {&IS::jump, Kernel::Jump},
+        {&IS::jumpAndLink, Kernel::JumpAndLink},
+        {&IS::nop, Kernel::Nop},   // Also CMP, which is only its flag effect
+        {&IS::fence, Kernel::Nop}, // Lanes share no memory
+    };
+    std::array<Kernel, 64> kernels{};
+    kernels.fill(Kernel::Scalar);
+    for (size_t opcode = 0; opcode < kernels.size(); ++opcode) {
+        for (const auto& [handler, kernel] : Handlers) {
+            if (OpcodeTable[opcode].handler == handler) {
+                kernels[opcode] = kernel;
+            }
+        }
+    }
+    return kernels;
+}();
+
+LockstepGroup::LockstepGroup(const std::vector<CPU*>& cpus, uint64_t budgetLimit, uint32_t imageStart, uint32_t imageEnd)
+    : lanes(cpus), laneCount(static_cast<unsigned>(cpus.size())), budget(budgetLimit), codeStart(imageStart),
+      codeEnd(imageEnd) {
+    if (laneCount == 0 || laneCount > MaxLanes) {
+        throw std::invalid_argument("A lockstep group holds 1 to 16 lanes");
+    }
+    for (unsigned lane = 0; lane < laneCount; ++lane) {
+        ram[lane] = lanes[lane]->memory.physicalSpan(0, 0);
+        ramSize[lane] = lanes[lane]->memory.size();
+        loadLane(lane);
+    }
+    running = (1u << laneCount) - 1;
+}
+
+void LockstepGroup::run() {
+    uint64_t stepsLeft = 0;
+    while (running) {
+        if (stepsLeft == 0) {
+            // Every lane retires at most one instruction per step, so budgets need checking only this often.
+            uint64_t furthest = 0;
+            for (unsigned lane = 0; lane < laneCount; ++lane) {
+                if (!(running & (1u << lane))) {
+                    continue;
+                }
+                if (regs.executed[lane] >= budget) {
+                    storeLane(lane);
+                    finish(lane, LaneStatus::BudgetExhausted);
+                } else {
+                    furthest = std::max(furthest, regs.executed[lane]);
+                }
+            }
+            if (!running) {
+                break;
+            }
+            stepsLeft = budget - furthest;
+        }
+
+        uint32_t before = running;
+        uint32_t issued;
+        for (uint32_t pending = step(issued); pending; pending &= pending - 1) {
+            escape(static_cast<unsigned>(std::countr_zero(pending)));
+        }
+        --stepsLeft;
+
+        divergentSteps = issued == before ? 0 : divergentSteps + 1;
+        if (divergentSteps > DivergenceLimit) {
+            splitDivergentLanes();
+            divergentSteps = 0;
+        }
+        for (uint32_t eject = ejectPending & running; eject; eject &= eject - 1) {
+            unsigned lane = static_cast<unsigned>(std::countr_zero(eject));
+            running &= ~(1u << lane);
+            runScalar(lane);
+        }
+        ejectPending = 0;
+    }
+}
+
+uint32_t LockstepGroup::step(uint32_t& issued) {
+    auto& R = regs.R;
+
+    uint32_t pc = UINT32_MAX;
+    for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+        pc = std::min(pc, (running >> lane) & 1 ? regs.I0[lane] : UINT32_MAX);
+    }
+    uint32_t mask = 0;
+    for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+        mask |= uint32_t(regs.I0[lane] == pc) << lane;
+    }
+    mask &= running;
+    issued = mask;
+
+    // Lanes run the same, unmodified image, so any of them can supply the instruction.
+    unsigned leader = static_cast<unsigned>(std::countr_zero(mask));
+    if (uint64_t(pc) + InstructionSize > ramSize[leader]) {
+        return mask; // The scalar CPUs raise the fault
+    }
+    uint64_t instruction;
+    std::memcpy(&instruction, ram[leader] + pc, InstructionSize);
+    uint8_t opcode = static_cast<uint8_t>(instruction >> 58);
+    uint8_t rd = (instruction >> 53) & 0x1F;
+    uint8_t rs1 = (instruction >> 48) & 0x1F;
+    uint8_t rs2 = (instruction >> 43) & 0x1F;
+    uint8_t shamt = (instruction >> 37) & 0x3F;
+    uint32_t immediate = static_cast<uint32_t>(instruction >> 16);
+    uint32_t baseMask = instruction & AbsoluteAddressBit ? 0 : ~0u; // Absolute LDR/STR ignore rs1
+    uint32_t address = static_cast<uint32_t>(instruction >> 26);
+    uint8_t func = (instruction >> 29) & 0xFF;
+    uint32_t next = pc + InstructionSize;
+
+    LaneArray active;
+    for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+        active[lane] = 0u - ((mask >> lane) & 1);
+    }
+    const LaneArray a = R[rs1];
+    const LaneArray b = R[rs2];
+    const LaneArray d = R[rd];
+
+    // Lane kernels: fixed-width loops over every lane, blended by `active`, which vectorize cleanly.
+    auto retire = [&]() {
+        for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+            regs.I0[lane] += InstructionSize & active[lane];
+            regs.executed[lane] += active[lane] & 1;
+        }
+    };
+    auto setFlags = [&](const LaneArray& result) {
+        for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+            uint32_t flags = (result[lane] == 0 ? ZeroFlag : 0) | ((result[lane] >> 29) & SignFlag);
+            regs.FR[lane] |= flags & active[lane];
+        }
+    };
+    auto commit = [&](uint8_t target, const LaneArray& result) {
+        for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+            R[target][lane] = (result[lane] & active[lane]) | (R[target][lane] & ~active[lane]);
+        }
+    };
+    auto alu = [&](auto op) {
+        LaneArray result;
+        for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+            result[lane] = op(lane);
+        }
+        retire();
+        commit(rd, result);
+        return 0u;
+    };
+
+    // Memory accesses go lane by lane; a lane whose access would fault is left to its scalar CPU.
+    auto load = [&](unsigned lane, uint32_t at, uint32_t& value) {
+        if (uint64_t(at) + WordSize > ramSize[lane]) {
+            return false;
+        }
+        std::memcpy(&value, ram[lane] + at, WordSize);
+        return true;
+    };
+    auto store = [&](unsigned lane, uint32_t at, uint32_t value) {
+        if (uint64_t(at) + WordSize > ramSize[lane]) {
+            return false;
+        }
+        std::memcpy(ram[lane] + at, &value, WordSize);
+        if (at < codeEnd && uint64_t(at) + WordSize > codeStart) {
+            ejectPending |= 1u << lane; // Its code no longer matches the other lanes'
+        }
+        return true;
+    };
+    auto perLane = [&](auto access) {
+        uint32_t pending = 0;
+        for (uint32_t rest = mask; rest; rest &= rest - 1) {
+            unsigned lane = static_cast<unsigned>(std::countr_zero(rest));
+            if (access(lane)) {
+                ++regs.executed[lane];
+            } else {
+                pending |= 1u << lane;
+            }
+        }
+        return pending;
+    };
+
+    const Kernel kernel = Kernels[opcode];
+    uint32_t pending = 0;
+    switch (kernel) {
+        case Kernel::Scalar:
+            return mask;
+        case Kernel::Packed:
+            if (!PackedAlu::defined(func)) {
+                return mask; // The scalar CPUs raise the invalid opcode interrupt
+            }
+            pending = alu([&](unsigned l) { return PackedAlu::execute(func, a[l], b[l]); });
+            break;
+        case Kernel::Add: pending = alu([&](unsigned l) { return a[l] + b[l]; }); break;
+        case Kernel::Subtract: pending = alu([&](unsigned l) { return a[l] - b[l]; }); break;
+        case Kernel::And: pending = alu([&](unsigned l) { return a[l] & b[l]; }); break;
+        case Kernel::Or: pending = alu([&](unsigned l) { return a[l] | b[l]; }); break;
+        case Kernel::Xor: pending = alu([&](unsigned l) { return a[l] ^ b[l]; }); break;
+        case Kernel::Multiply: pending = alu([&](unsigned l) { return a[l] * b[l]; }); break;
+        case Kernel::ShiftLeft: pending = alu([&](unsigned l) { return Shifter::left(a[l], shamt); }); break;
+        case Kernel::ShiftRightLogical:
+            pending = alu([&](unsigned l) { return Shifter::rightLogical(a[l], shamt); });
+            break;
+        case Kernel::ShiftRightArithmetic:
+            pending = alu([&](unsigned l) { return Shifter::rightArithmetic(a[l], shamt); });
+            break;
+        case Kernel::Divide:
+        case Kernel::Modulo:
+            // Lanes with a zero divisor are left to their scalar CPU, which raises Divide by Zero
+            for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+                pending |= uint32_t(b[lane] == 0) << lane;
+            }
+            pending &= mask;
+            for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+                active[lane] &= ((pending >> lane) & 1) - 1u;
+            }
+            if (kernel == Kernel::Divide) {
+                alu([&](unsigned l) { return a[l] / (b[l] | ~active[l]); });
+            } else {
+                alu([&](unsigned l) { return a[l] % (b[l] | ~active[l]); });
+            }
+            break;
+
+        case Kernel::Load:
+            pending = perLane([&](unsigned lane) {
+                uint32_t value;
+                if (!load(lane, (R[rs1][lane] & baseMask) + immediate, value)) {
+                    return false;
+                }
+                R[rd][lane] = value;
+                regs.I0[lane] = next;
+                return true;
+            });
+            break;
+        case Kernel::Store:
+            pending = perLane([&](unsigned lane) {
+                if (!store(lane, (R[rs1][lane] & baseMask) + immediate, R[rd][lane])) {
+                    return false;
+                }
+                regs.I0[lane] = next;
+                return true;
+            });
+            break;
+        case Kernel::Push:
+            pending = perLane([&](unsigned lane) {
+                if (!store(lane, regs.S0[lane] - WordSize, R[rd][lane])) {
+                    return false;
+                }
+                regs.S0[lane] -= WordSize;
+                regs.I0[lane] = next;
+                return true;
+            });
+            break;
+        case Kernel::Pop:
+            pending = perLane([&](unsigned lane) {
+                uint32_t value;
+                if (!load(lane, regs.S0[lane], value)) {
+                    return false;
+                }
+                R[rd][lane] = value;
+                regs.S0[lane] += WordSize;
+                regs.I0[lane] = next;
+                return true;
+            });
+            break;
+        case Kernel::Call:
+            pending = perLane([&](unsigned lane) {
+                if (!store(lane, regs.S0[lane] - WordSize, next)) {
+                    return false;
+                }
+                regs.S0[lane] -= WordSize;
+                regs.I0[lane] = address;
+                return true;
+            });
+            break;
+        case Kernel::Return:
+            pending = perLane([&](unsigned lane) {
+                uint32_t value;
+                if (!load(lane, regs.S0[lane], value)) {
+                    return false;
+                }
+                regs.S0[lane] += WordSize;
+                regs.I0[lane] = value;
+                return true;
+            });
+            break;
+
+        case Kernel::BranchIfEqual:
+        case Kernel::BranchIfNotEqual:
+            retire();
+            for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+                uint32_t taken = 0u - uint32_t((a[lane] == d[lane]) == (kernel == Kernel::BranchIfEqual));
+                regs.I0[lane] += immediate & taken & active[lane];
+            }
+            break;
+        case Kernel::Move:
+            retire();
+            commit(rd, a);
+            break;
+        case Kernel::Jump:
+        case Kernel::JumpAndLink:
+            retire();
+            if (kernel == Kernel::JumpAndLink) {
+                commit(31, regs.I0);
+            }
+            for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+                regs.I0[lane] = (address & active[lane]) | (regs.I0[lane] & ~active[lane]);
+            }
+            break;
+        case Kernel::Nop:
+            retire();
+            break;
+    }
+
+    // The flag effect of the instruction, as InstructionSet::execute applies it, on the lanes that ran it
+    for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+        active[lane] &= ((pending >> lane) & 1) - 1u;
+    }
+    switch (OpcodeTable[opcode].flags) {
+        case FlagEffect::None:
+            break;
+        case FlagEffect::Result:
+            setFlags(R[rd]);
+            break;
+        case FlagEffect::Compare: {
+            LaneArray difference;
+            for (unsigned lane = 0; lane < MaxLanes; ++lane) {
+                difference[lane] = a[lane] - d[lane];
+            }
+            setFlags(difference);
+            break;
+        }
+    }
+    return pending;
+}
+
+void LockstepGroup::splitDivergentLanes() noexcept {
+    uint32_t largest = 0;
+    for (unsigned lane = 0; lane < laneCount; ++lane) {
+        if (!(running & (1u << lane))) {
+            continue;
+        }
+        uint32_t group = 0;
+        for (unsigned other = 0; other < laneCount; ++other) {
+            group |= uint32_t(regs.I0[other] == regs.I0[lane]) << other;
+        }
+        group &= running;
+        if (std::popcount(group) > std::popcount(largest)) {
+            largest = group;
+        }
+    }
+    ejectPending |= running & ~largest;
+}
+
+void LockstepGroup::escape(unsigned lane) {
+    storeLane(lane);
+    if (!executeScalar(lane)) {
+        return;
+    }
+    loadLane(lane);
+    const CPU& cpu = *lanes[lane];
+    if (cpu.registers.TPDR != 0 || cpu.pmu.active() || cpu.halted()) {
+        ejectPending |= 1u << lane;
+    }
+}
+
+void LockstepGroup::runScalar(unsigned lane) {
+    storeLane(lane);
+    while (regs.executed[lane] < budget) {
+        if (!executeScalar(lane)) {
+            return;
+        }
+    }
+    finish(lane, LaneStatus::BudgetExhausted);
+}
+
+bool LockstepGroup::executeScalar(unsigned lane) noexcept {
+    try {
+        lanes[lane]->executeNextInstruction();
+        ++regs.executed[lane];
+        return true;
+    } catch (const GuestExit& exit) {
+        ++regs.executed[lane];
+        outcomes[lane].exitCode = exit.status();
+        finish(lane, LaneStatus::Exited);
+    } catch (const CpuHalted&) {
+        ++regs.executed[lane];
+        finish(lane, LaneStatus::Halted);
+    } catch (const std::exception& e) {
+        outcomes[lane].message = e.what();
+        finish(lane, LaneStatus::Error);
+    }
+    return false;
+}
+
+void LockstepGroup::loadLane(unsigned lane) noexcept {
+    const CPU::Registers& scalar = lanes[lane]->registers;
+    for (size_t index = 0; index < scalar.R.size(); ++index) {
+        regs.R[index][lane] = scalar.R[index];
+    }
+    regs.I0[lane] = scalar.I0;
+    regs.S0[lane] = scalar.S0;
+    regs.FR[lane] = scalar.FR;
+}
+
+void LockstepGroup::storeLane(unsigned lane) noexcept {
+    CPU::Registers& scalar = lanes[lane]->registers;
+    for (size_t index = 0; index < scalar.R.size(); ++index) {
+        scalar.R[index] = regs.R[index][lane];
+    }
+    scalar.I0 = regs.I0[lane];
+    scalar.S0 = regs.S0[lane];
+    scalar.FR = static_cast<uint8_t>(regs.FR[lane]);
+}
+
+void LockstepGroup::finish(unsigned lane, LaneStatus status) noexcept {
+    running &= ~(1u << lane);
+    outcomes[lane].status = status;
+    outcomes[lane].instructions = regs.executed[lane];
+}
@@ -2,13 +2,70 @@
 #include <components/memory.hpp>
 #include <stdexcept>
 #include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+PhysicalMemory::PhysicalMemory(size_t size) : length(size), ramLength(size) {
+    // Window space is only address space until a window is mapped over it.
+    void* mapping = mmap(nullptr, size + WindowSpace, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    bytes = static_cast<uint8_t*>(mapping);
+}
+
+PhysicalMemory::~PhysicalMemory() {
+    munmap(bytes, ramLength + WindowSpace);
+}
+
+void PhysicalMemory::clear() noexcept {
+    // Private file pages would read back from the file, so replace them with anonymous memory first.
+    if (hasFileMappings && mmap(bytes, ramLength, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) != MAP_FAILED) {
+        hasFileMappings = false;
+        return;
+    }
+    // Private anonymous pages read back as zero after MADV_DONTNEED.
+    if (ramLength && madvise(bytes, ramLength, MADV_DONTNEED) != 0) {
+        std::memset(bytes, 0, ramLength);
+    }
+}
+
+uint32_t PhysicalMemory::mapShared(int fd, size_t size) {
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t offset = (length + pageSize - 1) & ~(pageSize - 1);
+    if (size == 0 || size % pageSize != 0 || offset + size > ramLength + WindowSpace || offset + size > (size_t(1) << 32)) {
+        throw std::runtime_error("Shared window does not fit into the physical address space");
+    }
+    if (mmap(bytes + offset, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        throw std::runtime_error("Failed to map shared window");
+    }
+    length = offset + size;
+    return static_cast<uint32_t>(offset);
+}
+
+void PhysicalMemory::mapPrivate(size_t offset, int fd, uint64_t fileOffset, size_t size) {
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if ((offset | fileOffset) % pageSize != 0 || offset > ramLength || size > ramLength - offset) {
+        throw std::runtime_error("File mapping does not fit into RAM");
+    }
+    if (mmap(bytes + offset, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(fileOffset)) == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file into RAM");
+    }
+    hasFileMappings = true;
+}
 
-Memory::Memory(size_t size, CPU& cpuarg) : memory(size), cpu(cpuarg) {
+Memory::Memory(size_t size, CPU& cpuarg)
+    : storage(std::make_shared<PhysicalMemory>(size)), memory(*storage), cpu(cpuarg) {
     this->reset();
 }
 
+Memory::Memory(const Memory& shared, CPU& cpuarg) : storage(shared.storage), memory(*storage), cpu(cpuarg) {}
+
 uint32_t Memory::readRaw(uint32_t address) const {
-    if (address >= memory.size()) {
+    if (address > memory.size() - sizeof(uint32_t)) {
         throw std::out_of_range("Address out of bounds"); // Actuall emulator error here
     }
     uint32_t value;
@@ -17,7 +74,7 @@ uint32_t Memory::readRaw(uint32_t address) const {
 }
 
 void Memory::writeRaw(uint32_t address, uint32_t value) {
-    if (address >= memory.size()) {
+    if (address > memory.size() - sizeof(uint32_t)) {
         throw std::out_of_range("Address out of bounds"); // not an exception, emulator error
     }
     std::memcpy(&memory[address], &value, sizeof(uint32_t));
@@ -29,7 +86,11 @@ uint32_t Memory::read(uint32_t virtualAddress) const {
         cpu.interrupts.triggerInterrupt(GeneralProtectionFault, 0x01); // GPF: Unauthorized read
         return 0;
     }
-    return readRaw(physicalAddress);
+    uint32_t value = readRaw(physicalAddress);
+    if (cpu.tracer()) [[unlikely]] {
+        cpu.tracer()->access(false, virtualAddress, value);
+    }
+    return value;
 }
 
 void Memory::write(uint32_t virtualAddress, uint32_t value) {
@@ -39,11 +100,14 @@ void Memory::write(uint32_t virtualAddress, uint32_t value) {
         return;
     }
     writeRaw(physicalAddress, value);
+    if (cpu.tracer()) [[unlikely]] {
+        cpu.tracer()->access(true, virtualAddress, value);
+    }
 }
 
 
 bool Memory::checkAccessRights(uint32_t physicalAddress, AccessType accessType) const {
-    if (accessType == AccessType::Read) {
+    if (accessType == AccessType::Read || cpu.registers.TPDR == 0) {
         return true;
     }
     
@@ -71,17 +135,49 @@ bool Memory::checkAccessRights(uint32_t physicalAddress, AccessType accessType)
     return true;
 }
 
+uint32_t* Memory::atomicWord(uint32_t virtualAddress, AccessType access) {
+    if (virtualAddress & (sizeof(uint32_t) - 1)) {
+        cpu.interrupts.triggerInterrupt(AlignmentCheck, Misaligned32BitWordAccess);
+        return nullptr;
+    }
+    uint32_t physicalAddress = translate(virtualAddress);
+    if (physicalAddress == 0xFFFFFFFF) {
+        return nullptr; // Page fault already raised
+    }
+    if (!checkAccessRights(physicalAddress, access)) {
+        cpu.interrupts.triggerInterrupt(GeneralProtectionFault, access == AccessType::Write ? 0x02 : 0x01);
+        return nullptr;
+    }
+    if (physicalAddress > memory.size() - sizeof(uint32_t)) {
+        throw std::out_of_range("Address out of bounds");
+    }
+    return reinterpret_cast<uint32_t*>(memory.data() + physicalAddress);
+}
+
 uint32_t Memory::translateVirtualAddress(uint32_t virtualAddress) const {
     return translate(virtualAddress);
 }
 
 uint32_t Memory::translate(uint32_t virtualAddress) const {
+    if (cpu.registers.TPDR == 0) {
+        return virtualAddress; // Paging disabled, identity mapped
+    }
+    uint32_t pageNumber = virtualAddress >> 12;
+    TlbEntry& entry = tlb[pageNumber & (TlbEntries - 1)];
+    if (entry.tag == ((pageNumber << 1) | 1)) {
+        return entry.frame | (virtualAddress & 0xFFF);
+    }
+    if (cpu.pmu.active()) {
+        cpu.pmu.count(PerformanceMonitor::PageWalks);
+        cpu.pmu.count(PerformanceMonitor::Cycles, PerformanceMonitor::CycleCost::PageWalk);
+    }
+
     uint32_t pageDirectoryIndex = (virtualAddress >> 22) & 0x3FF;
     uint32_t pageTableIndex = (virtualAddress >> 12) & 0x3FF;
     uint32_t pageOffset = virtualAddress & 0xFFF;
 
     uint32_t pageDirectoryBase = cpu.registers.TPDR;
-    uint32_t pageTableBase = read(pageDirectoryBase + pageDirectoryIndex * sizeof(uint32_t));
+    uint32_t pageTableBase = readRaw(pageDirectoryBase + pageDirectoryIndex * sizeof(uint32_t));
 
     if (!(pageTableBase & 0x1)) {
         cpu.interrupts.triggerInterrupt(InterruptType::PageFault, 0x00);
@@ -89,7 +185,7 @@ uint32_t Memory::translate(uint32_t virtualAddress) const {
     }
 
     uint32_t pageTableAddress = pageTableBase & ~0xFFF;
-    uint32_t pageEntry = read(pageTableAddress + pageTableIndex * sizeof(uint32_t));
+    uint32_t pageEntry = readRaw(pageTableAddress + pageTableIndex * sizeof(uint32_t));
 
     if (!(pageEntry & 0x1)) {
         cpu.interrupts.triggerInterrupt(InterruptType::PageFault, 0x00);
@@ -98,10 +194,11 @@ uint32_t Memory::translate(uint32_t virtualAddress) const {
 
     uint32_t physicalPageBase = pageEntry & ~0xFFF;
     uint32_t physicalAddress = physicalPageBase + pageOffset;
+    entry = {(pageNumber << 1) | 1, physicalPageBase};
 
     return physicalAddress;
 }
 
 void Memory::reset() noexcept {
-    std::memset(memory.data(), 0, memory.size());
+    memory.clear();
 }
@@ -0,0 +1,64 @@
+#include <components/pmu.hpp>
+#include <components/cpu.hpp>
+
+void PerformanceMonitor::endBlock() noexcept {
+    if (blockInstructions == 0) {
+        return;
+    }
+    uint32_t retired = blockInstructions;
+    blockInstructions = 0;
+    count(Instructions, retired);
+    count(Cycles, retired * CycleCost::Instruction);
+}
+
+void PerformanceMonitor::count(Counter counter, uint32_t amount) noexcept {
+    if (!(control & (1u << counter))) {
+        return;
+    }
+    uint32_t before = counters[counter];
+    counters[counter] = before + amount;
+    if (counters[counter] < before) {
+        overflowStatus |= 1u << counter;
+        if (control & (1u << (counter + OverflowInterruptShift))) {
+            pendingOverflow = true;
+        }
+    }
+}
+
+void PerformanceMonitor::deliverOverflow() {
+    if (!(cpu.registers.FR & (1 << 4))) {
+        return; // Stays pending until the guest re-enables interrupts
+    }
+    pendingOverflow = false;
+    cpu.interrupts.triggerInterrupt(InterruptType::PerformanceMonitorOverflow);
+}
+
+uint32_t PerformanceMonitor::read(uint8_t index) noexcept {
+    if (index == PMCR) {
+        return control;
+    }
+    if (index == PMOVS) {
+        return overflowStatus;
+    }
+    endBlock(); // Make the counters exact at the point of the read
+    return counters[index - PMC0];
+}
+
+void PerformanceMonitor::write(uint8_t index, uint32_t value) noexcept {
+    endBlock();
+    if (index == PMCR) {
+        control = value & (EnableMask | (EnableMask << OverflowInterruptShift));
+    } else if (index == PMOVS) {
+        overflowStatus &= ~value; // Write one to clear
+    } else {
+        counters[index - PMC0] = value;
+    }
+}
+
+void PerformanceMonitor::reset() noexcept {
+    control = 0;
+    overflowStatus = 0;
+    counters.fill(0);
+    blockInstructions = 0;
+    pendingOverflow = false;
+}
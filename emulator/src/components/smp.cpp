@@ -0,0 +1,58 @@
+#include <components/smp.hpp>
+#include <stdexcept>
+
+CoreCluster::CoreCluster(CPU& boot, unsigned coreCount) {
+    if (coreCount == 0 || coreCount > 255) {
+        throw std::invalid_argument("Core count must be between 1 and 255");
+    }
+    for (unsigned id = 1; id < coreCount; ++id) {
+        auto core = std::make_unique<CPU>(boot);
+        core->registers.I0 = boot.registers.I0;
+        cores.push_back(std::move(core));
+    }
+}
+
+CoreCluster::~CoreCluster() {
+    stop();
+}
+
+void CoreCluster::start() {
+    for (auto& core : cores) {
+        threads.emplace_back(&CoreCluster::run, this, std::ref(*core));
+    }
+}
+
+void CoreCluster::stop() noexcept {
+    stopping.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+void CoreCluster::rethrowFailure() {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
+void CoreCluster::run(CPU& core) noexcept {
+    try {
+        for (uint64_t cycle = 1; ; ++cycle) {
+            core.executeNextInstruction();
+            // A halted core returns from every step after a bounded wait, so check on each of those too.
+            if (((cycle & 0x3FF) == 0 || core.halted()) && stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+        }
+    } catch (const CpuHalted&) {
+        // This core is done; the machine runs on.
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!firstError) {
+            firstError = std::current_exception();
+            failure.store(true, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,599 @@
+#include <components/snapshot.hpp>
+#include <components/cpu.hpp>
+#include <components/syscalls.hpp>
+#include <utils/byte_stream.hpp>
+#include <utils/hash.hpp>
+#include <utils/work_stealing_pool.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+    constexpr char Magic[8] = {'X', 'R', '3', '2', 'S', 'N', 'A', 'P'};
+    constexpr size_t HeaderBytes = 48;        ///< Magic, version, page size, RAM size, ids, metadata size.
+    constexpr size_t ExtentEntryBytes = 16;   ///< Offset, stored size, page count, encoding, padding.
+    constexpr size_t HashBatch = 1024;        ///< Pages hashed per task.
+    constexpr size_t MaxMappings = 16384;     ///< Mapped runs per restore; beyond this, raw extents are read.
+    constexpr size_t MaxChainLength = 256;    ///< Guards against parent cycles.
+    constexpr size_t PageSize = MachineSnapshot::PageSize;
+
+    enum PageKind : uint8_t {
+        Zero = 0,   ///< All zero, not stored.
+        Parent = 1, ///< Same content as in the parent snapshot.
+        Data = 2,   ///< Stored in the next extent.
+    };
+
+    enum Encoding : uint8_t {
+        Raw = 0,     ///< Page contents, page-aligned in the file.
+        Deflate = 1, ///< One zlib stream of the extent's pages.
+    };
+
+    struct Extent {
+        uint64_t offset{0};      ///< File offset of the stored bytes.
+        uint32_t storedBytes{0}; ///< Bytes in the file.
+        uint16_t pages{0};       ///< Data pages it holds, the next ones in page order.
+        uint8_t encoding{Raw};
+    };
+
+    using Writer = ByteWriter;
+
+    class Reader : public ByteReader {
+    public:
+        Reader(const uint8_t* data, size_t size) noexcept : ByteReader(data, size, "Corrupt snapshot metadata") {}
+    };
+
+    bool readAt(int fd, void* buffer, size_t size, uint64_t offset) noexcept {
+        auto* bytes = static_cast<uint8_t*>(buffer);
+        while (size > 0) {
+            ssize_t n = ::pread(fd, bytes, size, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            bytes += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    bool writeAt(int fd, const void* buffer, size_t size, uint64_t offset) noexcept {
+        auto* bytes = static_cast<const uint8_t*>(buffer);
+        while (size > 0) {
+            ssize_t n = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            bytes += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    /**
+     * @brief An open snapshot file and its metadata; the page contents stay on disk.
+     */
+    struct Image {
+        Image() = default;
+        Image(const Image&) = delete;
+        Image& operator=(const Image&) = delete;
+        ~Image() {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+
+        std::string path;
+        int fd{-1};
+        uint64_t ramSize{0};
+        uint64_t id{0};
+        uint64_t parentId{0};            ///< 0 for a snapshot without parent.
+        std::string parentPath;          ///< Relative to the directory of `path`.
+        std::vector<uint8_t> coreState;
+        std::vector<uint8_t> hostState;  ///< Empty unless taken in user mode.
+        std::vector<uint8_t> kinds;      ///< PageKind per page.
+        std::vector<uint64_t> hashes;    ///< Content hash per page, whatever its kind.
+        std::vector<Extent> extents;
+    };
+
+    std::unique_ptr<Image> openImage(const std::string& path) {
+        auto image = std::make_unique<Image>();
+        image->path = path;
+        image->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (image->fd < 0) {
+            throw std::runtime_error("Failed to open snapshot: " + path);
+        }
+        struct stat status{};
+        uint8_t header[HeaderBytes];
+        if (::fstat(image->fd, &status) != 0 || !readAt(image->fd, header, sizeof(header), 0) ||
+            std::memcmp(header, Magic, sizeof(Magic)) != 0) {
+            throw std::runtime_error("Not a snapshot: " + path);
+        }
+        Reader fields(header + sizeof(Magic), sizeof(header) - sizeof(Magic));
+        uint32_t version = fields.u32();
+        uint32_t pageSize = fields.u32();
+        image->ramSize = fields.u64();
+        image->id = fields.u64();
+        image->parentId = fields.u64();
+        uint64_t metadataBytes = fields.u64();
+        auto fileBytes = static_cast<uint64_t>(status.st_size);
+        if (version != MachineSnapshot::Version || pageSize != PageSize) {
+            throw std::runtime_error("Snapshot format version " + std::to_string(version) + " is not supported: " + path);
+        }
+        if (image->ramSize % PageSize != 0 || metadataBytes > fileBytes - HeaderBytes) {
+            throw std::runtime_error("Corrupt snapshot: " + path);
+        }
+
+        std::vector<uint8_t> metadata(metadataBytes);
+        if (!readAt(image->fd, metadata.data(), metadata.size(), HeaderBytes) ||
+            contentHash(metadata.data(), metadata.size(), image->parentId) != image->id) {
+            throw std::runtime_error("Corrupt snapshot metadata: " + path);
+        }
+        Reader in(metadata.data(), metadata.size());
+        size_t pageCount = image->ramSize / PageSize;
+        image->parentPath = in.string();
+        image->coreState = in.blob();
+        image->hostState = in.blob();
+        const uint8_t* kinds = in.raw(pageCount);
+        image->kinds.assign(kinds, kinds + pageCount);
+        image->hashes.resize(pageCount);
+        std::memcpy(image->hashes.data(), in.raw(pageCount * sizeof(uint64_t)), pageCount * sizeof(uint64_t));
+        image->extents.resize(in.u32());
+        size_t extentPages = 0;
+        for (Extent& extent : image->extents) {
+            extent.offset = in.u64();
+            extent.storedBytes = in.u32();
+            extent.pages = in.u16();
+            extent.encoding = in.u8();
+            in.u8();
+            extentPages += extent.pages;
+            bool rawSizeMatches = extent.encoding != Raw || extent.storedBytes == extent.pages * PageSize;
+            if (extent.encoding > Deflate || !rawSizeMatches || extent.offset > fileBytes ||
+                extent.storedBytes > fileBytes - extent.offset) {
+                throw std::runtime_error("Corrupt snapshot extent table: " + path);
+            }
+        }
+        if (!in.done() || (image->parentId == 0) != image->parentPath.empty() ||
+            std::any_of(image->kinds.begin(), image->kinds.end(), [](uint8_t kind) { return kind > Data; }) ||
+            extentPages != static_cast<size_t>(std::count(image->kinds.begin(), image->kinds.end(), Data))) {
+            throw std::runtime_error("Corrupt snapshot metadata: " + path);
+        }
+        return image;
+    }
+
+    /**
+     * @brief Runs tasks on a pool and rethrows the first failure once all have finished.
+     */
+    class TaskGroup {
+    public:
+        explicit TaskGroup(unsigned threads) : pool(threads) {}
+
+        void submit(std::function<void()> task) {
+            pool.submit([this, task = std::move(task)]() {
+                try {
+                    task();
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (error.empty()) {
+                        error = e.what();
+                    }
+                }
+            });
+        }
+
+        void wait() {
+            pool.wait();
+            if (!error.empty()) {
+                throw std::runtime_error(error);
+            }
+        }
+
+    private:
+        WorkStealingPool pool;
+        std::mutex errorMutex;
+        std::string error; ///< First failure, if any.
+    };
+}
+
+std::vector<uint8_t> MachineSnapshot::encodeCore(const CPU& cpu) {
+    Writer out;
+    const CPU::Registers& r = cpu.registers;
+    for (uint32_t value : r.R) {
+        out.u32(value);
+    }
+    out.u32(r.I0);
+    out.u32(r.S0);
+    out.u32(r.S1);
+    out.u8(r.FR);
+    out.u32(r.IVTR);
+    out.u8(r.IE0);
+    out.u32(r.IE1);
+    out.u32(r.IE2);
+    out.u8(r.IE3);
+    out.u32(r.IE4);
+    out.u32(r.TPDR);
+    out.u32(r.TSP);
+    out.u32(r.MSR); // PRR describes the emulator that runs the guest, not the guest
+    out.u64(cpu.retiredInstructions);
+    out.u8(cpu.waiting);
+    for (const auto& word : cpu.pendingVectors) {
+        out.u64(word.load(std::memory_order_relaxed));
+    }
+    const PerformanceMonitor& pmu = cpu.pmu;
+    out.u32(pmu.control);
+    out.u32(pmu.overflowStatus);
+    for (uint32_t counter : pmu.counters) {
+        out.u32(counter);
+    }
+    out.u32(pmu.blockInstructions);
+    out.u8(pmu.pendingOverflow);
+    return std::move(out.bytes);
+}
+
+void MachineSnapshot::decodeCore(CPU& cpu, const std::vector<uint8_t>& state) {
+    Reader in(state.data(), state.size());
+    CPU::Registers& r = cpu.registers;
+    for (uint32_t& value : r.R) {
+        value = in.u32();
+    }
+    r.I0 = in.u32();
+    r.S0 = in.u32();
+    r.S1 = in.u32();
+    r.FR = in.u8();
+    r.IVTR = in.u32();
+    r.IE0 = in.u8();
+    r.IE1 = in.u32();
+    r.IE2 = in.u32();
+    r.IE3 = in.u8();
+    r.IE4 = in.u32();
+    r.TPDR = in.u32();
+    r.TSP = in.u32();
+    r.MSR = in.u32();
+    cpu.retiredInstructions = in.u64();
+    cpu.waiting = in.u8() != 0;
+    bool pending = false;
+    for (auto& word : cpu.pendingVectors) {
+        uint64_t bits = in.u64();
+        word.store(bits, std::memory_order_relaxed);
+        pending |= bits != 0;
+    }
+    PerformanceMonitor& pmu = cpu.pmu;
+    pmu.control = in.u32();
+    pmu.overflowStatus = in.u32();
+    for (uint32_t& counter : pmu.counters) {
+        counter = in.u32();
+    }
+    pmu.blockInstructions = in.u32();
+    pmu.pendingOverflow = in.u8() != 0;
+    if (!in.done()) {
+        throw std::runtime_error("Corrupt snapshot CPU state");
+    }
+
+    cpu.reservation = {}; // SC fails once and the guest retries, as after an interrupt
+    cpu.memory.flushTlb();
+    if (pending) {
+        cpu.interruptPending.store(true, std::memory_order_seq_cst);
+    }
+}
+
+MachineSnapshot::SaveStatistics MachineSnapshot::save(const std::string& path, CPU& cpu, SyscallEmulator* syscalls,
+                                                      const SaveOptions& options) {
+    namespace fs = std::filesystem;
+    size_t ramSize = cpu.memory.size();
+    if (ramSize % PageSize != 0) {
+        throw std::runtime_error("Snapshots need a RAM size that is a multiple of " + std::to_string(PageSize) + " bytes");
+    }
+    const uint8_t* ram = cpu.memory.physicalSpan(0, ramSize);
+    size_t pageCount = ramSize / PageSize;
+
+    std::unique_ptr<Image> parent;
+    std::string parentPath;
+    if (options.parent) {
+        if (fs::weakly_canonical(*options.parent) == fs::weakly_canonical(path)) {
+            throw std::runtime_error("A snapshot cannot be its own parent: " + path);
+        }
+        parent = openImage(*options.parent);
+        if (parent->ramSize != ramSize) {
+            throw std::runtime_error("Parent snapshot has a different RAM size: " + *options.parent);
+        }
+        parentPath = fs::relative(fs::absolute(*options.parent), fs::absolute(path).parent_path()).string();
+    }
+
+    // Pages the guest never touched are zero without reading them, unless RAM was mapped from a file.
+    std::vector<unsigned char> resident(pageCount, 1);
+    if (!cpu.memory.fileBacked() && pageCount && mincore(const_cast<uint8_t*>(ram), ramSize, resident.data()) != 0) {
+        std::fill(resident.begin(), resident.end(), 1);
+    }
+
+    static const uint8_t zeros[PageSize]{};
+    const uint64_t zeroHash = contentHash(zeros, PageSize);
+    std::vector<uint8_t> kinds(pageCount);
+    std::vector<uint64_t> hashes(pageCount);
+    TaskGroup tasks(options.threads);
+    for (size_t first = 0; first < pageCount; first += HashBatch) {
+        tasks.submit([&, first]() {
+            for (size_t page = first; page < std::min(first + HashBatch, pageCount); ++page) {
+                const uint8_t* bytes = ram + page * PageSize;
+                if (!(resident[page] & 1) || std::memcmp(bytes, zeros, PageSize) == 0) {
+                    kinds[page] = Zero;
+                    hashes[page] = zeroHash;
+                    continue;
+                }
+                hashes[page] = contentHash(bytes, PageSize);
+                kinds[page] = parent && parent->hashes[page] == hashes[page] ? Parent : Data;
+            }
+        });
+    }
+    tasks.wait();
+
+    SaveStatistics statistics;
+    statistics.pages = pageCount;
+    std::vector<size_t> stored;
+    for (size_t page = 0; page < pageCount; ++page) {
+        switch (kinds[page]) {
+            case Zero: ++statistics.zeroPages; break;
+            case Parent: ++statistics.parentPages; break;
+            default: stored.push_back(page); break;
+        }
+    }
+    statistics.storedPages = stored.size();
+
+    std::vector<Extent> extents((stored.size() + ExtentPages - 1) / ExtentPages);
+    std::vector<std::vector<uint8_t>> packed(extents.size());
+    for (size_t e = 0; e < extents.size(); ++e) {
+        Extent& extent = extents[e];
+        extent.pages = static_cast<uint16_t>(std::min(ExtentPages, stored.size() - e * ExtentPages));
+        extent.storedBytes = static_cast<uint32_t>(extent.pages * PageSize);
+        if (!options.compress) {
+            continue;
+        }
+        tasks.submit([&, e]() {
+            Extent& target = extents[e];
+            std::vector<uint8_t> pages(target.pages * PageSize);
+            for (size_t i = 0; i < target.pages; ++i) {
+                std::memcpy(pages.data() + i * PageSize, ram + stored[e * ExtentPages + i] * PageSize, PageSize);
+            }
+            std::vector<uint8_t> output(compressBound(static_cast<uLong>(pages.size())));
+            uLongf size = static_cast<uLongf>(output.size());
+            // Extents that barely compress stay raw: they restore by mapping instead of inflating.
+            if (compress2(output.data(), &size, pages.data(), static_cast<uLong>(pages.size()), Z_BEST_SPEED) == Z_OK &&
+                size < pages.size() - pages.size() / 8) {
+                output.resize(size);
+                packed[e] = std::move(output);
+                target.encoding = Deflate;
+                target.storedBytes = static_cast<uint32_t>(size);
+            }
+        });
+    }
+    tasks.wait();
+
+    size_t metadataBytes = 4 + parentPath.size() + pageCount * (1 + sizeof(uint64_t)) + 4 + extents.size() * ExtentEntryBytes;
+    std::vector<uint8_t> coreState = encodeCore(cpu);
+    std::vector<uint8_t> hostState;
+    if (syscalls) {
+        SyscallEmulator::Snapshot host = syscalls->snapshot();
+        Writer out;
+        out.u32(host.mmapTop);
+        out.u32(host.mmapFloor);
+        out.u32(static_cast<uint32_t>(host.files.size()));
+        for (const SyscallEmulator::OpenFile& file : host.files) {
+            out.string(file.path);
+            out.u32(static_cast<uint32_t>(file.flags));
+            out.u64(static_cast<uint64_t>(file.offset));
+        }
+        hostState = std::move(out.bytes);
+    }
+    metadataBytes += 4 + coreState.size() + 4 + hostState.size();
+    uint64_t offset = HeaderBytes + metadataBytes;
+    for (Extent& extent : extents) {
+        if (extent.encoding == Raw) {
+            offset = (offset + PageSize - 1) & ~uint64_t(PageSize - 1);
+        }
+        extent.offset = offset;
+        offset += extent.storedBytes;
+    }
+    statistics.fileBytes = offset;
+
+    Writer metadata;
+    metadata.string(parentPath);
+    metadata.blob(coreState);
+    metadata.blob(hostState);
+    metadata.raw(kinds.data(), kinds.size());
+    metadata.raw(hashes.data(), hashes.size() * sizeof(uint64_t));
+    metadata.u32(static_cast<uint32_t>(extents.size()));
+    for (const Extent& extent : extents) {
+        metadata.u64(extent.offset);
+        metadata.u32(extent.storedBytes);
+        metadata.u16(extent.pages);
+        metadata.u8(extent.encoding);
+        metadata.u8(0);
+    }
+    if (metadata.bytes.size() != metadataBytes) {
+        throw std::logic_error("Snapshot metadata size mismatch");
+    }
+    uint64_t parentId = parent ? parent->id : 0;
+    Writer header;
+    header.raw(Magic, sizeof(Magic));
+    header.u32(Version);
+    header.u32(PageSize);
+    header.u64(ramSize);
+    header.u64(contentHash(metadata.bytes.data(), metadata.bytes.size(), parentId));
+    header.u64(parentId);
+    header.u64(metadata.bytes.size());
+
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create snapshot: " + temporary);
+    }
+    // Gaps before raw extents are left as holes; they read back as zeros.
+    bool written = writeAt(fd, header.bytes.data(), header.bytes.size(), 0) &&
+                   writeAt(fd, metadata.bytes.data(), metadata.bytes.size(), HeaderBytes) &&
+                   ::ftruncate(fd, static_cast<off_t>(statistics.fileBytes)) == 0;
+    for (size_t e = 0; written && e < extents.size(); ++e) {
+        const Extent& extent = extents[e];
+        if (extent.encoding == Deflate) {
+            written = writeAt(fd, packed[e].data(), packed[e].size(), extent.offset);
+            continue;
+        }
+        for (size_t i = 0; written && i < extent.pages; ++i) {
+            written = writeAt(fd, ram + stored[e * ExtentPages + i] * PageSize, PageSize, extent.offset + i * PageSize);
+        }
+    }
+    if (::close(fd) != 0 || !written || ::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        throw std::runtime_error("Failed to write snapshot: " + path);
+    }
+    return statistics;
+}
+
+size_t MachineSnapshot::memorySize(const std::string& path) {
+    return openImage(path)->ramSize;
+}
+
+void MachineSnapshot::restore(const std::string& path, CPU& cpu, SyscallEmulator* syscalls, unsigned threads) {
+    namespace fs = std::filesystem;
+    std::vector<std::unique_ptr<Image>> chain;
+    chain.push_back(openImage(path));
+    while (chain.back()->parentId != 0) {
+        if (chain.size() == MaxChainLength) {
+            throw std::runtime_error("Snapshot chain is longer than " + std::to_string(MaxChainLength) + ": " + path);
+        }
+        const Image& child = *chain.back();
+        std::string parentPath = (fs::path(child.path).parent_path() / child.parentPath).string();
+        auto parent = openImage(parentPath);
+        if (parent->id != child.parentId || parent->ramSize != child.ramSize) {
+            throw std::runtime_error("Snapshot " + parentPath + " changed after " + child.path + " was taken from it");
+        }
+        chain.push_back(std::move(parent));
+    }
+    const Image& leaf = *chain.front();
+    if (leaf.ramSize != cpu.memory.size()) {
+        throw std::runtime_error("Snapshot needs " + std::to_string(leaf.ramSize) + " bytes of RAM: " + path);
+    }
+    if (leaf.hostState.empty() != (syscalls == nullptr)) {
+        throw std::runtime_error(syscalls ? "Snapshot was not taken in user mode: " + path
+                                          : "Snapshot was taken in user mode and needs --user: " + path);
+    }
+
+    // Resolve every page to the snapshot in the chain that stores it.
+    constexpr uint32_t ZeroPage = UINT32_MAX;
+    size_t pageCount = leaf.ramSize / PageSize;
+    std::vector<uint32_t> source(pageCount, ZeroPage);
+    for (size_t page = 0; page < pageCount; ++page) {
+        for (uint32_t level = 0; ; ++level) {
+            uint8_t kind = chain[level]->kinds[page];
+            if (kind == Parent) {
+                if (level + 1 == chain.size()) {
+                    throw std::runtime_error("Corrupt snapshot: page refers to a missing parent: " + chain[level]->path);
+                }
+                continue;
+            }
+            if (kind == Data) {
+                source[page] = level;
+            }
+            break;
+        }
+    }
+
+    cpu.memory.reset();
+    uint8_t* ram = cpu.memory.physicalSpan(0, leaf.ramSize);
+    struct Run {
+        const Image* image;
+        size_t page;         ///< First page in RAM.
+        uint64_t fileOffset; ///< Its contents in the image.
+        size_t pages;
+    };
+    std::vector<Run> runs;
+    TaskGroup tasks(threads);
+    for (uint32_t level = 0; level < chain.size(); ++level) {
+        const Image& image = *chain[level];
+        size_t page = 0;
+        for (const Extent& extent : image.extents) {
+            // The extent holds the next `extent.pages` data pages of this image, in page order.
+            std::vector<std::pair<size_t, size_t>> wanted; // (page, index in extent)
+            for (size_t index = 0; index < extent.pages; ++page) {
+                if (image.kinds[page] == Data) {
+                    if (source[page] == level) {
+                        wanted.emplace_back(page, index);
+                    }
+                    ++index;
+                }
+            }
+            if (wanted.empty()) {
+                continue;
+            }
+            if (extent.encoding == Raw) {
+                for (auto [target, index] : wanted) {
+                    Run* last = runs.empty() ? nullptr : &runs.back();
+                    uint64_t fileOffset = extent.offset + index * PageSize;
+                    if (last && last->image == &image && last->page + last->pages == target &&
+                        last->fileOffset + last->pages * PageSize == fileOffset) {
+                        ++last->pages;
+                    } else {
+                        runs.push_back({&image, target, fileOffset, 1});
+                    }
+                }
+                continue;
+            }
+            tasks.submit([&image, &extent, ram, wanted = std::move(wanted)]() {
+                std::vector<uint8_t> packedBytes(extent.storedBytes);
+                std::vector<uint8_t> pages(extent.pages * PageSize);
+                uLongf size = static_cast<uLongf>(pages.size());
+                if (!readAt(image.fd, packedBytes.data(), packedBytes.size(), extent.offset) ||
+                    uncompress(pages.data(), &size, packedBytes.data(), static_cast<uLong>(packedBytes.size())) != Z_OK ||
+                    size != pages.size()) {
+                    throw std::runtime_error("Corrupt snapshot extent: " + image.path);
+                }
+                for (auto [target, index] : wanted) {
+                    const uint8_t* bytes = pages.data() + index * PageSize;
+                    if (contentHash(bytes, PageSize) != image.hashes[target]) {
+                        throw std::runtime_error("Snapshot page " + std::to_string(target) + " fails its hash check: " + image.path);
+                    }
+                    std::memcpy(ram + target * PageSize, bytes, PageSize);
+                }
+            });
+        }
+    }
+    // Raw pages are mapped copy-on-write and read when the guest touches them, unless there are
+    // so many scattered runs that the mappings would exhaust the process limit.
+    for (const Run& run : runs) {
+        if (runs.size() <= MaxMappings) {
+            cpu.memory.mapPrivate(run.page * PageSize, run.image->fd, run.fileOffset, run.pages * PageSize);
+        } else if (!readAt(run.image->fd, ram + run.page * PageSize, run.pages * PageSize, run.fileOffset)) {
+            throw std::runtime_error("Failed to read snapshot: " + run.image->path);
+        }
+    }
+    tasks.wait();
+
+    decodeCore(cpu, leaf.coreState);
+    if (syscalls) {
+        Reader in(leaf.hostState.data(), leaf.hostState.size());
+        SyscallEmulator::Snapshot host;
+        host.mmapTop = in.u32();
+        host.mmapFloor = in.u32();
+        host.files.resize(in.u32());
+        for (SyscallEmulator::OpenFile& file : host.files) {
+            file.path = in.string();
+            file.flags = static_cast<int>(in.u32());
+            file.offset = static_cast<off_t>(in.u64());
+        }
+        syscalls->restore(host);
+    }
+}
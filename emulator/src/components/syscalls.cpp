@@ -0,0 +1,370 @@
+#include <components/syscalls.hpp>
+#include <components/cpu.hpp>
+#include <components/journal.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <filesystem>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+    constexpr uint32_t PageSize = 0x1000;
+    constexpr uint32_t MaxDescriptors = 256;
+    constexpr uint32_t MaxPathLength = 4096;
+
+    std::string describeFault(uint8_t vector, uint8_t errorCode, uint32_t address) {
+        std::ostringstream message;
+        message << "Unhandled exception 0x" << std::hex << static_cast<int>(vector)
+                << " (error code 0x" << static_cast<int>(errorCode) << ") at I0: 0x" << address;
+        return message.str();
+    }
+}
+
+GuestFault::GuestFault(uint8_t vector, uint8_t errorCode, uint32_t address)
+    : std::runtime_error(describeFault(vector, errorCode, address)) {}
+
+SyscallEmulator::SyscallEmulator(CPU& boot, uint32_t imageEnd, unsigned coreCount) : descriptors{0, 1, 2} {
+    stackTop = static_cast<uint32_t>(std::min<size_t>(boot.memory.size(), UINT32_MAX) & ~size_t(PageSize - 1));
+    uint64_t stacks = uint64_t(coreCount) * StackSize;
+    mmapTop = stackTop > stacks ? static_cast<uint32_t>(stackTop - stacks) : 0;
+    mmapFloor = (imageEnd + PageSize - 1) & ~(PageSize - 1);
+}
+
+SyscallEmulator::~SyscallEmulator() {
+    for (size_t fd = 3; fd < descriptors.size(); ++fd) {
+        if (descriptors[fd] >= 0) {
+            ::close(descriptors[fd]);
+        }
+    }
+}
+
+void SyscallEmulator::attach(CPU& core) noexcept {
+    core.registers.S0 = stackTop - core.id() * StackSize;
+    core.interrupts.setSyscallHandler(this);
+}
+
+void SyscallEmulator::handle(CPU& core, uint8_t vector) {
+    auto& R = core.registers.R;
+    int32_t result;
+    switch (vector - VectorBase) {
+        case Exit:
+            throw GuestExit(static_cast<int32_t>(R[1]));
+        case Read:
+            result = journal ? doJournaledRead(core, R[1], R[2], R[3]) : doRead(core, R[1], R[2], R[3]);
+            break;
+        case Write:
+            result = doWrite(core, R[1], R[2], R[3]);
+            break;
+        case Open:
+            result = doOpen(core, R[1], R[2], R[3]);
+            break;
+        case Close:
+            result = doClose(R[1]);
+            break;
+        case Mmap:
+            result = doMmap(core, R[2], R[4]);
+            break;
+        case Clock:
+            result = doClock(core, R[1], R[2]);
+            break;
+        default:
+            result = -ENOSYS;
+            break;
+    }
+    R[0] = static_cast<uint32_t>(result);
+}
+
+int32_t SyscallEmulator::doRead(CPU& core, uint32_t fd, uint32_t buffer, uint32_t length) {
+    int host = hostDescriptor(fd);
+    if (host < 0) {
+        return -EBADF;
+    }
+    std::vector<iovec> iov;
+    if (!guestBuffer(core, buffer, std::min<uint32_t>(length, INT32_MAX), iov)) {
+        return -EFAULT;
+    }
+    if (captured && host == 0) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        return readCaptured(*captured, iov);
+    }
+    ssize_t n;
+    do {
+        n = ::readv(host, iov.data(), static_cast<int>(iov.size()));
+    } while (n < 0 && errno == EINTR);
+    return n < 0 ? -errno : static_cast<int32_t>(n);
+}
+
+int32_t SyscallEmulator::doJournaledRead(CPU& core, uint32_t fd, uint32_t buffer, uint32_t length) {
+    std::vector<uint8_t> data;
+    int32_t result;
+    if (journal->replaying()) {
+        result = journal->replayRead(data);
+    } else {
+        result = doRead(core, fd, buffer, length);
+    }
+    std::vector<iovec> iov;
+    if (result > 0 && !guestBuffer(core, buffer, static_cast<uint32_t>(result), iov)) {
+        throw ReplayDivergence("a read of " + std::to_string(result) + " bytes no longer fits the guest buffer");
+    }
+    size_t offset = 0;
+    for (const iovec& part : iov) {
+        auto* bytes = static_cast<uint8_t*>(part.iov_base);
+        if (journal->replaying()) {
+            std::memcpy(bytes, data.data() + offset, part.iov_len);
+        } else {
+            data.insert(data.end(), bytes, bytes + part.iov_len);
+        }
+        offset += part.iov_len;
+    }
+    if (!journal->replaying()) {
+        journal->recordRead(result, data);
+    }
+    return result;
+}
+
+int32_t SyscallEmulator::doWrite(CPU& core, uint32_t fd, uint32_t buffer, uint32_t length) {
+    int host = hostDescriptor(fd);
+    if (host < 0) {
+        return -EBADF;
+    }
+    std::vector<iovec> iov;
+    if (!guestBuffer(core, buffer, std::min<uint32_t>(length, INT32_MAX), iov)) {
+        return -EFAULT;
+    }
+    if (captured && (host == 1 || host == 2)) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        return writeCaptured(host == 1 ? captured->output : captured->error, *captured, iov);
+    }
+    if (sandboxed && fd > 2) {
+        return static_cast<int32_t>(std::min<uint32_t>(length, INT32_MAX));
+    }
+    ssize_t n;
+    do {
+        n = ::writev(host, iov.data(), static_cast<int>(iov.size()));
+    } while (n < 0 && errno == EINTR);
+    return n < 0 ? -errno : static_cast<int32_t>(n);
+}
+
+int32_t SyscallEmulator::doOpen(CPU& core, uint32_t path, uint32_t flags, uint32_t mode) {
+    std::string hostPath;
+    for (uint32_t address = path; ; ++address) {
+        if (hostPath.size() == MaxPathLength) {
+            return -ENAMETOOLONG;
+        }
+        const uint8_t* byte = core.memory.physicalSpan(core.memory.translateVirtualAddress(address), 1);
+        if (!byte) {
+            return -EFAULT;
+        }
+        if (*byte == 0) {
+            break;
+        }
+        hostPath.push_back(static_cast<char>(*byte));
+    }
+
+    int hostFlags = O_CLOEXEC;
+    switch (flags & 0x3) {
+        case ReadOnly: hostFlags |= O_RDONLY; break;
+        case WriteOnly: hostFlags |= O_WRONLY; break;
+        case ReadWrite: hostFlags |= O_RDWR; break;
+        default: return -EINVAL;
+    }
+    if (flags & Create) hostFlags |= O_CREAT;
+    if (flags & Truncate) hostFlags |= O_TRUNC;
+    if (flags & Append) hostFlags |= O_APPEND;
+    if (sandboxed) {
+        hostFlags = O_CLOEXEC | O_RDONLY;
+    }
+
+    int host = ::open(hostPath.c_str(), hostFlags, static_cast<mode_t>(mode & 0777));
+    if (host < 0) {
+        return -errno;
+    }
+    std::lock_guard<std::mutex> lock(stateMutex);
+    auto slot = std::find(descriptors.begin(), descriptors.end(), -1);
+    if (slot == descriptors.end() && descriptors.size() == MaxDescriptors) {
+        ::close(host);
+        return -EMFILE;
+    }
+    if (slot != descriptors.end()) {
+        *slot = host;
+        return static_cast<int32_t>(slot - descriptors.begin());
+    }
+    descriptors.push_back(host);
+    return static_cast<int32_t>(descriptors.size() - 1);
+}
+
+int32_t SyscallEmulator::doClose(uint32_t fd) {
+    int host;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (fd >= descriptors.size() || descriptors[fd] < 0) {
+            return -EBADF;
+        }
+        host = descriptors[fd];
+        descriptors[fd] = -1;
+    }
+    // The host's standard streams stay open for the emulator's own output.
+    if (fd > 2 && ::close(host) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+int32_t SyscallEmulator::doMmap(CPU& core, uint32_t length, uint32_t flags) {
+    if (!(flags & MapAnonymous)) {
+        return -ENODEV;
+    }
+    if (length == 0) {
+        return -EINVAL;
+    }
+    uint32_t pages = static_cast<uint32_t>((uint64_t(length) + PageSize - 1) / PageSize);
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (mmapTop < mmapFloor || uint64_t(pages) * PageSize > mmapTop - mmapFloor) {
+        return -ENOMEM;
+    }
+    mmapTop -= pages * PageSize;
+    // Physical RAM may hold stale data from a previous mapping of the same range; anonymous memory is zeroed.
+    if (uint8_t* span = core.memory.physicalSpan(mmapTop, pages * PageSize)) {
+        std::memset(span, 0, pages * PageSize);
+    }
+    return static_cast<int32_t>(mmapTop);
+}
+
+int32_t SyscallEmulator::doClock(CPU& core, uint32_t clockId, uint32_t timespec) {
+    ::timespec now{};
+    clockid_t id = clockId == 0 ? CLOCK_REALTIME : clockId == 1 ? CLOCK_MONOTONIC : clockid_t(-1);
+    if (id == clockid_t(-1)) {
+        return -EINVAL;
+    }
+    uint32_t fields[2];
+    if (journal && journal->replaying()) {
+        journal->replayClock(fields[0], fields[1]);
+    } else {
+        ::clock_gettime(id, &now);
+        fields[0] = static_cast<uint32_t>(now.tv_sec);
+        fields[1] = static_cast<uint32_t>(now.tv_nsec);
+        if (journal) {
+            journal->recordClock(fields[0], fields[1]);
+        }
+    }
+    std::vector<iovec> iov;
+    if (!guestBuffer(core, timespec, sizeof(fields), iov)) {
+        return -EFAULT;
+    }
+    const uint8_t* source = reinterpret_cast<const uint8_t*>(fields);
+    for (const iovec& part : iov) {
+        std::memcpy(part.iov_base, source, part.iov_len);
+        source += part.iov_len;
+    }
+    return 0;
+}
+
+SyscallEmulator::Snapshot SyscallEmulator::snapshot() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    Snapshot state{mmapTop, mmapFloor, {}};
+    for (size_t fd = 3; fd < descriptors.size(); ++fd) {
+        OpenFile& file = state.files.emplace_back();
+        int host = descriptors[fd];
+        if (host < 0) {
+            continue;
+        }
+        std::error_code error;
+        auto path = std::filesystem::read_symlink("/proc/self/fd/" + std::to_string(host), error);
+        if (!error && path.is_absolute()) {
+            file.path = path.string();
+            file.flags = ::fcntl(host, F_GETFL) & (O_ACCMODE | O_APPEND);
+            file.offset = ::lseek(host, 0, SEEK_CUR);
+        }
+    }
+    return state;
+}
+
+void SyscallEmulator::restore(const Snapshot& state) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    for (size_t fd = 3; fd < descriptors.size(); ++fd) {
+        if (descriptors[fd] >= 0) {
+            ::close(descriptors[fd]);
+        }
+    }
+    descriptors.resize(3);
+    for (const OpenFile& file : state.files) {
+        int host = -1;
+        if (!file.path.empty()) {
+            host = ::open(file.path.c_str(), O_CLOEXEC | (sandboxed ? O_RDONLY : file.flags));
+            if (host >= 0 && file.offset > 0 && ::lseek(host, file.offset, SEEK_SET) < 0) {
+                ::close(host);
+                host = -1;
+            }
+        }
+        descriptors.push_back(host);
+    }
+    mmapTop = state.mmapTop;
+    mmapFloor = state.mmapFloor;
+}
+
+bool SyscallEmulator::guestBuffer(CPU& core, uint32_t address, uint32_t length, std::vector<iovec>& out) {
+    out.clear();
+    if (length == 0) {
+        out.push_back({nullptr, 0});
+        return true;
+    }
+    if (core.registers.TPDR == 0) {
+        uint8_t* span = core.memory.physicalSpan(address, length);
+        if (!span) {
+            return false;
+        }
+        out.push_back({span, length});
+        return true;
+    }
+    // Paged guests: translate page by page, merging physically adjacent pages into one iovec.
+    while (length > 0) {
+        uint32_t chunk = std::min(length, PageSize - (address & (PageSize - 1)));
+        uint32_t physical = core.memory.translateVirtualAddress(address);
+        uint8_t* span = core.memory.physicalSpan(physical, chunk);
+        if (!span) {
+            return false;
+        }
+        if (!out.empty() && static_cast<uint8_t*>(out.back().iov_base) + out.back().iov_len == span) {
+            out.back().iov_len += chunk;
+        } else {
+            out.push_back({span, chunk});
+        }
+        address += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+int32_t SyscallEmulator::readCaptured(CapturedStreams& streams, const std::vector<iovec>& iov) {
+    size_t total = 0;
+    for (const iovec& part : iov) {
+        size_t n = std::min(part.iov_len, streams.input.size() - streams.inputOffset);
+        if (n == 0) {
+            break;
+        }
+        std::memcpy(part.iov_base, streams.input.data() + streams.inputOffset, n);
+        streams.inputOffset += n;
+        total += n;
+    }
+    return static_cast<int32_t>(total);
+}
+
+int32_t SyscallEmulator::writeCaptured(std::string& stream, CapturedStreams& streams, const std::vector<iovec>& iov) {
+    size_t total = 0;
+    for (const iovec& part : iov) {
+        size_t n = std::min(part.iov_len, streams.limit - std::min(streams.limit, stream.size()));
+        stream.append(static_cast<const char*>(part.iov_base), n);
+        streams.truncated |= n < part.iov_len;
+        total += part.iov_len;
+    }
+    return static_cast<int32_t>(total);
+}
+
+int SyscallEmulator::hostDescriptor(uint32_t fd) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return fd < descriptors.size() ? descriptors[fd] : -1;
+}
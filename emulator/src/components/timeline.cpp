@@ -0,0 +1,243 @@
+#include <components/timeline.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr int HostProcess = 1;
+    constexpr int VirtualProcess = 2;
+
+    void appendNumber(std::string& out, uint64_t value, int base = 10) {
+        char digits[24];
+        out.append(digits, std::to_chars(digits, digits + sizeof(digits), value, base).ptr);
+    }
+
+    void appendHex(std::string& out, uint64_t value) {
+        out += "0x";
+        appendNumber(out, value, 16);
+    }
+
+    /**
+     * @brief Builds an event name from a prefix, an operand and a suffix, e.g. `interrupt 0xb`.
+     */
+    std::string_view label(char (&buffer)[48], std::string_view prefix, uint64_t operand, int base,
+                           std::string_view suffix = {}) {
+        char* p = std::copy(prefix.begin(), prefix.end(), buffer);
+        if (base == 16) {
+            *p++ = '0';
+            *p++ = 'x';
+        }
+        p = std::to_chars(p, buffer + sizeof(buffer) - suffix.size(), operand, base).ptr;
+        p = std::copy(suffix.begin(), suffix.end(), p);
+        return {buffer, static_cast<size_t>(p - buffer)};
+    }
+
+    /**
+     * @brief Appends `,\n{"name":..,"cat":..,"ph":..,"pid":..,"tid":..,"ts":..`; the caller closes the
+     * object. Host time is in microseconds with nanosecond decimals, virtual time in instructions.
+     */
+    void openEvent(std::string& out, std::string_view name, std::string_view category, char phase, int pid,
+                   uint8_t core, uint64_t hostNs, uint64_t retired) {
+        out += ",\n{\"name\":\"";
+        out += name;
+        out += "\",\"cat\":\"";
+        out += category;
+        out += "\",\"ph\":\"";
+        out += phase;
+        out += "\",\"pid\":";
+        appendNumber(out, static_cast<uint64_t>(pid));
+        out += ",\"tid\":";
+        appendNumber(out, core);
+        out += ",\"ts\":";
+        if (pid == HostProcess) {
+            appendNumber(out, hostNs / 1000);
+            out += '.';
+            out += static_cast<char>('0' + hostNs % 1000 / 100);
+            out += static_cast<char>('0' + hostNs % 100 / 10);
+            out += static_cast<char>('0' + hostNs % 10);
+        } else {
+            appendNumber(out, retired);
+        }
+    }
+
+    bool writeAll(int fd, const char* data, size_t size) noexcept {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
+
+void EventTimeline::Track::handOff() {
+    std::vector<Record> full;
+    full.reserve(BatchSize);
+    full.swap(events);
+    timeline.submit(std::move(full));
+}
+
+EventTimeline::EventTimeline(const std::string& path) : start(std::chrono::steady_clock::now()) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create timeline: " + path);
+    }
+    // The first element carries no comma; every event after it is preceded by one.
+    write("[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"XR-32 (host time)\"}}"
+          ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"XR-32 (virtual time, 1 us = 1 instruction)\"}}");
+    writer = std::thread(&EventTimeline::writerLoop, this);
+}
+
+EventTimeline::~EventTimeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& core : tracks) {
+            if (!core->events.empty()) {
+                pending.push_back(std::move(core->events));
+            }
+        }
+        if (!raises.empty()) {
+            pending.push_back(std::move(raises));
+        }
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    write("\n]\n");
+    ::close(fd);
+}
+
+EventTimeline::Track& EventTimeline::track(uint8_t core) {
+    std::string names;
+    for (int pid : {HostProcess, VirtualProcess}) {
+        names += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":";
+        appendNumber(names, static_cast<uint64_t>(pid));
+        names += ",\"tid\":";
+        appendNumber(names, core);
+        names += ",\"args\":{\"name\":\"cpu";
+        appendNumber(names, core);
+        names += "\"}}";
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    metadata += names;
+    tracks.push_back(std::unique_ptr<Track>(new Track(*this, core)));
+    return *tracks.back();
+}
+
+void EventTimeline::raised(uint8_t core, uint8_t vector) noexcept {
+    const uint64_t host = now();
+    std::lock_guard<std::mutex> lock(mutex);
+    raises.push_back({host, 0, vector, 0, Event::Raise, core});
+    if (raises.size() == BatchSize) {
+        pending.push_back(std::move(raises));
+        raises = {};
+        wake.notify_one();
+    }
+}
+
+void EventTimeline::submit(std::vector<Record>&& batch) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(batch));
+    }
+    wake.notify_one();
+}
+
+void EventTimeline::write(const std::string& text) noexcept {
+    writeAll(fd, text.data(), text.size());
+}
+
+void EventTimeline::writerLoop() noexcept {
+    std::string text;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !pending.empty() || !metadata.empty(); });
+        std::vector<std::vector<Record>> batches;
+        batches.swap(pending);
+        text.swap(metadata);
+        const bool last = stopping;
+        lock.unlock();
+        write(text);
+        text.clear();
+        for (const auto& batch : batches) {
+            for (const Record& record : batch) {
+                format(record, text);
+            }
+            write(text);
+            text.clear();
+        }
+        lock.lock();
+        if (last && pending.empty() && metadata.empty()) {
+            return;
+        }
+    }
+}
+
+void EventTimeline::format(const Record& record, std::string& out) {
+    char name[48];
+    for (int pid : {HostProcess, VirtualProcess}) {
+        auto open = [&](std::string_view title, std::string_view category, char phase) {
+            openEvent(out, title, category, phase, pid, record.core, record.host, record.retired);
+        };
+        switch (record.kind) {
+            case Event::InterruptEntry:
+                open(label(name, "interrupt ", record.a & 0xFF, 16), "interrupt", 'B');
+                out += ",\"args\":{\"error\":";
+                appendNumber(out, record.a >> 8);
+                out += ",\"I0\":\"";
+                appendHex(out, record.b);
+                out += "\"}}";
+                break;
+            case Event::InterruptExit:
+                open("interrupt", "interrupt", 'E');
+                out += '}';
+                break;
+            case Event::SyscallEntry:
+                open(label(name, "syscall ", record.a, 16), "syscall", 'B');
+                out += '}';
+                break;
+            case Event::SyscallExit:
+                open("syscall", "syscall", 'E');
+                out += '}';
+                break;
+            case Event::Mode:
+                // Counters belong to the process, so the core is named in the counter
+                open(label(name, "cpu", record.core, 10, " kernel mode"), "mode", 'C');
+                out += ",\"args\":{\"kernel\":";
+                out += record.a ? '1' : '0';
+                out += "}}";
+                break;
+            case Event::PortIn:
+            case Event::PortOut:
+                open(label(name, record.kind == Event::PortIn ? "in " : "out ", record.a, 16), "port", 'i');
+                out += ",\"s\":\"t\",\"args\":{\"value\":\"";
+                appendHex(out, record.b);
+                out += "\"}}";
+                break;
+            case Event::HaltEntry:
+                open("HLT", "idle", 'B');
+                out += '}';
+                break;
+            case Event::HaltExit:
+                open("HLT", "idle", 'E');
+                out += '}';
+                break;
+            case Event::Raise:
+                if (pid == HostProcess) {
+                    open(label(name, "raise ", record.a, 16), "device", 'i');
+                    out += ",\"s\":\"t\"}";
+                }
+                break;
+        }
+    }
+}
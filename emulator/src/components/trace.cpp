@@ -0,0 +1,404 @@
+#include <components/trace.hpp>
+#include <components/cpu.hpp>
+#include <utils/disassembler.hpp>
+#include <utils/mapped_file.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+    constexpr char Magic[8] = {'X', 'R', '3', '2', 'T', 'R', 'C', 'E'};
+    constexpr uint32_t Version = 1;
+
+    /**
+     * @brief Precedes every block.
+     */
+    struct BlockHeader {
+        uint8_t core;
+        uint8_t deflated;
+        uint16_t reserved;
+        uint32_t size;       ///< Bytes of records.
+        uint32_t storedSize; ///< Bytes that follow the header.
+        uint32_t reserved2;
+        uint64_t first;      ///< Index of the block's first record in the core's trace.
+    };
+
+    bool writeAll(int fd, const uint8_t* data, size_t size) noexcept {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    uint64_t zigzag(int64_t value) noexcept {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) noexcept {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    /// Register indices as recorded: general registers by number, then S0 and FR by their encodings.
+    constexpr uint8_t S0Index = 0x21;
+    constexpr uint8_t FRIndex = 0x23;
+
+    /**
+     * @brief Decoding state of one core, carried from block to block.
+     */
+    struct CoreState {
+        uint32_t expected{0};
+        std::array<std::pair<uint32_t, uint64_t>, 4096> words{};
+        uint64_t next{0}; ///< Index of the next record.
+    };
+
+    class BlockReader {
+    public:
+        BlockReader(const uint8_t* data, size_t size) : position(data), end(data + size) {}
+
+        [[nodiscard]] bool done() const noexcept { return position == end; }
+
+        uint8_t byte() {
+            if (position == end) {
+                throw std::runtime_error("Truncated trace record");
+            }
+            return *position++;
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                uint8_t b = byte();
+                value |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) {
+                    return value;
+                }
+            }
+            throw std::runtime_error("Malformed varint in trace");
+        }
+
+        uint64_t word() {
+            if (end - position < 8) {
+                throw std::runtime_error("Truncated trace record");
+            }
+            uint64_t value;
+            std::memcpy(&value, position, sizeof(value));
+            position += sizeof(value);
+            return value;
+        }
+
+    private:
+        const uint8_t* position;
+        const uint8_t* end;
+    };
+
+    void appendHex(std::string& out, uint64_t value, int digits) {
+        static constexpr char Hex[] = "0123456789abcdef";
+        for (int i = digits - 1; i >= 0; --i) {
+            out += Hex[(value >> (i * 4)) & 0xF];
+        }
+    }
+}
+
+InstructionTrace::Recorder::Recorder(InstructionTrace& owner, uint8_t core) : trace(owner), coreId(core) {
+    for (uint32_t i = 1; i < RingChunks; ++i) {
+        spare.push(i);
+    }
+    cursor = chunks[current].data.get();
+}
+
+void InstructionTrace::Recorder::end(const std::array<uint32_t, 32>& R, uint32_t S0, uint8_t FR) {
+    Chunk& chunk = chunks[current];
+    if (static_cast<size_t>(cursor - chunk.data.get()) > ChunkSize - MaxRecordSize) [[unlikely]] {
+        handOff();
+    }
+    uint8_t* header = cursor++;
+    uint8_t flags = 0;
+    if (pc != expected) {
+        flags |= Jump;
+        putVarint(zigzag(static_cast<int64_t>(pc) - static_cast<int64_t>(expected)));
+    }
+    expected = pc + sizeof(uint64_t);
+
+    auto& cached = words[(pc >> 3) & (words.size() - 1)];
+    if (cached.first != pc || cached.second != instruction) {
+        cached = {pc, instruction};
+        flags |= Word;
+        std::memcpy(cursor, &instruction, sizeof(instruction));
+        cursor += sizeof(instruction);
+    }
+
+    uint8_t* count = nullptr;
+    auto registerWrite = [&](uint8_t index, uint32_t value) {
+        if (!count) {
+            flags |= Registers;
+            count = cursor++;
+            *count = 0;
+        }
+        ++*count;
+        *cursor++ = index;
+        putVarint(value);
+    };
+    for (uint8_t i = 0; i < R.size(); ++i) {
+        if (R[i] != before.R[i]) {
+            registerWrite(i, R[i]);
+        }
+    }
+    if (S0 != before.S0) {
+        registerWrite(S0Index, S0);
+    }
+    if (FR != before.FR) {
+        registerWrite(FRIndex, FR);
+    }
+
+    if (accessCount) {
+        flags |= Accesses;
+        *cursor++ = static_cast<uint8_t>(accessCount);
+        for (size_t i = 0; i < accessCount; ++i) {
+            *cursor++ = accesses[i].write;
+            putVarint(accesses[i].address);
+            putVarint(accesses[i].value);
+        }
+    }
+    *header = flags;
+    ++records;
+}
+
+void InstructionTrace::Recorder::handOff() {
+    Chunk& chunk = chunks[current];
+    chunk.size = static_cast<size_t>(cursor - chunk.data.get());
+    if (chunk.size == 0) {
+        return;
+    }
+    filled.push(current);
+    trace.wake();
+    std::optional<uint32_t> next;
+    while (!(next = spare.pop())) {
+        // Every chunk is waiting for the writer: hold the core back rather than lose records.
+        trace.wake();
+        std::this_thread::yield();
+    }
+    current = *next;
+    chunks[current].first = records;
+    cursor = chunks[current].data.get();
+}
+
+InstructionTrace::InstructionTrace(const std::string& path, bool compress) : compressBlocks(compress) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create trace: " + path);
+    }
+    uint8_t header[sizeof(Magic) + sizeof(Version)];
+    std::memcpy(header, Magic, sizeof(Magic));
+    std::memcpy(header + sizeof(Magic), &Version, sizeof(Version));
+    if (!writeAll(fd, header, sizeof(header))) {
+        ::close(fd);
+        throw std::runtime_error("Failed to write trace: " + path);
+    }
+    writer = std::thread(&InstructionTrace::writerLoop, this);
+}
+
+InstructionTrace::~InstructionTrace() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& core : recorders) {
+            Recorder::Chunk& chunk = core->chunks[core->current];
+            chunk.size = static_cast<size_t>(core->cursor - chunk.data.get());
+            if (chunk.size) {
+                core->filled.push(core->current);
+            }
+        }
+        stopping.store(true, std::memory_order_release);
+    }
+    pending.notify_one();
+    writer.join();
+    ::close(fd);
+}
+
+InstructionTrace::Recorder& InstructionTrace::recorder(uint8_t core) {
+    std::lock_guard<std::mutex> lock(mutex);
+    recorders.push_back(std::unique_ptr<Recorder>(new Recorder(*this, core)));
+    return *recorders.back();
+}
+
+void InstructionTrace::wake() noexcept {
+    pending.notify_one();
+}
+
+bool InstructionTrace::writeChunks(Recorder& core) {
+    bool wrote = false;
+    std::vector<uint8_t> packed;
+    while (auto index = core.filled.pop()) {
+        Recorder::Chunk& chunk = core.chunks[*index];
+        BlockHeader header{core.coreId, 0, 0, static_cast<uint32_t>(chunk.size), static_cast<uint32_t>(chunk.size), 0, chunk.first};
+        const uint8_t* data = chunk.data.get();
+        if (compressBlocks) {
+            uLongf size = compressBound(static_cast<uLong>(chunk.size));
+            packed.resize(size);
+            if (compress2(packed.data(), &size, data, static_cast<uLong>(chunk.size), Z_BEST_SPEED) == Z_OK) {
+                header.deflated = 1;
+                header.storedSize = static_cast<uint32_t>(size);
+                data = packed.data();
+            }
+        }
+        writeAll(fd, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+        writeAll(fd, data, header.storedSize);
+        core.spare.push(*index);
+        wrote = true;
+    }
+    return wrote;
+}
+
+void InstructionTrace::writerLoop() noexcept {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        bool wrote = false;
+        for (auto& core : recorders) {
+            wrote |= writeChunks(*core);
+        }
+        if (wrote) {
+            continue;
+        }
+        if (stopping.load(std::memory_order_acquire)) {
+            return;
+        }
+        // The timeout covers a hand-off that raced with going to sleep.
+        pending.wait_for(lock, std::chrono::milliseconds(10));
+    }
+}
+
+uint64_t InstructionTrace::decode(const std::string& path, std::ostream& out, uint32_t low, uint64_t high) {
+    MappedFile file(path);
+    std::string_view data = file.view();
+    uint32_t version = 0;
+    if (data.size() < sizeof(Magic) + sizeof(Version) || std::memcmp(data.data(), Magic, sizeof(Magic)) != 0 ||
+        (std::memcpy(&version, data.data() + sizeof(Magic), sizeof(version)), version != Version)) {
+        throw std::runtime_error("Not a trace of this emulator version: " + path);
+    }
+    data.remove_prefix(sizeof(Magic) + sizeof(Version));
+
+    // Name the cores on every line if any block comes from a secondary core.
+    bool multicore = false;
+    for (std::string_view rest = data; rest.size() >= sizeof(BlockHeader);) {
+        BlockHeader header;
+        std::memcpy(&header, rest.data(), sizeof(header));
+        multicore |= header.core != 0;
+        rest.remove_prefix(std::min<size_t>(rest.size(), sizeof(header) + header.storedSize));
+    }
+
+    std::array<std::unique_ptr<CoreState>, 256> cores;
+    std::vector<uint8_t> inflated(ChunkSize);
+    std::string text;
+    uint64_t listed = 0;
+    while (!data.empty()) {
+        BlockHeader header;
+        if (data.size() < sizeof(header)) {
+            throw std::runtime_error("Truncated trace block in " + path);
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        data.remove_prefix(sizeof(header));
+        if (data.size() < header.storedSize || header.size > ChunkSize) {
+            throw std::runtime_error("Truncated trace block in " + path);
+        }
+        const auto* stored = reinterpret_cast<const uint8_t*>(data.data());
+        data.remove_prefix(header.storedSize);
+        const uint8_t* records = stored;
+        if (header.deflated) {
+            uLongf size = ChunkSize;
+            if (uncompress(inflated.data(), &size, stored, header.storedSize) != Z_OK || size != header.size) {
+                throw std::runtime_error("Corrupt trace block in " + path);
+            }
+            records = inflated.data();
+        }
+
+        auto& state = cores[header.core];
+        if (!state) {
+            state = std::make_unique<CoreState>();
+        }
+        state->next = header.first;
+        BlockReader reader(records, header.size);
+        while (!reader.done()) {
+            const uint8_t flags = reader.byte();
+            uint32_t pc = state->expected;
+            if (flags & Jump) {
+                pc = static_cast<uint32_t>(static_cast<int64_t>(pc) + unzigzag(reader.varint()));
+            }
+            state->expected = pc + sizeof(uint64_t);
+            auto& cached = state->words[(pc >> 3) & (state->words.size() - 1)];
+            if (flags & Word) {
+                cached = {pc, reader.word()};
+            } else if (cached.first != pc) {
+                throw std::runtime_error("Corrupt trace: no word for 0x" + std::to_string(pc));
+            }
+            const uint64_t index = state->next++;
+            const bool shown = pc >= low && pc < high;
+            if (shown) {
+                if (multicore) {
+                    text += "cpu";
+                    text += std::to_string(header.core);
+                    text += ' ';
+                }
+                text += '#';
+                text += std::to_string(index);
+                text += "  ";
+                appendHex(text, pc, 8);
+                text += ":  ";
+                appendHex(text, cached.second, 16);
+                text += "  ";
+                text += Disassembler::disassembleInstruction(cached.second, pc);
+            }
+            if (flags & Registers) {
+                for (uint8_t n = reader.byte(); n > 0; --n) {
+                    const uint8_t reg = reader.byte();
+                    const auto value = static_cast<uint32_t>(reader.varint());
+                    if (shown) {
+                        text += "  ";
+                        text += CPU::findRegister(reg);
+                        text += "=0x";
+                        appendHex(text, value, reg == FRIndex ? 2 : 8);
+                    }
+                }
+            }
+            if (flags & Accesses) {
+                for (uint8_t n = reader.byte(); n > 0; --n) {
+                    const bool write = reader.byte();
+                    const auto address = static_cast<uint32_t>(reader.varint());
+                    const auto value = static_cast<uint32_t>(reader.varint());
+                    if (shown) {
+                        text += write ? "  [0x" : "  0x";
+                        if (write) {
+                            appendHex(text, address, 8);
+                            text += "]<-0x";
+                            appendHex(text, value, 8);
+                        } else {
+                            appendHex(text, value, 8);
+                            text += "<-[0x";
+                            appendHex(text, address, 8);
+                            text += ']';
+                        }
+                    }
+                }
+            }
+            if (shown) {
+                text += '\n';
+                ++listed;
+                if (text.size() >= (1 << 20)) {
+                    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+                    text.clear();
+                }
+            }
+        }
+    }
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    return listed;
+}
@@ -0,0 +1,96 @@
+#include <emulator.hpp>
+#include <utils/assembler.hpp>
+#include <utils/mapped_file.hpp>
+#include <utils/object_file.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+Emulator::Emulator(size_t memorySize) : cpu(memorySize) {
+    if (auto directory = BuildCache::defaultDirectory()) {
+        cache.emplace(*directory);
+    }
+}
+
+uint32_t Emulator::loadProgram(std::string_view filepath, uint32_t paddr, bool assemble) {
+    ProgramImage program = readProgram(filepath, assemble, cache ? &*cache : nullptr);
+    const uint32_t start = program.origin.value_or(paddr);
+    uint8_t* target = cpu.memory.physicalSpan(start, program.bytes.size());
+    if (!target) {
+        throw std::runtime_error("Program exceeds available memory size");
+    }
+    std::memcpy(target, program.bytes.data(), program.bytes.size());
+    cpu.registers.I0 = start;
+    return start + static_cast<uint32_t>(program.bytes.size());
+}
+
+Emulator::ProgramImage Emulator::readProgram(std::string_view filepath, bool assemble, const BuildCache* cache) {
+    if (!assemble) {
+        std::ifstream file{std::string(filepath), std::ios::binary};
+        if (!file) {
+            throw std::runtime_error("Could not open binary file: " + std::string(filepath));
+        }
+        std::vector<uint8_t> program((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (ObjectFile::isObject({reinterpret_cast<const char*>(program.data()), program.size()})) {
+            throw std::runtime_error(std::string(filepath) + " is an object file; link it with --link first");
+        }
+        return {std::move(program), std::nullopt};
+    }
+
+    // A cache entry is the origin, 4 bytes little-endian, followed by the image.
+    MappedFile source{std::string(filepath)};
+    std::string key = BuildCache::key(source.view(), Assembler::Version);
+    if (cache) {
+        if (auto entry = cache->load(key); entry && entry->size() >= sizeof(uint32_t)) {
+            uint32_t origin;
+            std::memcpy(&origin, entry->data(), sizeof(origin));
+            entry->erase(entry->begin(), entry->begin() + sizeof(origin));
+            return {std::move(*entry), origin};
+        }
+    }
+    Assembler assembler;
+    std::vector<uint8_t> program;
+    try {
+        program = assembler.assemble(source.view());
+    } catch (const std::exception& e) {
+        throw std::runtime_error(std::string(filepath) + ": " + e.what());
+    }
+    const uint32_t origin = assembler.imageOrigin();
+    if (cache) {
+        std::vector<uint8_t> entry(sizeof(origin) + program.size());
+        std::memcpy(entry.data(), &origin, sizeof(origin));
+        std::copy(program.begin(), program.end(), entry.begin() + sizeof(origin));
+        cache->store(key, entry);
+    }
+    return {std::move(program), origin};
+}
+
+bool Emulator::isAssemblySource(std::string_view filepath) noexcept {
+    return filepath.ends_with(".s") || filepath.ends_with(".asm");
+}
+
+void Emulator::run() {
+    try {
+        for (uint64_t cycle = 1; ; ++cycle) {
+            executeCycle();
+            if ((cycle & 0x3FF) == 0 || cpu.halted()) {
+                cpu.io.poll();
+            }
+        }
+    } catch (const CpuHalted&) {
+        // The core stopped for good
+    }
+}
+
+void Emulator::reset() {
+    cpu.reset();
+    cpu.memory.reset();
+    cpu.memory.flushTlb();
+}
+
+void Emulator::executeCycle() {
+    cpu.executeNextInstruction();
+}
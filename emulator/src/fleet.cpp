@@ -0,0 +1,358 @@
+#include <fleet.hpp>
+#include <components/cpu.hpp>
+#include <components/lockstep.hpp>
+#include <components/io_extern/channel.hpp>
+#include <components/syscalls.hpp>
+#include <utils/json.hpp>
+#include <utils/work_stealing_pool.hpp>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+namespace {
+    constexpr uint32_t LoadAddress = 0x1000;
+
+    using Image = std::shared_ptr<const std::string>;
+
+    /**
+     * @brief A job's connection to a channel: the channel (nullptr if it could not be created) and its endpoint.
+     */
+    struct Endpoint {
+        std::string name;
+        std::shared_ptr<Channel> channel;
+        unsigned index;
+    };
+
+    Image readImage(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return nullptr;
+        }
+        return std::make_shared<const std::string>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    uint64_t microsecondsSince(std::chrono::steady_clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    /**
+     * @brief A loaded user-mode guest with captured standard streams, ready to run.
+     */
+    struct Guest {
+        Guest(const FleetJob& job, const std::string& program, const Image& input, const std::vector<Endpoint>& endpoints)
+            : cpu(job.memorySize), syscalls(cpu, LoadAddress + static_cast<uint32_t>(program.size())) {
+            uint8_t* image = cpu.memory.physicalSpan(LoadAddress, program.size());
+            if (!image) {
+                throw std::runtime_error("Program exceeds available memory size");
+            }
+            std::memcpy(image, program.data(), program.size());
+            cpu.registers.I0 = LoadAddress;
+            if (input) {
+                streams.input = *input;
+            }
+            syscalls.captureStandardStreams(&streams);
+            syscalls.attach(cpu);
+            // Windows go above RAM, so they are mapped after the syscall layer has placed the stack.
+            for (const Endpoint& endpoint : endpoints) {
+                if (!endpoint.channel) {
+                    throw std::runtime_error("Could not create channel " + endpoint.name);
+                }
+                auto base = static_cast<uint16_t>(ChannelDevice::DefaultBase + channels.size() * ChannelDevice::PortStride);
+                channels.push_back(std::make_unique<ChannelDevice>(cpu, endpoint.channel, endpoint.index));
+                channels.back()->attach(cpu.io, base);
+            }
+        }
+
+        void collect(FleetResult& result) {
+            result.output = std::move(streams.output);
+            result.error = std::move(streams.error);
+            result.truncated = streams.truncated;
+        }
+
+        CPU cpu;
+        SyscallEmulator syscalls;
+        SyscallEmulator::CapturedStreams streams;
+        std::vector<std::unique_ptr<ChannelDevice>> channels; ///< Disconnected first, waking the peers.
+    };
+
+    std::unique_ptr<Guest> loadGuest(const FleetJob& job, const Image& program, const Image& input,
+                                     const std::vector<Endpoint>& endpoints = {}) {
+        if (!program) {
+            throw std::runtime_error("Could not open binary file: " + job.binary);
+        }
+        if (!job.input.empty() && !input) {
+            throw std::runtime_error("Could not open input file: " + job.input);
+        }
+        return std::make_unique<Guest>(job, *program, input, endpoints);
+    }
+
+    void runJob(const FleetJob& job, const Image& program, const Image& input, const std::vector<Endpoint>& endpoints,
+                FleetResult& result) noexcept {
+        auto start = std::chrono::steady_clock::now();
+        try {
+            auto guest = loadGuest(job, program, input, endpoints);
+            result.status = FleetResult::Status::BudgetExhausted;
+            try {
+                for (; result.instructions < job.budget; ++result.instructions) {
+                    guest->cpu.executeNextInstruction();
+                }
+            } catch (const GuestExit& exit) {
+                ++result.instructions;
+                result.status = FleetResult::Status::Exited;
+                result.exitCode = exit.status();
+            } catch (const CpuHalted&) {
+                ++result.instructions;
+                result.status = FleetResult::Status::Halted;
+            }
+            guest->collect(result);
+        } catch (const std::exception& e) {
+            result.status = FleetResult::Status::Error;
+            result.message = e.what();
+        }
+        result.microseconds = microsecondsSince(start);
+    }
+
+    /**
+     * @brief Runs jobs that share a binary, memory size and budget as the lanes of one LockstepGroup.
+     */
+    void runBatch(const std::vector<FleetJob>& jobs, const std::vector<size_t>& batch,
+                  const std::map<std::string, Image>& images, std::vector<FleetResult>& results) noexcept {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::unique_ptr<Guest>> guests;
+        std::vector<CPU*> cpus;
+        std::vector<size_t> laneJobs;
+        for (size_t index : batch) {
+            const FleetJob& job = jobs[index];
+            try {
+                Image input = job.input.empty() ? nullptr : images.at(job.input);
+                guests.push_back(loadGuest(job, images.at(job.binary), input));
+                cpus.push_back(&guests.back()->cpu);
+                laneJobs.push_back(index);
+            } catch (const std::exception& e) {
+                results[index].status = FleetResult::Status::Error;
+                results[index].message = e.what();
+            }
+        }
+
+        if (!cpus.empty()) {
+            const FleetJob& first = jobs[laneJobs.front()];
+            uint32_t imageEnd = LoadAddress + static_cast<uint32_t>(images.at(first.binary)->size());
+            try {
+                LockstepGroup group(cpus, first.budget, LoadAddress, imageEnd);
+                group.run();
+                for (size_t lane = 0; lane < laneJobs.size(); ++lane) {
+                    const LockstepGroup::LaneOutcome& outcome = group.outcome(static_cast<unsigned>(lane));
+                    FleetResult& result = results[laneJobs[lane]];
+                    switch (outcome.status) {
+                        case LockstepGroup::LaneStatus::Exited: result.status = FleetResult::Status::Exited; break;
+                        case LockstepGroup::LaneStatus::Halted: result.status = FleetResult::Status::Halted; break;
+                        case LockstepGroup::LaneStatus::BudgetExhausted:
+                            result.status = FleetResult::Status::BudgetExhausted;
+                            break;
+                        default: result.status = FleetResult::Status::Error; break;
+                    }
+                    result.exitCode = outcome.exitCode;
+                    result.instructions = outcome.instructions;
+                    result.message = outcome.message;
+                    guests[lane]->collect(result);
+                }
+            } catch (const std::exception& e) {
+                for (size_t index : laneJobs) {
+                    results[index].status = FleetResult::Status::Error;
+                    results[index].message = e.what();
+                }
+            }
+        }
+
+        // Lanes run interleaved, so each reports the wall time of the whole batch.
+        uint64_t elapsed = microsecondsSince(start);
+        for (size_t index : batch) {
+            results[index].microseconds = elapsed;
+        }
+    }
+
+    std::string_view statusName(FleetResult::Status status) {
+        switch (status) {
+            case FleetResult::Status::Exited: return "exited";
+            case FleetResult::Status::Halted: return "halted";
+            case FleetResult::Status::BudgetExhausted: return "budget";
+            case FleetResult::Status::Error: return "error";
+        }
+        return "error";
+    }
+}
+
+std::vector<FleetJob> Fleet::parseJobs(const std::string& path, const Defaults& defaults) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not open job file: " + path);
+    }
+    std::filesystem::path base = std::filesystem::path(path).parent_path();
+    auto resolve = [&base](const std::string& relative) {
+        std::filesystem::path p(relative);
+        return (p.is_relative() ? base / p : p).string();
+    };
+
+    std::vector<FleetJob> jobs;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        std::istringstream fields(line);
+        std::string binary;
+        if (!(fields >> binary) || binary.starts_with('#')) {
+            continue;
+        }
+        FleetJob job{resolve(binary), {}, defaults.budget, defaults.memorySize, {}};
+        std::string field;
+        while (fields >> field) {
+            auto equal = field.find('=');
+            std::string key = field.substr(0, equal);
+            std::string value = equal == std::string::npos ? std::string() : field.substr(equal + 1);
+            try {
+                if (key == "input" && !value.empty()) {
+                    job.input = resolve(value);
+                } else if (key == "budget") {
+                    job.budget = std::stoull(value);
+                } else if (key == "mem") {
+                    job.memorySize = std::stoull(value);
+                } else if (key == "channel" && !value.empty()) {
+                    job.channels.push_back(value);
+                } else {
+                    throw std::invalid_argument(field);
+                }
+            } catch (const std::exception&) {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": invalid field '" + field + "'");
+            }
+        }
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+std::vector<FleetResult> Fleet::run(const std::vector<FleetJob>& jobs, unsigned threads, unsigned lanes) {
+    // Every distinct file is read once, before any job starts, and then only shared read-only.
+    std::map<std::string, Image> images;
+    for (const FleetJob& job : jobs) {
+        for (const std::string* path : {&job.binary, &job.input}) {
+            if (!path->empty() && !images.contains(*path)) {
+                images.emplace(*path, readImage(*path));
+            }
+        }
+    }
+
+    // Every job naming a channel is one of its endpoints, numbered in job order.
+    std::map<std::string, unsigned> endpointCounts;
+    for (const FleetJob& job : jobs) {
+        for (const std::string& name : job.channels) {
+            ++endpointCounts[name];
+        }
+    }
+    std::map<std::string, std::shared_ptr<Channel>> channels;
+    for (const auto& [name, count] : endpointCounts) {
+        try {
+            channels[name] = std::make_shared<Channel>(name, Channel::DefaultSize, count);
+        } catch (const std::exception&) {
+            channels[name] = nullptr; // Reported by every job using it
+        }
+    }
+    std::vector<std::vector<Endpoint>> endpoints(jobs.size());
+    std::map<std::string, unsigned> nextEndpoint;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        for (const std::string& name : jobs[i].channels) {
+            endpoints[i].push_back({name, channels[name], nextEndpoint[name]++});
+        }
+    }
+
+    std::vector<FleetResult> results(jobs.size());
+
+    // Connected jobs wait for each other, so each gets its own thread instead of a pool slot.
+    std::vector<std::thread> connected;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (!endpoints[i].empty()) {
+            connected.emplace_back([&, i]() {
+                const FleetJob& job = jobs[i];
+                runJob(job, images.at(job.binary), job.input.empty() ? nullptr : images.at(job.input), endpoints[i], results[i]);
+            });
+        }
+    }
+
+    {
+        WorkStealingPool pool(threads);
+        if (lanes > 1) {
+            // Jobs that can share a lockstep group, in job order, split into groups of `lanes`.
+            std::map<std::tuple<std::string, size_t, uint64_t>, std::vector<size_t>> pending;
+            std::vector<std::vector<size_t>> batches;
+            for (size_t i = 0; i < jobs.size(); ++i) {
+                if (!endpoints[i].empty()) {
+                    continue;
+                }
+                auto& batch = pending[{jobs[i].binary, jobs[i].memorySize, jobs[i].budget}];
+                batch.push_back(i);
+                if (batch.size() == lanes) {
+                    batches.push_back(std::move(batch));
+                    batch.clear();
+                }
+            }
+            for (auto& [key, batch] : pending) {
+                if (!batch.empty()) {
+                    batches.push_back(std::move(batch));
+                }
+            }
+            for (const auto& batch : batches) {
+                pool.submit([&jobs, &batch, &images, &results]() { runBatch(jobs, batch, images, results); });
+            }
+            pool.wait();
+        } else {
+            for (size_t i = 0; i < jobs.size(); ++i) {
+                if (!endpoints[i].empty()) {
+                    continue;
+                }
+                const FleetJob& job = jobs[i];
+                Image program = images.at(job.binary);
+                Image input = job.input.empty() ? nullptr : images.at(job.input);
+                pool.submit([&job, program, input, &result = results[i]]() { runJob(job, program, input, {}, result); });
+            }
+            pool.wait();
+        }
+    }
+    for (std::thread& thread : connected) {
+        thread.join();
+    }
+    return results;
+}
+
+void Fleet::writeReport(std::ostream& out, const std::vector<FleetJob>& jobs, const std::vector<FleetResult>& results) {
+    for (size_t i = 0; i < results.size(); ++i) {
+        const FleetResult& result = results[i];
+        out << "{\"job\":" << i << ",\"binary\":";
+        writeJsonString(out, jobs[i].binary);
+        if (!jobs[i].input.empty()) {
+            out << ",\"input\":";
+            writeJsonString(out, jobs[i].input);
+        }
+        out << ",\"status\":\"" << statusName(result.status) << '"';
+        if (result.status == FleetResult::Status::Exited) {
+            out << ",\"exit_code\":" << result.exitCode;
+        }
+        if (result.status == FleetResult::Status::Error) {
+            out << ",\"message\":";
+            writeJsonString(out, result.message);
+        }
+        out << ",\"instructions\":" << result.instructions << ",\"microseconds\":" << result.microseconds << ",\"stdout\":";
+        writeJsonString(out, result.output);
+        out << ",\"stderr\":";
+        writeJsonString(out, result.error);
+        if (result.truncated) {
+            out << ",\"truncated\":true";
+        }
+        out << "}\n";
+    }
+}
@@ -4,9 +4,32 @@
 #include <fstream>
 #include <utils/argparser.hpp>
 #include <utils/assembler.hpp>
+#include <utils/disassembler.hpp>
+#include <utils/linker.hpp>
 #include <components/cpu.hpp>
+#include <components/io_extern/output_sink.hpp>
+#include <components/io_extern/input_source.hpp>
+#include <components/io_extern/serial.hpp>
+#include <components/io_extern/debugcon.hpp>
+#include <components/io_extern/packet.hpp>
+#include <components/io_extern/device_host.hpp>
+#include <components/io_extern/disk.hpp>
+#include <components/syscalls.hpp>
+#include <components/journal.hpp>
+#include <components/trace.hpp>
+#include <components/timeline.hpp>
+#include <components/snapshot.hpp>
+#include <components/smp.hpp>
+#include <components/lockstep.hpp>
+#include <fleet.hpp>
+#include <sampler.hpp>
+#include <memory>
 #include <optional>
 #include <iomanip>
+#include <chrono>
+#include <limits>
+#include <csignal>
+#include <filesystem>
 
 constexpr std::string_view resetColor = "\033[0m";
 constexpr std::string_view boldColor = "\033[1m";
@@ -14,10 +37,15 @@ constexpr std::string_view yellowColor = "\033[33m";
 constexpr std::string_view greenColor = "\033[32m";
 constexpr std::string_view cyanColor = "\033[36m";
 
+volatile std::sig_atomic_t snapshotRequested = 0; ///< Set by SIGUSR1 while --save is active.
+
 struct Config {
     std::optional<std::string> assembleFile;
     std::optional<std::string> outputFile;
     std::optional<std::string> disassembleFile;
+    std::optional<std::string> symbolFile;
+    std::optional<std::string> baseAddress;
+    std::optional<std::string> graphFile;
     std::optional<std::string> emulateFile;
     std::optional<std::string> hddImage;
     std::optional<std::string> floppyImage;
@@ -25,8 +53,35 @@ struct Config {
     std::optional<std::string> memSize;
     std::optional<std::string> serialOutput;
     std::optional<std::string> debugconOutput;
+    std::optional<std::string> netdev;
     std::optional<std::string> dumpCondition;
-    bool trace = false;
+    std::optional<std::string> smp;
+    std::optional<std::string> recordFile;
+    std::optional<std::string> replayFile;
+    std::optional<std::string> saveFile;
+    std::optional<std::string> saveAt;
+    std::optional<std::string> parentFile;
+    std::optional<std::string> restoreFile;
+    std::optional<std::string> fleetFile;
+    std::optional<std::string> threads;
+    std::optional<std::string> budget;
+    std::optional<std::string> lockstep;
+    std::optional<std::string> sampleFile;
+    std::optional<std::string> interval;
+    std::optional<std::string> clusters;
+    std::optional<std::string> inputFile;
+    std::optional<std::string> traceFile;
+    std::optional<std::string> traceDecodeFile;
+    std::optional<std::string> traceRange;
+    std::optional<std::string> timelineFile;
+    std::vector<std::string> linkObjects;
+    bool link = false;
+    bool object = false;
+    bool incremental = false;
+    bool traceUncompressed = false;
+    bool saveUncompressed = false;
+    bool userMode = false;
+    bool noCache = false;
     bool showHelp = false;
     bool showVersion = false;
 };
@@ -43,9 +98,17 @@ namespace config {
     constexpr std::string_view assembleShort = "-a";
     constexpr std::string_view outputFlag = "--output";
     constexpr std::string_view outputShort = "-o";
+    constexpr std::string_view objectFlag = "--object";
+    constexpr std::string_view objectShort = "-c";
+
+    constexpr std::string_view linkFlag = "--link";
+    constexpr std::string_view incrementalFlag = "--incremental";
 
     constexpr std::string_view disassembleFlag = "--disassemble";
     constexpr std::string_view disassembleShort = "-d";
+    constexpr std::string_view symbolsFlag = "--symbols";
+    constexpr std::string_view baseFlag = "--base";
+    constexpr std::string_view cfgFlag = "--cfg";
     constexpr std::string_view emulateFlag = "--emulate";
     constexpr std::string_view emulateShort = "-e";
     constexpr std::string_view hddFlag = "--harddisk";
@@ -54,9 +117,35 @@ namespace config {
     constexpr std::string_view memFlag = "--mem";
     constexpr std::string_view serialFlag = "--serial";
     constexpr std::string_view debugconFlag = "--debugcon";
+    constexpr std::string_view netdevFlag = "--netdev";
+    constexpr std::string_view userFlag = "--user";
+    constexpr std::string_view noCacheFlag = "--no-cache";
+    constexpr std::string_view smpFlag = "--smp";
     constexpr std::string_view traceFlag = "--trace";
+    constexpr std::string_view traceUncompressedFlag = "--trace-uncompressed";
+    constexpr std::string_view timelineFlag = "--timeline";
+    constexpr std::string_view recordFlag = "--record";
+    constexpr std::string_view replayFlag = "--replay";
+    constexpr std::string_view saveFlag = "--save";
+    constexpr std::string_view saveAtFlag = "--save-at";
+    constexpr std::string_view parentFlag = "--parent";
+    constexpr std::string_view saveUncompressedFlag = "--save-uncompressed";
+    constexpr std::string_view restoreFlag = "--restore";
     constexpr std::string_view dumpFlag = "--dump";
     constexpr std::string_view dumpShort = "-D";
+
+    constexpr std::string_view fleetFlag = "--fleet";
+    constexpr std::string_view threadsFlag = "--threads";
+    constexpr std::string_view budgetFlag = "--budget";
+    constexpr std::string_view lockstepFlag = "--lockstep";
+
+    constexpr std::string_view sampleFlag = "--sample";
+    constexpr std::string_view intervalFlag = "--interval";
+    constexpr std::string_view clustersFlag = "--clusters";
+    constexpr std::string_view inputFlag = "--input";
+
+    constexpr std::string_view traceDecodeFlag = "--trace-decode";
+    constexpr std::string_view traceRangeFlag = "--trace-range";
 }
 
 void printHelp() {
@@ -70,16 +159,28 @@ void printHelp() {
               << greenColor << "                            " << resetColor << "Assemble the specified XR-32 assembly source file into a binary file\n"
               << yellowColor << "  -o, --output <output_file>\n" << resetColor
               << greenColor << "                            " << resetColor << "Specify the output file for the assembled binary (default: output.bin)\n"
+              << yellowColor << "  -c, --object              " << resetColor << "Write a relocatable object for --link instead (default: output.o)\n"
+              << "\n" << boldColor << "Linking Mode:\n" << resetColor
+              << yellowColor << "  --link <object_file>...\n" << resetColor
+              << greenColor << "                            " << resetColor << "Link objects into a binary that --emulate loads; .text of each object in order, then .data\n"
+              << yellowColor << "  -o, --output <output_file>\n" << resetColor
+              << greenColor << "                            " << resetColor << "Specify the linked binary (default: output.bin)\n"
+              << yellowColor << "  --incremental             " << resetColor << "Leave room to grow and keep <output>.xlink, so relinking rewrites only changed objects\n"
               << "\n" << boldColor << "Disassembly Mode:\n" << resetColor
               << yellowColor << "  -d, --disassemble <binary_file>\n" << resetColor
               << greenColor << "                            " << resetColor << "Disassemble the specified XR-32 binary file into assembly code\n"
               << yellowColor << "  -o, --output <output_file>\n" << resetColor
               << greenColor << "                            " << resetColor << "Specify the output file for the disassembled assembly code (default: output.asm)\n"
+              << yellowColor << "  --symbols <map_file>      " << resetColor << "Name addresses in the listing; one \"<address> <name>\" per line\n"
+              << yellowColor << "  --base <address>          " << resetColor << "Address of the binary's first byte (default: 0x1000)\n"
+              << yellowColor << "  --cfg <json_file>         " << resetColor << "Also write the basic blocks, functions and control-flow edges as JSON\n"
+              << yellowColor << "  --threads <count>         " << resetColor << "Threads to decode on (default: one per hardware thread)\n"
               << "\n" << boldColor << "Emulation Mode:\n" << resetColor
               << yellowColor << "  -e, --emulate <binary_file>\n" << resetColor
-              << greenColor << "                            " << resetColor << "Emulate the execution of the specified XR-32 binary file\n"
+              << greenColor << "                            " << resetColor << "Emulate the execution of the specified XR-32 binary file; .s and .asm sources are assembled in memory\n"
+              << yellowColor << "  --no-cache                " << resetColor << "Assemble sources even if the build cache holds them, and do not store the result\n"
               << yellowColor << "  -hdd, --harddisk <hdd_image>\n" << resetColor
-              << greenColor << "                            " << resetColor << "Load the specified hard disk image for the emulated system\n"
+              << greenColor << "                            " << resetColor << "Load the specified hard disk image (disk controller at ports 1f0-1f6)\n"
               << yellowColor << "  -fda, --floppy <floppy_image>\n" << resetColor
               << greenColor << "                            " << resetColor << "Load the specified floppy disk image\n"
               << yellowColor << "  --B, --bios <bios_file>\n" << resetColor
@@ -90,11 +191,48 @@ void printHelp() {
               << greenColor << "                            " << resetColor << "Redirect serial port output to stdout or a specified file\n"
               << yellowColor << "  --debugcon <output>\n" << resetColor
               << greenColor << "                            " << resetColor << "Redirect debug console output (port e9) to stdout or a specified file\n"
-              << yellowColor << "  --trace                   " << resetColor << "Enable instruction tracing, printing each executed instruction into stderr\n"
+              << yellowColor << "  --netdev <local>,<peer>\n" << resetColor
+              << greenColor << "                            " << resetColor << "Attach the virtqueue packet device (ports c000+), bound to Unix socket <local> and sending to <peer>\n"
+              << yellowColor << "  --smp <cores>             " << resetColor << "Run <cores> XR-32 cores on separate host threads, sharing memory and devices\n"
+              << yellowColor << "  --user                    " << resetColor << "Run without a guest kernel, servicing SWI 0x80-0x8f syscalls on the host (see ARCH.md)\n"
+              << yellowColor << "  --trace [trace_file]      " << resetColor << "Record every retired instruction, register write and memory access (default: trace.xrt)\n"
+              << yellowColor << "  --trace-uncompressed      " << resetColor << "Store trace blocks raw instead of deflated\n"
+              << yellowColor << "  --timeline <json_file>    " << resetColor << "Write interrupts, syscalls, mode switches and device activity as a Chrome/Perfetto trace\n"
+              << yellowColor << "  --record <log>            " << resetColor << "Record port reads, interrupts and host clock/read results into a compressed log\n"
+              << yellowColor << "  --replay <log>            " << resetColor << "Re-run a recorded execution, feeding the logged inputs back instead of the host's\n"
+              << yellowColor << "  --save <snapshot>         " << resetColor << "Save the machine and stop at --save-at or on SIGUSR1\n"
+              << yellowColor << "  --save-at <instructions>  " << resetColor << "Save once this many instructions have retired\n"
+              << yellowColor << "  --parent <snapshot>       " << resetColor << "Only store pages that differ from this snapshot\n"
+              << yellowColor << "  --save-uncompressed       " << resetColor << "Store pages raw so restoring maps them lazily\n"
+              << yellowColor << "  --restore <snapshot>      " << resetColor << "Resume a saved machine, program included; replaces -e\n"
               << yellowColor << "  -D, --dump <condition>\n" << resetColor
               << greenColor << "                            " << resetColor << "Dump the CPU state based on the specified condition:\n"
               << greenColor << "                              int     " << resetColor << "Dump on every interrupt\n"
-              << greenColor << "                              <number>" << resetColor << " Dump after every specified number of clock cycles\n";
+              << greenColor << "                              <number>" << resetColor << " Dump after every specified number of clock cycles\n"
+              << "\n" << boldColor << "Fleet Mode:\n" << resetColor
+              << yellowColor << "  --fleet <job_file>\n" << resetColor
+              << greenColor << "                            " << resetColor << "Run every job in <job_file> as an independent user-mode guest and report JSON Lines\n"
+              << yellowColor << "  --threads <count>         " << resetColor << "Number of worker threads (default: one per hardware thread)\n"
+              << yellowColor << "  --budget <instructions>   " << resetColor << "Default per-job instruction budget (default: 1000000000)\n"
+              << yellowColor << "  --mem <size>              " << resetColor << "Default per-job memory size in bytes (default: 64 MiB)\n"
+              << yellowColor << "  --lockstep <lanes>        " << resetColor << "Run jobs of the same binary in lockstep groups of up to <lanes> (at most 16) guests per thread\n"
+              << yellowColor << "  -o, --output <report_file>\n" << resetColor
+              << greenColor << "                            " << resetColor << "Write the report to a file instead of stdout\n"
+              << "\n" << boldColor << "Sampling Mode:\n" << resetColor
+              << yellowColor << "  --sample <binary_file>\n" << resetColor
+              << greenColor << "                            " << resetColor << "Run a user-mode guest once, then replay its representative intervals in parallel with profiling\n"
+              << yellowColor << "  --interval <instructions> " << resetColor << "Interval length and checkpoint spacing (default: 100000000)\n"
+              << yellowColor << "  --clusters <count>        " << resetColor << "Maximum number of intervals to replay (default: 10)\n"
+              << yellowColor << "  --input <file>            " << resetColor << "File served as the guest's standard input\n"
+              << yellowColor << "  --threads, --budget, --mem, -o\n" << resetColor
+              << greenColor << "                            " << resetColor << "As in fleet mode; the budget is unlimited by default\n"
+              << "\n" << boldColor << "Trace Decoding Mode:\n" << resetColor
+              << yellowColor << "  --trace-decode <trace_file>\n" << resetColor
+              << greenColor << "                            " << resetColor << "List a --trace recording, one instruction per line\n"
+              << yellowColor << "  --trace-range <start>:<end>\n" << resetColor
+              << greenColor << "                            " << resetColor << "Only list instructions with start <= I0 < end\n"
+              << yellowColor << "  -o, --output <output_file>\n" << resetColor
+              << greenColor << "                            " << resetColor << "Write the listing to a file instead of stdout\n";
 }
 
 Config parseArguments(int argc, char** argv) {
@@ -125,91 +263,347 @@ Config parseArguments(int argc, char** argv) {
         {config::assembleShort, assembleLambda},
         {config::outputFlag, outputLambda},
         {config::outputShort, outputLambda},
+        {config::objectFlag, [&](std::optional<std::string>) { config.object = true; }},
+        {config::objectShort, [&](std::optional<std::string>) { config.object = true; }},
+        {config::linkFlag, [&](std::optional<std::string> value) {
+            config.link = true;
+            if (value) {
+                config.linkObjects.push_back(*value);
+            }
+        }},
+        {config::incrementalFlag, [&](std::optional<std::string> value) {
+            config.incremental = true;
+            if (value) {
+                config.linkObjects.push_back(*value); // "--incremental a.o" takes a.o as its value
+            }
+        }},
         {config::disassembleFlag, [&](std::optional<std::string> value) { config.disassembleFile = value; }},
         {config::disassembleShort, [&](std::optional<std::string> value) { config.disassembleFile = value; }},
+        {config::symbolsFlag, [&](std::optional<std::string> value) { config.symbolFile = value; }},
+        {config::baseFlag, [&](std::optional<std::string> value) { config.baseAddress = value; }},
+        {config::cfgFlag, [&](std::optional<std::string> value) { config.graphFile = value; }},
         {config::emulateFlag, [&](std::optional<std::string> value) { config.emulateFile = value; }},
         {config::emulateShort, [&](std::optional<std::string> value) { config.emulateFile = value; }},
         {config::hddFlag, [&](std::optional<std::string> value) { config.hddImage = value; }},
         {config::floppyFlag, [&](std::optional<std::string> value) { config.floppyImage = value; }},
         {config::biosFlag, [&](std::optional<std::string> value) { config.biosFile = value; }},
         {config::memFlag, [&](std::optional<std::string> value) { config.memSize = value; }},
-        {config::serialFlag, [&](std::optional<std::string> value) { config.serialOutput = value; }},
-        {config::debugconFlag, [&](std::optional<std::string> value) { config.debugconOutput = value; }},
-        {config::traceFlag, [&](std::optional<std::string>) { config.trace = true; }},
+        {config::serialFlag, [&](std::optional<std::string> value) { config.serialOutput = value.value_or("stdout"); }},
+        {config::debugconFlag, [&](std::optional<std::string> value) { config.debugconOutput = value.value_or("stdout"); }},
+        {config::netdevFlag, [&](std::optional<std::string> value) { config.netdev = value; }},
+        {config::userFlag, [&](std::optional<std::string>) { config.userMode = true; }},
+        {config::noCacheFlag, [&](std::optional<std::string>) { config.noCache = true; }},
+        {config::smpFlag, [&](std::optional<std::string> value) { config.smp = value; }},
+        {config::traceFlag, [&](std::optional<std::string> value) { config.traceFile = value.value_or("trace.xrt"); }},
+        {config::traceUncompressedFlag, [&](std::optional<std::string>) { config.traceUncompressed = true; }},
+        {config::timelineFlag, [&](std::optional<std::string> value) { config.timelineFile = value; }},
+        {config::recordFlag, [&](std::optional<std::string> value) { config.recordFile = value; }},
+        {config::replayFlag, [&](std::optional<std::string> value) { config.replayFile = value; }},
+        {config::saveFlag, [&](std::optional<std::string> value) { config.saveFile = value; }},
+        {config::saveAtFlag, [&](std::optional<std::string> value) { config.saveAt = value; }},
+        {config::parentFlag, [&](std::optional<std::string> value) { config.parentFile = value; }},
+        {config::saveUncompressedFlag, [&](std::optional<std::string>) { config.saveUncompressed = true; }},
+        {config::restoreFlag, [&](std::optional<std::string> value) { config.restoreFile = value; }},
         {config::dumpFlag, [&](std::optional<std::string> value) { config.dumpCondition = value; }},
-        {config::dumpShort, [&](std::optional<std::string> value) { config.dumpCondition = value; }}
+        {config::dumpShort, [&](std::optional<std::string> value) { config.dumpCondition = value; }},
+        {config::fleetFlag, [&](std::optional<std::string> value) { config.fleetFile = value; }},
+        {config::threadsFlag, [&](std::optional<std::string> value) { config.threads = value; }},
+        {config::budgetFlag, [&](std::optional<std::string> value) { config.budget = value; }},
+        {config::lockstepFlag, [&](std::optional<std::string> value) { config.lockstep = value; }},
+        {config::sampleFlag, [&](std::optional<std::string> value) { config.sampleFile = value; }},
+        {config::intervalFlag, [&](std::optional<std::string> value) { config.interval = value; }},
+        {config::clustersFlag, [&](std::optional<std::string> value) { config.clusters = value; }},
+        {config::inputFlag, [&](std::optional<std::string> value) { config.inputFile = value; }},
+        {config::traceDecodeFlag, [&](std::optional<std::string> value) { config.traceDecodeFile = value; }},
+        {config::traceRangeFlag, [&](std::optional<std::string> value) { config.traceRange = value; }}
     });
 
     parser.parse(argc, argv);
+    if (config.link) {
+        // Objects after the first are positional
+        const std::vector<std::string>& objects = parser.getPositionalArguments();
+        config.linkObjects.insert(config.linkObjects.end(), objects.begin(), objects.end());
+    }
     return config;
 }
 
-void handleConfig(const Config& config) {
+int runFleet(const Config& config) {
+    Fleet::Defaults defaults{1'000'000'000, 64 * 1024 * 1024};
+    unsigned threads = 0;
+    unsigned lanes = 1;
+    try {
+        if (config.budget) {
+            defaults.budget = std::stoull(*config.budget);
+        }
+        if (config.memSize) {
+            defaults.memorySize = std::stoull(*config.memSize);
+        }
+        if (config.threads) {
+            threads = static_cast<unsigned>(std::stoul(*config.threads));
+        }
+        if (config.lockstep) {
+            lanes = static_cast<unsigned>(std::stoul(*config.lockstep));
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Error: Invalid --budget, --mem, --threads or --lockstep value" << std::endl;
+        return 1;
+    }
+    if (lanes == 0 || lanes > LockstepGroup::MaxLanes) {
+        std::cerr << "Error: --lockstep expects 1 to " << LockstepGroup::MaxLanes << " lanes" << std::endl;
+        return 1;
+    }
+
+    std::vector<FleetJob> jobs;
+    try {
+        jobs = Fleet::parseJobs(*config.fleetFile, defaults);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<FleetResult> results = Fleet::run(jobs, threads, lanes);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (config.outputFile && !config.outputFile->empty()) {
+        std::ofstream report(*config.outputFile);
+        if (!report) {
+            std::cerr << "Error: Unable to open output file: " << *config.outputFile << std::endl;
+            return 1;
+        }
+        Fleet::writeReport(report, jobs, results);
+    } else {
+        Fleet::writeReport(std::cout, jobs, results);
+    }
+
+    size_t succeeded = 0;
+    uint64_t instructions = 0;
+    for (const FleetResult& result : results) {
+        succeeded += result.status == FleetResult::Status::Exited && result.exitCode == 0;
+        instructions += result.instructions;
+    }
+    std::cerr << "Fleet: " << succeeded << "/" << results.size() << " jobs exited with status 0, "
+              << instructions << " instructions in " << elapsed << " s" << std::endl;
+    return succeeded == results.size() ? 0 : 1;
+}
+
+int runSampling(const Config& config) {
+    SampleOptions options{*config.sampleFile, config.inputFile.value_or(""), 100'000'000, 10,
+                          std::numeric_limits<uint64_t>::max(), 64 * 1024 * 1024, 0};
+    try {
+        if (config.interval) {
+            options.interval = std::stoull(*config.interval);
+        }
+        if (config.clusters) {
+            options.clusters = static_cast<unsigned>(std::stoul(*config.clusters));
+        }
+        if (config.budget) {
+            options.budget = std::stoull(*config.budget);
+        }
+        if (config.memSize) {
+            options.memorySize = std::stoull(*config.memSize);
+        }
+        if (config.threads) {
+            options.threads = static_cast<unsigned>(std::stoul(*config.threads));
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Error: Invalid --interval, --clusters, --budget, --mem or --threads value" << std::endl;
+        return 1;
+    }
+    if (options.interval == 0 || options.clusters == 0) {
+        std::cerr << "Error: --interval and --clusters must be positive" << std::endl;
+        return 1;
+    }
+
+    SampleReport report;
+    try {
+        report = Sampler::run(options, std::cout, std::cerr);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (config.outputFile && !config.outputFile->empty()) {
+        std::ofstream out(*config.outputFile);
+        if (!out) {
+            std::cerr << "Error: Unable to open output file: " << *config.outputFile << std::endl;
+            return 1;
+        }
+        Sampler::writeReport(out, options, report);
+    } else {
+        Sampler::writeReport(std::cout, options, report);
+    }
+
+    size_t diverged = 0;
+    for (const SimulationPoint& point : report.points) {
+        diverged += point.profile.diverged;
+    }
+    std::cerr << "Sampling: " << report.instructions << " instructions in " << report.intervals << " intervals, "
+              << report.fastForwardSeconds << " s fast-forward; " << report.points.size() << " points replayed in "
+              << report.replaySeconds << " s";
+    if (diverged) {
+        std::cerr << ", " << diverged << " diverged";
+    }
+    std::cerr << std::endl;
+    return report.status == SampleReport::Status::Error ? 1 : 0;
+}
+
+int runTraceDecode(const Config& config) {
+    uint32_t low = 0;
+    uint64_t high = uint64_t{1} << 32;
+    if (config.traceRange) {
+        auto colon = config.traceRange->find(':');
+        try {
+            if (colon == std::string::npos) {
+                throw std::invalid_argument("missing ':'");
+            }
+            if (colon > 0) {
+                low = static_cast<uint32_t>(std::stoul(config.traceRange->substr(0, colon), nullptr, 0));
+            }
+            if (colon + 1 < config.traceRange->size()) {
+                high = std::stoull(config.traceRange->substr(colon + 1), nullptr, 0);
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: --trace-range expects <start>:<end>" << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        if (config.outputFile && !config.outputFile->empty()) {
+            std::ofstream out(*config.outputFile);
+            if (!out) {
+                std::cerr << "Error: Unable to open output file: " << *config.outputFile << std::endl;
+                return 1;
+            }
+            InstructionTrace::decode(*config.traceDecodeFile, out, low, high);
+        } else {
+            InstructionTrace::decode(*config.traceDecodeFile, std::cout, low, high);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int handleConfig(const Config& config) {
     if (config.showHelp) {
         printHelp();
-        return;
+        return 0;
     }
 
     if (config.showVersion) {
         std::cout << "XR-32 Emulator version " << config::version << std::endl;
-        return;
+        return 0;
     }
 
-    if (config.assembleFile) {
-        Assembler assembler;
-        std::string outputFile = config.outputFile.value_or("");
+    if (config.fleetFile) {
+        return runFleet(config);
+    }
 
-        std::vector<uint8_t> machineCode;
+    if (config.sampleFile) {
+        return runSampling(config);
+    }
 
-        if (config.assembleFile->empty()) {
-            std::cout << "Assembling from stdin. Type assembly code below (CTRL+D to end input):\n";
-            std::string line;
-            while (std::getline(std::cin, line)) {
-                uint64_t binaryInstruction = assembler.parseAssemblyLine(line);
-                for (int i = 0; i < 8; ++i) {
-                    machineCode.push_back(static_cast<uint8_t>((binaryInstruction >> (i * 8)) & 0xFF));
-                }
-            }
-        } else {
-            std::cout << "Assembling file: " << *config.assembleFile << std::endl;
-            bool success = assembler.assemble(*config.assembleFile, outputFile);
+    if (config.traceDecodeFile) {
+        return runTraceDecode(config);
+    }
 
-            if (!success) {
-                std::cerr << "Error: Assembly failed for file " << *config.assembleFile << std::endl;
-                return;
-            }
-        }
+    if (config.assembleFile) {
+        Assembler assembler;
+        std::string outputFile = config.outputFile.value_or(config.object ? "output.o" : "output.bin");
 
-        if (!outputFile.empty()) {
-            std::ofstream outFile(outputFile, std::ios::binary);
-            if (!outFile) {
-                std::cerr << "Error: Unable to open output file: " << outputFile << std::endl;
-                return;
+        try {
+            if (config.assembleFile->empty()) {
+                std::cout << "Assembling from stdin. Type assembly code below (CTRL+D to end input):\n";
+                std::string source((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+                if (config.object) {
+                    assembler.assembleObject(source).write(outputFile);
+                } else {
+                    std::vector<uint8_t> machineCode = assembler.assemble(source);
+                    std::ofstream outFile(outputFile, std::ios::binary);
+                    if (!outFile) {
+                        std::cerr << "Error: Unable to open output file: " << outputFile << std::endl;
+                        return 1;
+                    }
+                    outFile.write(reinterpret_cast<const char*>(machineCode.data()), static_cast<std::streamsize>(machineCode.size()));
+                }
+            } else if (config.object) {
+                std::cout << "Assembling file: " << *config.assembleFile << std::endl;
+                assembler.assembleObject(*config.assembleFile, outputFile);
+            } else {
+                // Maps the source and the output, so large sources are assembled in parallel without copies
+                std::cout << "Assembling file: " << *config.assembleFile << std::endl;
+                assembler.assemble(*config.assembleFile, outputFile);
             }
-            outFile.write(reinterpret_cast<const char*>(machineCode.data()), machineCode.size());
-            std::cout << "Assembly successful. Output written to " << outputFile << std::endl;
+            std::cout << "Assembly successful. " << std::filesystem::file_size(outputFile) << " bytes written to "
+                      << outputFile << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Assembly failed: " << e.what() << std::endl;
+            return 1;
         }
+        return 0;
+    }
 
-        std::cout << "Assembled binary (hex):\n";
-        std::cout << std::hex << std::setfill('0');
-        for (size_t i = 0; i < machineCode.size(); ++i) {
-            std::cout << "0x" << std::setw(2) << static_cast<int>(machineCode[i]);
-            if (i < machineCode.size() - 1) {
-                std::cout << " ";
+    if (config.link) {
+        std::string outputFile = config.outputFile.value_or("output.bin");
+        try {
+            Linker::Report report = Linker().link(config.linkObjects, outputFile, config.incremental);
+            if (report.incremental) {
+                std::cout << "Relinked " << report.relinked << " of " << report.objects << " objects into " << outputFile
+                          << std::endl;
+            } else {
+                std::cout << "Linked " << report.objects << " objects into " << outputFile << " (" << report.size
+                          << " bytes)" << std::endl;
             }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Link failed: " << e.what() << std::endl;
+            return 1;
         }
-        std::cout << std::endl;
-
-        return;
+        return 0;
     }
 
     if (config.disassembleFile) {
+        std::string outputFile = config.outputFile.value_or("output.asm");
         std::cout << "Disassembling file: " << *config.disassembleFile << std::endl;
-        // TODO: Implement disassembly logic
+        try {
+            uint64_t base = Assembler::DefaultOrigin;
+            if (config.baseAddress) {
+                base = std::stoull(*config.baseAddress, nullptr, 0);
+            }
+            unsigned threads = 0;
+            if (config.threads) {
+                threads = static_cast<unsigned>(std::stoul(*config.threads));
+            }
+            Disassembler disassembler(base, threads);
+            if (config.symbolFile) {
+                disassembler.loadSymbols(*config.symbolFile);
+            }
+            uint64_t size = disassembler.disassemble(*config.disassembleFile, outputFile, config.graphFile.value_or(""));
+            std::cout << "Disassembly successful. " << size << " bytes listed in " << outputFile << std::endl;
+            if (config.graphFile) {
+                std::cout << "Control-flow graph written to " << *config.graphFile << std::endl;
+            }
+        } catch (const std::invalid_argument&) {
+            std::cerr << "Error: Invalid --base or --threads value" << std::endl;
+            return 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Disassembly failed: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
     }
 
-    if (config.emulateFile) {
-        std::cout << "Emulating file: " << *config.emulateFile << std::endl;
+    if (config.emulateFile || config.restoreFile) {
+        // A snapshot holds the program in its RAM, so restoring loads none.
+        if (config.emulateFile && config.restoreFile) {
+            std::cerr << "Error: --restore resumes the snapshot's own program; do not name one with -e" << std::endl;
+            return 1;
+        }
+        if (config.emulateFile) {
+            std::cout << "Emulating file: " << *config.emulateFile << std::endl;
+        }
 
         size_t memorySize = 64 * 1024 * 1024;
         if (config.memSize) {
@@ -217,32 +611,196 @@ void handleConfig(const Config& config) {
                 memorySize = std::stoull(*config.memSize);
             } catch (const std::exception& e) {
                 std::cerr << "Error: Invalid memory size specified: " << *config.memSize << std::endl;
-                return;
+                return 1;
+            }
+        } else if (config.restoreFile) {
+            try {
+                memorySize = MachineSnapshot::memorySize(*config.restoreFile);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
             }
         }
 
-        CPU cpu(memorySize);
-
-        std::ifstream binaryFile(*config.emulateFile, std::ios::binary);
-        if (!binaryFile) {
-            std::cerr << "Error: Could not open binary file: " << *config.emulateFile << std::endl;
-            return;
+        Emulator emulator(memorySize);
+        CPU& cpu = emulator.core();
+        if (config.noCache) {
+            emulator.disableBuildCache();
         }
 
-        std::vector<uint8_t> programData((std::istreambuf_iterator<char>(binaryFile)), std::istreambuf_iterator<char>());
-        if (programData.size() > memorySize) {
-            std::cerr << "Error: Program exceeds available memory size" << std::endl;
-            return;
+        uint32_t imageEnd = 0x1000;
+        try {
+            if (config.emulateFile) {
+                imageEnd = emulator.loadProgram(*config.emulateFile, 0x1000, Emulator::isAssemblySource(*config.emulateFile));
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
         }
 
-        uint32_t startAddress = 0x1000;
-        for (size_t i = 0; i < programData.size(); ++i) {
-            cpu.memory.write(startAddress + i, programData[i]);
+        // Devices must outlive the emulation loop; sinks drain on destruction.
+        std::unique_ptr<OutputSink> serialSink;
+        std::unique_ptr<InputSource> serialInput;
+        std::unique_ptr<SerialPort> serial;
+        std::unique_ptr<OutputSink> debugconSink;
+        std::unique_ptr<DebugCon> debugcon;
+        std::unique_ptr<PacketDevice> netdev;
+        try {
+            if (config.serialOutput) {
+                serialSink = std::make_unique<OutputSink>(*config.serialOutput);
+                serialInput = std::make_unique<InputSource>();
+                serial = std::make_unique<SerialPort>(*serialSink, serialInput.get());
+                serial->attach(cpu.io);
+            }
+            if (config.debugconOutput) {
+                debugconSink = std::make_unique<OutputSink>(*config.debugconOutput);
+                debugcon = std::make_unique<DebugCon>(*debugconSink);
+                debugcon->attach(cpu.io);
+            }
+            if (config.netdev) {
+                auto comma = config.netdev->find(',');
+                if (comma == std::string::npos) {
+                    std::cerr << "Error: --netdev expects <local>,<peer>" << std::endl;
+                    return 1;
+                }
+                netdev = std::make_unique<PacketDevice>(cpu, config.netdev->substr(0, comma), config.netdev->substr(comma + 1));
+                netdev->attach(cpu.io, PacketDevice::DefaultBase);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
         }
 
+        std::unique_ptr<DiskDevice> disk;
         if (config.hddImage) {
             std::cout << "Loading hard disk image: " << *config.hddImage << std::endl;
-            // TODO: Implement hard disk loading logic
+            try {
+                disk = std::make_unique<DiskDevice>(cpu, *config.hddImage);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        // Declared after the devices it serves so it is joined before they are destroyed.
+        std::unique_ptr<DeviceHost> deviceHost;
+        if (disk) {
+            deviceHost = std::make_unique<DeviceHost>(cpu);
+            deviceHost->attach(cpu.io, DiskDevice::DefaultBase, *disk);
+        }
+
+        unsigned coreCount = 1;
+        if (config.smp) {
+            try {
+                coreCount = static_cast<unsigned>(std::stoul(*config.smp));
+            } catch (const std::exception&) {
+                coreCount = 0;
+            }
+            if (coreCount == 0 || coreCount > 255) {
+                std::cerr << "Error: Invalid core count specified: " << *config.smp << std::endl;
+                return 1;
+            }
+        }
+
+        // Snapshots hold the boot core and RAM only, not other cores or device state.
+        MachineSnapshot::SaveOptions saveOptions;
+        uint64_t saveAt = std::numeric_limits<uint64_t>::max();
+        if (config.saveFile || config.restoreFile) {
+            if (coreCount > 1 || config.netdev || config.hddImage) {
+                std::cerr << "Error: --save and --restore support neither --smp, --netdev nor --harddisk" << std::endl;
+                return 1;
+            }
+            try {
+                if (config.saveAt) {
+                    saveAt = std::stoull(*config.saveAt);
+                }
+                if (config.threads) {
+                    saveOptions.threads = static_cast<unsigned>(std::stoul(*config.threads));
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid --save-at or --threads value" << std::endl;
+                return 1;
+            }
+            saveOptions.parent = config.parentFile;
+            saveOptions.compress = !config.saveUncompressed;
+        }
+        if (config.saveFile) {
+            std::signal(SIGUSR1, [](int) { snapshotRequested = 1; });
+        }
+
+        // Inputs that reach the guest by DMA or from other cores are not journaled.
+        std::unique_ptr<ExecutionJournal> journal;
+        if (config.recordFile || config.replayFile) {
+            if (config.recordFile && config.replayFile) {
+                std::cerr << "Error: --record and --replay are mutually exclusive" << std::endl;
+                return 1;
+            }
+            if (coreCount > 1 || config.netdev || config.hddImage) {
+                std::cerr << "Error: --record and --replay support neither --smp, --netdev nor --harddisk" << std::endl;
+                return 1;
+            }
+            try {
+                journal = config.recordFile ? std::make_unique<ExecutionJournal>(*config.recordFile, ExecutionJournal::Mode::Record)
+                                            : std::make_unique<ExecutionJournal>(*config.replayFile, ExecutionJournal::Mode::Replay);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+            cpu.setJournal(journal.get());
+        }
+
+        std::unique_ptr<SyscallEmulator> syscalls;
+        if (config.userMode) {
+            syscalls = std::make_unique<SyscallEmulator>(cpu, imageEnd, coreCount);
+        }
+
+        std::unique_ptr<InstructionTrace> trace;
+        if (config.traceFile) {
+            try {
+                trace = std::make_unique<InstructionTrace>(*config.traceFile, !config.traceUncompressed);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        std::unique_ptr<EventTimeline> timeline;
+        if (config.timelineFile) {
+            try {
+                timeline = std::make_unique<EventTimeline>(*config.timelineFile);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+
+        // Declared last so the secondary cores stop before anything they use is destroyed.
+        std::unique_ptr<CoreCluster> cluster;
+        if (coreCount > 1) {
+            cluster = std::make_unique<CoreCluster>(cpu, coreCount);
+        }
+        if (trace) {
+            cpu.setTracer(&trace->recorder(cpu.id()));
+            if (cluster) {
+                for (const auto& core : cluster->secondaries()) {
+                    core->setTracer(&trace->recorder(core->id()));
+                }
+            }
+        }
+        if (timeline) {
+            cpu.setTimeline(&timeline->track(cpu.id()));
+            if (cluster) {
+                for (const auto& core : cluster->secondaries()) {
+                    core->setTimeline(&timeline->track(core->id()));
+                }
+            }
+        }
+        if (syscalls) {
+            syscalls->attach(cpu);
+            syscalls->setJournal(journal.get());
+            if (cluster) {
+                for (const auto& core : cluster->secondaries()) {
+                    syscalls->attach(*core);
+                }
+            }
         }
 
         if (config.floppyImage) {
@@ -255,21 +813,55 @@ void handleConfig(const Config& config) {
             // TODO: Implement BIOS loading logic
         }
 
+        auto saveSnapshot = [&]() {
+            auto statistics = MachineSnapshot::save(*config.saveFile, cpu, syscalls.get(), saveOptions);
+            std::cout << "Saved snapshot " << *config.saveFile << " after " << cpu.retired() << " instructions: "
+                      << statistics.storedPages << " of " << statistics.pages << " pages stored ("
+                      << statistics.zeroPages << " zero, " << statistics.parentPages << " unchanged from parent), "
+                      << statistics.fileBytes << " bytes" << std::endl;
+            return 0;
+        };
+
         try {
-            while (true) {
+            if (config.restoreFile) {
+                std::cout << "Restoring snapshot: " << *config.restoreFile << std::endl;
+                MachineSnapshot::restore(*config.restoreFile, cpu, syscalls.get(), saveOptions.threads);
+            }
+            if (cluster) {
+                cluster->start();
+            }
+            for (uint64_t cycle = 1; ; ++cycle) {
+                if (cpu.retired() >= saveAt) [[unlikely]] {
+                    return saveSnapshot();
+                }
                 cpu.executeNextInstruction();
-                if (config.trace) {
-                    std::cerr << "Executed instruction at I0: 0x" << std::hex << cpu.registers.I0 << std::dec << std::endl;
+                if ((cycle & 0x3FF) == 0 || cpu.halted()) {
+                    cpu.io.poll();
+                    if (journal) {
+                        journal->sync();
+                    }
+                    if (cluster && cluster->failed()) {
+                        cluster->rethrowFailure();
+                    }
+                    if (snapshotRequested && config.saveFile) {
+                        return saveSnapshot();
+                    }
                 }
             }
+        } catch (const GuestExit& exit) {
+            return exit.status();
+        } catch (const CpuHalted& e) {
+            std::cerr << "Emulation error: " << e.what() << std::endl;
+            return 0;
         } catch (const std::exception& e) {
             std::cerr << "Emulation error: " << e.what() << std::endl;
+            return 1;
         }
     }
+    return 0;
 }
 
 int main(int argc, char** argv) {
     const auto config = parseArguments(argc, argv);
-    handleConfig(config);
-    return 0;
+    return handleConfig(config);
 }
@@ -0,0 +1,580 @@
+#include <sampler.hpp>
+#include <components/cpu.hpp>
+#include <components/syscalls.hpp>
+#include <utils/json.hpp>
+#include <utils/work_stealing_pool.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+#include <sys/mman.h>
+
+namespace {
+    constexpr uint32_t LoadAddress = 0x1000;
+    constexpr size_t PageSize = 0x1000;
+    constexpr unsigned Dimensions = 15;        ///< SimPoint's default projection size.
+    constexpr unsigned KMeansIterations = 100;
+    constexpr size_t HotBlockCount = 8;
+
+    using Signature = std::array<double, Dimensions>;
+    using Status = SampleReport::Status;
+
+    /**
+     * @brief Machine state at the start of an interval, apart from RAM (see PageHistory).
+     */
+    struct Checkpoint {
+        CPU::Registers registers;
+        SyscallEmulator::Snapshot syscalls;
+        size_t inputOffset; ///< Bytes of standard input consumed.
+        uint64_t start;     ///< Instructions executed before the checkpoint.
+    };
+
+    /**
+     * @brief Every version of every RAM page seen at a checkpoint.
+     *
+     * A checkpoint only stores the pages that differ from their previous version, and pages that were
+     * never touched are never read: only host-resident pages are compared, and all-zero pages that
+     * were never stored are skipped. Restoring copies, for each page, the newest version not younger
+     * than the checkpoint.
+     */
+    class PageHistory {
+    public:
+        explicit PageHistory(size_t ramSize)
+            : pages((ramSize + PageSize - 1) / PageSize), resident(pages.size()) {}
+
+        /**
+         * @brief Records the pages that changed since the last capture.
+         *
+         * @return Bytes added to the history.
+         */
+        size_t capture(uint8_t* ram, size_t checkpoint) {
+            static const uint8_t zero[PageSize] = {};
+            if (mincore(ram, pages.size() * PageSize, resident.data()) != 0) {
+                std::fill(resident.begin(), resident.end(), 1); // Compare everything instead
+            }
+            size_t added = 0;
+            for (size_t page = 0; page < pages.size(); ++page) {
+                std::vector<Version>& versions = pages[page];
+                if (!(resident[page] & 1) && versions.empty()) {
+                    continue;
+                }
+                const uint8_t* bytes = ram + page * PageSize;
+                const uint8_t* previous = versions.empty() ? zero : versions.back().bytes.get();
+                if (std::memcmp(bytes, previous, PageSize) == 0) {
+                    continue;
+                }
+                auto copy = std::make_unique<uint8_t[]>(PageSize);
+                std::memcpy(copy.get(), bytes, PageSize);
+                versions.push_back({checkpoint, std::move(copy)});
+                added += PageSize;
+            }
+            return added;
+        }
+
+        /**
+         * @brief Fills zeroed RAM with its contents at a checkpoint.
+         */
+        void restore(uint8_t* ram, size_t checkpoint) const {
+            for (size_t page = 0; page < pages.size(); ++page) {
+                const std::vector<Version>& versions = pages[page];
+                auto next = std::upper_bound(versions.begin(), versions.end(), checkpoint,
+                                             [](size_t index, const Version& version) { return index < version.checkpoint; });
+                if (next != versions.begin()) {
+                    std::memcpy(ram + page * PageSize, std::prev(next)->bytes.get(), PageSize);
+                }
+            }
+        }
+
+    private:
+        struct Version {
+            size_t checkpoint;               ///< First checkpoint holding this content.
+            std::unique_ptr<uint8_t[]> bytes;
+        };
+
+        std::vector<std::vector<Version>> pages; ///< Versions per page, oldest first.
+        std::vector<unsigned char> resident;     ///< mincore() scratch buffer.
+    };
+
+    /**
+     * @brief Counts retired instructions per basic block, a block ending at every control transfer.
+     */
+    struct BlockCounter {
+        void before(uint32_t) noexcept {}
+
+        void after(uint32_t pc, uint32_t next) {
+            ++length;
+            if (next != pc + sizeof(uint64_t)) {
+                counter(start) += length;
+                start = next;
+                length = 0;
+                ++transfers;
+            }
+        }
+
+        void begin(uint32_t pc) {
+            blocks.clear();
+            cache.fill({});
+            start = pc;
+            length = 0;
+            transfers = 0;
+        }
+
+        void finish() {
+            if (length) {
+                counter(start) += length;
+                length = 0;
+            }
+        }
+
+        /**
+         * @brief The count of a block. Hot loops hit a small direct-mapped cache instead of the hash map.
+         */
+        uint64_t& counter(uint32_t address) {
+            auto& [tag, count] = cache[(address >> 3) & (cache.size() - 1)];
+            if (!count || tag != address) {
+                tag = address;
+                count = &blocks[address];
+            }
+            return *count;
+        }
+
+        std::unordered_map<uint32_t, uint64_t> blocks; ///< Block address -> instructions retired in it.
+        std::array<std::pair<uint32_t, uint64_t*>, 256> cache{}; ///< Recently used entries of `blocks`.
+        uint32_t start{0};     ///< Address of the current block.
+        uint64_t length{0};    ///< Instructions retired in the current block so far.
+        uint64_t transfers{0}; ///< Blocks ended by a control transfer.
+    };
+
+    /**
+     * @brief Block counting plus an opcode histogram, for replays.
+     */
+    struct Profiler : BlockCounter {
+        explicit Profiler(CPU& cpuRef) : cpu(cpuRef) {}
+
+        void before(uint32_t pc) noexcept {
+            // User-mode guests run unpaged; paged code is counted but not classified.
+            if (cpu.registers.TPDR == 0) {
+                if (const uint8_t* instruction = cpu.memory.physicalSpan(pc, sizeof(uint64_t))) {
+                    ++opcodes[instruction[7] >> 2];
+                }
+            }
+        }
+
+        CPU& cpu;
+        std::array<uint64_t, 64> opcodes{};
+    };
+
+    /**
+     * @brief How a stretch of execution ended.
+     */
+    struct Outcome {
+        uint64_t executed{0};
+        Status status{Status::BudgetExhausted}; ///< BudgetExhausted if all instructions ran.
+        int32_t exitCode{0};
+        std::string message;
+    };
+
+    template <typename Observer>
+    Outcome execute(CPU& cpu, uint64_t count, Observer& observer) noexcept {
+        Outcome outcome;
+        observer.begin(cpu.registers.I0);
+        uint32_t pc = 0;
+        try {
+            for (; outcome.executed < count; ++outcome.executed) {
+                pc = cpu.registers.I0;
+                observer.before(pc);
+                cpu.executeNextInstruction();
+                observer.after(pc, cpu.registers.I0);
+            }
+        } catch (const GuestExit& exit) {
+            observer.after(pc, pc + sizeof(uint64_t));
+            ++outcome.executed;
+            outcome.status = Status::Exited;
+            outcome.exitCode = exit.status();
+        } catch (const CpuHalted&) {
+            observer.after(pc, pc + sizeof(uint64_t));
+            ++outcome.executed;
+            outcome.status = Status::Halted;
+        } catch (const std::exception& e) {
+            outcome.status = Status::Error;
+            outcome.message = e.what();
+        }
+        observer.finish();
+        return outcome;
+    }
+
+    /**
+     * @brief A user-mode guest with captured standard streams.
+     */
+    struct Guest {
+        Guest(size_t memorySize, const std::string& program, const std::string& input)
+            : cpu(memorySize), syscalls(cpu, LoadAddress + static_cast<uint32_t>(program.size())) {
+            streams.input = input;
+            syscalls.captureStandardStreams(&streams);
+            syscalls.attach(cpu);
+        }
+
+        CPU cpu;
+        SyscallEmulator syscalls;
+        SyscallEmulator::CapturedStreams streams;
+    };
+
+    std::string readFile(const std::string& path, std::string_view kind) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Could not open " + std::string(kind) + " file: " + path);
+        }
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    /**
+     * @brief A deterministic pseudo-random projection weight in [-1, 1) for a block and a dimension.
+     */
+    double projectionWeight(uint32_t block, unsigned dimension) noexcept {
+        uint64_t x = (uint64_t(block) << 8 | dimension) + 0x9E3779B97F4A7C15ull; // splitmix64
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return static_cast<double>(x >> 11) * 0x1p-52 - 1.0;
+    }
+
+    /**
+     * @brief Projects an interval's basic block vector, normalized to its length, to `Dimensions` values.
+     */
+    Signature project(const std::unordered_map<uint32_t, uint64_t>& blocks, uint64_t instructions) {
+        Signature signature{};
+        for (const auto& [block, count] : blocks) {
+            double share = static_cast<double>(count) / static_cast<double>(instructions);
+            for (unsigned d = 0; d < Dimensions; ++d) {
+                signature[d] += share * projectionWeight(block, d);
+            }
+        }
+        return signature;
+    }
+
+    double distance(const Signature& a, const Signature& b) noexcept {
+        double sum = 0;
+        for (unsigned d = 0; d < Dimensions; ++d) {
+            sum += (a[d] - b[d]) * (a[d] - b[d]);
+        }
+        return sum;
+    }
+
+    /**
+     * @brief Clusters interval signatures with k-means (k-means++ seeding, fixed seed).
+     *
+     * @return The cluster of every interval. Clusters are numbered densely; there may be fewer than `k`.
+     */
+    std::vector<size_t> cluster(const std::vector<Signature>& signatures, size_t k) {
+        std::mt19937_64 random(0x5EED);
+        std::vector<Signature> centroids{signatures[random() % signatures.size()]};
+        std::vector<double> nearest(signatures.size());
+        while (centroids.size() < k) {
+            double total = 0;
+            for (size_t i = 0; i < signatures.size(); ++i) {
+                nearest[i] = std::numeric_limits<double>::max();
+                for (const Signature& centroid : centroids) {
+                    nearest[i] = std::min(nearest[i], distance(signatures[i], centroid));
+                }
+                total += nearest[i];
+            }
+            if (total == 0) {
+                break; // Fewer distinct intervals than clusters
+            }
+            double target = std::uniform_real_distribution<double>(0, total)(random);
+            size_t pick = 0;
+            for (; pick + 1 < signatures.size() && target >= nearest[pick]; ++pick) {
+                target -= nearest[pick];
+            }
+            centroids.push_back(signatures[pick]);
+        }
+
+        std::vector<size_t> assignment(signatures.size());
+        for (unsigned iteration = 0; iteration < KMeansIterations; ++iteration) {
+            bool changed = iteration == 0;
+            for (size_t i = 0; i < signatures.size(); ++i) {
+                size_t best = 0;
+                for (size_t c = 1; c < centroids.size(); ++c) {
+                    if (distance(signatures[i], centroids[c]) < distance(signatures[i], centroids[best])) {
+                        best = c;
+                    }
+                }
+                changed |= assignment[i] != best;
+                assignment[i] = best;
+            }
+            if (!changed) {
+                break;
+            }
+            std::vector<Signature> sums(centroids.size(), Signature{});
+            std::vector<size_t> sizes(centroids.size());
+            for (size_t i = 0; i < signatures.size(); ++i) {
+                ++sizes[assignment[i]];
+                for (unsigned d = 0; d < Dimensions; ++d) {
+                    sums[assignment[i]][d] += signatures[i][d];
+                }
+            }
+            for (size_t c = 0; c < centroids.size(); ++c) {
+                if (sizes[c]) {
+                    for (unsigned d = 0; d < Dimensions; ++d) {
+                        centroids[c][d] = sums[c][d] / static_cast<double>(sizes[c]);
+                    }
+                }
+            }
+        }
+
+        // Renumber so that empty clusters disappear.
+        std::vector<size_t> renumber(centroids.size(), SIZE_MAX);
+        size_t used = 0;
+        for (size_t& c : assignment) {
+            if (renumber[c] == SIZE_MAX) {
+                renumber[c] = used++;
+            }
+            c = renumber[c];
+        }
+        return assignment;
+    }
+
+    void flushStreams(SyscallEmulator::CapturedStreams& streams, std::ostream& output, std::ostream& error) {
+        output << streams.output;
+        error << streams.error;
+        output.flush();
+        streams.output.clear();
+        streams.error.clear();
+    }
+
+    /**
+     * @brief Replays one interval from its checkpoint with full instrumentation.
+     *
+     * @param next The checkpoint the interval should end at, or nullptr for the last interval.
+     * @param last How the fast-forward pass ended, checked against the replay of the last interval.
+     */
+    void replay(const SampleOptions& options, const std::string& program, const std::string& input,
+                const PageHistory& history, const Checkpoint& checkpoint, size_t index, uint64_t length,
+                const Checkpoint* next, const SampleReport& last, IntervalProfile& profile) noexcept {
+        try {
+            Guest guest(options.memorySize, program, input);
+            guest.streams.inputOffset = checkpoint.inputOffset;
+            guest.streams.limit = 0;
+            guest.syscalls.sandbox();
+            guest.syscalls.restore(checkpoint.syscalls);
+            history.restore(guest.cpu.memory.physicalSpan(0, options.memorySize), index);
+            guest.cpu.registers = checkpoint.registers;
+
+            Profiler profiler(guest.cpu);
+            Outcome outcome = execute(guest.cpu, length, profiler);
+            profile.instructions = outcome.executed;
+            profile.controlTransfers = profiler.transfers;
+            profile.opcodes = profiler.opcodes;
+            profile.hotBlocks.assign(profiler.blocks.begin(), profiler.blocks.end());
+            std::sort(profile.hotBlocks.begin(), profile.hotBlocks.end(),
+                      [](const auto& a, const auto& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+            profile.hotBlocks.resize(std::min(profile.hotBlocks.size(), HotBlockCount));
+
+            if (outcome.status == Status::Error) {
+                profile.message = outcome.message;
+            }
+            if (next) {
+                const CPU::Registers& expected = next->registers;
+                const CPU::Registers& actual = guest.cpu.registers;
+                profile.diverged = outcome.status != Status::BudgetExhausted || actual.R != expected.R ||
+                                   actual.I0 != expected.I0 || actual.S0 != expected.S0 || actual.FR != expected.FR;
+            } else {
+                profile.diverged = outcome.status != last.status || outcome.exitCode != last.exitCode;
+            }
+        } catch (const std::exception& e) {
+            profile.message = e.what();
+            profile.diverged = true;
+        }
+    }
+
+    std::string_view statusName(Status status) {
+        switch (status) {
+            case Status::Exited: return "exited";
+            case Status::Halted: return "halted";
+            case Status::BudgetExhausted: return "budget";
+            case Status::Error: return "error";
+        }
+        return "error";
+    }
+
+    void writeOpcodes(std::ostream& out, const std::array<double, 64>& counts) {
+        out << '{';
+        bool first = true;
+        for (size_t opcode = 0; opcode < counts.size(); ++opcode) {
+            if (counts[opcode] == 0) {
+                continue;
+            }
+            out << (first ? "" : ",") << '"';
+            if (OpcodeTable[opcode].mnemonic.empty()) {
+                out << "0x" << std::hex << opcode << std::dec;
+            } else {
+                out << OpcodeTable[opcode].mnemonic;
+            }
+            out << "\":" << static_cast<uint64_t>(counts[opcode] + 0.5);
+            first = false;
+        }
+        out << '}';
+    }
+}
+
+SampleReport Sampler::run(const SampleOptions& options, std::ostream& output, std::ostream& error) {
+    std::string program = readFile(options.binary, "binary");
+    std::string input = options.input.empty() ? std::string() : readFile(options.input, "input");
+    if (LoadAddress + program.size() > options.memorySize) {
+        throw std::runtime_error("Program exceeds available memory size");
+    }
+
+    SampleReport report;
+    auto start = std::chrono::steady_clock::now();
+    Guest guest(options.memorySize, program, input);
+    guest.streams.limit = std::numeric_limits<size_t>::max(); // Flushed at every checkpoint
+    uint8_t* ram = guest.cpu.memory.physicalSpan(0, options.memorySize);
+    std::memcpy(ram + LoadAddress, program.data(), program.size());
+    guest.cpu.registers.I0 = LoadAddress;
+
+    PageHistory history(options.memorySize);
+    std::vector<Checkpoint> checkpoints;
+    std::vector<uint64_t> lengths;
+    std::vector<Signature> signatures;
+    BlockCounter counter;
+    report.status = Status::BudgetExhausted;
+    while (report.instructions < options.budget) {
+        checkpoints.push_back({guest.cpu.registers, guest.syscalls.snapshot(), guest.streams.inputOffset, report.instructions});
+        report.checkpointBytes += history.capture(ram, checkpoints.size() - 1);
+        flushStreams(guest.streams, output, error);
+
+        Outcome outcome = execute(guest.cpu, std::min(options.interval, options.budget - report.instructions), counter);
+        report.instructions += outcome.executed;
+        if (outcome.executed > 0) {
+            lengths.push_back(outcome.executed);
+            signatures.push_back(project(counter.blocks, outcome.executed));
+        } else {
+            checkpoints.pop_back();
+        }
+        if (outcome.status != Status::BudgetExhausted) {
+            report.status = outcome.status;
+            report.exitCode = outcome.exitCode;
+            report.message = outcome.message;
+            break;
+        }
+    }
+    flushStreams(guest.streams, output, error);
+    report.intervals = lengths.size();
+    report.fastForwardSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (lengths.empty()) {
+        return report;
+    }
+
+    start = std::chrono::steady_clock::now();
+    std::vector<size_t> assignment = cluster(signatures, options.clusters);
+    size_t clusterCount = *std::max_element(assignment.begin(), assignment.end()) + 1;
+    std::vector<Signature> centroids(clusterCount, Signature{});
+    std::vector<size_t> members(clusterCount);
+    std::vector<uint64_t> covered(clusterCount);
+    for (size_t i = 0; i < assignment.size(); ++i) {
+        ++members[assignment[i]];
+        covered[assignment[i]] += lengths[i];
+        for (unsigned d = 0; d < Dimensions; ++d) {
+            centroids[assignment[i]][d] += signatures[i][d];
+        }
+    }
+    std::vector<size_t> representative(clusterCount, SIZE_MAX);
+    for (size_t i = 0; i < assignment.size(); ++i) {
+        size_t c = assignment[i];
+        Signature mean = centroids[c];
+        for (double& value : mean) {
+            value /= static_cast<double>(members[c]);
+        }
+        if (representative[c] == SIZE_MAX || distance(signatures[i], mean) < distance(signatures[representative[c]], mean)) {
+            representative[c] = i;
+        }
+    }
+    std::sort(representative.begin(), representative.end());
+    for (size_t index : representative) {
+        size_t c = assignment[index];
+        report.points.push_back({index, checkpoints[index].start, members[c],
+                                 static_cast<double>(covered[c]) / static_cast<double>(report.instructions), {}});
+    }
+
+    {
+        WorkStealingPool pool(options.threads);
+        for (SimulationPoint& point : report.points) {
+            size_t index = point.interval;
+            const Checkpoint* next = index + 1 < checkpoints.size() ? &checkpoints[index + 1] : nullptr;
+            pool.submit([&, index, next, &profile = point.profile]() {
+                replay(options, program, input, history, checkpoints[index], index, lengths[index], next, report, profile);
+            });
+        }
+        pool.wait();
+    }
+    report.replaySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+void Sampler::writeReport(std::ostream& out, const SampleOptions& options, const SampleReport& report) {
+    // Whole-run estimates: every point stands for its cluster, scaled from its own length to the run.
+    std::array<double, 64> opcodes{};
+    double transfers = 0;
+    double weights = 0;
+    for (const SimulationPoint& point : report.points) {
+        if (point.profile.instructions > 0) {
+            weights += point.weight;
+        }
+    }
+    for (const SimulationPoint& point : report.points) {
+        if (point.profile.instructions == 0) {
+            continue;
+        }
+        double scale = point.weight / weights * static_cast<double>(report.instructions) /
+                       static_cast<double>(point.profile.instructions);
+        for (size_t opcode = 0; opcode < opcodes.size(); ++opcode) {
+            opcodes[opcode] += static_cast<double>(point.profile.opcodes[opcode]) * scale;
+        }
+        transfers += static_cast<double>(point.profile.controlTransfers) * scale;
+    }
+
+    out << "{\"binary\":";
+    writeJsonString(out, options.binary);
+    out << ",\"status\":\"" << statusName(report.status) << '"';
+    if (report.status == Status::Exited) {
+        out << ",\"exit_code\":" << report.exitCode;
+    }
+    if (report.status == Status::Error) {
+        out << ",\"message\":";
+        writeJsonString(out, report.message);
+    }
+    out << ",\"instructions\":" << report.instructions << ",\"interval\":" << options.interval
+        << ",\"intervals\":" << report.intervals << ",\"points\":" << report.points.size()
+        << ",\"checkpoint_bytes\":" << report.checkpointBytes << ",\"fast_forward_seconds\":" << report.fastForwardSeconds
+        << ",\"replay_seconds\":" << report.replaySeconds << ",\"estimate\":{\"control_transfers\":"
+        << static_cast<uint64_t>(transfers + 0.5) << ",\"opcodes\":";
+    writeOpcodes(out, opcodes);
+    out << "}}\n";
+
+    for (const SimulationPoint& point : report.points) {
+        const IntervalProfile& profile = point.profile;
+        std::array<double, 64> counts{};
+        std::copy(profile.opcodes.begin(), profile.opcodes.end(), counts.begin());
+        out << "{\"interval\":" << point.interval << ",\"start\":" << point.start << ",\"members\":" << point.members
+            << ",\"weight\":" << point.weight << ",\"instructions\":" << profile.instructions
+            << ",\"control_transfers\":" << profile.controlTransfers << ",\"diverged\":" << (profile.diverged ? "true" : "false");
+        if (!profile.message.empty()) {
+            out << ",\"message\":";
+            writeJsonString(out, profile.message);
+        }
+        out << ",\"opcodes\":";
+        writeOpcodes(out, counts);
+        out << ",\"hot_blocks\":[";
+        for (size_t i = 0; i < profile.hotBlocks.size(); ++i) {
+            out << (i ? "," : "") << "{\"address\":" << profile.hotBlocks[i].first
+                << ",\"instructions\":" << profile.hotBlocks[i].second << '}';
+        }
+        out << "]}\n";
+    }
+}
@@ -1,254 +1,565 @@
 #include <utils/assembler.hpp>
-#include <fstream>
-#include <sstream>
-#include <stdexcept>
+#include <utils/mapped_file.hpp>
+#include <components/packed.hpp>
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
 
-int32_t Assembler::parseImmediate(const std::string& immStr) {
-    if (immStr.find("0x") == 0 || immStr.find("0X") == 0) {
-        return std::stoi(immStr, nullptr, 16);
-    } else {
-        return std::stoi(immStr);
+namespace {
+    using xr32::syntax::EncodingError;
+    using xr32::syntax::encodeOperands;
+    using xr32::syntax::isSymbolStart;
+    using xr32::syntax::parseNumber;
+
+    /**
+     * @brief Splits `symbol+n` / `symbol-n` into the symbol and its addend.
+     */
+    bool splitSymbol(std::string_view token, std::string_view& symbol, int64_t& addend) {
+        switch (xr32::syntax::splitSymbol(token, symbol, addend)) {
+            case xr32::syntax::SymbolForm::NotSymbol:
+                return false;
+            case xr32::syntax::SymbolForm::InvalidAddend:
+                throw std::runtime_error("Invalid expression: " + std::string(token));
+            case xr32::syntax::SymbolForm::Symbol:
+                break;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Decodes the body of a string literal with C escapes.
+     */
+    std::string parseString(std::string_view text) {
+        size_t open = text.find('"');
+        size_t close = text.rfind('"');
+        if (open == std::string_view::npos || close == open) {
+            throw std::runtime_error("Expected a quoted string");
+        }
+        std::string_view body = text.substr(open + 1, close - open - 1);
+        std::string bytes;
+        bytes.reserve(body.size());
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (body[i] != '\\' || i + 1 == body.size()) {
+                bytes.push_back(body[i]);
+                continue;
+            }
+            switch (body[++i]) {
+                case 'n': bytes.push_back('\n'); break;
+                case 't': bytes.push_back('\t'); break;
+                case 'r': bytes.push_back('\r'); break;
+                case '0': bytes.push_back('\0'); break;
+                default: bytes.push_back(body[i]); break;
+            }
+        }
+        return bytes;
     }
 }
 
+Assembler::Assembler(unsigned threadCount)
+    : threads(threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency())) {}
+
 bool Assembler::assemble(const std::string& sourceFile, const std::string& outputFile) {
-    std::ifstream input(sourceFile);
-    if (!input.is_open()) {
-        throw std::runtime_error("Failed to open source file: " + sourceFile);
+    MappedFile source(sourceFile);
+    size_t size = layout(source.view(), false);
+    MappedFile binary(outputFile, size);
+    try {
+        uint8_t* image = reinterpret_cast<uint8_t*>(binary.data());
+        encode({image, image});
+    } catch (const std::exception&) {
+        std::filesystem::remove(outputFile); // Do not leave a partly encoded binary behind
+        throw;
     }
+    return true;
+}
+
+std::vector<uint8_t> Assembler::assemble(std::string_view source) {
+    std::vector<uint8_t> machineCode(layout(source, false));
+    encode({machineCode.data(), machineCode.data()});
+    return machineCode;
+}
 
-    std::ofstream output(outputFile, std::ios::binary);
-    if (!output.is_open()) {
-        throw std::runtime_error("Failed to open output file: " + outputFile);
+ObjectFile Assembler::assembleObject(std::string_view source) {
+    (void)layout(source, true);
+    ObjectFile object;
+    for (size_t i = 0; i < ObjectFile::SectionCount; ++i) {
+        object.sections[i].resize(sectionSize[i]);
+        object.alignment[i] = sectionAlignment[i];
+    }
+    std::unordered_map<std::string_view, uint32_t> index;
+    auto addSymbol = [&](std::string_view name, Section section, int64_t value) {
+        index.emplace(name, static_cast<uint32_t>(ObjectFile::SectionSymbols + object.symbols.size()));
+        object.symbols.push_back({std::string(name), section, value});
+    };
+    for (std::string_view name : globalOrder) {
+        auto it = symbols.find(name);
+        if (it == symbols.end()) {
+            addSymbol(name, Section::Undefined, 0);
+        } else {
+            addSymbol(name, it->second.section, it->second.value);
+        }
     }
 
-    std::string line;
-    while (std::getline(input, line)) {
-        uint64_t machineCode = parseAssemblyLine(line);
-        output.write(reinterpret_cast<const char*>(&machineCode), sizeof(machineCode));
+    forEachChunk([this, &object](Chunk& chunk) {
+        encodeChunk(chunk, {object.sections[0].data(), object.sections[1].data()});
+    });
+    pool.reset();
+    throwFirstError();
+    for (Chunk& chunk : chunks) {
+        for (auto& [relocation, name] : chunk.relocations) {
+            if (!name.empty()) {
+                if (!index.contains(name)) {
+                    addSymbol(name, Section::Undefined, 0); // An import
+                }
+                relocation.symbol = index.at(name);
+            }
+            object.relocations.push_back(relocation);
+        }
     }
+    chunks.clear();
+    symbols.clear();
+    globals.clear();
+    globalOrder.clear();
+    return object;
+}
 
-    input.close();
-    output.close();
-    return true;
+void Assembler::assembleObject(const std::string& sourceFile, const std::string& objectFile) {
+    MappedFile source(sourceFile);
+    assembleObject(source.view()).write(objectFile);
 }
 
-uint64_t Assembler::parseAssemblyLine(const std::string& line) {
-    std::vector<std::string> tokens = tokenizeLine(line);
-    if (tokens.empty()) {
-        throw std::runtime_error("Failed to parse empty instruction");
+uint64_t Assembler::parseAssemblyLine(std::string_view line) {
+    std::vector<uint8_t> machineCode = assemble(line);
+    if (machineCode.size() != sizeof(uint64_t)) {
+        throw std::runtime_error("Expected exactly one instruction");
     }
+    uint64_t instruction;
+    std::memcpy(&instruction, machineCode.data(), sizeof(instruction));
+    return instruction;
+}
 
-    const std::string& mnemonic = tokens[0];
-    uint64_t opcode = CPU::findInstruction(mnemonic);
-
-    if (mnemonic == "NOP" || mnemonic == "HLT" || mnemonic == "IRET" || mnemonic == "RET") {
-        return (opcode << 58);
+size_t Assembler::layout(std::string_view source, bool object) {
+    chunks.clear();
+    symbols.clear();
+    globals.clear();
+    globalOrder.clear();
+    relocatable = object;
+    origin = DefaultOrigin;
+    while (!source.empty()) {
+        size_t end = source.size() <= ChunkSize ? std::string_view::npos : source.find('\n', ChunkSize);
+        end = end == std::string_view::npos ? source.size() : end + 1;
+        chunks.emplace_back().source = source.substr(0, end);
+        source.remove_prefix(end);
+    }
+    pool.reset();
+    if (chunks.size() > 1 && threads > 1) {
+        pool = std::make_unique<WorkStealingPool>(std::min<size_t>(threads, chunks.size()));
     }
 
-    if (mnemonic == "PUSH" || mnemonic == "POP") {
-        if (tokens.size() != 2) {
-            throw std::runtime_error(mnemonic + " requires exactly 1 register");
-        }
-        uint8_t rd = CPU::findRegister(tokens[1]);
-        if (rd == 0xFF) {
-            throw std::runtime_error("Invalid register in " + mnemonic + " instruction");
-        }
-        return (opcode << 58) | (static_cast<uint64_t>(rd) << 53);
+    forEachChunk([this](Chunk& chunk) { layoutChunk(chunk); });
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        chunks[i].firstLine = chunks[i - 1].firstLine + chunks[i - 1].lines;
+    }
+    throwFirstError();
+    place();
+    if (sectionSize[1] == 0) {
+        return sectionSize[0];
     }
+    return static_cast<size_t>(sectionBase[1] + sectionSize[1] - origin);
+}
 
-    if (mnemonic == "OUT" || mnemonic == "IN") {
-        if (tokens.size() != 3) {
-            throw std::runtime_error(mnemonic + " requires exactly 2 registers");
-        }
-        uint8_t rd = CPU::findRegister(tokens[1]);
-        uint8_t rs1 = CPU::findRegister(tokens[2]);
-        if (rd == 0xFF || rs1 == 0xFF) {
-            throw std::runtime_error("Invalid register in " + mnemonic + " instruction");
+void Assembler::encode(const std::array<uint8_t*, ObjectFile::SectionCount>& targets) {
+    forEachChunk([this, &targets](Chunk& chunk) { encodeChunk(chunk, targets); });
+    pool.reset();
+    throwFirstError();
+    chunks.clear();
+    symbols.clear(); // Keys point into the source
+    globals.clear();
+    globalOrder.clear();
+}
+
+template <typename Work>
+void Assembler::forEachChunk(Work work) {
+    if (!pool) {
+        for (Chunk& chunk : chunks) {
+            work(chunk);
         }
-        return (opcode << 58) | (static_cast<uint64_t>(rd) << 53) | (static_cast<uint64_t>(rs1) << 48);
+        return;
     }
+    for (Chunk& chunk : chunks) {
+        pool->submit([&work, &chunk] { work(chunk); });
+    }
+    pool->wait();
+}
 
-    if (mnemonic == "SWI") {
-        if (tokens.size() != 2) {
-            throw std::runtime_error("SWI requires exactly 1 immediate value");
+void Assembler::throwFirstError() const {
+    for (const Chunk& chunk : chunks) {
+        if (chunk.error) {
+            throw std::runtime_error("Line " + std::to_string(chunk.firstLine + chunk.errorLine) + ": " + *chunk.error);
         }
-        uint64_t immediate = std::stoul(tokens[1]);
-        return (opcode << 58) | ((immediate & 0xFF) << 16);
     }
+}
 
-    if (mnemonic == "NOT" || mnemonic == "NEG") {
-        if (tokens.size() != 3) {
-            throw std::runtime_error(mnemonic + " requires exactly 2 registers");
+void Assembler::layoutChunk(Chunk& chunk) const {
+    std::string_view source = chunk.source;
+    size_t offset = 0;
+    try {
+        Statement statement;
+        while (!source.empty()) {
+            size_t end = source.find('\n');
+            std::string_view line = source.substr(0, end);
+            source.remove_prefix(end == std::string_view::npos ? source.size() : end + 1);
+            ++chunk.lines;
+
+            // Instructions are always 8 bytes, so only directives need their operands lexed.
+            lex(line, statement, false);
+            if (!statement.mnemonic.empty() && statement.mnemonic.front() == '.') {
+                lex(line, statement, true);
+            }
+            for (std::string_view labels = statement.labels; !labels.empty();) {
+                chunk.items.push_back({LayoutItem::Kind::Label, offset, xr32::syntax::nextLabel(labels), {}, chunk.lines});
+                offset = 0;
+            }
+
+            const std::string_view mnemonic = statement.mnemonic;
+            if (mnemonic.empty()) {
+                continue;
+            }
+            if (mnemonic.front() != '.') {
+                offset += sizeof(uint64_t);
+                continue;
+            }
+            auto item = [&](LayoutItem::Kind kind, std::string_view name, std::string_view value) {
+                chunk.items.push_back({kind, offset, name, value, chunk.lines});
+                offset = 0;
+            };
+            const std::string_view value = statement.operandCount ? statement.operands[0] : std::string_view{};
+            if (mnemonic == ".equ") {
+                if (statement.operandCount != 2) {
+                    throw std::runtime_error(".equ requires a name and a value");
+                }
+                item(LayoutItem::Kind::Equ, statement.operands[0], statement.operands[1]);
+            } else if (mnemonic == ".align" || mnemonic == ".space" || mnemonic == ".org") {
+                if (statement.operandCount != 1) {
+                    throw std::runtime_error(std::string(mnemonic) + " requires exactly 1 operand");
+                }
+                item(mnemonic == ".align" ? LayoutItem::Kind::Align
+                                          : mnemonic == ".space" ? LayoutItem::Kind::Space : LayoutItem::Kind::Org,
+                     {}, value);
+            } else if (mnemonic == ".text" || mnemonic == ".data") {
+                if (statement.operandCount != 0) {
+                    throw std::runtime_error(std::string(mnemonic) + " takes no operands");
+                }
+                item(LayoutItem::Kind::Section, mnemonic, {});
+            } else if (mnemonic == ".global") {
+                if (statement.operandCount == 0) {
+                    throw std::runtime_error(".global requires a symbol name");
+                }
+                for (size_t i = 0; i < statement.operandCount; ++i) {
+                    item(LayoutItem::Kind::Global, statement.operands[i], {});
+                }
+            } else {
+                offset += dataSize(statement);
+            }
         }
-        uint8_t rd = CPU::findRegister(tokens[1]);
-        uint8_t rs1 = CPU::findRegister(tokens[2]);
-        uint8_t rs2 = 0;
-        if (rd == 0xFF || rs1 == 0xFF) {
-            throw std::runtime_error("Invalid register in " + mnemonic + " instruction");
+    } catch (const std::exception& e) {
+        chunk.errorLine = chunk.lines;
+        chunk.error = e.what();
+        // Keep counting so later chunks still know their first line
+        while (!source.empty()) {
+            size_t end = source.find('\n');
+            source.remove_prefix(end == std::string_view::npos ? source.size() : end + 1);
+            ++chunk.lines;
         }
-        return (opcode << 58) | (static_cast<uint64_t>(rd) << 53) |
-               (static_cast<uint64_t>(rs1) << 48) | (static_cast<uint64_t>(rs2) << 43);
     }
+    chunk.tail = offset;
+}
 
-    if (mnemonic == "INC" || mnemonic == "DEC") {
-        if (tokens.size() != 2) {
-            throw std::runtime_error(mnemonic + " requires exactly 1 register");
-        }
-        uint8_t rd = CPU::findRegister(tokens[1]);
-        if (rd == 0xFF) {
-            throw std::runtime_error("Invalid register in " + mnemonic + " instruction");
+void Assembler::place() {
+    size_t items = 0;
+    for (const Chunk& chunk : chunks) {
+        items += chunk.items.size();
+    }
+    symbols.reserve(items);
+
+    // Offsets within each section. A flat binary's .text starts at the origin, so its offsets are
+    // already addresses; .data is placed after it once its size is known.
+    std::array<uint64_t, ObjectFile::SectionCount> position{relocatable ? 0 : origin, 0};
+    sectionAlignment.fill(sizeof(uint64_t));
+    Section section = Section::Text;
+    for (Chunk& chunk : chunks) {
+        chunk.section = section;
+        chunk.start = position;
+        for (const LayoutItem& item : chunk.items) {
+            uint64_t& address = position[static_cast<size_t>(section)];
+            address += item.gap;
+            try {
+                switch (item.kind) {
+                    case LayoutItem::Kind::Label:
+                        define(item.name, {static_cast<int64_t>(address), section});
+                        break;
+                    case LayoutItem::Kind::Equ:
+                        define(item.name, evaluate(item.value));
+                        break;
+                    case LayoutItem::Kind::Align: {
+                        int64_t alignment = constant(item.value);
+                        if (alignment <= 0 || (alignment & (alignment - 1)) != 0 || alignment > 0x10000) {
+                            throw std::runtime_error(".align requires a power of two up to 65536");
+                        }
+                        uint32_t& sectionAlign = sectionAlignment[static_cast<size_t>(section)];
+                        sectionAlign = std::max(sectionAlign, static_cast<uint32_t>(alignment));
+                        address += (alignment - address % alignment) % alignment;
+                        break;
+                    }
+                    case LayoutItem::Kind::Space: {
+                        int64_t size = constant(item.value);
+                        if (size < 0) {
+                            throw std::runtime_error(".space requires a byte count");
+                        }
+                        address += static_cast<uint64_t>(size);
+                        break;
+                    }
+                    case LayoutItem::Kind::Org:
+                        if (relocatable) {
+                            throw std::runtime_error(".org cannot be used in an object; the linker places sections");
+                        }
+                        if (position[0] != origin || position[1] != 0) {
+                            throw std::runtime_error(".org must precede all code and data");
+                        }
+                        origin = static_cast<uint32_t>(constant(item.value));
+                        position[0] = origin;
+                        for (Chunk& empty : chunks) {
+                            empty.start[0] = origin; // This and all earlier chunks have no .text yet
+                            if (&empty == &chunk) {
+                                break;
+                            }
+                        }
+                        break;
+                    case LayoutItem::Kind::Section:
+                        section = item.name == ".text" ? Section::Text : Section::Data;
+                        break;
+                    case LayoutItem::Kind::Global:
+                        if (globals.insert(item.name).second) {
+                            globalOrder.push_back(item.name);
+                        }
+                        break;
+                }
+            } catch (const std::exception& e) {
+                throw std::runtime_error("Line " + std::to_string(chunk.firstLine + item.line) + ": " + e.what());
+            }
         }
-        return (opcode << 58) | (static_cast<uint64_t>(rd) << 53);
+        position[static_cast<size_t>(section)] += chunk.tail;
     }
 
-    if (mnemonic == "SEXT" || mnemonic == "ZEXT") {
-        if (tokens.size() != 3) {
-            throw std::runtime_error(mnemonic + " requires exactly 2 registers");
-        }
-        uint8_t rd = CPU::findRegister(tokens[1]);
-        uint8_t rs1 = CPU::findRegister(tokens[2]);
-        if (rd == 0xFF || rs1 == 0xFF) {
-            throw std::runtime_error("Invalid register in " + mnemonic + " instruction");
+    if (relocatable) {
+        sectionBase = {0, 0};
+        sectionSize = position;
+        return;
+    }
+    const uint64_t dataAlignment = sectionAlignment[1];
+    sectionBase = {0, (position[0] + dataAlignment - 1) / dataAlignment * dataAlignment};
+    sectionSize = {position[0] - origin, position[1]};
+    for (auto& [name, symbol] : symbols) {
+        if (symbol.section != Section::Absolute) {
+            symbol = {symbol.value + static_cast<int64_t>(sectionBase[static_cast<size_t>(symbol.section)]), Section::Absolute};
         }
-        return (opcode << 58) | (static_cast<uint64_t>(rd) << 53) |
-               (static_cast<uint64_t>(rs1) << 48);
     }
+}
 
-    if (mnemonic == "MTS" || mnemonic == "MFS") {
-        if (tokens.size() != 3) {
-            throw std::runtime_error(mnemonic + " requires exactly 2 registers");
-        }
-        uint8_t rd = CPU::findRegister(tokens[1]);
-        uint8_t rs1 = CPU::findRegister(tokens[2]);
-        if (rd == 0xFF || rs1 == 0xFF) {
-            throw std::runtime_error("Invalid register in " + mnemonic + " instruction");
+void Assembler::encodeChunk(Chunk& chunk, const std::array<uint8_t*, ObjectFile::SectionCount>& targets) const {
+    std::string_view source = chunk.source;
+    // Objects are laid out from 0 in separate buffers; a flat binary holds both sections from the origin.
+    const uint64_t imageBase = relocatable ? 0 : origin;
+    std::array<Cursor, ObjectFile::SectionCount> cursors;
+    for (size_t i = 0; i < ObjectFile::SectionCount; ++i) {
+        uint64_t address = sectionBase[i] + chunk.start[i];
+        cursors[i] = {targets[i] + (address - imageBase), address, static_cast<Section>(i)};
+    }
+    Cursor* at = &cursors[static_cast<size_t>(chunk.section)];
+    size_t line = 0;
+    try {
+        Statement statement;
+        while (!source.empty()) {
+            size_t end = source.find('\n');
+            std::string_view text = source.substr(0, end);
+            source.remove_prefix(end == std::string_view::npos ? source.size() : end + 1);
+            ++line;
+            lex(text, statement, true);
+            if (statement.mnemonic.empty()) {
+                continue;
+            }
+            if (statement.mnemonic == ".text" || statement.mnemonic == ".data") {
+                at = &cursors[statement.mnemonic == ".text" ? 0 : 1];
+            } else if (statement.mnemonic.front() == '.') {
+                encodeDirective(statement, *at, chunk);
+            } else {
+                encodeInstruction(statement, *at, chunk);
+            }
         }
-        return (opcode << 58) | (static_cast<uint64_t>(rd) << 53) |
-               (static_cast<uint64_t>(rs1) << 48);
+    } catch (const std::exception& e) {
+        chunk.errorLine = line;
+        chunk.error = e.what();
     }
+}
 
-    switch (opcode) {
-        case 0x01: // ADD
-        case 0x02: // SUB
-        case 0x03: // AND
-        case 0x04: // OR
-        case 0x05: // XOR
-        case 0x17: // MUL
-        case 0x18: // DIV
-        case 0x19: // MOD
-            return assembleRType(tokens);
-
-        case 0x08: // LDR
-        case 0x09: // STR
-        case 0x0C: // BEQ
-        case 0x0D: // BNE
-        case 0x0E: // MOV
-        case 0x0F: // CMP
-        case 0x21: // SEXT
-        case 0x22: // ZEXT
-        case 0x23: // MFS
-        case 0x24: // MTS
-        case 0x25: // OUT
-        case 0x26: // IN
-        case 0x06: // LSL
-        case 0x07: // LSR
-            return assembleIType(tokens);
-
-        case 0x0A: // JMP
-        case 0x0B: // JAL
-        case 0x12: // CALL
-            return assembleJType(tokens);
-
-        case 0xFFFFFFFF: // Invalid opcode case handled earlier
-            throw std::runtime_error("Invalid opcode: " + mnemonic);
-
-        default:
-            throw std::runtime_error("Unknown instruction type for opcode: " + mnemonic);
+void Assembler::lex(std::string_view line, Statement& statement, bool operands) {
+    if (!xr32::syntax::lex(line, statement, operands)) {
+        throw std::runtime_error("Too many operands");
     }
 }
 
-uint64_t Assembler::assembleRType(const std::vector<std::string>& tokens) {
-    if (tokens.size() != 4) {
-        throw std::runtime_error("R-Type instruction requires 3 operands (rd, rs1, rs2)");
+size_t Assembler::dataSize(const Statement& statement) {
+    const std::string_view directive = statement.mnemonic;
+    if (directive == ".byte") {
+        return statement.operandCount;
+    } else if (directive == ".word") {
+        return 4 * statement.operandCount;
+    } else if (directive == ".quad") {
+        return 8 * statement.operandCount;
+    } else if (directive == ".ascii" || directive == ".asciz") {
+        return parseString(statement.text).size() + (directive == ".asciz");
     }
+    throw std::runtime_error("Unknown directive: " + std::string(directive));
+}
 
-    uint8_t rd = CPU::findRegister(tokens[1]);
-    uint8_t rs1 = CPU::findRegister(tokens[2]);
-    uint8_t rs2 = CPU::findRegister(tokens[3]);
-    uint64_t opcode = CPU::findInstruction(tokens[0]);
-
-    if (rd == 0xFF || rs1 == 0xFF || rs2 == 0xFF) {
-        throw std::runtime_error("Invalid register in R-Type instruction");
+void Assembler::encodeInstruction(const Statement& statement, Cursor& at, Chunk& chunk) const {
+    const std::string_view mnemonic = statement.mnemonic;
+    uint64_t opcode = CPU::findInstruction(mnemonic);
+    uint64_t func = 0;
+    if (opcode == 0xFFFFFFFF) {
+        auto packed = PackedAlu::findMnemonic(mnemonic);
+        if (!packed) {
+            throw std::runtime_error("Invalid opcode: " + std::string(mnemonic));
+        }
+        opcode = PackedAlu::Opcode;
+        func = *packed;
     }
 
-    return (opcode << 58) | (static_cast<uint64_t>(rd) << 53) |
-           (static_cast<uint64_t>(rs1) << 48) | (static_cast<uint64_t>(rs2) << 43);
+    auto reject = [&](EncodingError error, std::string_view token, size_t count) {
+        switch (error) {
+            case EncodingError::WrongOperandCount:
+                throw std::runtime_error(std::string(token) + " requires exactly " + std::to_string(count) + " operand" +
+                                         (count == 1 ? "" : "s"));
+            case EncodingError::InvalidRegister:
+                throw std::runtime_error("Invalid register: " + std::string(token));
+            case EncodingError::InvalidSpecialRegister:
+                throw std::runtime_error("Invalid special register: " + std::string(token));
+            case EncodingError::InvalidOpcode:
+                break;
+        }
+        throw std::runtime_error("Unknown instruction type for opcode: " + std::string(token));
+    };
+    auto registers = [](std::string_view token) { return CPU::findRegister(token); };
+    auto resolve = [&](std::string_view token, FieldKind kind) { return operand(token, kind, at, chunk); };
+
+    uint64_t instruction = (opcode << 58) | (func << 29) |
+                           encodeOperands(opcode, statement, registers, resolve, reject);
+    std::memcpy(at.data, &instruction, sizeof(instruction));
+    at.data += sizeof(instruction);
+    at.address += sizeof(instruction);
 }
 
-uint64_t Assembler::assembleIType(const std::vector<std::string>& tokens) {
-    uint8_t rd, rs1;
-    int32_t immediate;
-    uint64_t opcode = CPU::findInstruction(tokens[0]);
-
-    if (tokens[0] == "LDR" || tokens[0] == "STR") {
-        if (tokens.size() == 3) {
-            // If rs1 is omitted, use 0x2D for absolute addressing
-            rd = CPU::findRegister(tokens[1]);
-            rs1 = 0x2D;
-            immediate = std::stoi(tokens[2]);
-        } else if (tokens.size() == 4) {
-            // Standard base + offset addressing
-            rd = CPU::findRegister(tokens[1]);
-            rs1 = CPU::findRegister(tokens[2]);
-            immediate = std::stoi(tokens[3]);
-        } else {
-            throw std::runtime_error(tokens[0] + " requires 2 or 3 operands");
+void Assembler::encodeDirective(const Statement& statement, Cursor& at, Chunk& chunk) const {
+    const std::string_view directive = statement.mnemonic;
+    const auto& op = statement.operands;
+    const size_t count = statement.operandCount;
+    // Layout and placement have checked these directives and sized the output for them
+    auto skip = [&](uint64_t bytes) {
+        at.data += bytes;
+        at.address += bytes;
+    };
+
+    if (directive == ".org" || directive == ".equ" || directive == ".global") {
+        return;
+    } else if (directive == ".byte") {
+        for (size_t i = 0; i < count; ++i) {
+            *at.data = static_cast<uint8_t>(constant(op[i]));
+            skip(1);
         }
-    } else if (tokens[0] == "MOV" || tokens[0] == "CMP") {
-        if (tokens.size() != 3) {
-            throw std::runtime_error(tokens[0] + " requires exactly 2 operands");
+    } else if (directive == ".word" || directive == ".quad") {
+        const bool quad = directive == ".quad";
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t value = operand(op[i], quad ? FieldKind::Quad : FieldKind::Word, at, chunk);
+            std::memcpy(at.data, &value, quad ? 8 : 4);
+            skip(quad ? 8 : 4);
         }
-        rd = CPU::findRegister(tokens[1]);
-        rs1 = CPU::findRegister(tokens[2]);
-        immediate = 0;
-    } else {
-        if (tokens.size() != 4) {
-            throw std::runtime_error(tokens[0] + " requires exactly 3 operands");
-        }
-        rd = CPU::findRegister(tokens[1]);
-        rs1 = CPU::findRegister(tokens[2]);
-        immediate = std::stoi(tokens[3]);
+    } else if (directive == ".ascii" || directive == ".asciz") {
+        std::string bytes = parseString(statement.text);
+        std::memcpy(at.data, bytes.data(), bytes.size());
+        skip(bytes.size() + (directive == ".asciz")); // The output is zero-filled
+    } else if (directive == ".align") {
+        uint64_t alignment = static_cast<uint64_t>(constant(op[0]));
+        skip((alignment - at.address % alignment) % alignment);
+    } else if (directive == ".space") {
+        skip(static_cast<uint64_t>(constant(op[0])));
     }
+}
 
-    if (rd == 0xFF || rs1 == 0xFF) {
-        throw std::runtime_error("Invalid register in " + tokens[0] + " instruction");
+void Assembler::define(std::string_view symbol, Symbol value) {
+    if (symbol.empty() || !isSymbolStart(symbol.front()) || CPU::findRegister(symbol) != 0xFF) {
+        throw std::runtime_error("Invalid symbol name: " + std::string(symbol));
+    }
+    if (!symbols.emplace(symbol, value).second) {
+        throw std::runtime_error("Symbol defined twice: " + std::string(symbol));
     }
-
-    return (opcode << 58) | (static_cast<uint64_t>(rd) << 53) |
-           (static_cast<uint64_t>(rs1) << 48) | ((static_cast<uint64_t>(immediate) & 0xFFFFFFFF) << 16);
 }
 
-uint64_t Assembler::assembleJType(const std::vector<std::string>& tokens) {
-    if (tokens.size() != 2) {
-        throw std::runtime_error("J-Type instruction requires 1 operand (address)");
+uint64_t Assembler::operand(std::string_view token, FieldKind kind, const Cursor& at, Chunk& chunk) const {
+    int64_t value;
+    if (parseNumber(token, value)) {
+        return ObjectFile::field(kind, value, at.address);
+    }
+    std::string_view symbol;
+    int64_t addend;
+    if (!splitSymbol(token, symbol, addend)) {
+        throw std::runtime_error("Invalid operand: " + std::string(token));
+    }
+    auto it = symbols.find(symbol);
+    if (it == symbols.end() && !relocatable) {
+        throw std::runtime_error("Undefined symbol: " + std::string(symbol));
+    }
+    if (it != symbols.end()) {
+        const Symbol& target = it->second;
+        // Numbers, and branches within a section, come out the same wherever the linker puts it
+        if (target.section == Section::Absolute || (kind == FieldKind::Branch && target.section == at.section)) {
+            return ObjectFile::field(kind, target.value + addend, at.address);
+        }
+    }
+    if (kind == FieldKind::Vector || kind == FieldKind::Shift) {
+        throw std::runtime_error("Operand must be a constant: " + std::string(token));
     }
 
-    uint64_t address = parseImmediate(tokens[1]);
-    uint64_t opcode = CPU::findInstruction(tokens[0]);
-
-    return (opcode << 58) | ((address & 0xFFFFFFFF) << 26);
+    ObjectFile::Relocation relocation{at.section, kind, static_cast<uint32_t>(at.address), 0, addend};
+    if (it != symbols.end() && !globals.contains(symbol)) {
+        // A local label: relative to its section, which needs no entry in the symbol table
+        relocation.symbol = static_cast<uint32_t>(it->second.section);
+        relocation.addend += it->second.value;
+        symbol = {};
+    }
+    chunk.relocations.emplace_back(relocation, symbol);
+    return 0;
 }
 
-std::vector<std::string> Assembler::tokenizeLine(const std::string& line) {
-    std::vector<std::string> tokens;
-    std::istringstream stream(line);
-    std::string token;
-
-    while (stream >> token) {
-        tokens.push_back(token);
+Assembler::Symbol Assembler::evaluate(std::string_view token) const {
+    int64_t value;
+    if (parseNumber(token, value)) {
+        return {value, Section::Absolute};
+    }
+    std::string_view symbol;
+    int64_t addend;
+    if (splitSymbol(token, symbol, addend)) {
+        if (auto it = symbols.find(symbol); it != symbols.end()) {
+            return {it->second.value + addend, it->second.section};
+        }
+        throw std::runtime_error("Symbol must be defined before use here: " + std::string(symbol));
     }
+    throw std::runtime_error("Invalid operand: " + std::string(token));
+}
 
-    return tokens;
-}
\ No newline at end of file
+int64_t Assembler::constant(std::string_view token) const {
+    Symbol symbol = evaluate(token);
+    if (symbol.section != Section::Absolute) {
+        throw std::runtime_error("Operand must be a constant: " + std::string(token));
+    }
+    return symbol.value;
+}
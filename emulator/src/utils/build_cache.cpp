@@ -0,0 +1,82 @@
+#include <utils/build_cache.hpp>
+#include <utils/hash.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::optional<std::filesystem::path> BuildCache::defaultDirectory() {
+    if (const char* dir = std::getenv("XR32_CACHE_DIR"); dir && *dir) {
+        return std::filesystem::path(dir);
+    }
+    if (const char* dir = std::getenv("XDG_CACHE_HOME"); dir && *dir) {
+        return std::filesystem::path(dir) / "xr32";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::filesystem::path(home) / ".cache" / "xr32";
+    }
+    return std::nullopt;
+}
+
+std::string BuildCache::key(std::string_view input, uint32_t toolVersion) {
+    // Two independently seeded hashes give a 128-bit name; accidental collisions are out of reach.
+    auto bytes = reinterpret_cast<const uint8_t*>(input.data());
+    uint64_t first = contentHash(bytes, input.size(), toolVersion);
+    uint64_t second = contentHash(bytes, input.size(), ~uint64_t(toolVersion));
+    char name[48];
+    std::snprintf(name, sizeof(name), "v%u-%016llx%016llx", toolVersion,
+                  static_cast<unsigned long long>(first), static_cast<unsigned long long>(second));
+    return name;
+}
+
+std::optional<std::vector<uint8_t>> BuildCache::load(const std::string& key) const {
+    int fd = ::open((directory / key).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    struct stat info{};
+    std::optional<std::vector<uint8_t>> output;
+    if (::fstat(fd, &info) == 0) {
+        std::vector<uint8_t> bytes(static_cast<size_t>(info.st_size));
+        size_t done = 0;
+        while (done < bytes.size()) {
+            ssize_t n = ::read(fd, bytes.data() + done, bytes.size() - done);
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        if (done == bytes.size()) {
+            output = std::move(bytes);
+        }
+    }
+    ::close(fd);
+    return output;
+}
+
+void BuildCache::store(const std::string& key, const std::vector<uint8_t>& output) const noexcept {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        return;
+    }
+    // Unique per process, so concurrent runs storing the same entry do not interleave their writes.
+    std::string path = (directory / key).string();
+    std::string temporary = path + "." + std::to_string(::getpid()) + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    size_t done = 0;
+    while (done < output.size()) {
+        ssize_t n = ::write(fd, output.data() + done, output.size() - done);
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    if (::close(fd) != 0 || done != output.size() || ::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+    }
+}
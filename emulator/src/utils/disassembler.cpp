@@ -0,0 +1,619 @@
+#include <utils/disassembler.hpp>
+#include <utils/assembly_syntax.hpp>
+#include <utils/mapped_file.hpp>
+#include <utils/object_file.hpp>
+#include <utils/json.hpp>
+#include <utils/work_stealing_pool.hpp>
+#include <components/cpu.hpp>
+#include <components/isa.hpp>
+#include <components/packed.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    using xr32::syntax::Operands;
+
+    /// Register names by encoding; empty where no register is defined.
+    constexpr auto RegisterNames = [] {
+        std::array<std::string_view, 64> names{};
+        for (const auto& [code, name] : Hex2Register) {
+            names[code] = name;
+        }
+        return names;
+    }();
+
+    constexpr char HexDigits[] = "0123456789abcdef";
+
+    /**
+     * @brief Whether a word is an instruction the emulator executes rather than an invalid opcode.
+     */
+    constexpr bool defined(uint64_t instruction) noexcept {
+        const auto opcode = static_cast<uint8_t>(instruction >> 58);
+        const Operands syntax = OpcodeTable[opcode].operands;
+        if (OpcodeTable[opcode].format == InstructionFormat::Invalid || syntax == Operands::Invalid) {
+            return false;
+        }
+        if (opcode == PackedAlu::Opcode) {
+            return PackedAlu::defined(static_cast<uint8_t>((instruction >> 29) & 0xFF));
+        }
+        return syntax != Operands::Special || !RegisterNames[0x20 | ((instruction >> 48) & 0x1F)].empty();
+    }
+
+    /**
+     * @brief Where a branch, jump or call at `address` goes.
+     */
+    constexpr uint64_t controlTarget(uint64_t instruction, uint64_t address) noexcept {
+        if (OpcodeTable[instruction >> 58].control == ControlFlow::Branch) {
+            const auto offset = static_cast<int32_t>(static_cast<uint32_t>(instruction >> 16));
+            return static_cast<uint32_t>(address + sizeof(uint64_t) + static_cast<uint64_t>(static_cast<int64_t>(offset)));
+        }
+        return static_cast<uint32_t>(instruction >> 26);
+    }
+
+    constexpr std::string_view edgeName(Disassembler::Edge::Kind kind) noexcept {
+        switch (kind) {
+            case Disassembler::Edge::Kind::Fallthrough: return "fallthrough";
+            case Disassembler::Edge::Kind::Branch: return "branch";
+            case Disassembler::Edge::Kind::Jump: return "jump";
+            case Disassembler::Edge::Kind::Call: return "call";
+        }
+        return "";
+    }
+
+    uint64_t wordAt(std::string_view image, size_t index) noexcept {
+        uint64_t word;
+        std::memcpy(&word, image.data() + index * sizeof(uint64_t), sizeof(word));
+        return word;
+    }
+}
+
+/**
+ * @brief A block of listing text. Once the block is full it is written to the sink, if there is
+ * one, and otherwise grown.
+ */
+class Disassembler::Listing {
+public:
+    Listing(std::ostream* output, size_t capacity) : sink(output), buffer(capacity) {}
+
+    void put(char c) {
+        room(1);
+        buffer[used++] = c;
+    }
+
+    void put(std::string_view text) {
+        room(text.size());
+        std::memcpy(buffer.data() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    /**
+     * @brief Writes the low `digits` nibbles of `value`, zero-padded.
+     */
+    void hex(uint64_t value, int digits) {
+        room(static_cast<size_t>(digits));
+        for (int i = digits - 1; i >= 0; --i) {
+            buffer[used + static_cast<size_t>(i)] = HexDigits[value & 0xF];
+            value >>= 4;
+        }
+        used += static_cast<size_t>(digits);
+    }
+
+    /**
+     * @brief Writes a number as `0x` hex, or in decimal if `decimal` is set.
+     */
+    template <typename Integer>
+    void number(Integer value, bool decimal) {
+        room(24);
+        if (!decimal) {
+            buffer[used++] = '0';
+            buffer[used++] = 'x';
+        }
+        char* end = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value, decimal ? 10 : 16).ptr;
+        used = static_cast<size_t>(end - buffer.data());
+    }
+
+    void flush() {
+        if (sink && used) {
+            sink->write(buffer.data(), static_cast<std::streamsize>(used));
+            used = 0;
+        }
+    }
+
+    [[nodiscard]] std::string_view text() const noexcept { return {buffer.data(), used}; }
+
+private:
+    void room(size_t bytes) {
+        if (buffer.size() - used >= bytes) {
+            return;
+        }
+        flush();
+        if (buffer.size() - used < bytes) {
+            buffer.resize(std::max(buffer.size() * 2, used + bytes));
+        }
+    }
+
+    std::ostream* sink;
+    std::vector<char> buffer;
+    size_t used{0};
+};
+
+Disassembler::Disassembler(uint64_t baseAddress, unsigned threadCount)
+    : base(baseAddress), threads(threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency())) {}
+
+void Disassembler::addSymbol(uint64_t address, std::string name) {
+    sorted = sorted && (symbols.empty() || symbols.back().first <= address);
+    symbols.emplace_back(address, std::move(name));
+}
+
+void Disassembler::loadSymbols(const std::string& path) {
+    MappedFile file(path);
+    std::string_view text = file.view();
+    size_t line = 0;
+    while (!text.empty()) {
+        size_t end = text.find('\n');
+        std::string_view content = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+        ++line;
+
+        xr32::syntax::Statement statement;
+        // Lexed like assembly: the address lands in the mnemonic, the name in the first operand
+        bool fits = xr32::syntax::lex(content, statement, true);
+        if (statement.mnemonic.empty()) {
+            continue;
+        }
+        int64_t address;
+        if (!fits || !statement.labels.empty() || statement.operandCount != 1 ||
+            !xr32::syntax::parseNumber(statement.mnemonic, address) || address < 0) {
+            throw std::runtime_error(path + ": line " + std::to_string(line) + ": expected <address> <name>");
+        }
+        addSymbol(static_cast<uint64_t>(address), std::string(statement.operands[0]));
+    }
+}
+
+void Disassembler::disassemble(std::string_view image, std::ostream& out) {
+    scan(image, &out, nullptr);
+}
+
+Disassembler::ControlFlowGraph Disassembler::controlFlow(std::string_view image) {
+    ControlFlowGraph graph;
+    scan(image, nullptr, &graph);
+    return graph;
+}
+
+void Disassembler::scan(std::string_view image, std::ostream* listing, ControlFlowGraph* graph) {
+    sortSymbols();
+    const size_t words = image.size() / sizeof(uint64_t);
+    const size_t chunkWords = ChunkSize / sizeof(uint64_t);
+    const size_t chunkCount = (words + chunkWords - 1) / chunkWords;
+    std::unique_ptr<WorkStealingPool> pool;
+    if (chunkCount > 1 && threads > 1) {
+        pool = std::make_unique<WorkStealingPool>(std::min<size_t>(threads, chunkCount));
+    }
+
+    // A batch of chunks is decoded at once and its listings written in order, so at most a batch of
+    // listings is held in memory. Without a pool the single chunk in flight writes straight through.
+    const size_t batch = pool ? pool->size() : 1;
+    std::vector<std::vector<uint64_t>> boundaries(graph ? chunkCount : 0);
+    for (size_t first = 0; first < chunkCount; first += batch) {
+        const size_t last = std::min(chunkCount, first + batch);
+        std::vector<Listing> texts;
+        texts.reserve(last - first);
+        for (size_t chunk = first; chunk < last; ++chunk) {
+            texts.emplace_back(pool ? nullptr : listing, listing ? BufferSize : 0);
+        }
+        auto work = [&](size_t chunk) {
+            const size_t begin = chunk * chunkWords;
+            const size_t end = std::min(words, begin + chunkWords);
+            if (listing) {
+                listWords(image, begin, end, texts[chunk - first]);
+            }
+            if (graph) {
+                findBoundaries(image, begin, end, boundaries[chunk]);
+            }
+        };
+        if (pool) {
+            for (size_t chunk = first; chunk < last; ++chunk) {
+                pool->submit([&work, chunk] { work(chunk); });
+            }
+            pool->wait();
+        } else {
+            for (size_t chunk = first; chunk < last; ++chunk) {
+                work(chunk);
+            }
+        }
+        if (listing) {
+            for (Listing& text : texts) {
+                listing->write(text.text().data(), static_cast<std::streamsize>(text.text().size()));
+            }
+        }
+    }
+    pool.reset();
+
+    const size_t tail = image.size() % sizeof(uint64_t);
+    if (listing && tail) {
+        Listing text(listing, 256);
+        text.hex(base + words * sizeof(uint64_t), base + image.size() > 0x100000000 ? 16 : 8);
+        text.put(":  ");
+        text.put(std::string_view("                  ", 18));
+        text.put(".byte");
+        for (size_t i = image.size() - tail; i < image.size(); ++i) {
+            text.put(i + tail == image.size() ? " " : ", ");
+            text.number(static_cast<uint8_t>(image[i]), false);
+        }
+        text.put('\n');
+        text.flush();
+    }
+
+    if (graph) {
+        std::vector<uint64_t> all;
+        size_t count = 0;
+        for (const auto& chunk : boundaries) {
+            count += chunk.size();
+        }
+        all.reserve(count);
+        for (auto& chunk : boundaries) {
+            all.insert(all.end(), chunk.begin(), chunk.end());
+            std::vector<uint64_t>().swap(chunk);
+        }
+        buildGraph(image, all, *graph);
+    }
+}
+
+void Disassembler::listWords(std::string_view image, size_t first, size_t last, Listing& out) const {
+    const int addressDigits = base + image.size() > 0x100000000 ? 16 : 8;
+    const uint64_t start = base + first * sizeof(uint64_t);
+    auto nextSymbol = std::lower_bound(symbols.begin(), symbols.end(), start,
+                                       [](const auto& symbol, uint64_t address) { return symbol.first < address; });
+    for (size_t i = first; i < last; ++i) {
+        const uint64_t address = base + i * sizeof(uint64_t);
+        for (; nextSymbol != symbols.end() && nextSymbol->first < address + sizeof(uint64_t); ++nextSymbol) {
+            if (nextSymbol->first == address) {
+                out.put('\n');
+                out.hex(address, addressDigits);
+                out.put(" <");
+                out.put(nextSymbol->second);
+                out.put(">:\n");
+            }
+        }
+        const uint64_t instruction = wordAt(image, i);
+        out.hex(address, addressDigits);
+        out.put(":  ");
+        out.hex(instruction, 16);
+        out.put("  ");
+        formatInstruction(instruction, address, out);
+        out.put('\n');
+    }
+    out.flush();
+}
+
+void Disassembler::findBoundaries(std::string_view image, size_t first, size_t last, std::vector<uint64_t>& boundaries) const {
+    const size_t words = image.size() / sizeof(uint64_t);
+    auto leader = [&](size_t index) {
+        if (index < words) {
+            boundaries.push_back(static_cast<uint64_t>(index) << 1);
+        }
+    };
+    if (first == 0) {
+        leader(0);
+    }
+    for (size_t i = first; i < last; ++i) {
+        const uint64_t instruction = wordAt(image, i);
+        if (!defined(instruction)) {
+            boundaries.push_back(static_cast<uint64_t>(i) << 1 | 1);
+            leader(i + 1);
+            continue;
+        }
+        const ControlFlow control = OpcodeTable[instruction >> 58].control;
+        if (control == ControlFlow::None) {
+            continue;
+        }
+        if (control == ControlFlow::Branch || control == ControlFlow::Jump || control == ControlFlow::Call) {
+            const uint64_t target = controlTarget(instruction, base + i * sizeof(uint64_t));
+            if (target >= base && (target - base) % sizeof(uint64_t) == 0) {
+                leader(static_cast<size_t>((target - base) / sizeof(uint64_t)));
+            }
+        }
+        leader(i + 1);
+    }
+}
+
+void Disassembler::buildGraph(std::string_view image, std::vector<uint64_t>& boundaries, ControlFlowGraph& graph) const {
+    const size_t words = image.size() / sizeof(uint64_t);
+    std::sort(boundaries.begin(), boundaries.end());
+    // Several words may start a block at the same index; an undefined word there wins.
+    size_t unique = 0;
+    for (uint64_t boundary : boundaries) {
+        if (unique && boundaries[unique - 1] >> 1 == boundary >> 1) {
+            boundaries[unique - 1] |= boundary;
+        } else {
+            boundaries[unique++] = boundary;
+        }
+    }
+    boundaries.resize(unique);
+
+    auto address = [&](uint64_t index) { return base + index * sizeof(uint64_t); };
+    for (size_t k = 0; k < boundaries.size(); ++k) {
+        if (boundaries[k] & 1) {
+            continue;
+        }
+        const uint64_t start = boundaries[k] >> 1;
+        const uint64_t end = k + 1 < boundaries.size() ? boundaries[k + 1] >> 1 : words;
+        const bool codeFollows = k + 1 < boundaries.size() && !(boundaries[k + 1] & 1);
+
+        BasicBlock& block = graph.blocks.emplace_back();
+        block.start = address(start);
+        block.end = address(end);
+        auto edge = [&](Edge::Kind kind, uint64_t target) { block.successors[block.successorCount++] = {kind, target}; };
+        const uint64_t last = wordAt(image, static_cast<size_t>(end - 1));
+        const uint64_t lastAddress = address(end - 1);
+        switch (OpcodeTable[last >> 58].control) {
+            case ControlFlow::Branch:
+                edge(Edge::Kind::Branch, controlTarget(last, lastAddress));
+                break;
+            case ControlFlow::Jump:
+                edge(Edge::Kind::Jump, controlTarget(last, lastAddress));
+                break;
+            case ControlFlow::Call:
+                edge(Edge::Kind::Call, controlTarget(last, lastAddress));
+                break;
+            case ControlFlow::Return:
+                continue;
+            case ControlFlow::Halt:
+            case ControlFlow::None:
+                break;
+        }
+        if (OpcodeTable[last >> 58].control != ControlFlow::Jump && codeFollows) {
+            edge(Edge::Kind::Fallthrough, block.end);
+        }
+    }
+
+    auto blockAt = [&](uint64_t target) -> size_t {
+        auto it = std::lower_bound(graph.blocks.begin(), graph.blocks.end(), target,
+                                   [](const BasicBlock& block, uint64_t value) { return block.start < value; });
+        return it != graph.blocks.end() && it->start == target ? static_cast<size_t>(it - graph.blocks.begin())
+                                                               : graph.blocks.size();
+    };
+
+    std::vector<size_t> entries;
+    if (!graph.blocks.empty() && graph.blocks.front().start == base) {
+        entries.push_back(0);
+    }
+    for (const BasicBlock& block : graph.blocks) {
+        for (uint8_t i = 0; i < block.successorCount; ++i) {
+            if (block.successors[i].kind == Edge::Kind::Call) {
+                if (size_t callee = blockAt(block.successors[i].target); callee < graph.blocks.size()) {
+                    entries.push_back(callee);
+                }
+            }
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    // Blocks reachable from each entry without following calls; shared blocks belong to every function that reaches them.
+    std::vector<size_t> visited(graph.blocks.size(), 0);
+    std::vector<size_t> pending;
+    for (size_t entry : entries) {
+        Function& function = graph.functions.emplace_back();
+        function.entry = graph.blocks[entry].start;
+        const size_t stamp = graph.functions.size();
+        pending.push_back(entry);
+        visited[entry] = stamp;
+        while (!pending.empty()) {
+            const size_t current = pending.back();
+            pending.pop_back();
+            function.blocks.push_back(current);
+            const BasicBlock& block = graph.blocks[current];
+            for (uint8_t i = 0; i < block.successorCount; ++i) {
+                if (block.successors[i].kind == Edge::Kind::Call) {
+                    continue;
+                }
+                size_t next = blockAt(block.successors[i].target);
+                if (next < graph.blocks.size() && visited[next] != stamp) {
+                    visited[next] = stamp;
+                    pending.push_back(next);
+                }
+            }
+        }
+        std::sort(function.blocks.begin(), function.blocks.end());
+    }
+}
+
+void Disassembler::writeControlFlow(const ControlFlowGraph& graph, uint64_t imageSize, std::ostream& out) const {
+    out << "{\"base\":" << base << ",\"size\":" << imageSize << ",\"blocks\":[";
+    for (size_t i = 0; i < graph.blocks.size(); ++i) {
+        const BasicBlock& block = graph.blocks[i];
+        out << (i ? ",\n" : "\n") << "{\"start\":" << block.start << ",\"end\":" << block.end << ",\"successors\":[";
+        for (uint8_t j = 0; j < block.successorCount; ++j) {
+            out << (j ? "," : "") << "{\"to\":" << block.successors[j].target << ",\"kind\":\""
+                << edgeName(block.successors[j].kind) << "\"}";
+        }
+        out << "]}";
+    }
+    out << "\n],\"functions\":[";
+    for (size_t i = 0; i < graph.functions.size(); ++i) {
+        const Function& function = graph.functions[i];
+        out << (i ? ",\n" : "\n") << "{\"entry\":" << function.entry;
+        if (const std::string* name = symbolAt(function.entry)) {
+            out << ",\"name\":";
+            writeJsonString(out, *name);
+        }
+        out << ",\"blocks\":[";
+        for (size_t j = 0; j < function.blocks.size(); ++j) {
+            out << (j ? "," : "") << graph.blocks[function.blocks[j]].start;
+        }
+        out << "]}";
+    }
+    out << "\n]}\n";
+}
+
+uint64_t Disassembler::disassemble(const std::string& binaryFile, const std::string& outputFile, const std::string& graphFile) {
+    MappedFile binary(binaryFile);
+    if (ObjectFile::isObject(binary.view())) {
+        throw std::runtime_error(binaryFile + " is an object file; link it with --link first");
+    }
+    std::ofstream out(outputFile, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Unable to open output file: " + outputFile);
+    }
+    ControlFlowGraph graph;
+    scan(binary.view(), &out, graphFile.empty() ? nullptr : &graph);
+    if (!out.flush()) {
+        throw std::runtime_error("Failed to write " + outputFile);
+    }
+    if (!graphFile.empty()) {
+        std::ofstream graphOut(graphFile);
+        if (!graphOut) {
+            throw std::runtime_error("Unable to open output file: " + graphFile);
+        }
+        writeControlFlow(graph, binary.view().size(), graphOut);
+        if (!graphOut.flush()) {
+            throw std::runtime_error("Failed to write " + graphFile);
+        }
+    }
+    return binary.view().size();
+}
+
+std::string Disassembler::disassembleInstruction(uint64_t instruction, uint64_t address) {
+    Listing listing(nullptr, 64);
+    Disassembler().formatInstruction(instruction, address, listing);
+    return std::string(listing.text());
+}
+
+void Disassembler::formatInstruction(uint64_t instruction, uint64_t address, Listing& out) const {
+    const auto opcode = static_cast<uint8_t>(instruction >> 58);
+    const auto rd = static_cast<uint8_t>((instruction >> 53) & 0x1F);
+    const auto rs1 = static_cast<uint8_t>((instruction >> 48) & 0x1F);
+    const auto rs2 = static_cast<uint8_t>((instruction >> 43) & 0x1F);
+    const auto shamt = static_cast<uint8_t>((instruction >> 37) & 0x3F);
+    const auto func = static_cast<uint8_t>((instruction >> 29) & 0xFF);
+    const auto immediate = static_cast<uint32_t>(instruction >> 16);
+    const auto target = static_cast<uint32_t>(instruction >> 26);
+    const Operands syntax = OpcodeTable[opcode].operands;
+    const std::string_view special = RegisterNames[0x20 | rs1];
+
+    if (!defined(instruction)) {
+        out.put(".quad ");
+        out.number(instruction, false);
+        return;
+    }
+
+    if (opcode == PackedAlu::Opcode) {
+        out.put(PackedAlu::operationMnemonic(func));
+        out.put('.');
+        out.put("NBH"[func & 3]);
+    } else {
+        out.put(OpcodeTable[opcode].mnemonic);
+    }
+    auto reg = [&](uint8_t index) {
+        out.put(' ');
+        out.put(RegisterNames[index]);
+    };
+    // An address shown by name if it has one
+    auto location = [&](uint64_t value) {
+        out.put(' ');
+        if (const std::string* name = symbolAt(value)) {
+            out.put(*name);
+            return true;
+        }
+        return false;
+    };
+
+    switch (syntax) {
+        case Operands::None:
+            break;
+        case Operands::One:
+            reg(rd);
+            break;
+        case Operands::Two:
+            reg(rd);
+            reg(rs1);
+            break;
+        case Operands::Three:
+            reg(rd);
+            reg(rs1);
+            reg(rs2);
+            break;
+        case Operands::Shift:
+            reg(rd);
+            reg(rs1);
+            out.put(' ');
+            out.number(shamt, true);
+            break;
+        case Operands::Memory:
+            reg(rd);
+            if (instruction & AbsoluteAddressBit) {
+                if (!location(immediate)) {
+                    out.number(immediate, false);
+                }
+                break;
+            }
+            out.put(" [");
+            out.put(RegisterNames[rs1]);
+            out.put(']');
+            if (rs1 != 0 || !location(immediate)) {
+                if (rs1 == 0) {
+                    out.number(immediate, false);
+                } else {
+                    out.put(' ');
+                    out.number(static_cast<int32_t>(immediate), true);
+                }
+            }
+            break;
+        case Operands::Branch: {
+            reg(rd);
+            reg(rs1);
+            const uint64_t destination = static_cast<uint32_t>(address + sizeof(uint64_t) + static_cast<int32_t>(immediate));
+            if (!location(destination)) {
+                out.number(static_cast<int32_t>(immediate), true);
+                out.put("  ; ");
+                out.number(destination, false);
+            }
+            break;
+        }
+        case Operands::Jump:
+            if (!location(target)) {
+                out.number(target, false);
+            }
+            break;
+        case Operands::Vector:
+            out.put(' ');
+            out.number(immediate, true);
+            break;
+        case Operands::Special:
+            if (opcode == 0x24) { // MTS special rd
+                out.put(' ');
+                out.put(special);
+                reg(rd);
+            } else {
+                reg(rd);
+                out.put(' ');
+                out.put(special);
+            }
+            break;
+        case Operands::Invalid:
+            break;
+    }
+}
+
+const std::string* Disassembler::symbolAt(uint64_t address) const {
+    if (symbols.empty()) {
+        return nullptr;
+    }
+    auto it = std::lower_bound(symbols.begin(), symbols.end(), address,
+                               [](const auto& symbol, uint64_t value) { return symbol.first < value; });
+    return it != symbols.end() && it->first == address ? &it->second : nullptr;
+}
+
+void Disassembler::sortSymbols() {
+    if (!sorted) {
+        std::stable_sort(symbols.begin(), symbols.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        sorted = true;
+    }
+}
@@ -0,0 +1,355 @@
+#include <utils/linker.hpp>
+#include <utils/byte_stream.hpp>
+#include <components/cpu.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+    constexpr char StateMagic[8] = {'X', 'R', '3', '2', 'L', 'N', 'K', '1'};
+
+    /// Fills text slack, so falling off the end of an object that grew less than its slot is harmless.
+    const uint64_t NopWord = static_cast<uint64_t>(CPU::findInstruction("NOP")) << 58;
+
+    constexpr uint64_t alignUp(uint64_t value, uint64_t alignment) noexcept {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint64_t slotSize(uint64_t length, bool incremental) noexcept {
+        if (!incremental) {
+            return alignUp(length, sizeof(uint64_t));
+        }
+        return alignUp(length + std::max(Linker::MinimumSlack, length / 4), sizeof(uint64_t));
+    }
+
+    int64_t modificationTime(const std::string& path) {
+        return static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+    }
+
+    void fillText(uint8_t* bytes, size_t size) noexcept {
+        for (size_t offset = 0; offset + sizeof(NopWord) <= size; offset += sizeof(NopWord)) {
+            std::memcpy(bytes + offset, &NopWord, sizeof(NopWord));
+        }
+    }
+}
+
+Linker::Report Linker::link(const std::vector<std::string>& objects, const std::string& output, bool incremental) {
+    if (objects.empty()) {
+        throw std::runtime_error("No objects to link");
+    }
+    if (incremental) {
+        if (auto report = incrementalLink(objects, output)) {
+            return *report;
+        }
+    }
+    return fullLink(objects, output, incremental);
+}
+
+Linker::Report Linker::fullLink(const std::vector<std::string>& objects, const std::string& output, bool incremental) {
+    std::vector<ObjectFile> files;
+    std::vector<Input> inputs(objects.size());
+    files.reserve(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        inputs[i].path = objects[i];
+        files.push_back(ObjectFile::read(objects[i]));
+    }
+
+    // All .text contributions, then all .data contributions
+    uint64_t address = origin;
+    uint64_t textEnd = origin;
+    for (size_t section = 0; section < SectionCount; ++section) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            address = alignUp(address, files[i].alignment[section]);
+            inputs[i].base[section] = address;
+            inputs[i].length[section] = files[i].sections[section].size();
+            inputs[i].capacity[section] = slotSize(inputs[i].length[section], incremental);
+            address += inputs[i].capacity[section];
+        }
+        if (section == 0) {
+            textEnd = address;
+        }
+    }
+    if (address - origin > UINT32_MAX) {
+        throw std::runtime_error("Linked image does not fit the address space");
+    }
+
+    SymbolTable table;
+    for (size_t i = 0; i < files.size(); ++i) {
+        describe(inputs[i], files[i]);
+        define(table, inputs, i);
+    }
+
+    std::vector<uint8_t> image(address - origin);
+    fillText(image.data(), textEnd - origin);
+    for (size_t i = 0; i < files.size(); ++i) {
+        for (size_t section = 0; section < SectionCount; ++section) {
+            std::vector<uint8_t> slot = render(files[i], inputs[i], section, table);
+            std::memcpy(image.data() + (inputs[i].base[section] - origin), slot.data(), slot.size());
+        }
+    }
+
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Failed to write output file: " + output);
+    }
+
+    std::error_code ignored;
+    if (incremental) {
+        writeState(statePath(output), State{origin, image.size(), modificationTime(output), std::move(inputs)});
+    } else {
+        std::filesystem::remove(statePath(output), ignored); // It would describe a different layout
+    }
+    return Report{objects.size(), objects.size(), false, image.size()};
+}
+
+std::optional<Linker::Report> Linker::incrementalLink(const std::vector<std::string>& objects, const std::string& output) {
+    std::optional<State> state = readState(statePath(output));
+    std::error_code error;
+    if (!state || state->origin != origin || state->inputs.size() != objects.size() ||
+        std::filesystem::file_size(output, error) != state->outputSize || error ||
+        modificationTime(output) != state->outputTime) {
+        return std::nullopt;
+    }
+    std::vector<Input>& inputs = state->inputs;
+    std::vector<size_t> changed;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        if (inputs[i].path != objects[i]) {
+            return std::nullopt;
+        }
+        if (std::filesystem::file_size(objects[i]) != inputs[i].fileSize || modificationTime(objects[i]) != inputs[i].fileTime) {
+            changed.push_back(i);
+        }
+    }
+    if (changed.empty()) {
+        return Report{objects.size(), 0, true, state->outputSize};
+    }
+
+    // Changed objects must still fit where they are
+    std::unordered_map<size_t, ObjectFile> files;
+    for (size_t i : changed) {
+        ObjectFile object = ObjectFile::read(objects[i]);
+        for (size_t section = 0; section < SectionCount; ++section) {
+            if (object.sections[section].size() > inputs[i].capacity[section] ||
+                inputs[i].base[section] % object.alignment[section] != 0) {
+                return std::nullopt;
+            }
+        }
+        files.emplace(i, std::move(object));
+    }
+
+    // Symbols whose value changed, appeared or disappeared make their importers stale too
+    std::unordered_map<std::string, int64_t> before;
+    for (size_t i : changed) {
+        for (const auto& [name, value] : inputs[i].exports) {
+            before.emplace(name, value);
+        }
+        for (size_t section = 0; section < SectionCount; ++section) {
+            inputs[i].length[section] = files.at(i).sections[section].size();
+        }
+        describe(inputs[i], files.at(i));
+    }
+    std::unordered_set<std::string> moved;
+    for (size_t i : changed) {
+        for (const auto& [name, value] : inputs[i].exports) {
+            auto it = before.find(name);
+            if (it == before.end() || it->second != value) {
+                moved.insert(name);
+            }
+            before.erase(name);
+        }
+    }
+    for (const auto& [name, value] : before) {
+        moved.insert(name);
+    }
+
+    SymbolTable table;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        define(table, inputs, i);
+    }
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (files.contains(i)) {
+            continue;
+        }
+        bool stale = std::any_of(inputs[i].imports.begin(), inputs[i].imports.end(),
+                                 [&](const std::string& name) { return moved.contains(name); });
+        if (stale) {
+            if (std::filesystem::file_size(objects[i]) != inputs[i].fileSize || modificationTime(objects[i]) != inputs[i].fileTime) {
+                return std::nullopt;
+            }
+            files.emplace(i, ObjectFile::read(objects[i]));
+        }
+    }
+
+    // Render everything before touching the output, so a failed relink leaves it as it was
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>> slots;
+    for (const auto& [i, object] : files) {
+        for (size_t section = 0; section < SectionCount; ++section) {
+            slots.emplace_back(inputs[i].base[section] - origin, render(object, inputs[i], section, table));
+        }
+    }
+    std::fstream file(output, std::ios::binary | std::ios::in | std::ios::out);
+    for (const auto& [offset, slot] : slots) {
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(reinterpret_cast<const char*>(slot.data()), static_cast<std::streamsize>(slot.size()));
+    }
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Failed to update output file: " + output);
+    }
+    state->outputTime = modificationTime(output);
+    writeState(statePath(output), *state);
+    return Report{objects.size(), files.size(), true, state->outputSize};
+}
+
+void Linker::describe(Input& input, const ObjectFile& object) {
+    input.fileSize = std::filesystem::file_size(input.path);
+    input.fileTime = modificationTime(input.path);
+    input.exports.clear();
+    input.imports.clear();
+    for (const ObjectFile::Symbol& symbol : object.symbols) {
+        switch (symbol.section) {
+            case ObjectFile::Section::Undefined:
+                input.imports.push_back(symbol.name);
+                break;
+            case ObjectFile::Section::Absolute:
+                input.exports.emplace_back(symbol.name, symbol.value);
+                break;
+            default:
+                input.exports.emplace_back(symbol.name, symbol.value + static_cast<int64_t>(input.base[static_cast<size_t>(symbol.section)]));
+                break;
+        }
+    }
+}
+
+void Linker::define(SymbolTable& table, const std::vector<Input>& inputs, size_t owner) {
+    for (const auto& [name, value] : inputs[owner].exports) {
+        auto [it, inserted] = table.emplace(name, Definition{value, owner});
+        if (!inserted) {
+            throw std::runtime_error("Symbol " + name + " is defined in both " + inputs[it->second.owner].path + " and " +
+                                     inputs[owner].path);
+        }
+    }
+}
+
+std::vector<uint8_t> Linker::render(const ObjectFile& object, const Input& input, size_t section, const SymbolTable& table) {
+    const std::vector<uint8_t>& contents = object.sections[section];
+    std::vector<uint8_t> slot(input.capacity[section]);
+    if (section == 0) {
+        fillText(slot.data(), slot.size());
+    }
+    std::memcpy(slot.data(), contents.data(), contents.size());
+    if (section == 0 && contents.size() % sizeof(uint64_t) != 0) {
+        // Data at the end of .text: clear the rest of its word rather than leave part of a NOP
+        std::memset(slot.data() + contents.size(), 0, sizeof(uint64_t) - contents.size() % sizeof(uint64_t));
+    }
+
+    for (const ObjectFile::Relocation& relocation : object.relocations) {
+        if (static_cast<size_t>(relocation.section) != section) {
+            continue;
+        }
+        int64_t value;
+        if (relocation.symbol < ObjectFile::SectionSymbols) {
+            value = static_cast<int64_t>(input.base[relocation.symbol]);
+        } else {
+            const ObjectFile::Symbol& symbol = object.symbols[relocation.symbol - ObjectFile::SectionSymbols];
+            auto it = table.find(symbol.name);
+            if (it == table.end()) {
+                throw std::runtime_error("Undefined symbol " + symbol.name + " referenced by " + input.path);
+            }
+            value = it->second.value;
+        }
+        const uint64_t address = input.base[section] + relocation.offset;
+        uint64_t bits;
+        try {
+            bits = ObjectFile::field(relocation.kind, value + relocation.addend, address);
+        } catch (const std::exception& e) {
+            throw std::runtime_error(input.path + ": relocation at " + std::to_string(relocation.offset) + ": " + e.what());
+        }
+        const size_t width = relocation.kind == ObjectFile::FieldKind::Word ? 4 : 8;
+        uint64_t current = 0;
+        std::memcpy(&current, slot.data() + relocation.offset, width);
+        current |= bits;
+        std::memcpy(slot.data() + relocation.offset, &current, width);
+    }
+    return slot;
+}
+
+std::optional<Linker::State> Linker::readState(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.size() < sizeof(StateMagic) || std::memcmp(bytes.data(), StateMagic, sizeof(StateMagic)) != 0) {
+        return std::nullopt;
+    }
+    try {
+        ByteReader in(bytes.data() + sizeof(StateMagic), bytes.size() - sizeof(StateMagic), "Corrupt link state");
+        State state;
+        state.origin = in.u32();
+        state.outputSize = in.u64();
+        state.outputTime = static_cast<int64_t>(in.u64());
+        state.inputs.resize(in.u32());
+        for (Input& input : state.inputs) {
+            input.path = in.string();
+            input.fileSize = in.u64();
+            input.fileTime = static_cast<int64_t>(in.u64());
+            for (size_t section = 0; section < SectionCount; ++section) {
+                input.base[section] = in.u64();
+                input.capacity[section] = in.u64();
+                input.length[section] = in.u64();
+            }
+            input.exports.resize(in.u32());
+            for (auto& [name, value] : input.exports) {
+                name = in.string();
+                value = static_cast<int64_t>(in.u64());
+            }
+            input.imports.resize(in.u32());
+            for (std::string& name : input.imports) {
+                name = in.string();
+            }
+        }
+        return state;
+    } catch (const std::exception&) {
+        return std::nullopt; // Relink from scratch
+    }
+}
+
+void Linker::writeState(const std::string& path, const State& state) {
+    ByteWriter out;
+    out.raw(StateMagic, sizeof(StateMagic));
+    out.u32(state.origin);
+    out.u64(state.outputSize);
+    out.u64(static_cast<uint64_t>(state.outputTime));
+    out.u32(static_cast<uint32_t>(state.inputs.size()));
+    for (const Input& input : state.inputs) {
+        out.string(input.path);
+        out.u64(input.fileSize);
+        out.u64(static_cast<uint64_t>(input.fileTime));
+        for (size_t section = 0; section < SectionCount; ++section) {
+            out.u64(input.base[section]);
+            out.u64(input.capacity[section]);
+            out.u64(input.length[section]);
+        }
+        out.u32(static_cast<uint32_t>(input.exports.size()));
+        for (const auto& [name, value] : input.exports) {
+            out.string(name);
+            out.u64(static_cast<uint64_t>(value));
+        }
+        out.u32(static_cast<uint32_t>(input.imports.size()));
+        for (const std::string& name : input.imports) {
+            out.string(name);
+        }
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(out.bytes.data()), static_cast<std::streamsize>(out.bytes.size()));
+    if (!file) {
+        throw std::runtime_error("Failed to write link state: " + path);
+    }
+}
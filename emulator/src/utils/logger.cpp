@@ -0,0 +1,147 @@
+#include <utils/logger.hpp>
+#include <algorithm>
+#include <bit>
+
+Logger::Logger(std::ostream& os, size_t capacity, OverflowPolicy policy)
+    : outStream(os), overflow(policy), mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+      slots(std::make_unique<Slot[]>(mask + 1)) {
+    for (size_t i = 0; i <= mask; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer = std::thread([this] { run(); });
+}
+
+Logger::~Logger() {
+    stopping.store(true, std::memory_order_release);
+    wake();
+    writer.join();
+}
+
+Logger::Slot* Logger::claim() noexcept {
+    uint64_t position = enqueued.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots[position & mask];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto lag = static_cast<int64_t>(sequence - position);
+        if (lag == 0) {
+            if (enqueued.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                return &slot;
+            }
+        } else if (lag < 0) {
+            // The writer has not consumed the message a lap behind
+            if (overflow == OverflowPolicy::Drop) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            wake();
+            std::this_thread::yield();
+            position = enqueued.load(std::memory_order_relaxed);
+        } else {
+            position = enqueued.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::publish(Slot& slot) noexcept {
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    wake();
+}
+
+void Logger::wake() noexcept {
+    // Pairs with the fence in run(): either the writer sees the new message or we see it sleeping.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+        sleeping.store(false, std::memory_order_relaxed);
+        sleeping.notify_one();
+    }
+}
+
+void Logger::flush() {
+    const uint64_t target = enqueued.load(std::memory_order_acquire);
+    uint64_t done = written.load(std::memory_order_acquire);
+    while (done < target) {
+        wake();
+        written.wait(done, std::memory_order_acquire);
+        done = written.load(std::memory_order_acquire);
+    }
+}
+
+void Logger::run() {
+    constexpr size_t BatchSize = 64 * 1024;
+    std::string text;
+    text.reserve(BatchSize);
+    uint64_t position = 0;
+    auto drain = [&] {
+        if (uint64_t lost = dropped.exchange(0, std::memory_order_relaxed)) {
+            writePrefix(LogLevel::WARN, text);
+            text += std::to_string(lost);
+            text += " log messages dropped\n";
+        }
+        if (!text.empty()) {
+            outStream.write(text.data(), static_cast<std::streamsize>(text.size()));
+            text.clear();
+        }
+        outStream.flush();
+        written.store(position, std::memory_order_release);
+        written.notify_all();
+    };
+
+    while (true) {
+        Slot& slot = slots[position & mask];
+        if (slot.sequence.load(std::memory_order_acquire) == position + 1) {
+            writePrefix(slot.level, text);
+            slot.render(slot.format, slot.payload, text);
+            text += '\n';
+            slot.sequence.store(position + mask + 1, std::memory_order_release);
+            ++position;
+            if (text.size() >= BatchSize) {
+                outStream.write(text.data(), static_cast<std::streamsize>(text.size()));
+                text.clear();
+            }
+            continue;
+        }
+
+        drain();
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (slot.sequence.load(std::memory_order_acquire) == position + 1) {
+            sleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        if (stopping.load(std::memory_order_acquire) && enqueued.load(std::memory_order_acquire) == position) {
+            return;
+        }
+        sleeping.wait(true, std::memory_order_relaxed);
+    }
+}
+
+void Logger::writePrefix(LogLevel level, std::string& out) {
+    switch (level) {
+        case LogLevel::DEBUG: out += "\033[1;34m[DEBUG]\033[0m "; break;
+        case LogLevel::WARN: out += "\033[2;33m[WARN]\033[0m "; break;
+        case LogLevel::ERROR: out += "\033[31m[ERROR]\033[0m "; break;
+        case LogLevel::FATAL: out += "\033[1;31m[FATAL]\033[0m "; break;
+        case LogLevel::LOG:
+        default: out += "[LOG] "; break;
+    }
+}
+
+bool Logger::copyText(std::string_view format, size_t& position, std::string& out) {
+    // LogFormat checked the format when it compiled, so every brace is escaped or opens `{}` / `{:x}`.
+    while (position < format.size()) {
+        const char c = format[position];
+        if ((c == '{' || c == '}') && position + 1 < format.size() && format[position + 1] == c) {
+            out += c;
+            position += 2;
+        } else if (c == '{') {
+            const size_t close = format.find('}', position);
+            const bool hex = close != position + 1;
+            position = close + 1;
+            return hex;
+        } else {
+            out += c;
+            ++position;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,120 @@
+#include <utils/object_file.hpp>
+#include <utils/byte_stream.hpp>
+#include <utils/mapped_file.hpp>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    constexpr char Magic[8] = {'X', 'R', '3', '2', 'O', 'B', 'J', '1'};
+
+    bool validSection(uint8_t section, bool symbolic) noexcept {
+        return section < ObjectFile::SectionCount ||
+               (symbolic && (section == static_cast<uint8_t>(ObjectFile::Section::Absolute) ||
+                             section == static_cast<uint8_t>(ObjectFile::Section::Undefined)));
+    }
+}
+
+uint64_t ObjectFile::field(FieldKind kind, int64_t value, uint64_t address) {
+    if (auto bits = tryField(kind, value, address)) {
+        return *bits;
+    }
+    if (kind == FieldKind::Branch) {
+        value -= static_cast<int64_t>(address + sizeof(uint64_t));
+    }
+    throw std::runtime_error("Value out of range: " + std::to_string(value));
+}
+
+bool ObjectFile::isObject(std::string_view bytes) noexcept {
+    return bytes.size() >= sizeof(Magic) && std::memcmp(bytes.data(), Magic, sizeof(Magic)) == 0;
+}
+
+std::vector<uint8_t> ObjectFile::serialize() const {
+    ByteWriter out;
+    out.raw(Magic, sizeof(Magic));
+    for (size_t i = 0; i < SectionCount; ++i) {
+        out.u32(alignment[i]);
+        out.blob(sections[i]);
+    }
+    out.u32(static_cast<uint32_t>(symbols.size()));
+    for (const Symbol& symbol : symbols) {
+        out.string(symbol.name);
+        out.u8(static_cast<uint8_t>(symbol.section));
+        out.u64(static_cast<uint64_t>(symbol.value));
+    }
+    out.u32(static_cast<uint32_t>(relocations.size()));
+    for (const Relocation& relocation : relocations) {
+        out.u8(static_cast<uint8_t>(relocation.section));
+        out.u8(static_cast<uint8_t>(relocation.kind));
+        out.u32(relocation.offset);
+        out.u32(relocation.symbol);
+        out.u64(static_cast<uint64_t>(relocation.addend));
+    }
+    return std::move(out.bytes);
+}
+
+ObjectFile ObjectFile::parse(std::string_view bytes) {
+    if (!isObject(bytes)) {
+        throw std::runtime_error("Not an XR-32 object file");
+    }
+    ByteReader in(reinterpret_cast<const uint8_t*>(bytes.data()) + sizeof(Magic), bytes.size() - sizeof(Magic),
+                  "Corrupt object file");
+    ObjectFile object;
+    for (size_t i = 0; i < SectionCount; ++i) {
+        object.alignment[i] = in.u32();
+        object.sections[i] = in.blob();
+        if (object.alignment[i] == 0 || (object.alignment[i] & (object.alignment[i] - 1)) != 0) {
+            throw std::runtime_error("Corrupt object file");
+        }
+    }
+    object.symbols.resize(in.u32());
+    for (Symbol& symbol : object.symbols) {
+        symbol.name = in.string();
+        uint8_t section = in.u8();
+        symbol.value = static_cast<int64_t>(in.u64());
+        if (!validSection(section, true)) {
+            throw std::runtime_error("Corrupt object file");
+        }
+        symbol.section = static_cast<Section>(section);
+    }
+    object.relocations.resize(in.u32());
+    for (Relocation& relocation : object.relocations) {
+        uint8_t section = in.u8();
+        uint8_t kind = in.u8();
+        relocation.offset = in.u32();
+        relocation.symbol = in.u32();
+        relocation.addend = static_cast<int64_t>(in.u64());
+        if (!validSection(section, false) || kind > static_cast<uint8_t>(FieldKind::Quad) ||
+            relocation.symbol >= SectionSymbols + object.symbols.size()) {
+            throw std::runtime_error("Corrupt object file");
+        }
+        relocation.section = static_cast<Section>(section);
+        relocation.kind = static_cast<FieldKind>(kind);
+        size_t width = relocation.kind == FieldKind::Word ? 4 : 8;
+        if (relocation.offset + width > object.sections[section].size()) {
+            throw std::runtime_error("Corrupt object file");
+        }
+    }
+    if (!in.done()) {
+        throw std::runtime_error("Corrupt object file");
+    }
+    return object;
+}
+
+ObjectFile ObjectFile::read(const std::string& path) {
+    MappedFile file(path);
+    try {
+        return parse(file.view());
+    } catch (const std::exception& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+}
+
+void ObjectFile::write(const std::string& path) const {
+    std::vector<uint8_t> bytes = serialize();
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file) {
+        throw std::runtime_error("Failed to write object file: " + path);
+    }
+}
@@ -0,0 +1,259 @@
+#include <xr32.h>
+#include <components/cpu.hpp>
+#include <components/snapshot.hpp>
+#include <components/syscalls.hpp>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief A boot core with its RAM, and the syscall layer of a user-mode machine.
+ */
+struct xr32_machine {
+    xr32_machine(size_t memorySize, uint32_t machineFlags) : cpu(memorySize), flags(machineFlags) {}
+
+    [[nodiscard]] bool userMode() const noexcept { return flags & XR32_MACHINE_USER_MODE; }
+
+    /**
+     * @brief (Re)creates the syscall layer so its memory layout starts above `imageEnd`.
+     */
+    void layOut() {
+        syscalls.reset();
+        syscalls = std::make_unique<SyscallEmulator>(cpu, imageEnd);
+        syscalls->attach(cpu);
+    }
+
+    CPU cpu;
+    uint32_t flags;
+    uint32_t imageEnd{0};                      ///< First address past the highest loaded image.
+    std::unique_ptr<SyscallEmulator> syscalls; ///< Set for user-mode machines once an image is loaded.
+    std::string error;                         ///< See xr32_last_error().
+};
+
+namespace {
+    /**
+     * @brief Runs an API call, turning exceptions into a status and the machine's error message.
+     */
+    template <typename Function>
+    xr32_status guarded(xr32_machine* machine, Function function) noexcept {
+        if (!machine) {
+            return XR32_ERROR_ARGUMENT;
+        }
+        machine->error.clear();
+        try {
+            return function(*machine);
+        } catch (const std::exception& e) {
+            machine->error = e.what();
+        } catch (...) {
+            machine->error = "Unknown error";
+        }
+        return XR32_ERROR_FAILED;
+    }
+
+    xr32_status fail(xr32_machine& machine, xr32_status status, const char* message) {
+        machine.error = message;
+        return status;
+    }
+
+    [[nodiscard]] bool validRegister(unsigned index) noexcept {
+        return index <= 0xFF && CPU::findRegister(static_cast<uint8_t>(index)) != "Unknown";
+    }
+}
+
+extern "C" {
+
+uint32_t xr32_api_version(void) {
+    return XR32_API_VERSION;
+}
+
+xr32_machine* xr32_create(size_t memory_size, uint32_t flags) {
+    try {
+        return new xr32_machine(memory_size, flags);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void xr32_destroy(xr32_machine* machine) {
+    delete machine;
+}
+
+xr32_status xr32_reset(xr32_machine* machine) {
+    return guarded(machine, [](xr32_machine& m) {
+        m.syscalls.reset();
+        m.imageEnd = 0;
+        m.cpu.reset();
+        m.cpu.memory.reset();
+        m.cpu.memory.flushTlb();
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_load_image(xr32_machine* machine, const void* image, size_t size, uint32_t address) {
+    return guarded(machine, [&](xr32_machine& m) {
+        if (!image && size) {
+            return fail(m, XR32_ERROR_ARGUMENT, "Image is null");
+        }
+        uint8_t* target = m.cpu.memory.physicalSpan(address, size);
+        if (!target) {
+            return fail(m, XR32_ERROR_RANGE, "Program exceeds available memory size");
+        }
+        std::memcpy(target, image, size);
+        m.cpu.registers.I0 = address;
+        m.imageEnd = std::max(m.imageEnd, static_cast<uint32_t>(address + size));
+        if (m.userMode()) {
+            m.layOut();
+        }
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_run(xr32_machine* machine, uint64_t budget, xr32_run_result* result) {
+    return guarded(machine, [&](xr32_machine& m) {
+        xr32_run_result outcome{XR32_STOP_BUDGET, 0, 0};
+        uint64_t start = m.cpu.retired();
+        try {
+            for (uint64_t step = 1; step <= budget; ++step) {
+                m.cpu.executeNextInstruction();
+                if ((step & 0x3FF) == 0 || m.cpu.halted()) {
+                    m.cpu.io.poll();
+                }
+            }
+        } catch (const GuestExit& exit) {
+            outcome.reason = XR32_STOP_EXITED;
+            outcome.exit_code = exit.status();
+        } catch (const CpuHalted&) {
+            outcome.reason = XR32_STOP_HALTED;
+        } catch (const std::exception& e) {
+            outcome.reason = XR32_STOP_FAULT;
+            m.error = e.what();
+        }
+        outcome.instructions = m.cpu.retired() - start;
+        if (result) {
+            *result = outcome;
+        }
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_get_register(xr32_machine* machine, unsigned index, uint32_t* value) {
+    return guarded(machine, [&](xr32_machine& m) {
+        if (!value || !validRegister(index)) {
+            return fail(m, XR32_ERROR_ARGUMENT, "Invalid register");
+        }
+        *value = index < m.cpu.registers.R.size() ? m.cpu.registers.R[index]
+                                                  : m.cpu.readSpecialRegister(static_cast<uint8_t>(index));
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_set_register(xr32_machine* machine, unsigned index, uint32_t value) {
+    return guarded(machine, [&](xr32_machine& m) {
+        if (!validRegister(index) || index == 0x2B || index == 0x35) { // PRR and CID are read-only
+            return fail(m, XR32_ERROR_ARGUMENT, "Invalid register");
+        }
+        if (index < m.cpu.registers.R.size()) {
+            m.cpu.registers.R[index] = value;
+        } else if (index == 0x20) {
+            m.cpu.registers.I0 = value; // The guest cannot write I0, the host can
+        } else {
+            m.cpu.writeSpecialRegister(static_cast<uint8_t>(index), value);
+        }
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_read_memory(xr32_machine* machine, uint32_t address, void* buffer, size_t size) {
+    return guarded(machine, [&](xr32_machine& m) {
+        if (!buffer && size) {
+            return fail(m, XR32_ERROR_ARGUMENT, "Buffer is null");
+        }
+        const uint8_t* source = m.cpu.memory.physicalSpan(address, size);
+        if (!source) {
+            return fail(m, XR32_ERROR_RANGE, "Access outside RAM");
+        }
+        std::memcpy(buffer, source, size);
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_write_memory(xr32_machine* machine, uint32_t address, const void* data, size_t size) {
+    return guarded(machine, [&](xr32_machine& m) {
+        if (!data && size) {
+            return fail(m, XR32_ERROR_ARGUMENT, "Data is null");
+        }
+        uint8_t* target = m.cpu.memory.physicalSpan(address, size);
+        if (!target) {
+            return fail(m, XR32_ERROR_RANGE, "Access outside RAM");
+        }
+        std::memcpy(target, data, size);
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_map_port(xr32_machine* machine, uint16_t port, xr32_port_read_fn read,
+                          xr32_port_write_fn write, void* context) {
+    return guarded(machine, [&](xr32_machine& m) {
+        try {
+            m.cpu.io.mapDevice(port,
+                [read, context, port]() { return read ? read(context, port) : 0u; },
+                [write, context, port](uint32_t value) {
+                    if (write) {
+                        write(context, port, value);
+                    }
+                });
+        } catch (const std::invalid_argument& e) {
+            return fail(m, XR32_ERROR_STATE, e.what());
+        }
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_raise_interrupt(xr32_machine* machine, uint8_t vector) {
+    return guarded(machine, [&](xr32_machine& m) {
+        m.cpu.raiseInterrupt(vector);
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_save_snapshot(xr32_machine* machine, const char* path, const char* parent) {
+    return guarded(machine, [&](xr32_machine& m) {
+        if (!path) {
+            return fail(m, XR32_ERROR_ARGUMENT, "Path is null");
+        }
+        MachineSnapshot::SaveOptions options;
+        if (parent) {
+            options.parent = parent;
+        }
+        // Callers run many machines side by side; one thread each keeps saves from oversubscribing the host.
+        options.threads = 1;
+        (void)MachineSnapshot::save(path, m.cpu, m.syscalls.get(), options);
+        return XR32_OK;
+    });
+}
+
+xr32_status xr32_restore_snapshot(xr32_machine* machine, const char* path) {
+    return guarded(machine, [&](xr32_machine& m) {
+        if (!path) {
+            return fail(m, XR32_ERROR_ARGUMENT, "Path is null");
+        }
+        if (MachineSnapshot::memorySize(path) != m.cpu.memory.size()) {
+            return fail(m, XR32_ERROR_STATE, "Snapshot RAM size differs from the machine's");
+        }
+        if (m.userMode() && !m.syscalls) {
+            m.layOut(); // The snapshot's host state replaces the layout
+        }
+        MachineSnapshot::restore(path, m.cpu, m.syscalls.get(), 1);
+        return XR32_OK;
+    });
+}
+
+const char* xr32_last_error(const xr32_machine* machine) {
+    return machine ? machine->error.c_str() : "";
+}
+
+} // extern "C"
@@ -0,0 +1,52 @@
+/**
+ * @file c_api_faults.c
+ * @brief Checks that guest faults stop xr32_run() with XR32_STOP_FAULT instead of taking down the host.
+ *
+ * Usage: c-api-faults
+ *
+ * Written in C so it also checks that xr32.h compiles as C. Each case runs a two-instruction user-mode
+ * guest, an arithmetic instruction followed by `SWI 0x80` (exit with `R1`), and prints one line; the
+ * program exits non-zero if any case fails.
+ */
+
+#include <xr32.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOAD_ADDRESS 0x1000u
+
+/* Instruction words as the assembler emits them. */
+#define DIV_R3_R1_R2 UINT64_C(0x6061100000000000)
+#define MOD_R3_R1_R2 UINT64_C(0x6461100000000000)
+#define SWI_0X80     UINT64_C(0x8000000000800000)
+
+static int run_case(const char* name, uint64_t instruction, uint32_t divisor, xr32_stop_reason expected,
+                    int32_t expected_exit_code) {
+    const uint64_t image[2] = {instruction, SWI_0X80};
+    xr32_run_result result;
+    xr32_machine* machine = xr32_create(1u << 20, XR32_MACHINE_USER_MODE);
+    int ok = machine != NULL &&
+             xr32_load_image(machine, image, sizeof(image), LOAD_ADDRESS) == XR32_OK &&
+             xr32_set_register(machine, 1, 7) == XR32_OK &&
+             xr32_set_register(machine, 2, divisor) == XR32_OK &&
+             xr32_run(machine, 100, &result) == XR32_OK &&
+             result.reason == expected &&
+             (expected != XR32_STOP_EXITED || result.exit_code == expected_exit_code);
+    printf("%s %s", ok ? "PASS" : "FAIL", name);
+    if (machine && expected == XR32_STOP_FAULT) {
+        printf(": %s", xr32_last_error(machine));
+    }
+    printf("\n");
+    xr32_destroy(machine);
+    return ok;
+}
+
+int main(void) {
+    int ok = 1;
+    ok &= run_case("DIV by zero faults", DIV_R3_R1_R2, 0, XR32_STOP_FAULT, 0);
+    ok &= run_case("MOD by zero faults", MOD_R3_R1_R2, 0, XR32_STOP_FAULT, 0);
+    ok &= run_case("DIV by two exits", DIV_R3_R1_R2, 2, XR32_STOP_EXITED, 7);
+    ok &= run_case("MOD by two exits", MOD_R3_R1_R2, 2, XR32_STOP_EXITED, 7);
+    return ok ? 0 : 1;
+}